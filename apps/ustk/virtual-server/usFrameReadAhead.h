@@ -0,0 +1,239 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usFrameReadAhead.h
+ * @brief Read-ahead cache of the frames of a 2D mhd/raw sequence.
+ */
+#ifndef US_FRAME_READ_AHEAD_H
+#define US_FRAME_READ_AHEAD_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <visp3/ustk_core/usMHDSequenceReader.h>
+
+/**
+ * @class usFrameReadAhead
+ * @brief Read-ahead cache of the frames of a 2D mhd/raw sequence.
+ *
+ * A reading thread loads the next frames of the sequence (with its own usMHDSequenceReader) in a bounded queue, so
+ * that the disk accesses are not on the critical path of the sending loop of the virtual server. The interface is
+ * the subset of usMHDSequenceReader used by the sending loop : acquire(), end() and getNextTimeStamp().
+ *
+ * ImageType can be usImageRF2D<short int>, usImagePreScan2D<unsigned char> or usImagePostScan2D<unsigned char>.
+ */
+template <class ImageType> class usFrameReadAhead
+{
+public:
+  explicit usFrameReadAhead(unsigned int capacity = 32);
+  ~usFrameReadAhead();
+
+  void acquire(ImageType &image, uint64_t &timestamp);
+
+  bool end() const;
+
+  uint64_t getNextTimeStamp();
+
+  bool isRunning() const;
+
+  void start(const std::string &sequenceDirectory, unsigned int firstImageNumber);
+  void stop();
+
+private:
+  void readingLoop();
+
+  usMHDSequenceReader m_reader;
+  unsigned int m_capacity;
+
+  std::deque<std::pair<ImageType, uint64_t> > m_frames;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_frameRead;
+  std::condition_variable m_frameConsumed;
+  std::thread m_thread;
+
+  unsigned int m_nextImageToRead;
+  unsigned int m_nextImageToDeliver;
+  unsigned int m_totalImageNumber;
+  bool m_running;
+};
+
+/**
+* Constructor.
+* @param capacity Maximum number of frames kept in memory ahead of the sending loop.
+*/
+template <class ImageType>
+usFrameReadAhead<ImageType>::usFrameReadAhead(unsigned int capacity)
+  : m_reader(), m_capacity(capacity), m_frames(), m_mutex(), m_frameRead(), m_frameConsumed(), m_thread(),
+    m_nextImageToRead(0), m_nextImageToDeliver(0), m_totalImageNumber(0), m_running(false)
+{
+  if (m_capacity == 0)
+    m_capacity = 1;
+}
+
+/**
+* Destructor, stops the reading thread.
+*/
+template <class ImageType> usFrameReadAhead<ImageType>::~usFrameReadAhead() { stop(); }
+
+/**
+* Starts the reading thread.
+* @param sequenceDirectory Directory containing the mhd/raw sequence.
+* @param firstImageNumber Index of the first frame to deliver with acquire().
+*/
+template <class ImageType>
+void usFrameReadAhead<ImageType>::start(const std::string &sequenceDirectory, unsigned int firstImageNumber)
+{
+  stop();
+
+  m_reader.setSequenceDirectory(sequenceDirectory);
+  m_totalImageNumber = (unsigned int)m_reader.getTotalImageNumber();
+  m_nextImageToRead = firstImageNumber;
+  m_nextImageToDeliver = firstImageNumber;
+  m_frames.clear();
+  m_running = true;
+
+  m_thread = std::thread(&usFrameReadAhead<ImageType>::readingLoop, this);
+}
+
+/**
+* Stops the reading thread, and drops the frames cached.
+*/
+template <class ImageType> void usFrameReadAhead<ImageType>::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+  }
+  m_frameConsumed.notify_all();
+  if (m_thread.joinable())
+    m_thread.join();
+  m_frames.clear();
+}
+
+/**
+* Returns true if the reading thread is started.
+*/
+template <class ImageType> bool usFrameReadAhead<ImageType>::isRunning() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_running;
+}
+
+/**
+* Reading thread : fills the queue until the end of the sequence, blocking when the queue is full.
+*/
+template <class ImageType> void usFrameReadAhead<ImageType>::readingLoop()
+{
+  while (true) {
+    unsigned int imageNumber;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_frameConsumed.wait(lock, [this] { return !m_running || m_frames.size() < m_capacity; });
+      if (!m_running || m_nextImageToRead >= m_totalImageNumber)
+        return;
+      imageNumber = m_nextImageToRead;
+    }
+
+    // disk access, out of the lock
+    std::pair<ImageType, uint64_t> frame;
+    try {
+      m_reader.getImage(imageNumber, frame.first, frame.second);
+    } catch (...) { // unreadable frame : the sequence ends here
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_totalImageNumber = imageNumber;
+      }
+      m_frameRead.notify_all();
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_frames.push_back(frame);
+      m_nextImageToRead++;
+    }
+    m_frameRead.notify_all();
+  }
+}
+
+/**
+* Fills the output image with the next frame of the sequence. Blocks if the frame is not read yet.
+* @param [out] image The next frame of the sequence.
+* @param [out] timestamp The timestamp of the frame.
+*/
+template <class ImageType> void usFrameReadAhead<ImageType>::acquire(ImageType &image, uint64_t &timestamp)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_nextImageToDeliver >= m_totalImageNumber)
+      throw(vpException(vpException::fatalError, "usFrameReadAhead : end of sequence reached !"));
+    m_frameRead.wait(lock, [this] { return !m_frames.empty() || m_nextImageToDeliver >= m_totalImageNumber; });
+    if (m_frames.empty())
+      throw(vpException(vpException::fatalError, "usFrameReadAhead : end of sequence reached !"));
+
+    image = m_frames.front().first;
+    timestamp = m_frames.front().second;
+    m_frames.pop_front();
+    m_nextImageToDeliver++;
+  }
+  m_frameConsumed.notify_all();
+}
+
+/**
+* Returns true if all the frames of the sequence were delivered.
+*/
+template <class ImageType> bool usFrameReadAhead<ImageType>::end() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_nextImageToDeliver >= m_totalImageNumber;
+}
+
+/**
+* Returns the timestamp of the next frame (blocks if the frame is not read yet).
+* @return The timestamp of the next frame.
+*/
+template <class ImageType> uint64_t usFrameReadAhead<ImageType>::getNextTimeStamp()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_nextImageToDeliver >= m_totalImageNumber)
+    throw(vpException(vpException::fatalError, "usFrameReadAhead : end of sequence reached !"));
+  m_frameRead.wait(lock, [this] { return !m_frames.empty() || m_nextImageToDeliver >= m_totalImageNumber; });
+  if (m_frames.empty())
+    throw(vpException(vpException::fatalError, "usFrameReadAhead : end of sequence reached !"));
+  return m_frames.front().second;
+}
+
+#endif // US_FRAME_READ_AHEAD_H
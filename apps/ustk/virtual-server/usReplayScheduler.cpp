@@ -0,0 +1,169 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include "usReplayScheduler.h"
+
+#include <iostream>
+#include <thread>
+
+#include <visp3/core/vpException.h>
+
+/**
+* Constructor, sets a real-time replay (speed factor of 1).
+*/
+usReplayScheduler::usReplayScheduler()
+  : m_speedFactor(1.0), m_asFastAsPossible(false), m_startTime(), m_firstTimestamp(0), m_windowStartTime(),
+    m_windowFirstTimestamp(0), m_windowLastTimestamp(0), m_windowFrameNumber(0), m_achievedFrameRate(0.0),
+    m_targetFrameRate(0.0), m_lateFrameNumber(0)
+{
+}
+
+/**
+* Starts the replay : the deadlines of the next frames are computed from now.
+* @param firstTimestamp Timestamp (in ms) of the first frame to send.
+*/
+void usReplayScheduler::start(uint64_t firstTimestamp)
+{
+  m_startTime = usClock::now();
+  m_firstTimestamp = firstTimestamp;
+
+  m_windowStartTime = m_startTime;
+  m_windowFirstTimestamp = firstTimestamp;
+  m_windowLastTimestamp = firstTimestamp;
+  m_windowFrameNumber = 0;
+  m_lateFrameNumber = 0;
+}
+
+/**
+* To call once a frame is written on the socket, to update the frame rate statistics.
+* @param timestamp Timestamp (in ms) of the frame sent.
+*/
+void usReplayScheduler::frameSent(uint64_t timestamp)
+{
+  m_windowFrameNumber++;
+  m_windowLastTimestamp = timestamp;
+
+  if (usClock::now() - m_windowStartTime >= std::chrono::seconds(1))
+    report();
+}
+
+/**
+* Waits until the deadline of the frame with the timestamp given. Returns immediately if the deadline is already
+* passed, or if the replay runs as fast as possible.
+* @param timestamp Timestamp (in ms) of the next frame to send.
+*/
+void usReplayScheduler::waitUntil(uint64_t timestamp)
+{
+  if (m_asFastAsPossible || timestamp < m_firstTimestamp)
+    return;
+
+  std::chrono::duration<double, std::milli> offset((timestamp - m_firstTimestamp) / m_speedFactor);
+  usClock::time_point deadline = m_startTime + std::chrono::duration_cast<usClock::duration>(offset);
+
+  if (usClock::now() > deadline)
+    m_lateFrameNumber++;
+  else
+    std::this_thread::sleep_until(deadline);
+}
+
+/**
+* Computes the frame rates on the current window, prints them and starts a new window.
+*/
+void usReplayScheduler::report()
+{
+  usClock::time_point now = usClock::now();
+  double elapsed = std::chrono::duration<double>(now - m_windowStartTime).count();
+  m_achievedFrameRate = m_windowFrameNumber / elapsed;
+
+  if (m_asFastAsPossible || m_windowLastTimestamp <= m_windowFirstTimestamp)
+    m_targetFrameRate = 0.0;
+  else
+    m_targetFrameRate =
+        (m_windowFrameNumber * 1000.0 * m_speedFactor) / (double)(m_windowLastTimestamp - m_windowFirstTimestamp);
+
+  std::cout << "replay : achieved " << m_achievedFrameRate << " fps, target ";
+  if (m_asFastAsPossible)
+    std::cout << "max";
+  else
+    std::cout << m_targetFrameRate << " fps";
+  std::cout << " (speed x" << m_speedFactor << ", " << m_lateFrameNumber << " late frames)" << std::endl;
+
+  m_windowStartTime = now;
+  m_windowFirstTimestamp = m_windowLastTimestamp;
+  m_windowFrameNumber = 0;
+}
+
+/**
+* Getter for the frame rate achieved on the last report window (1 second).
+* @return The frame rate achieved (in frames per second).
+*/
+double usReplayScheduler::getAchievedFrameRate() const { return m_achievedFrameRate; }
+
+/**
+* Getter for the number of frames sent after their deadline since the replay start.
+* @return The number of late frames.
+*/
+unsigned int usReplayScheduler::getLateFrameNumber() const { return m_lateFrameNumber; }
+
+/**
+* Getter for the speed factor of the replay.
+* @return The speed factor (1 for real-time replay).
+*/
+double usReplayScheduler::getSpeedFactor() const { return m_speedFactor; }
+
+/**
+* Getter for the frame rate targeted on the last report window (1 second).
+* @return The target frame rate (in frames per second), 0 if the replay runs as fast as possible.
+*/
+double usReplayScheduler::getTargetFrameRate() const { return m_targetFrameRate; }
+
+/**
+* Returns true if the frames are sent without waiting (timestamps ignored).
+*/
+bool usReplayScheduler::isAsFastAsPossible() const { return m_asFastAsPossible; }
+
+/**
+* Setter for the as fast as possible mode : frames are sent without waiting.
+* @param asFastAsPossible Boolean to activate / desactivate the mode.
+*/
+void usReplayScheduler::setAsFastAsPossible(bool asFastAsPossible) { m_asFastAsPossible = asFastAsPossible; }
+
+/**
+* Setter for the speed factor of the replay.
+* @param speedFactor The speed factor, from 0.5 (twice slower than the sequence) to 10.
+*/
+void usReplayScheduler::setSpeedFactor(double speedFactor)
+{
+  if (speedFactor < 0.5 || speedFactor > 10.0)
+    throw(vpException(vpException::badValue, "usReplayScheduler : speed factor must be between 0.5 and 10 !"));
+  m_speedFactor = speedFactor;
+}
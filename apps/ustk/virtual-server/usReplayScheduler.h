@@ -0,0 +1,98 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usReplayScheduler.h
+ * @brief Pacing of the frames sent by the virtual server.
+ */
+#ifndef US_REPLAY_SCHEDULER_H
+#define US_REPLAY_SCHEDULER_H
+
+#include <chrono>
+#include <stdint.h>
+
+/**
+ * @class usReplayScheduler
+ * @brief Pacing of the frames sent by the virtual server, based on the timestamps of the sequence replayed.
+ *
+ * Each frame deadline is computed from the start of the replay, on a monotonic clock : the deadline of a frame with
+ * timestamp t is start + (t - t0) / speedFactor, where t0 is the timestamp of the first frame sent. The error made on
+ * one frame (process scheduling, network write) is therefore not accumulated on the following ones. When the server
+ * is late, the frames are sent without waiting until the deadlines are met again.
+ *
+ * The replay can be accelerated or slowed down with a speed factor (from 0.5x to 10x), or run as fast as possible to
+ * stress the clients. The frame rate achieved is compared to the target frame rate, and printed every second.
+ */
+class usReplayScheduler
+{
+public:
+  usReplayScheduler();
+
+  void frameSent(uint64_t timestamp);
+
+  double getAchievedFrameRate() const;
+  unsigned int getLateFrameNumber() const;
+  double getSpeedFactor() const;
+  double getTargetFrameRate() const;
+
+  bool isAsFastAsPossible() const;
+
+  void setAsFastAsPossible(bool asFastAsPossible);
+  void setSpeedFactor(double speedFactor);
+
+  void start(uint64_t firstTimestamp);
+
+  void waitUntil(uint64_t timestamp);
+
+private:
+  typedef std::chrono::steady_clock usClock;
+
+  void report();
+
+  double m_speedFactor;
+  bool m_asFastAsPossible;
+
+  // replay origin
+  usClock::time_point m_startTime;
+  uint64_t m_firstTimestamp;
+
+  // statistics on the current report window
+  usClock::time_point m_windowStartTime;
+  uint64_t m_windowFirstTimestamp;
+  uint64_t m_windowLastTimestamp;
+  unsigned int m_windowFrameNumber;
+  double m_achievedFrameRate;
+  double m_targetFrameRate;
+  unsigned int m_lateFrameNumber;
+};
+
+#endif // US_REPLAY_SCHEDULER_H
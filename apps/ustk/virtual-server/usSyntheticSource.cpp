@@ -0,0 +1,320 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include "usSyntheticSource.h"
+
+#include <cmath>
+#include <cstring>
+
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpMath.h>
+#include <visp3/ustk_core/usFrameStamp.h>
+
+namespace
+{
+// number of frames computed in the content pool
+const unsigned int usSyntheticPoolSize = 8;
+
+// xorshift generator : cheap and good enough for speckle
+class usXorShift
+{
+public:
+  explicit usXorShift(uint32_t seed) : m_state(seed ? seed : 2463534242u) {}
+  // uniform in ]0,1]
+  double uniform()
+  {
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return (m_state + 1.0) / 4294967296.0;
+  }
+  // Rayleigh distributed envelope (unit scale)
+  double rayleigh() { return sqrt(-2.0 * log(uniform())); }
+
+private:
+  uint32_t m_state;
+};
+
+// shift applied along the scan lines for the frame count given (simulates a slow probe motion)
+unsigned int shiftForFrame(unsigned int frameCount, unsigned int length)
+{
+  return length == 0 ? 0 : ((frameCount / usSyntheticPoolSize) * 3) % length;
+}
+
+// copies src in dst with a circular shift (dst[i] = src[(i + shift) % length])
+template <class Type> void circularCopy(Type *dst, const Type *src, unsigned int length, unsigned int shift)
+{
+  memcpy(dst, src + shift, (length - shift) * sizeof(Type));
+  memcpy(dst + length - shift, src, shift * sizeof(Type));
+}
+}
+
+/**
+* Constructor, sets default settings : pre-scan 2D frames at 30 fps from a C5-2 like convex probe, and a 4DC7 like
+* tilting motor for 3D streams.
+*/
+usSyntheticSource::usSyntheticSource()
+  : m_imageType(us::PRESCAN_2D), m_height(0), m_width(0), m_frameRate(30.0), m_preScanSettings(), m_motorSettings(),
+    m_rfPool(), m_bModePool()
+{
+  m_preScanSettings.setTransducerRadius(0.0606);
+  m_preScanSettings.setScanLinePitch(0.0105);
+  m_preScanSettings.setTransducerConvexity(true);
+  m_preScanSettings.setTransmitFrequency(5000000);
+  m_preScanSettings.setSamplingFrequency(20000000);
+
+  m_motorSettings.setMotorRadius(0.0275);
+  m_motorSettings.setFramePitch(vpMath::rad(1.45));
+  m_motorSettings.setFrameNumber(31);
+  m_motorSettings.setMotorType(usMotorSettings::TiltingMotor);
+}
+
+/**
+* Computes the settings and the content pool. To call after the setters, and before generate().
+*/
+void usSyntheticSource::init()
+{
+  bool isRF = (m_imageType == us::RF_2D || m_imageType == us::RF_3D);
+
+  // default sizes
+  if (m_height == 0 || m_width == 0) {
+    if (isRF) {
+      m_height = 2000;
+      m_width = 128;
+    } else if (m_imageType == us::POSTSCAN_2D) {
+      m_height = 480;
+      m_width = 640;
+    } else {
+      m_height = 200;
+      m_width = 128;
+    }
+  }
+
+  if (m_height * m_width * (isRF ? 2 : 1) < usFrameStamp::size)
+    throw(vpException(vpException::badValue, "usSyntheticSource : frame size too small !"));
+
+  m_preScanSettings.setScanLineNumber(m_width);
+  if (isRF) // axial resolution given by the sampling frequency (speed of sound of 1540 m/s)
+    m_preScanSettings.setAxialResolution(1540.0 / (2.0 * m_preScanSettings.getSamplingFrequency()));
+  else
+    m_preScanSettings.setAxialResolution(0.15 / m_height);
+  m_preScanSettings.setDepth(m_preScanSettings.getAxialResolution() * m_height);
+
+  // content pool
+  m_rfPool.clear();
+  m_bModePool.clear();
+  usXorShift generator(12345);
+  unsigned int size = m_height * m_width;
+  if (isRF) {
+    // carrier sampled at the sampling frequency, speckle envelope and depth attenuation
+    double carrier = 2.0 * M_PI * m_preScanSettings.getTransmitFrequency() / m_preScanSettings.getSamplingFrequency();
+    m_rfPool.resize(usSyntheticPoolSize, std::vector<short int>(size));
+    for (unsigned int p = 0; p < usSyntheticPoolSize; p++) {
+      for (unsigned int j = 0; j < m_width; j++) {
+        short int *scanLine = &m_rfPool[p][j * m_height];
+        for (unsigned int i = 0; i < m_height; i++) {
+          double attenuation = exp(-2.0 * i / m_height);
+          scanLine[i] = (short int)(4000.0 * attenuation * generator.rayleigh() * sin(carrier * i + p));
+        }
+      }
+    }
+  } else {
+    // log-compressed speckle envelope
+    m_bModePool.resize(usSyntheticPoolSize, std::vector<unsigned char>(size));
+    for (unsigned int p = 0; p < usSyntheticPoolSize; p++) {
+      for (unsigned int k = 0; k < size; k++) {
+        double value = 80.0 * log(1.0 + 4.0 * generator.rayleigh());
+        m_bModePool[p][k] = (unsigned char)(value > 255.0 ? 255.0 : value);
+      }
+    }
+  }
+}
+
+/**
+* Generates a RF frame, and stamps it.
+* @param [out] frame The RF frame generated.
+* @param [in] frameCount Index of the frame in the stream.
+*/
+void usSyntheticSource::generate(usImageRF2D<short int> &frame, unsigned int frameCount) const
+{
+  if (m_rfPool.empty())
+    throw(vpException(vpException::notInitialized, "usSyntheticSource : RF source not initialized !"));
+
+  frame.resize(m_height, m_width);
+  frame.setImagePreScanSettings(m_preScanSettings);
+
+  const std::vector<short int> &content = m_rfPool[frameCount % usSyntheticPoolSize];
+  unsigned int shift = shiftForFrame(frameCount, m_height);
+  for (unsigned int j = 0; j < m_width; j++)
+    circularCopy(frame.bitmap + j * m_height, &content[j * m_height], m_height, shift);
+
+  usFrameStamp::write((unsigned char *)frame.bitmap, m_height * m_width * sizeof(short int), frameCount,
+                      usFrameStamp::now());
+}
+
+/**
+* Generates a pre-scan frame, and stamps it.
+* @param [out] frame The pre-scan frame generated.
+* @param [in] frameCount Index of the frame in the stream.
+*/
+void usSyntheticSource::generate(usImagePreScan2D<unsigned char> &frame, unsigned int frameCount) const
+{
+  if (m_bModePool.empty())
+    throw(vpException(vpException::notInitialized, "usSyntheticSource : pre-scan source not initialized !"));
+
+  frame.resize(m_height, m_width);
+  frame.setImagePreScanSettings(m_preScanSettings);
+
+  const std::vector<unsigned char> &content = m_bModePool[frameCount % usSyntheticPoolSize];
+  unsigned int size = m_height * m_width;
+  circularCopy(frame.bitmap, &content[0], size, shiftForFrame(frameCount, m_height) * m_width);
+
+  usFrameStamp::write(frame.bitmap, size, frameCount, usFrameStamp::now());
+}
+
+/**
+* Generates a post-scan frame, and stamps it.
+* @param [out] frame The post-scan frame generated.
+* @param [in] frameCount Index of the frame in the stream.
+*/
+void usSyntheticSource::generate(usImagePostScan2D<unsigned char> &frame, unsigned int frameCount) const
+{
+  if (m_bModePool.empty())
+    throw(vpException(vpException::notInitialized, "usSyntheticSource : post-scan source not initialized !"));
+
+  frame.resize(m_height, m_width);
+  frame.setTransducerSettings(m_preScanSettings);
+  frame.setWidthResolution(m_preScanSettings.getDepth() / m_height);
+  frame.setHeightResolution(m_preScanSettings.getDepth() / m_height);
+
+  const std::vector<unsigned char> &content = m_bModePool[frameCount % usSyntheticPoolSize];
+  unsigned int size = m_height * m_width;
+  circularCopy(frame.bitmap, &content[0], size, shiftForFrame(frameCount, m_height) * m_width);
+
+  usFrameStamp::write(frame.bitmap, size, frameCount, usFrameStamp::now());
+}
+
+/**
+* Getter for the frame rate.
+* @return The frame rate, in frames per second.
+*/
+double usSyntheticSource::getFrameRate() const { return m_frameRate; }
+
+/**
+* Getter for the frame height (samples per scan line, or pixels along y for post-scan frames).
+*/
+unsigned int usSyntheticSource::getHeight() const { return m_height; }
+
+/**
+* Getter for the type of stream generated.
+*/
+us::ImageType usSyntheticSource::getImageType() const { return m_imageType; }
+
+/**
+* Getter for the motor settings (3D streams).
+*/
+usMotorSettings usSyntheticSource::getMotorSettings() const { return m_motorSettings; }
+
+/**
+* Getter for the transducer settings and axial resolution of the frames.
+*/
+usImagePreScanSettings usSyntheticSource::getPreScanSettings() const { return m_preScanSettings; }
+
+/**
+* Getter for the frame width (scan line number, or pixels along x for post-scan frames).
+*/
+unsigned int usSyntheticSource::getWidth() const { return m_width; }
+
+/**
+* Returns true if the stream is made of volumes sent frame by frame (RF 3D or pre-scan 3D).
+*/
+bool usSyntheticSource::is3D() const { return m_imageType == us::RF_3D || m_imageType == us::PRESCAN_3D; }
+
+/**
+* Setter for the frame rate.
+* @param frameRate The frame rate, in frames per second.
+*/
+void usSyntheticSource::setFrameRate(double frameRate)
+{
+  if (frameRate <= 0.0)
+    throw(vpException(vpException::badValue, "usSyntheticSource : frame rate must be positive !"));
+  m_frameRate = frameRate;
+}
+
+/**
+* Setter for the frame size.
+* @param height Samples per scan line (pixels along y for post-scan frames).
+* @param width Scan line number (pixels along x for post-scan frames).
+*/
+void usSyntheticSource::setFrameSize(unsigned int height, unsigned int width)
+{
+  m_height = height;
+  m_width = width;
+}
+
+/**
+* Setter for the type of stream generated.
+* @param imageType RF_2D, RF_3D, PRESCAN_2D, PRESCAN_3D or POSTSCAN_2D.
+*/
+void usSyntheticSource::setImageType(us::ImageType imageType)
+{
+  if (imageType != us::RF_2D && imageType != us::RF_3D && imageType != us::PRESCAN_2D &&
+      imageType != us::PRESCAN_3D && imageType != us::POSTSCAN_2D)
+    throw(vpException(vpException::badValue, "usSyntheticSource : image type not managed !"));
+  m_imageType = imageType;
+}
+
+/**
+* Setter for the type of stream generated, from its name on the command line.
+* @param imageType "rf2d", "rf3d", "prescan2d", "prescan3d" or "postscan2d".
+*/
+void usSyntheticSource::setImageType(const std::string &imageType)
+{
+  if (imageType == "rf2d")
+    setImageType(us::RF_2D);
+  else if (imageType == "rf3d")
+    setImageType(us::RF_3D);
+  else if (imageType == "prescan2d")
+    setImageType(us::PRESCAN_2D);
+  else if (imageType == "prescan3d")
+    setImageType(us::PRESCAN_3D);
+  else if (imageType == "postscan2d")
+    setImageType(us::POSTSCAN_2D);
+  else
+    throw(vpException(vpException::badValue, "usSyntheticSource : unknown image type " + imageType));
+}
+
+/**
+* Setter for the motor settings (3D streams).
+* @param motorSettings The motor settings (frame number gives the frames per volume).
+*/
+void usSyntheticSource::setMotorSettings(const usMotorSettings &motorSettings) { m_motorSettings = motorSettings; }
@@ -0,0 +1,101 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usSyntheticSource.h
+ * @brief Generator of synthetic ultrasound frames, used by the virtual server to produce unbounded streams.
+ */
+#ifndef US_SYNTHETIC_SOURCE_H
+#define US_SYNTHETIC_SOURCE_H
+
+#include <string>
+#include <vector>
+
+#include <visp3/ustk_core/us.h>
+#include <visp3/ustk_core/usImagePostScan2D.h>
+#include <visp3/ustk_core/usImagePreScan2D.h>
+#include <visp3/ustk_core/usImageRF2D.h>
+#include <visp3/ustk_core/usMotorSettings.h>
+
+/**
+ * @class usSyntheticSource
+ * @brief Generator of synthetic ultrasound frames, used by the virtual server to produce unbounded streams (soak and
+ * scaling tests of the clients).
+ *
+ * Frames have configurable dimensions, frame rate, transducer and motor settings (for RF 3D and pre-scan 3D streams,
+ * volumes are sent frame by frame as the real server does). Their content is a speckle-like pattern (Rayleigh
+ * distributed envelope, modulated by the transmit frequency for RF frames), computed once in a small pool of frames :
+ * each frame sent is a frame of the pool shifted along the scan lines, so that generating a frame costs a copy.
+ *
+ * Each frame embeds a usFrameStamp (frame count, send time and checksum), for the client to check the stream
+ * integrity and measure the end-to-end latency.
+ */
+class usSyntheticSource
+{
+public:
+  usSyntheticSource();
+
+  void generate(usImageRF2D<short int> &frame, unsigned int frameCount) const;
+  void generate(usImagePreScan2D<unsigned char> &frame, unsigned int frameCount) const;
+  void generate(usImagePostScan2D<unsigned char> &frame, unsigned int frameCount) const;
+
+  double getFrameRate() const;
+  unsigned int getHeight() const;
+  us::ImageType getImageType() const;
+  usMotorSettings getMotorSettings() const;
+  usImagePreScanSettings getPreScanSettings() const;
+  unsigned int getWidth() const;
+
+  void init();
+
+  bool is3D() const;
+
+  void setFrameRate(double frameRate);
+  void setFrameSize(unsigned int height, unsigned int width);
+  void setImageType(us::ImageType imageType);
+  void setImageType(const std::string &imageType);
+  void setMotorSettings(const usMotorSettings &motorSettings);
+
+private:
+  us::ImageType m_imageType;
+  unsigned int m_height; // samples along a scan line (pixels along y for post-scan)
+  unsigned int m_width;  // scan line number (pixels along x for post-scan)
+  double m_frameRate;
+  usImagePreScanSettings m_preScanSettings;
+  usMotorSettings m_motorSettings;
+
+  // pool of frames used as content (column-major for RF, row-major for the others)
+  std::vector<std::vector<short int> > m_rfPool;
+  std::vector<std::vector<unsigned char> > m_bModePool;
+};
+
+#endif // US_SYNTHETIC_SOURCE_H
@@ -35,7 +35,8 @@
 /**
 * Constructor, sets the sequence path to open.
 * @param sequencePath The path to the sequence to replay : xml file for pre-scan 2D or post-scan 2D (using
-* usSequenceReader), or directory containing mhd/raw files (using usMHDSequenceReader).
+* usSequenceReader), or directory containing mhd/raw files (using usMHDSequenceReader). Not used if the
+* --synthetic option is given.
 * @param parent The optionnal QObject parent.
 */
 usVirtualServer::usVirtualServer(std::string sequencePath, QObject *parent)
@@ -60,9 +61,56 @@ usVirtualServer::usVirtualServer(std::string sequencePath, QObject *parent)
     std::cout << "Rewind option activated\n";
   }
 
+  m_useReadAhead = false;
+
+  if (qApp->arguments().contains(QString("--speed"))) {
+    QString speed = qApp->arguments().at(qApp->arguments().indexOf(QString("--speed")) + 1);
+    if (speed == QString("max")) {
+      m_replayScheduler.setAsFastAsPossible(true);
+      std::cout << "Replay speed : as fast as possible\n";
+    } else {
+      m_replayScheduler.setSpeedFactor(speed.toDouble());
+      std::cout << "Replay speed factor : " << m_replayScheduler.getSpeedFactor() << "\n";
+    }
+  }
+
+  m_isSynthetic = false;
+
+  if (qApp->arguments().contains(QString("--synthetic"))) {
+    m_isSynthetic = true;
+    QStringList arguments = qApp->arguments();
+    m_syntheticSource.setImageType(arguments.at(arguments.indexOf(QString("--synthetic")) + 1).toStdString());
+
+    if (arguments.contains(QString("--size"))) { // <height>x<width>
+      QStringList size = arguments.at(arguments.indexOf(QString("--size")) + 1).split(QString("x"));
+      if (size.size() != 2)
+        throw(vpException(vpException::badValue, "usVirtualServer error : --size expects <height>x<width> !"));
+      m_syntheticSource.setFrameSize(size.at(0).toUInt(), size.at(1).toUInt());
+    }
+    if (arguments.contains(QString("--fps")))
+      m_syntheticSource.setFrameRate(arguments.at(arguments.indexOf(QString("--fps")) + 1).toDouble());
+
+    usMotorSettings motorSettings = m_syntheticSource.getMotorSettings();
+    if (arguments.contains(QString("--frames-per-volume")))
+      motorSettings.setFrameNumber(arguments.at(arguments.indexOf(QString("--frames-per-volume")) + 1).toUInt());
+    if (arguments.contains(QString("--frame-pitch"))) // degrees
+      motorSettings.setFramePitch(
+          vpMath::rad(arguments.at(arguments.indexOf(QString("--frame-pitch")) + 1).toDouble()));
+    if (arguments.contains(QString("--motor-radius"))) // meters
+      motorSettings.setMotorRadius(arguments.at(arguments.indexOf(QString("--motor-radius")) + 1).toDouble());
+    m_syntheticSource.setMotorSettings(motorSettings);
+
+    m_syntheticSource.init();
+    m_imageType = m_syntheticSource.getImageType();
+    m_isMHDSequence = false;
+    std::cout << "Synthetic stream : " << m_syntheticSource.getHeight() << "x" << m_syntheticSource.getWidth()
+              << " frames at " << m_syntheticSource.getFrameRate() << " fps\n";
+  }
+
   imageHeader.frameCount = 0;
   // read sequence parameters
-  setSequencePath(sequencePath); // opens first image of the sequence
+  if (!m_isSynthetic)
+    setSequencePath(sequencePath); // opens first image of the sequence
 
   // init TCP server
   // set : acceptTheConnection() will be called whenever there is a new connection
@@ -75,8 +123,10 @@ usVirtualServer::usVirtualServer(std::string sequencePath, QObject *parent)
   // console input (user)
   connect(&m_consoleListener, SIGNAL(quitPause()), this, SLOT(quitPause()));
 
-  // Start listening on port 8080
+  // Start listening on port 8080 (by default)
   QString portNum = QString::number(8080);
+  if (qApp->arguments().contains(QString("--port")))
+    portNum = qApp->arguments().at(qApp->arguments().indexOf(QString("--port")) + 1);
   bool status = m_tcpServer.listen(QHostAddress::Any, portNum.toUShort());
 
   // Check, if the server did start correctly or not
@@ -182,8 +232,15 @@ void usVirtualServer::connectionAboutToClose()
 #endif
   imageHeader.frameCount = 0;
 
+  // stop reading ahead the frames of the previous replay
+  m_useReadAhead = false;
+  m_rfReadAheadReader.stop();
+  m_preScanReadAheadReader.stop();
+  m_postScanReadAheadReader.stop();
+
   // Re-open the sequence to prepare next connection incomming (the server is still running)
-  setSequencePath(m_sequencePath);
+  if (!m_isSynthetic)
+    setSequencePath(m_sequencePath);
 }
 
 /**
@@ -220,7 +277,33 @@ void usVirtualServer::writeInitAcquisitionParameters(QDataStream &stream, int im
   int framesPerVolumeMax = 0;
   int stepsPerFrameMax = 0;
 
-  if (m_imageType == us::PRESCAN_2D) {
+  if (m_isSynthetic) {
+    usImagePreScanSettings settings = m_syntheticSource.getPreScanSettings();
+    transmitFrequency = settings.getTransmitFrequency();
+    transmitFrequencyMin = settings.getTransmitFrequency();
+    transmitFrequencyMax = settings.getTransmitFrequency();
+
+    samplingFrequency = settings.getSamplingFrequency();
+    samplingFrequencyMin = settings.getSamplingFrequency();
+    samplingFrequencyMax = settings.getSamplingFrequency();
+
+    imageDepth = (int)(settings.getDepth() * 1000.0);
+    imageDepthMin = imageDepth;
+    imageDepthMax = imageDepth;
+
+    postScanMode = m_imageType == us::POSTSCAN_2D;
+    if (postScanMode) {
+      postScanHeight = m_syntheticSource.getHeight();
+      postScanWidth = m_syntheticSource.getWidth();
+    }
+
+    if (m_syntheticSource.is3D()) {
+      activateMotor = true;
+      framesPerVolume = m_syntheticSource.getMotorSettings().getFrameNumber();
+      framesPerVolumeMin = framesPerVolume;
+      framesPerVolumeMax = framesPerVolume;
+    }
+  } else if (m_imageType == us::PRESCAN_2D) {
     transmitFrequency = m_preScanImage2d.getTransmitFrequency();
     transmitFrequencyMin = m_preScanImage2d.getTransmitFrequency();
     transmitFrequencyMax = m_preScanImage2d.getTransmitFrequency();
@@ -330,6 +413,7 @@ void usVirtualServer::setSequencePath(const std::string sequencePath)
   // case of a directory containing a sequence of mhd/raw images
   else if (vpIoTools::checkDirectory(sequencePath) &&
            usImageIo::getHeaderFormat(vpIoTools::getDirFiles(sequencePath).front()) == usImageIo::FORMAT_MHD) {
+    m_sequencePath = sequencePath;
     m_MHDSequenceReader.setSequenceDirectory(sequencePath);
 
     // at this point, we don't know the type of image contained in the sequence, we have to try them all
@@ -337,7 +421,7 @@ void usVirtualServer::setSequencePath(const std::string sequencePath)
       uint64_t timestampTmp;
       m_MHDSequenceReader.acquire(m_rfImage2d, timestampTmp);
       imageHeader.timeStamp = timestampTmp;
-      m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+      m_nextImageTimestamp = mhdNextTimeStamp();
       if (imageHeader.timeStamp == m_nextImageTimestamp) // timestamps are supposed to be different for different frames
         throw(vpException(vpException::fatalError), "usVirtualServer error : successives timestamps are equal !");
     } catch (...) { // if we have an exception, it's not a RF 2D image. So we try a pre-scan 2D
@@ -345,7 +429,7 @@ void usVirtualServer::setSequencePath(const std::string sequencePath)
         uint64_t timestampTmp;
         m_MHDSequenceReader.acquire(m_preScanImage2d, timestampTmp);
         imageHeader.timeStamp = timestampTmp;
-        m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+        m_nextImageTimestamp = mhdNextTimeStamp();
         if (imageHeader.timeStamp ==
             m_nextImageTimestamp) // timestamps are supposed to be different for different frames
           throw(vpException(vpException::fatalError), "usVirtualServer error : successives timestamps are equal !");
@@ -356,7 +440,7 @@ void usVirtualServer::setSequencePath(const std::string sequencePath)
           uint64_t timestampTmp;
           m_MHDSequenceReader.acquire(m_postScanImage2d, timestampTmp);
           imageHeader.timeStamp = timestampTmp;
-          m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+          m_nextImageTimestamp = mhdNextTimeStamp();
           if (imageHeader.timeStamp ==
               m_nextImageTimestamp) // timestamps are supposed to be different for different frames
             throw(vpException(vpException::fatalError), "usVirtualServer error : successives timestamps are equal !");
@@ -402,6 +486,30 @@ void usVirtualServer::setSequencePath(const std::string sequencePath)
 */
 void usVirtualServer::startSendingLoop()
 {
+  // 2D mhd sequences read without rewind are read ahead by a separate thread, to keep disk accesses out of the
+  // sending loop
+  if (m_isMHDSequence && !m_useRewind && !m_useReadAhead) {
+    unsigned int firstImageNumber = (unsigned int)m_MHDSequenceReader.getImageNumber();
+    if (m_imageType == us::RF_2D) {
+      m_rfReadAheadReader.start(m_sequencePath, firstImageNumber);
+      m_useReadAhead = true;
+    } else if (m_imageType == us::PRESCAN_2D) {
+      m_preScanReadAheadReader.start(m_sequencePath, firstImageNumber);
+      m_useReadAhead = true;
+    } else if (m_imageType == us::POSTSCAN_2D) {
+      m_postScanReadAheadReader.start(m_sequencePath, firstImageNumber);
+      m_useReadAhead = true;
+    }
+  }
+
+  if (m_isSynthetic) {
+    sendingLoopSynthetic();
+    return;
+  }
+
+  // deadlines of next frames are computed from the last frame sent
+  m_replayScheduler.start(imageHeader.timeStamp);
+
   if (m_isMHDSequence)
     sendingLoopSequenceMHD();
   else
@@ -560,9 +668,11 @@ void usVirtualServer::sendingLoopSequenceXml()
 
     std::cout << "new frame sent, No " << imageHeader.frameCount << std::endl;
 
+    m_replayScheduler.frameSent(imageHeader.timeStamp);
+
     imageHeader.frameCount++;
     // WAITING PROCESS (to respect sequence timestamps)
-    vpTime::wait((double)(m_nextImageTimestamp - imageHeader.timeStamp));
+    m_replayScheduler.waitUntil(m_nextImageTimestamp);
   }
 #else
   throw(vpException(vpException::badValue),
@@ -600,7 +710,7 @@ void usVirtualServer::sendingLoopSequenceMHD()
                 m_MHDSequenceReader.acquire(m_rfImage2d, localTimestamp);
                 imageHeader.timeStamp = localTimestamp;
                 if (imageIndex != m_MHDSequenceReader.getTotalImageNumber() - 1) {
-                  m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+                  m_nextImageTimestamp = mhdNextTimeStamp();
                 } else { // next timestamp is the previous image, so we compute the abs diff between 2 timpestamps
                   // first we get the timestamp of the previous image
                   usImageRF2D<short int> tmpImg;
@@ -675,10 +785,10 @@ void usVirtualServer::sendingLoopSequenceMHD()
               }
             } else {
               uint64_t localTimestamp;
-              m_MHDSequenceReader.acquire(m_rfImage2d, localTimestamp);
+              acquireNextFrame(m_rfImage2d, localTimestamp);
               imageHeader.timeStamp = localTimestamp + m_pauseDurationOffset;
-              if (!m_MHDSequenceReader.end())
-                m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp() + m_pauseDurationOffset;
+              if (!mhdSequenceEnd())
+                m_nextImageTimestamp = mhdNextTimeStamp() + m_pauseDurationOffset;
               imageHeader.imageType = 2;
             }
           } else { // pause activated, we continue sending the same image, and increasing timestamps
@@ -706,7 +816,7 @@ void usVirtualServer::sendingLoopSequenceMHD()
             m_MHDSequenceReader.acquire(m_rfImage2d, localTimestamp);
             imageHeader.timeStamp = localTimestamp;
             if (imageIndex != m_MHDSequenceReader.getTotalImageNumber() - 1) {
-              m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+              m_nextImageTimestamp = mhdNextTimeStamp();
             } else { // next timestamp is the previous image, so we compute the abs diff between 2 timpestamps
               // first we get the timestamp of the previous image
               usImageRF2D<short int> tmpImg;
@@ -779,10 +889,10 @@ void usVirtualServer::sendingLoopSequenceMHD()
           }
         } else {
           uint64_t localTimestamp;
-          m_MHDSequenceReader.acquire(m_rfImage2d, localTimestamp);
+          acquireNextFrame(m_rfImage2d, localTimestamp);
           imageHeader.timeStamp = localTimestamp;
-          if (!m_MHDSequenceReader.end())
-            m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+          if (!mhdSequenceEnd())
+            m_nextImageTimestamp = mhdNextTimeStamp();
           imageHeader.imageType = 2;
         }
       } else if (m_imageType == us::PRESCAN_2D) {
@@ -807,7 +917,7 @@ void usVirtualServer::sendingLoopSequenceMHD()
                 invertRowsColsOnPreScan(); // to fit with ultrasonix grabbers (pre-scan image is inverted in porta SDK)
                 imageHeader.timeStamp = localTimestamp;
                 if (imageIndex != m_MHDSequenceReader.getTotalImageNumber() - 1) {
-                  m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+                  m_nextImageTimestamp = mhdNextTimeStamp();
                 } else { // next timestamp is the previous image, so we compute the abs diff between 2 timpestamps
                   // first we get the timestamp of the previous image
                   usImagePreScan2D<unsigned char> tmpImg;
@@ -884,11 +994,11 @@ void usVirtualServer::sendingLoopSequenceMHD()
               }
             } else {
               uint64_t localTimestamp;
-              m_MHDSequenceReader.acquire(m_preScanImage2d, localTimestamp);
+              acquireNextFrame(m_preScanImage2d, localTimestamp);
               invertRowsColsOnPreScan(); // to fit with ultrasonix grabbers (pre-scan image is inverted in porta SDK)
               imageHeader.timeStamp = localTimestamp + m_pauseDurationOffset;
-              if (!m_MHDSequenceReader.end())
-                m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp() + m_pauseDurationOffset;
+              if (!mhdSequenceEnd())
+                m_nextImageTimestamp = mhdNextTimeStamp() + m_pauseDurationOffset;
               imageHeader.imageType = 0;
             }
           } else { // pause activated, we continue sending the same image, and increasing timestamps
@@ -917,7 +1027,7 @@ void usVirtualServer::sendingLoopSequenceMHD()
             invertRowsColsOnPreScan(); // to fit with ultrasonix grabbers (pre-scan image is inverted in porta SDK)
             imageHeader.timeStamp = localTimestamp;
             if (imageIndex != m_MHDSequenceReader.getTotalImageNumber() - 1) {
-              m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+              m_nextImageTimestamp = mhdNextTimeStamp();
             } else { // next timestamp is the previous image, so we compute the abs diff between 2 timpestamps
               // first we get the timestamp of the previous image
               usImagePreScan2D<unsigned char> tmpImg;
@@ -992,11 +1102,11 @@ void usVirtualServer::sendingLoopSequenceMHD()
           }
         } else {
           uint64_t localTimestamp;
-          m_MHDSequenceReader.acquire(m_preScanImage2d, localTimestamp);
+          acquireNextFrame(m_preScanImage2d, localTimestamp);
           invertRowsColsOnPreScan(); // to fit with ultrasonix grabbers (pre-scan image is inverted in porta SDK)
           imageHeader.timeStamp = localTimestamp;
-          if (!m_MHDSequenceReader.end())
-            m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+          if (!mhdSequenceEnd())
+            m_nextImageTimestamp = mhdNextTimeStamp();
           imageHeader.imageType = 0;
         }
       } else if (m_imageType == us::POSTSCAN_2D) {
@@ -1020,7 +1130,7 @@ void usVirtualServer::sendingLoopSequenceMHD()
                 m_MHDSequenceReader.acquire(m_postScanImage2d, localTimestamp);
                 imageHeader.timeStamp = localTimestamp;
                 if (imageIndex != m_MHDSequenceReader.getTotalImageNumber() - 1) {
-                  m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+                  m_nextImageTimestamp = mhdNextTimeStamp();
                 } else { // next timestamp is the previous image, so we compute the abs diff between 2 timpestamps
                   // first we get the timestamp of the previous image
                   usImagePostScan2D<unsigned char> tmpImg;
@@ -1095,10 +1205,10 @@ void usVirtualServer::sendingLoopSequenceMHD()
               }
             } else {
               uint64_t localTimestamp;
-              m_MHDSequenceReader.acquire(m_postScanImage2d, localTimestamp);
+              acquireNextFrame(m_postScanImage2d, localTimestamp);
               imageHeader.timeStamp = localTimestamp + m_pauseDurationOffset;
-              if (!m_MHDSequenceReader.end())
-                m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp() + m_pauseDurationOffset;
+              if (!mhdSequenceEnd())
+                m_nextImageTimestamp = mhdNextTimeStamp() + m_pauseDurationOffset;
               imageHeader.imageType = 1;
             }
           } else { // pause activated, we continue sending the same image, and increasing timestamps
@@ -1126,7 +1236,7 @@ void usVirtualServer::sendingLoopSequenceMHD()
             m_MHDSequenceReader.acquire(m_postScanImage2d, localTimestamp);
             imageHeader.timeStamp = localTimestamp;
             if (imageIndex != m_MHDSequenceReader.getTotalImageNumber() - 1) {
-              m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+              m_nextImageTimestamp = mhdNextTimeStamp();
             } else { // next timestamp is the previous image, so we compute the abs diff between 2 timpestamps
               // first we get the timestamp of the previous image
               usImagePostScan2D<unsigned char> tmpImg;
@@ -1199,10 +1309,10 @@ void usVirtualServer::sendingLoopSequenceMHD()
           }
         } else {
           uint64_t localTimestamp;
-          m_MHDSequenceReader.acquire(m_postScanImage2d, localTimestamp);
+          acquireNextFrame(m_postScanImage2d, localTimestamp);
           imageHeader.timeStamp = localTimestamp;
-          if (!m_MHDSequenceReader.end())
-            m_nextImageTimestamp = m_MHDSequenceReader.getNextTimeStamp();
+          if (!mhdSequenceEnd())
+            m_nextImageTimestamp = mhdNextTimeStamp();
           imageHeader.imageType = 1;
         }
       } else if (m_imageType == us::RF_3D) {
@@ -1458,17 +1568,19 @@ void usVirtualServer::sendingLoopSequenceMHD()
       out << (int)0;                                 // motorType
       out.writeRawData((char *)m_rfImage2d.bitmap, (int)m_rfImage2d.getHeight() * m_rfImage2d.getWidth() * 2);
 
-      endOfSequence = m_MHDSequenceReader.end() && !m_useRewind;
+      endOfSequence = mhdSequenceEnd() && !m_useRewind;
 
       connectionSoc->write(block);
       qApp->processEvents();
 
       std::cout << "new frame sent, No " << imageHeader.frameCount << std::endl;
 
+      m_replayScheduler.frameSent(imageHeader.timeStamp);
+
       imageHeader.frameCount++;
 
       // WAITING PROCESS (to respect sequence timestamps)
-      vpTime::wait((double)(m_nextImageTimestamp - imageHeader.timeStamp));
+      m_replayScheduler.waitUntil(m_nextImageTimestamp);
     } else if (m_imageType == us::PRESCAN_2D) { // send pre-scan image
       imageHeader.dataRate = 1000.0 / (m_nextImageTimestamp - imageHeader.timeStamp);
 
@@ -1504,17 +1616,19 @@ void usVirtualServer::sendingLoopSequenceMHD()
       out.writeRawData((char *)m_preScanImage2d.bitmap,
                        (int)m_preScanImage2d.getHeight() * m_preScanImage2d.getWidth());
 
-      endOfSequence = m_MHDSequenceReader.end() && !m_useRewind;
+      endOfSequence = mhdSequenceEnd() && !m_useRewind;
 
       connectionSoc->write(block);
       qApp->processEvents();
 
       std::cout << "new frame sent, No " << imageHeader.frameCount << std::endl;
 
+      m_replayScheduler.frameSent(imageHeader.timeStamp);
+
       imageHeader.frameCount++;
 
       // WAITING PROCESS (to respect sequence timestamps)
-      vpTime::wait((double)(m_nextImageTimestamp - imageHeader.timeStamp));
+      m_replayScheduler.waitUntil(m_nextImageTimestamp);
     } else if (m_imageType == us::POSTSCAN_2D) { // send post-scan image
       imageHeader.dataRate = 1000.0 / (m_nextImageTimestamp - imageHeader.timeStamp);
 
@@ -1550,17 +1664,19 @@ void usVirtualServer::sendingLoopSequenceMHD()
       out.writeRawData((char *)m_postScanImage2d.bitmap,
                        (int)m_postScanImage2d.getHeight() * m_postScanImage2d.getWidth());
 
-      endOfSequence = m_MHDSequenceReader.end() && !m_useRewind;
+      endOfSequence = mhdSequenceEnd() && !m_useRewind;
 
       connectionSoc->write(block);
       qApp->processEvents();
 
       std::cout << "new frame sent, No " << imageHeader.frameCount << std::endl;
 
+      m_replayScheduler.frameSent(imageHeader.timeStamp);
+
       imageHeader.frameCount++;
 
       // WAITING PROCESS (to respect sequence timestamps)
-      vpTime::wait((double)(m_nextImageTimestamp - imageHeader.timeStamp));
+      m_replayScheduler.waitUntil(m_nextImageTimestamp);
     }
     // 3D case
     else if (m_imageType == us::RF_3D) { // send RF volume frame by frame
@@ -1741,13 +1857,15 @@ void usVirtualServer::sendingLoopSequenceMHD()
 
         std::cout << "new frame sent, No " << imageHeader.frameCount << std::endl;
 
+        m_replayScheduler.frameSent(imageHeader.timeStamp);
+
         imageHeader.frameCount++;
         currentFrameInVolume++;
         endOfVolume = m_rfImage3d.getFrameNumber() == currentFrameInVolume;
         endOfSequence = (m_MHDSequenceReader.end() && endOfVolume && !m_useRewind);
 
         // WAITING PROCESS (to respect sequence timestamps)
-        vpTime::wait((double)(m_nextImageTimestamp - imageHeader.timeStamp));
+        m_replayScheduler.waitUntil(m_nextImageTimestamp);
       }
     } else if (m_imageType == us::PRESCAN_3D) { // send pre-scan volume frame by frame
       bool endOfVolume = false;
@@ -1943,6 +2061,8 @@ void usVirtualServer::sendingLoopSequenceMHD()
 
         std::cout << "new frame sent, No " << imageHeader.frameCount << std::endl;
 
+        m_replayScheduler.frameSent(imageHeader.timeStamp);
+
         imageHeader.frameCount++;
         currentFrameInVolume++;
         endOfVolume = m_preScanImage3d.getFrameNumber() == currentFrameInVolume;
@@ -1950,12 +2070,189 @@ void usVirtualServer::sendingLoopSequenceMHD()
 
         // WAITING PROCESS (to respect sequence timestamps)
         if (!endOfSequence)
-          vpTime::wait((double)(m_nextImageTimestamp - imageHeader.timeStamp));
+          m_replayScheduler.waitUntil(m_nextImageTimestamp);
       }
     }
   }
 }
 
+/**
+* Method to send an endless synthetic stream through the network (--synthetic option). Frames are generated at the
+* frame rate of the synthetic source, and stamped (see usFrameStamp) to let the clients check the stream integrity and
+* measure the latency. 3D streams are sent frame by frame, with the motor settings in the frame headers.
+*/
+void usVirtualServer::sendingLoopSynthetic()
+{
+  // header timestamps are computed from the frame index, to have a drift-free stream
+  uint64_t startTimestamp = QDateTime::currentMSecsSinceEpoch();
+  double framePeriod = 1000.0 / m_syntheticSource.getFrameRate();
+  unsigned int firstFrame = imageHeader.frameCount;
+  usMotorSettings motorSettings = m_syntheticSource.getMotorSettings();
+  usImagePreScanSettings settings = m_syntheticSource.getPreScanSettings();
+
+  m_replayScheduler.start(startTimestamp);
+
+  while (m_serverIsSendingImages) {
+    unsigned int frameIndex = imageHeader.frameCount - firstFrame;
+    imageHeader.timeStamp = startTimestamp + (uint64_t)vpMath::round(frameIndex * framePeriod);
+    m_nextImageTimestamp = startTimestamp + (uint64_t)vpMath::round((frameIndex + 1) * framePeriod);
+    imageHeader.dataRate = m_syntheticSource.getFrameRate();
+
+    QByteArray block;
+    QDataStream out(&block, QIODevice::WriteOnly);
+#if defined(USTK_HAVE_VTK_QT4)
+    out.setVersion(QDataStream::Qt_4_8);
+#else
+    out.setVersion(QDataStream::Qt_5_0);
+#endif
+    out << imageHeader.headerId;
+    out << imageHeader.frameCount;
+    out << imageHeader.timeStamp;
+    out << imageHeader.dataRate;
+
+    if (m_imageType == us::RF_2D || m_imageType == us::RF_3D) {
+      m_syntheticSource.generate(m_rfImage2d, imageHeader.frameCount);
+      out << (int)m_rfImage2d.getWidth() * m_rfImage2d.getHeight() * 2; // datalength in bytes
+      out << (int)16;                                                   // sample size in bits
+      out << (int)2;                                                    // image type
+      out << m_rfImage2d.getWidth();
+      out << m_rfImage2d.getHeight();
+    } else if (m_imageType == us::PRESCAN_2D || m_imageType == us::PRESCAN_3D) {
+      m_syntheticSource.generate(m_preScanImage2d, imageHeader.frameCount);
+      invertRowsColsOnPreScan(); // to fit with ultrasonix grabbers (pre-scan image is inverted in porta SDK)
+      out << (int)m_preScanImage2d.getHeight() * m_preScanImage2d.getWidth(); // datalength in bytes
+      out << (int)8;                                                          // sample size in bits
+      out << (int)0;
+      out << m_preScanImage2d.getHeight();
+      out << m_preScanImage2d.getWidth();
+    } else { // post-scan 2D
+      m_syntheticSource.generate(m_postScanImage2d, imageHeader.frameCount);
+      out << (int)m_postScanImage2d.getHeight() * m_postScanImage2d.getWidth(); // datalength in bytes
+      out << (int)8;                                                            // sample size in bits
+      out << (int)1;
+      out << m_postScanImage2d.getWidth();
+      out << m_postScanImage2d.getHeight();
+    }
+
+    if (m_imageType == us::POSTSCAN_2D) {
+      out << m_postScanImage2d.getWidthResolution();  // pixelWidth
+      out << m_postScanImage2d.getHeightResolution(); // pixelHeight
+    } else {
+      out << (double).0; // pixelWidth
+      out << (double).0; // pixelHeight
+    }
+    out << settings.getTransmitFrequency();
+    out << settings.getSamplingFrequency();
+    out << settings.getTransducerRadius();
+    out << settings.getScanLinePitch();
+    out << (int)settings.getScanLineNumber();
+    out << (int)(settings.getDepth() * 1000.0); // int in mm
+    if (m_syntheticSource.is3D()) {
+      out << (double)vpMath::deg(motorSettings.getFramePitch()); // degPerFrame
+      out << (int)motorSettings.getFrameNumber();                // framesPerVolume
+      out << (double)motorSettings.getMotorRadius();             // motorRadius
+      out << (int)motorSettings.getMotorType();                  // motorType
+    } else {
+      out << (double).0; // degPerFrame
+      out << (int)0;     // framesPerVolume
+      out << (double).0; // motorRadius
+      out << (int)0;     // motorType
+    }
+
+    if (m_imageType == us::RF_2D || m_imageType == us::RF_3D)
+      out.writeRawData((char *)m_rfImage2d.bitmap, (int)m_rfImage2d.getHeight() * m_rfImage2d.getWidth() * 2);
+    else if (m_imageType == us::POSTSCAN_2D)
+      out.writeRawData((char *)m_postScanImage2d.bitmap,
+                       (int)m_postScanImage2d.getHeight() * m_postScanImage2d.getWidth());
+    else
+      out.writeRawData((char *)m_preScanImage2d.bitmap,
+                       (int)m_preScanImage2d.getHeight() * m_preScanImage2d.getWidth());
+
+    connectionSoc->write(block);
+    qApp->processEvents();
+
+    std::cout << "new frame sent, No " << imageHeader.frameCount << std::endl;
+
+    m_replayScheduler.frameSent(imageHeader.timeStamp);
+
+    imageHeader.frameCount++;
+
+    // WAITING PROCESS (to respect the frame rate)
+    m_replayScheduler.waitUntil(m_nextImageTimestamp);
+  }
+}
+
+/**
+* Fills the RF image with the next frame of the mhd sequence, from the read-ahead cache if it is used.
+* @param [out] image The next RF frame.
+* @param [out] timestamp The timestamp of the frame.
+*/
+void usVirtualServer::acquireNextFrame(usImageRF2D<short int> &image, uint64_t &timestamp)
+{
+  if (m_useReadAhead)
+    m_rfReadAheadReader.acquire(image, timestamp);
+  else
+    m_MHDSequenceReader.acquire(image, timestamp);
+}
+
+/**
+* Fills the pre-scan image with the next frame of the mhd sequence, from the read-ahead cache if it is used.
+* @param [out] image The next pre-scan frame.
+* @param [out] timestamp The timestamp of the frame.
+*/
+void usVirtualServer::acquireNextFrame(usImagePreScan2D<unsigned char> &image, uint64_t &timestamp)
+{
+  if (m_useReadAhead)
+    m_preScanReadAheadReader.acquire(image, timestamp);
+  else
+    m_MHDSequenceReader.acquire(image, timestamp);
+}
+
+/**
+* Fills the post-scan image with the next frame of the mhd sequence, from the read-ahead cache if it is used.
+* @param [out] image The next post-scan frame.
+* @param [out] timestamp The timestamp of the frame.
+*/
+void usVirtualServer::acquireNextFrame(usImagePostScan2D<unsigned char> &image, uint64_t &timestamp)
+{
+  if (m_useReadAhead)
+    m_postScanReadAheadReader.acquire(image, timestamp);
+  else
+    m_MHDSequenceReader.acquire(image, timestamp);
+}
+
+/**
+* Returns true if all the frames of the mhd sequence were acquired.
+*/
+bool usVirtualServer::mhdSequenceEnd()
+{
+  if (m_useReadAhead) {
+    if (m_imageType == us::RF_2D)
+      return m_rfReadAheadReader.end();
+    else if (m_imageType == us::PRESCAN_2D)
+      return m_preScanReadAheadReader.end();
+    else
+      return m_postScanReadAheadReader.end();
+  }
+  return m_MHDSequenceReader.end();
+}
+
+/**
+* Returns the timestamp of the next frame of the mhd sequence (2D sequences).
+*/
+uint64_t usVirtualServer::mhdNextTimeStamp()
+{
+  if (m_useReadAhead) {
+    if (m_imageType == us::RF_2D)
+      return m_rfReadAheadReader.getNextTimeStamp();
+    else if (m_imageType == us::PRESCAN_2D)
+      return m_preScanReadAheadReader.getNextTimeStamp();
+    else
+      return m_postScanReadAheadReader.getNextTimeStamp();
+  }
+  return m_MHDSequenceReader.getNextTimeStamp();
+}
+
 /**
 * Method to invert rows and columns in the image (case of pre-scan frames) : to fit real server behaviour.
 */
@@ -58,11 +58,18 @@
 #include <visp3/ustk_core/usSequenceReader.h>
 
 #include "usConsoleListener.h"
+#include "usFrameReadAhead.h"
+#include "usReplayScheduler.h"
+#include "usSyntheticSource.h"
 
 /**
  * @class usVirtualServer
  * @brief Class to simulate a server sending frames from an ultrasound station. Permits to replay a sequence of images
  * sent through the network, by respeting the timestamps of each frame sent (to do real-time tests).
+ * The replay can be accelerated (or run as fast as possible) with the --speed option, to stress the clients (see
+ * usReplayScheduler).
+ * With the --synthetic option, no sequence is read : the server generates an endless stream of stamped frames (see
+ * usSyntheticSource and usFrameStamp), to test the clients without dataset.
  */
 class usVirtualServer : public QObject
 {
@@ -174,14 +181,22 @@ private slots:
   void startSendingLoop();
 
 private:
+  void acquireNextFrame(usImageRF2D<short int> &image, uint64_t &timestamp);
+  void acquireNextFrame(usImagePreScan2D<unsigned char> &image, uint64_t &timestamp);
+  void acquireNextFrame(usImagePostScan2D<unsigned char> &image, uint64_t &timestamp);
+
   void initServer(usInitHeaderIncomming header);
 
   void invertRowsColsOnPreScan();
 
+  uint64_t mhdNextTimeStamp();
+  bool mhdSequenceEnd();
+
   void setSequencePath(const std::string sequencePath);
 
   void sendingLoopSequenceXml();
   void sendingLoopSequenceMHD();
+  void sendingLoopSynthetic();
 
   bool updateServer(usUpdateHeaderIncomming header);
 
@@ -202,6 +217,19 @@ private:
 #endif
   usMHDSequenceReader m_MHDSequenceReader;
 
+  // read-ahead of 2D mhd sequences (one per image type)
+  usFrameReadAhead<usImageRF2D<short int> > m_rfReadAheadReader;
+  usFrameReadAhead<usImagePreScan2D<unsigned char> > m_preScanReadAheadReader;
+  usFrameReadAhead<usImagePostScan2D<unsigned char> > m_postScanReadAheadReader;
+  bool m_useReadAhead;
+
+  // frames pacing
+  usReplayScheduler m_replayScheduler;
+
+  // synthetic stream (no sequence read if true)
+  bool m_isSynthetic;
+  usSyntheticSource m_syntheticSource;
+
   usImageHeader imageHeader;
 
   // 2D images
@@ -36,20 +36,26 @@
 int main(int argc, char **argv)
 {
   std::string filename;
+  bool synthetic = false;
 
   for (int i = 0; i < argc; i++) {
     if (std::string(argv[i]) == "--input")
       filename = std::string(argv[i + 1]);
+    else if (std::string(argv[i]) == "--synthetic")
+      synthetic = true;
     else if (std::string(argv[i]) == "--help") {
       std::cout << "\nUsage: " << argv[0]
-                << " [--input <mysequence.mhd>] [--help] [--rewind] [--pause <imageToPauseOn]>\n"
+                << " [--input <mysequence.mhd>] [--help] [--rewind] [--pause <imageToPauseOn]>"
+                << " [--speed <factor from 0.5 to 10 | max>] [--port <port>]\n"
+                << " [--synthetic <rf2d | rf3d | prescan2d | prescan3d | postscan2d>] [--size <height>x<width>]"
+                << " [--fps <frameRate>] [--frames-per-volume <n>] [--frame-pitch <deg>] [--motor-radius <m>]\n"
                 << std::endl;
       return 0;
     }
   }
 
   // Get the ustk-dataset package path or USTK_DATASET_PATH environment variable value
-  if (filename.empty()) {
+  if (filename.empty() && !synthetic) {
     std::string env_ipath = us::getDataSetPath();
     if (!env_ipath.empty())
       filename = env_ipath + "/pre-scan/timestampSequence/sequenceTimestamps.xml";
@@ -0,0 +1,76 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usFrameStamp.h
+ * @brief Stamp embedded in synthetic frames, to check the integrity of a stream and measure its latency.
+ */
+
+#ifndef __usFrameStamp_h_
+#define __usFrameStamp_h_
+
+#include <visp3/ustk_core/us.h>
+
+/**
+ * @class usFrameStamp
+ * @brief Stamp embedded in the first bytes of synthetic frames (see the synthetic mode of ustk virtual server).
+ * @ingroup module_ustk_core
+ *
+ * The stamp is written in the first usFrameStamp::size bytes of the frame bitmap, in the ustk memory layout (first
+ * scan line of RF images, first row of the other images), and contains :
+ * - a magic number,
+ * - the frame count,
+ * - the time the frame was sent (microseconds since epoch, see now()),
+ * - a checksum of the rest of the frame.
+ *
+ * On client side, read() checks the magic number and the checksum, and gives back the frame count and the send time
+ * to detect lost frames and measure the end-to-end latency (now() - sendTime, server and client clocks have to be
+ * synchronized if they run on different machines).
+ *
+ * The frame bitmap must be at least usFrameStamp::size bytes long. For pre-scan images, which are transposed on the
+ * network, the stamp is only kept if the image has at least usFrameStamp::size scan lines.
+ */
+class VISP_EXPORT usFrameStamp
+{
+public:
+  static const unsigned int size = 24; /**< Size of the stamp in bytes. */
+
+  static uint64_t checksum(const unsigned char *data, unsigned int dataSize);
+
+  static uint64_t now();
+
+  static bool read(const unsigned char *frame, unsigned int frameSize, uint32_t &frameCount, uint64_t &sendTime);
+
+  static void write(unsigned char *frame, unsigned int frameSize, uint32_t frameCount, uint64_t sendTime);
+};
+
+#endif // __usFrameStamp_h_
@@ -0,0 +1,196 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+* @file usImage3DView.h
+* @brief Region of interest of a 3D image, without copy.
+*/
+
+#ifndef __usImage3DView_h_
+#define __usImage3DView_h_
+
+#include <algorithm>
+
+#include <visp3/core/vpException.h>
+#include <visp3/ustk_core/usImage3D.h>
+
+/**
+* @class usImage3DView
+* @brief Box shaped region of interest of an usImage3D, that refers to the voxels of the volume instead of copying them.
+* @ingroup module_ustk_core
+*
+* The view has the voxel accessors of usImage3D (getHeight(), getWidth(), getNumberOfFrames() and operator()), its
+* voxel (0, 0, 0) being the voxel (i0, j0, k0) of the volume, so that the algorithms written as templates on the volume
+* class (for instance usVolumeProcessing::applyFilter()) can be restricted to the region of interest. The rows of the
+* view are contiguous in memory (see getData()).
+*
+* The volume should not be resized or destroyed while the view is used.
+*/
+template <class Type> class usImage3DView
+{
+public:
+  usImage3DView(usImage3D<Type> &image, unsigned int i0, unsigned int j0, unsigned int k0, unsigned int height,
+                unsigned int width, unsigned int numberOfFrames);
+
+  virtual ~usImage3DView() {}
+
+  /**
+  * Get the pointer to a voxel of the view. The voxels of a row (j-axis) are contiguous.
+  * @param i Index on i-axis in the view.
+  * @param j Index on j-axis in the view.
+  * @param k Index on k-axis in the view.
+  * @return The pointer to the voxel in the volume.
+  */
+  Type *getData(unsigned int i, unsigned int j, unsigned int k) const
+  {
+    return m_image->getConstData() + ((m_k0 + k) * m_image->getHeight() + m_i0 + i) * m_image->getWidth() + m_j0 + j;
+  }
+
+  /**
+  * Get the volume height.
+  * @return The height of the view, in number of voxels.
+  */
+  unsigned int getHeight() const { return m_height; }
+
+  /**
+  * Get the viewed volume.
+  * @return The volume the view refers to.
+  */
+  usImage3D<Type> &getImage3D() const { return *m_image; }
+
+  /**
+  * Get the volume size along the k-axis.
+  * @return The k-axis size of the view, in number of voxels.
+  */
+  unsigned int getNumberOfFrames() const { return m_numberOfFrames; }
+
+  /**
+  * Get the index in the volume of the first voxel of the view along the i-axis.
+  * @return The first i index.
+  */
+  unsigned int getOriginI() const { return m_i0; }
+
+  /**
+  * Get the index in the volume of the first voxel of the view along the j-axis.
+  * @return The first j index.
+  */
+  unsigned int getOriginJ() const { return m_j0; }
+
+  /**
+  * Get the index in the volume of the first voxel of the view along the k-axis.
+  * @return The first k index.
+  */
+  unsigned int getOriginK() const { return m_k0; }
+
+  /**
+  * Get the view size.
+  * @return The number of voxels in the view.
+  */
+  unsigned int getSize() const { return m_height * m_width * m_numberOfFrames; }
+
+  /**
+  * Get the view width.
+  * @return The width of the view, in number of voxels.
+  */
+  unsigned int getWidth() const { return m_width; }
+
+  /**
+  * Access operator.
+  * @param i Index on i-axis in the view.
+  * @param j Index on j-axis in the view.
+  * @param k Index on k-axis in the view.
+  */
+  inline Type operator()(unsigned int i, unsigned int j, unsigned int k) const { return *getData(i, j, k); }
+
+  /**
+  * Modification operator : the voxel of the volume is modified.
+  * @param i Index on i-axis in the view.
+  * @param j Index on j-axis in the view.
+  * @param k Index on k-axis in the view.
+  * @param value Value to insert at the desired index.
+  */
+  inline void operator()(unsigned int i, unsigned int j, unsigned int k, Type value) const
+  {
+    *getData(i, j, k) = value;
+  }
+
+  void toImage3D(usImage3D<Type> &image) const;
+
+private:
+  usImage3D<Type> *m_image;      /**< Viewed volume */
+  unsigned int m_i0;             /**< Index on i-axis of the first voxel of the view */
+  unsigned int m_j0;             /**< Index on j-axis of the first voxel of the view */
+  unsigned int m_k0;             /**< Index on k-axis of the first voxel of the view */
+  unsigned int m_height;         /**< View height in voxels */
+  unsigned int m_width;          /**< View width in voxels */
+  unsigned int m_numberOfFrames; /**< View size in 3rd dimension in voxels */
+};
+
+/****************************************************************************
+* Template implementations.
+****************************************************************************/
+
+/**
+* Constructor.
+* @param image The volume to view.
+* @param i0 Index on i-axis of the first voxel of the view in the volume.
+* @param j0 Index on j-axis of the first voxel of the view in the volume.
+* @param k0 Index on k-axis of the first voxel of the view in the volume.
+* @param height Height of the view.
+* @param width Width of the view.
+* @param numberOfFrames Size of the view along the k-axis.
+*/
+template <class Type>
+usImage3DView<Type>::usImage3DView(usImage3D<Type> &image, unsigned int i0, unsigned int j0, unsigned int k0,
+                                   unsigned int height, unsigned int width, unsigned int numberOfFrames)
+  : m_image(&image), m_i0(i0), m_j0(j0), m_k0(k0), m_height(height), m_width(width), m_numberOfFrames(numberOfFrames)
+{
+  if (i0 + height > image.getHeight() || j0 + width > image.getWidth() ||
+      k0 + numberOfFrames > image.getNumberOfFrames())
+    throw(vpException(vpException::dimensionError, "usImage3DView: the view is not inside the volume"));
+}
+
+/**
+* Copy the voxels of the view to a volume.
+* @param image The volume, resized to the view dimensions.
+*/
+template <class Type> void usImage3DView<Type>::toImage3D(usImage3D<Type> &image) const
+{
+  image.resize(m_height, m_width, m_numberOfFrames);
+  for (unsigned int k = 0; k < m_numberOfFrames; k++)
+    for (unsigned int i = 0; i < m_height; i++) {
+      const Type *row = getData(i, 0, k);
+      std::copy(row, row + m_width, image.getData() + (k * m_height + i) * m_width);
+    }
+}
+
+#endif // __usImage3DView_h_
@@ -114,6 +114,8 @@ template <class Type> class usImageRF2D : public usImagePreScanSettings
   friend class usNetworkGrabberRF2D;
   friend class usNetworkGrabberRF3D;
   friend class usVirtualServer;
+  friend class usSyntheticSource;
+  friend class usElastography;
 
 public:
   usImageRF2D();
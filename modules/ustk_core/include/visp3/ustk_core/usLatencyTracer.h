@@ -0,0 +1,129 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usLatencyTracer.h
+ * @brief Lightweight latency tracing of the frames along the acquisition / processing chain.
+ */
+
+#ifndef __usLatencyTracer_h_
+#define __usLatencyTracer_h_
+
+#include <iostream>
+#include <string>
+
+#include <visp3/ustk_core/us.h>
+
+/**
+ * @class usLatencyTracer
+ * @brief Lightweight latency tracing of the frames along the acquisition / processing chain (grabber, converters,
+ * processing, display).
+ * @ingroup module_ustk_core
+ *
+ * Each frame is identified by a trace ID, made of the stream number of its grabber (see newStream()) and of its frame
+ * count (see getTraceId()), so that the frames of several grabbers with the same frame count are told apart. The chain
+ * records on this ID :
+ * - checkpoints : instants (socket receive, frame complete, acquire, display...), see checkpoint(),
+ * - stages : spans with a duration (conversions, elastography, confidence map...), see usLatencyTracer::usScope.
+ *
+ * The first checkpoint of a trace (startTrace(), called by the grabbers when a frame header arrives) is the origin of
+ * the frame : the delay of every following checkpoint since the origin is accumulated in a histogram, as the duration
+ * of each stage. Percentiles are available at any time (getPercentile(), printStatistics()).
+ *
+ * Events are recorded without lock in a ring buffer of getCapacity() events (the oldest are overwritten), and can be
+ * exported in the Chrome trace format (writeChromeTrace(), to open in chrome://tracing or Perfetto). Times are taken
+ * on a monotonic clock.
+ *
+ * The tracer is disabled by default : every call then returns after a single atomic load.
+ * Stages and checkpoints are identified by their name, which must be a string literal (only the pointer is stored).
+ *
+ * The current trace ID is kept per thread : acquire() methods of the grabbers set it, so that the processing done
+ * after in the same thread is recorded on the frame acquired.
+ * Code running in another thread, such as the display widgets slots called after a grabber signal, has to give the
+ * trace ID explicitly (see checkpoint(uint64_t, const char *) and the newFrame(image, traceId) signals of the 2D
+ * grabbers). 3D grabbers trace a volume on the frame count of its last frame.
+ *
+ * \code
+ * usLatencyTracer::setEnabled(true);
+ * while (run) {
+ *   usFrameGrabbedInfo<usImagePreScan2D<unsigned char> > *frame = grabber->acquire(); // "acquire" checkpoint
+ *   converter.convert(*frame, postScan);                                               // conversion stage
+ *   usLatencyTracer::checkpoint("display");
+ * }
+ * usLatencyTracer::printStatistics();
+ * usLatencyTracer::writeChromeTrace("trace.json");
+ * \endcode
+ */
+class VISP_EXPORT usLatencyTracer
+{
+public:
+  /**
+   * @class usScope
+   * @brief Records a stage of the current trace, from its construction to its destruction.
+   */
+  class VISP_EXPORT usScope
+  {
+  public:
+    explicit usScope(const char *stage);
+    ~usScope();
+
+  private:
+    const char *m_stage;
+    uint64_t m_traceId;
+    uint64_t m_begin;
+  };
+
+  static void checkpoint(const char *name);
+  static void checkpoint(uint64_t traceId, const char *name);
+
+  static void clear();
+
+  static unsigned int getCapacity();
+  static uint64_t getCurrentTraceId();
+  static double getPercentile(const char *name, double percentile);
+  static uint64_t getTraceId(unsigned int stream, uint64_t frameCount);
+
+  static bool isEnabled();
+
+  static unsigned int newStream();
+
+  static void printStatistics(std::ostream &out = std::cout);
+
+  static void setCurrentTraceId(uint64_t traceId);
+  static void setEnabled(bool enabled);
+
+  static void startTrace(uint64_t traceId, const char *name);
+
+  static bool writeChromeTrace(const std::string &filename);
+};
+
+#endif // __usLatencyTracer_h_
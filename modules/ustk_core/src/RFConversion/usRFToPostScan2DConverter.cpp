@@ -37,6 +37,7 @@
  */
 
 #include <visp3/ustk_core/usRFToPostScan2DConverter.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 #if defined(USTK_HAVE_FFTW)
 
@@ -67,6 +68,8 @@ usRFToPostScan2DConverter::~usRFToPostScan2DConverter() {}
 void usRFToPostScan2DConverter::convert(const usImageRF2D<short int> &rfImage,
                                         usImagePostScan2D<unsigned char> &postScanImage)
 {
+  usLatencyTracer::usScope traceScope("RF to post-scan 2D");
+
   usImagePreScan2D<unsigned char> preScanImage;
   m_RFConverter.convert(rfImage, preScanImage);
   m_scanConverter.convert(preScanImage, postScanImage);
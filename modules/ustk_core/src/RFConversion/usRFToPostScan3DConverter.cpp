@@ -36,6 +36,7 @@
  */
 
 #include <visp3/ustk_core/usRFToPostScan3DConverter.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 #if defined(USTK_HAVE_FFTW)
 
@@ -63,6 +64,8 @@ usRFToPostScan3DConverter::~usRFToPostScan3DConverter() {}
 void usRFToPostScan3DConverter::convert(const usImageRF3D<short int> &rfImage,
                                         usImagePostScan3D<unsigned char> &postScanImage)
 {
+  usLatencyTracer::usScope traceScope("RF to post-scan 3D");
+
   m_RFConverter.convert(rfImage, m_intermediateImage);
 
   // this init method checks if parameters are the same, to avoid recomputing all the init proccess if not necessarry
@@ -37,6 +37,7 @@
  */
 
 #include <visp3/ustk_core/usRFToPreScan2DConverter.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 #if defined(USTK_HAVE_FFTW)
 
@@ -167,6 +168,7 @@ void usRFToPreScan2DConverter::enveloppeDetection(const short int *s, double *ou
 void usRFToPreScan2DConverter::convert(const usImageRF2D<short int> &rfImage,
                                        usImagePreScan2D<unsigned char> &preScanImage)
 {
+  usLatencyTracer::usScope traceScope("RF to pre-scan 2D");
 
   if (!m_isInit || ((int)rfImage.getWidth()) != m_scanLineNumber || ((int)rfImage.getHeight()) != m_signalSize) {
     init(rfImage.getWidth(), rfImage.getHeight());
@@ -37,6 +37,7 @@
  */
 
 #include <visp3/ustk_core/usRFToPreScan3DConverter.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 #if defined(USTK_HAVE_FFTW)
 
@@ -66,6 +67,8 @@ usRFToPreScan3DConverter::~usRFToPreScan3DConverter() {}
 void usRFToPreScan3DConverter::convert(const usImageRF3D<short int> &rfImage,
                                        usImagePreScan3D<unsigned char> &preScanImage)
 {
+  usLatencyTracer::usScope traceScope("RF to pre-scan 3D");
+
   if (!m_isInit || (((int)rfImage.getNumberOfFrames()) != m_frameNumber) ||
       (((int)rfImage.getHeight()) != m_heightRF) || (((int)rfImage.getWidth()) != m_widthRF)) {
     init(rfImage.getHeight(), rfImage.getWidth(), rfImage.getNumberOfFrames());
@@ -0,0 +1,129 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+* @file usFrameStamp.cpp
+* @brief Stamp embedded in synthetic frames, to check the integrity of a stream and measure its latency.
+*/
+
+#include <visp3/ustk_core/usFrameStamp.h>
+
+#include <chrono>
+#include <cstring>
+
+#include <visp3/core/vpException.h>
+
+namespace
+{
+const uint32_t usFrameStampMagic = 0x55534653; // "USFS"
+}
+
+const unsigned int usFrameStamp::size;
+
+/**
+* Computes a 64 bits FNV-1a checksum of a buffer, processed by 8 bytes words.
+* @param data The buffer.
+* @param dataSize Size of the buffer in bytes.
+* @return The checksum.
+*/
+uint64_t usFrameStamp::checksum(const unsigned char *data, unsigned int dataSize)
+{
+  const uint64_t prime = 1099511628211ULL;
+  uint64_t hash = 14695981039346656037ULL;
+
+  unsigned int i = 0;
+  for (; i + 8 <= dataSize; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * prime;
+  }
+  for (; i < dataSize; i++)
+    hash = (hash ^ data[i]) * prime;
+
+  return hash;
+}
+
+/**
+* Current time used for the send time of the stamps.
+* @return Microseconds since epoch.
+*/
+uint64_t usFrameStamp::now()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+* Reads the stamp of a frame, and checks its integrity.
+* @param [in] frame The frame buffer.
+* @param [in] frameSize Size of the frame buffer in bytes.
+* @param [out] frameCount The frame count written in the stamp.
+* @param [out] sendTime The send time written in the stamp (microseconds since epoch).
+* @return False if the frame contains no stamp, or if the checksum does not match the frame content.
+*/
+bool usFrameStamp::read(const unsigned char *frame, unsigned int frameSize, uint32_t &frameCount, uint64_t &sendTime)
+{
+  if (frameSize < size)
+    return false;
+
+  uint32_t magic;
+  uint64_t frameChecksum;
+  memcpy(&magic, frame, 4);
+  memcpy(&frameCount, frame + 4, 4);
+  memcpy(&sendTime, frame + 8, 8);
+  memcpy(&frameChecksum, frame + 16, 8);
+
+  if (magic != usFrameStampMagic)
+    return false;
+
+  return frameChecksum == checksum(frame + size, frameSize - size);
+}
+
+/**
+* Writes the stamp at the beginning of a frame. The frame content must not be modified after this call.
+* @param frame The frame buffer.
+* @param frameSize Size of the frame buffer in bytes.
+* @param frameCount The frame count to write.
+* @param sendTime The send time to write (microseconds since epoch).
+*/
+void usFrameStamp::write(unsigned char *frame, unsigned int frameSize, uint32_t frameCount, uint64_t sendTime)
+{
+  if (frameSize < size)
+    throw(vpException(vpException::dimensionError, "usFrameStamp : frame too small to be stamped !"));
+
+  uint64_t frameChecksum = checksum(frame + size, frameSize - size);
+  memcpy(frame, &usFrameStampMagic, 4);
+  memcpy(frame + 4, &frameCount, 4);
+  memcpy(frame + 8, &sendTime, 8);
+  memcpy(frame + 16, &frameChecksum, 8);
+}
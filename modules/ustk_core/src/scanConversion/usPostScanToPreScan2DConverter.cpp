@@ -31,6 +31,7 @@
  *****************************************************************************/
 
 #include <visp3/ustk_core/usPostScanToPreScan2DConverter.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 //#include <visp/vpMath.h>
 /**
@@ -192,6 +193,8 @@ void usPostScanToPreScan2DConverter::init(const usTransducerSettings &transducer
 void usPostScanToPreScan2DConverter::convert(const usImagePostScan2D<unsigned char> &imageToConvert,
                                              usImagePreScan2D<unsigned char> &imageConverted, int preScanSamples)
 {
+  usLatencyTracer::usScope traceScope("post-scan to pre-scan 2D");
+
   if (!m_isInit) {
     init(imageToConvert, preScanSamples, imageToConvert.getScanLineNumber());
   }
@@ -32,6 +32,7 @@
 
 #include <visp/vpMath.h>
 #include <visp3/ustk_core/usPreScanToPostScan2DConverter.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 usPreScanToPostScan2DConverter::usPreScanToPostScan2DConverter() : m_initDone(false) {}
 
@@ -195,6 +196,8 @@ void usPreScanToPostScan2DConverter::convert(const usImagePreScan2D<unsigned cha
                                              usImagePostScan2D<unsigned char> &postScanImage, double xResolution,
                                              double yResolution)
 {
+  usLatencyTracer::usScope traceScope("pre-scan to post-scan 2D");
+
   // if user specified the resolution wanted
   if (xResolution != 0. && yResolution != 0.) {
     init(preScanImage, preScanImage.getBModeSampleNumber(), preScanImage.getScanLineNumber(), xResolution, yResolution);
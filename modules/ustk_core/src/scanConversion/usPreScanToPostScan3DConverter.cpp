@@ -32,6 +32,7 @@
  *****************************************************************************/
 
 #include <visp3/ustk_core/usPreScanToPostScan3DConverter.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 #ifdef VISP_HAVE_OPENMP
 #include <omp.h>
@@ -446,6 +447,8 @@ usPreScanToPostScan3DConverter::~usPreScanToPostScan3DConverter() {}
 void usPreScanToPostScan3DConverter::convert(usImagePostScan3D<unsigned char> &postScanImage,
                                              const usImagePreScan3D<unsigned char> &preScanImage)
 {
+  usLatencyTracer::usScope traceScope("pre-scan to post-scan 3D");
+
   init(preScanImage, m_downSamplingFactor);
 
   postScanImage.resize(m_nbY, m_nbX, m_nbZ);
@@ -0,0 +1,460 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+* @file usLatencyTracer.cpp
+* @brief Lightweight latency tracing of the frames along the acquisition / processing chain.
+*/
+
+#include <visp3/ustk_core/usLatencyTracer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+#include <visp3/core/vpException.h>
+
+namespace
+{
+const unsigned int usTraceCapacity = 1 << 16; // events in the ring buffer (power of 2)
+const unsigned int usTraceOriginNumber = 1024; // traces whose origin is kept (power of 2)
+const unsigned int usTraceNameNumber = 64;     // checkpoints / stages with a histogram
+const unsigned int usTraceBucketNumber = 256;  // histogram buckets (8 per power of 2, in microseconds)
+const unsigned int usTraceFrameBits = 40;      // low bits of a trace ID holding the frame count
+const uint64_t usTraceNoId = ~(uint64_t)0;
+
+typedef enum { CHECKPOINT_EVENT, STAGE_EVENT } usTraceEventType;
+
+// event of the ring buffer, protected by a sequence number (0 while the event is written)
+struct usTraceEvent {
+  std::atomic<uint64_t> sequence;
+  std::atomic<uint64_t> traceId;
+  std::atomic<const char *> name;
+  std::atomic<uint64_t> threadId;
+  std::atomic<uint64_t> time;     // ns, monotonic clock
+  std::atomic<uint64_t> duration; // ns, for stages
+  std::atomic<int> type;
+};
+
+// origin (first checkpoint) of a trace
+struct usTraceOrigin {
+  std::atomic<uint64_t> traceId;
+  std::atomic<uint64_t> time;
+};
+
+struct usTraceData {
+  std::atomic<bool> enabled;
+  std::atomic<uint64_t> writeIndex;
+  std::atomic<uint64_t> threadNumber;
+  std::atomic<unsigned int> streamNumber;
+  usTraceEvent events[usTraceCapacity];
+  usTraceOrigin origins[usTraceOriginNumber];
+  std::atomic<const char *> names[usTraceNameNumber];
+  std::atomic<int> nameTypes[usTraceNameNumber];
+  std::atomic<uint64_t> buckets[usTraceNameNumber][usTraceBucketNumber];
+};
+
+// zero-initialized (static storage)
+usTraceData usTrace;
+
+thread_local uint64_t usTraceCurrentId = 0;
+thread_local uint64_t usTraceThreadId = 0;
+
+uint64_t traceTime()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t traceThreadId()
+{
+  if (usTraceThreadId == 0)
+    usTraceThreadId = usTrace.threadNumber.fetch_add(1, std::memory_order_relaxed) + 1;
+  return usTraceThreadId;
+}
+
+void recordEvent(uint64_t traceId, const char *name, uint64_t time, uint64_t duration, usTraceEventType type)
+{
+  uint64_t index = usTrace.writeIndex.fetch_add(1, std::memory_order_relaxed);
+  usTraceEvent &event = usTrace.events[index & (usTraceCapacity - 1)];
+  event.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  event.traceId.store(traceId, std::memory_order_relaxed);
+  event.name.store(name, std::memory_order_relaxed);
+  event.threadId.store(traceThreadId(), std::memory_order_relaxed);
+  event.time.store(time, std::memory_order_relaxed);
+  event.duration.store(duration, std::memory_order_relaxed);
+  event.type.store(type, std::memory_order_relaxed);
+  event.sequence.store(index + 1, std::memory_order_release);
+}
+
+// index of the histogram of a name (created if needed and create is true), -1 if not found or no more room
+int nameIndex(const char *name, bool create, usTraceEventType type)
+{
+  for (unsigned int i = 0; i < usTraceNameNumber; i++) {
+    const char *current = usTrace.names[i].load(std::memory_order_acquire);
+    if (current == NULL) {
+      if (!create)
+        return -1;
+      if (usTrace.names[i].compare_exchange_strong(current, name, std::memory_order_acq_rel)) {
+        usTrace.nameTypes[i].store(type, std::memory_order_relaxed);
+        return i;
+      }
+      // another thread claimed the slot, current is now its name
+    }
+    if (current == name || strcmp(current, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+unsigned int bucketIndex(uint64_t microseconds)
+{
+  if (microseconds < 8)
+    return (unsigned int)microseconds;
+  unsigned int exponent = 3;
+  while (microseconds >> (exponent + 1))
+    exponent++;
+  unsigned int index = (exponent - 2) * 8 + (unsigned int)((microseconds >> (exponent - 3)) & 7);
+  return std::min(index, usTraceBucketNumber - 1);
+}
+
+// middle of a bucket, in microseconds
+double bucketValue(unsigned int index)
+{
+  if (index < 8)
+    return index + 0.5;
+  unsigned int exponent = index / 8 + 2;
+  double width = (double)((uint64_t)1 << (exponent - 3));
+  return (8 + index % 8) * width + width / 2.0;
+}
+
+void addSample(const char *name, uint64_t nanoseconds, usTraceEventType type)
+{
+  int index = nameIndex(name, true, type);
+  if (index >= 0)
+    usTrace.buckets[index][bucketIndex(nanoseconds / 1000)].fetch_add(1, std::memory_order_relaxed);
+}
+
+// origin slot of a trace : consecutive frames of a stream use consecutive slots, and the streams are shifted from each
+// other so that the frames of streams with the same frame count don't share a slot
+usTraceOrigin &originSlot(uint64_t traceId)
+{
+  uint64_t stream = traceId >> usTraceFrameBits;
+  return usTrace.origins[(traceId + 97 * stream) & (usTraceOriginNumber - 1)];
+}
+
+bool traceOrigin(uint64_t traceId, uint64_t &time)
+{
+  usTraceOrigin &origin = originSlot(traceId);
+  if (origin.traceId.load(std::memory_order_acquire) != traceId)
+    return false;
+  time = origin.time.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return origin.traceId.load(std::memory_order_relaxed) == traceId;
+}
+
+double percentileOf(int index, double percentile, uint64_t &count)
+{
+  count = 0;
+  for (unsigned int b = 0; b < usTraceBucketNumber; b++)
+    count += usTrace.buckets[index][b].load(std::memory_order_relaxed);
+  if (count == 0)
+    return 0.0;
+
+  uint64_t rank = (uint64_t)(percentile / 100.0 * (count - 1)) + 1;
+  uint64_t cumulated = 0;
+  for (unsigned int b = 0; b < usTraceBucketNumber; b++) {
+    cumulated += usTrace.buckets[index][b].load(std::memory_order_relaxed);
+    if (cumulated >= rank)
+      return bucketValue(b) / 1000.0;
+  }
+  return bucketValue(usTraceBucketNumber - 1) / 1000.0;
+}
+
+void writeJsonString(std::ostream &out, const char *text)
+{
+  out << '"';
+  for (const char *c = text; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\')
+      out << '\\';
+    out << *c;
+  }
+  out << '"';
+}
+}
+
+/**
+* Starts the record of a stage on the current trace of the thread (see setCurrentTraceId()).
+* @param stage Name of the stage (string literal).
+*/
+usLatencyTracer::usScope::usScope(const char *stage) : m_stage(NULL), m_traceId(0), m_begin(0)
+{
+  if (!usTrace.enabled.load(std::memory_order_relaxed))
+    return;
+  m_stage = stage;
+  m_traceId = usTraceCurrentId;
+  m_begin = traceTime();
+}
+
+/**
+* Ends the record of the stage.
+*/
+usLatencyTracer::usScope::~usScope()
+{
+  if (m_stage == NULL)
+    return;
+  uint64_t duration = traceTime() - m_begin;
+  recordEvent(m_traceId, m_stage, m_begin, duration, STAGE_EVENT);
+  addSample(m_stage, duration, STAGE_EVENT);
+}
+
+/**
+* Records a checkpoint on the current trace of the thread (see setCurrentTraceId()).
+* @param name Name of the checkpoint (string literal).
+*/
+void usLatencyTracer::checkpoint(const char *name)
+{
+  if (!usTrace.enabled.load(std::memory_order_relaxed))
+    return;
+  checkpoint(usTraceCurrentId, name);
+}
+
+/**
+* Records a checkpoint on a trace.
+* @param traceId The trace ID (see getTraceId()).
+* @param name Name of the checkpoint (string literal).
+*/
+void usLatencyTracer::checkpoint(uint64_t traceId, const char *name)
+{
+  if (!usTrace.enabled.load(std::memory_order_relaxed))
+    return;
+  uint64_t time = traceTime();
+  recordEvent(traceId, name, time, 0, CHECKPOINT_EVENT);
+
+  uint64_t origin;
+  if (traceOrigin(traceId, origin) && time >= origin)
+    addSample(name, time - origin, CHECKPOINT_EVENT);
+}
+
+/**
+* Removes all the events and histograms. Not to call while frames are traced by other threads.
+*/
+void usLatencyTracer::clear()
+{
+  usTrace.writeIndex.store(0);
+  for (unsigned int i = 0; i < usTraceCapacity; i++)
+    usTrace.events[i].sequence.store(0);
+  for (unsigned int i = 0; i < usTraceOriginNumber; i++)
+    usTrace.origins[i].traceId.store(usTraceNoId);
+  for (unsigned int i = 0; i < usTraceNameNumber; i++) {
+    usTrace.names[i].store(NULL);
+    for (unsigned int b = 0; b < usTraceBucketNumber; b++)
+      usTrace.buckets[i][b].store(0);
+  }
+}
+
+/**
+* Getter for the capacity of the ring buffer.
+* @return The number of events kept (the oldest events are overwritten).
+*/
+unsigned int usLatencyTracer::getCapacity() { return usTraceCapacity; }
+
+/**
+* Getter for the trace ID of the current thread.
+* @return The trace ID used by checkpoint(const char*) and usLatencyTracer::usScope in this thread.
+*/
+uint64_t usLatencyTracer::getCurrentTraceId() { return usTraceCurrentId; }
+
+/**
+* Computes a percentile of the histogram of a checkpoint (delay since the trace origin) or stage (duration).
+* @param name Name of the checkpoint or stage.
+* @param percentile The percentile wanted, in [0, 100].
+* @return The percentile in milliseconds (bucket precision : 12.5 %), 0 if no sample was recorded.
+*/
+double usLatencyTracer::getPercentile(const char *name, double percentile)
+{
+  if (percentile < 0.0 || percentile > 100.0)
+    throw(vpException(vpException::badValue, "usLatencyTracer : percentile must be in [0, 100]"));
+
+  int index = nameIndex(name, false, CHECKPOINT_EVENT);
+  if (index < 0)
+    return 0.0;
+  uint64_t count;
+  return percentileOf(index, percentile, count);
+}
+
+/**
+* Builds the trace ID of a frame.
+* @param stream The stream number of the grabber (see newStream()), 0 for the frames of a single stream.
+* @param frameCount The frame count given by the grabber (modulo 2^40).
+* @return The trace ID, unique among the frames of all the streams.
+*/
+uint64_t usLatencyTracer::getTraceId(unsigned int stream, uint64_t frameCount)
+{
+  return ((uint64_t)stream << usTraceFrameBits) | (frameCount & (((uint64_t)1 << usTraceFrameBits) - 1));
+}
+
+/**
+* Returns true if the tracer records the events.
+*/
+bool usLatencyTracer::isEnabled() { return usTrace.enabled.load(std::memory_order_relaxed); }
+
+/**
+* Gives a new stream number, to build the trace IDs of the frames of a grabber (see getTraceId()).
+* @return A stream number, different from the ones already given and from 0.
+*/
+unsigned int usLatencyTracer::newStream() { return usTrace.streamNumber.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+/**
+* Prints the number of samples, median, 90th and 99th percentiles of every checkpoint and stage histogram.
+* @param out The stream to print in.
+*/
+void usLatencyTracer::printStatistics(std::ostream &out)
+{
+  out << "latency statistics (ms)" << std::endl;
+  for (unsigned int i = 0; i < usTraceNameNumber; i++) {
+    const char *name = usTrace.names[i].load(std::memory_order_acquire);
+    if (name == NULL)
+      break;
+    uint64_t count;
+    double p50 = percentileOf(i, 50.0, count);
+    double p90 = percentileOf(i, 90.0, count);
+    double p99 = percentileOf(i, 99.0, count);
+    out << "  " << name
+        << (usTrace.nameTypes[i].load(std::memory_order_relaxed) == STAGE_EVENT ? " (duration)" : " (since origin)")
+        << " : n = " << count << ", p50 = " << p50 << ", p90 = " << p90 << ", p99 = " << p99 << std::endl;
+  }
+}
+
+/**
+* Setter for the trace ID of the current thread (set by the acquire() method of the grabbers).
+* @param traceId The trace ID (see getTraceId()).
+*/
+void usLatencyTracer::setCurrentTraceId(uint64_t traceId) { usTraceCurrentId = traceId; }
+
+/**
+* Enables / disables the record of the events.
+* @param enabled True to record the events.
+*/
+void usLatencyTracer::setEnabled(bool enabled)
+{
+  if (enabled && !usTrace.enabled.load()) {
+    // no origin is valid before the first trace
+    for (unsigned int i = 0; i < usTraceOriginNumber; i++)
+      usTrace.origins[i].traceId.store(usTraceNoId);
+  }
+  usTrace.enabled.store(enabled);
+}
+
+/**
+* Records the first checkpoint of a trace, used as origin for the delays of the following checkpoints.
+* @param traceId The trace ID (see getTraceId()).
+* @param name Name of the checkpoint (string literal).
+*/
+void usLatencyTracer::startTrace(uint64_t traceId, const char *name)
+{
+  if (!usTrace.enabled.load(std::memory_order_relaxed))
+    return;
+  uint64_t time = traceTime();
+  usTraceOrigin &origin = originSlot(traceId);
+  origin.traceId.store(usTraceNoId, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  origin.time.store(time, std::memory_order_relaxed);
+  origin.traceId.store(traceId, std::memory_order_release);
+
+  recordEvent(traceId, name, time, 0, CHECKPOINT_EVENT);
+}
+
+/**
+* Exports the events of the ring buffer in the Chrome trace format (JSON).
+* @param filename The output file.
+* @return False if the file can't be written.
+*/
+bool usLatencyTracer::writeChromeTrace(const std::string &filename)
+{
+  struct usEventCopy {
+    uint64_t traceId;
+    const char *name;
+    uint64_t threadId;
+    uint64_t time;
+    uint64_t duration;
+    int type;
+    bool operator<(const usEventCopy &other) const { return time < other.time; }
+  };
+
+  // snapshot of the valid events
+  std::vector<usEventCopy> events;
+  events.reserve(usTraceCapacity);
+  for (unsigned int i = 0; i < usTraceCapacity; i++) {
+    usTraceEvent &event = usTrace.events[i];
+    uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+    if (sequence == 0)
+      continue;
+    usEventCopy copy;
+    copy.traceId = event.traceId.load(std::memory_order_relaxed);
+    copy.name = event.name.load(std::memory_order_relaxed);
+    copy.threadId = event.threadId.load(std::memory_order_relaxed);
+    copy.time = event.time.load(std::memory_order_relaxed);
+    copy.duration = event.duration.load(std::memory_order_relaxed);
+    copy.type = event.type.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (event.sequence.load(std::memory_order_relaxed) == sequence && copy.name != NULL)
+      events.push_back(copy);
+  }
+  std::sort(events.begin(), events.end());
+
+  std::ofstream file(filename.c_str());
+  if (!file.is_open())
+    return false;
+
+  file << std::fixed << std::setprecision(3);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (unsigned int i = 0; i < events.size(); i++) {
+    file << (i == 0 ? "\n" : ",\n") << "{\"name\":";
+    writeJsonString(file, events[i].name);
+    file << ",\"cat\":\"ustk\",\"pid\":1,\"tid\":" << events[i].threadId << ",\"ts\":" << events[i].time / 1000.0;
+    if (events[i].type == STAGE_EVENT)
+      file << ",\"ph\":\"X\",\"dur\":" << events[i].duration / 1000.0;
+    else
+      file << ",\"ph\":\"i\",\"s\":\"t\"";
+    file << ",\"args\":{\"frame\":" << events[i].traceId << "}}";
+  }
+  file << "\n]}\n";
+
+  return file.good();
+}
@@ -0,0 +1,85 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include <visp3/core/vpConfig.h>
+
+#include <iostream>
+
+#include <visp3/ustk_core/usImage3D.h>
+#include <visp3/ustk_core/usImage3DView.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               MAIN FUNCTION                                */
+/* -------------------------------------------------------------------------- */
+
+int main()
+{
+  bool testFailed = false;
+
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << "  testUsImage3DView.cpp" << std::endl << std::endl;
+  std::cout << "  The test reads and writes a volume through a region of interest." << std::endl;
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << std::endl;
+
+  const unsigned int height = 13, width = 21, numberOfFrames = 10;
+  usImage3D<int> image(height, width, numberOfFrames);
+  for (unsigned int k = 0; k < numberOfFrames; k++)
+    for (unsigned int i = 0; i < height; i++)
+      for (unsigned int j = 0; j < width; j++)
+        image(i, j, k, (int)((k * height + i) * width + j));
+
+  // the view writes in the volume
+  usImage3DView<int> view(image, 2, 3, 4, 5, 6, 3);
+  view(0, 0, 0, -2);
+  if (image(2, 3, 4) != -2 || view(4, 5, 2) != image(6, 8, 6) || view.getSize() != 90) {
+    std::cout << "ERROR : wrong access through the region of interest !" << std::endl;
+    testFailed = true;
+  }
+  usImage3D<int> roi;
+  view.toImage3D(roi);
+  if (roi.getHeight() != 5 || roi.getWidth() != 6 || roi.getNumberOfFrames() != 3 || roi(1, 2, 1) != image(3, 5, 5)) {
+    std::cout << "ERROR : wrong copy of the region of interest !" << std::endl;
+    testFailed = true;
+  }
+
+  try {
+    usImage3DView<int> outside(image, 10, 0, 0, 5, 1, 1);
+    std::cout << "ERROR : view outside the volume accepted !" << std::endl;
+    testFailed = true;
+  } catch (const vpException &) {
+  }
+
+  if (!testFailed)
+    std::cout << "Test passed !" << std::endl;
+  return testFailed;
+}
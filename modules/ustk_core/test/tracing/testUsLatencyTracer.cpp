@@ -0,0 +1,143 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Author:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include <visp3/core/vpConfig.h>
+
+#include <iostream>
+
+#include <visp3/core/vpIoTools.h>
+#include <visp3/core/vpTime.h>
+
+#include <visp3/ustk_core/usLatencyTracer.h>
+
+#include <fstream>
+#include <string>
+
+/* -------------------------------------------------------------------------- */
+/*                               MAIN FUNCTION                                */
+/* -------------------------------------------------------------------------- */
+
+int main()
+{
+  bool testFailed = false;
+
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << "  testUsLatencyTracer.cpp" << std::endl << std::endl;
+  std::cout << "  The test traces frames through a simulated chain (receive, 2 ms stage, display), then checks the"
+               "  percentiles and the Chrome trace export."
+            << std::endl;
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << std::endl;
+
+  // nothing is recorded while disabled
+  usLatencyTracer::clear();
+  usLatencyTracer::startTrace(0, "socket receive");
+  usLatencyTracer::checkpoint(0, "display");
+  if (usLatencyTracer::getPercentile("display", 50.0) != 0.0) {
+    std::cout << "ERROR : events recorded while the tracer is disabled !" << std::endl;
+    testFailed = true;
+  }
+
+  usLatencyTracer::setEnabled(true);
+  for (unsigned int frame = 1; frame <= 20; frame++) {
+    usLatencyTracer::startTrace(frame, "socket receive");
+    usLatencyTracer::setCurrentTraceId(frame);
+    {
+      usLatencyTracer::usScope scope("processing");
+      vpTime::wait(2);
+    }
+    usLatencyTracer::checkpoint("display");
+  }
+  usLatencyTracer::setEnabled(false);
+
+  usLatencyTracer::printStatistics();
+
+  // histogram buckets are 12.5 % wide, the sleep can only last longer than asked
+  double processing = usLatencyTracer::getPercentile("processing", 50.0);
+  double display = usLatencyTracer::getPercentile("display", 50.0);
+  if (processing < 1.7 || display < processing * 0.8) {
+    std::cout << "ERROR : wrong percentiles (processing " << processing << " ms, display " << display << " ms) !"
+              << std::endl;
+    testFailed = true;
+  }
+
+#if defined(_WIN32)
+  std::string filename = "C:\\temp\\testUsLatencyTracer.json";
+#else
+  std::string filename = "/tmp/testUsLatencyTracer.json";
+#endif
+  if (!usLatencyTracer::writeChromeTrace(filename)) {
+    std::cout << "ERROR : can't write " << filename << std::endl;
+    testFailed = true;
+  } else {
+    // 20 frames * (receive + stage + display)
+    std::ifstream file(filename.c_str());
+    std::string line;
+    unsigned int eventNumber = 0;
+    while (std::getline(file, line))
+      if (line.find("\"cat\":\"ustk\"") != std::string::npos)
+        eventNumber++;
+    if (eventNumber != 60) {
+      std::cout << "ERROR : " << eventNumber << " events exported instead of 60 !" << std::endl;
+      testFailed = true;
+    }
+    vpIoTools::remove(filename);
+  }
+
+  // two streams with the same frame counts : the origin of a frame is not overwritten by the frame of the other stream
+  usLatencyTracer::clear();
+  usLatencyTracer::setEnabled(true);
+  unsigned int stream1 = usLatencyTracer::newStream();
+  unsigned int stream2 = usLatencyTracer::newStream();
+  if (stream1 == 0 || stream2 == stream1 ||
+      usLatencyTracer::getTraceId(stream1, 1) == usLatencyTracer::getTraceId(stream2, 1)) {
+    std::cout << "ERROR : the streams are not told apart !" << std::endl;
+    testFailed = true;
+  }
+  for (unsigned int frame = 1; frame <= 10; frame++) {
+    usLatencyTracer::startTrace(usLatencyTracer::getTraceId(stream1, frame), "socket receive");
+    vpTime::wait(2);
+    usLatencyTracer::startTrace(usLatencyTracer::getTraceId(stream2, frame), "socket receive");
+    usLatencyTracer::checkpoint(usLatencyTracer::getTraceId(stream1, frame), "stream 1 display");
+  }
+  usLatencyTracer::setEnabled(false);
+  double stream1Display = usLatencyTracer::getPercentile("stream 1 display", 50.0);
+  if (stream1Display < 1.7) {
+    std::cout << "ERROR : stream 1 display after " << stream1Display << " ms instead of 2 ms, origin overwritten !"
+              << std::endl;
+    testFailed = true;
+  }
+
+  if (!testFailed)
+    std::cout << "Test passed !" << std::endl;
+  return testFailed;
+}
@@ -0,0 +1,133 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usBlockMatching.h
+ * @brief Block-matching motion estimation on RF images, for elastography purpose.
+ */
+
+#ifndef __usBlockMatching_h_
+#define __usBlockMatching_h_
+
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <vector>
+
+#include <visp3/core/vpMatrix.h>
+#include <visp3/ustk_core/usImageRF2D.h>
+
+/**
+ * @class usBlockMatching
+ * @brief Block-matching motion estimation between two RF images, followed by a sub-sample Taylor refinement.
+ * @ingroup module_ustk_elastography
+ *
+ * The pre-compressed image is divided in blocks. Each block is searched in the post-compressed image among the axial
+ * displacements [0, searchHeight] and the lateral displacements [-searchWidth, searchWidth - 1], as done by
+ * usMotionEstimation. The integer displacement is then refined by a first order Taylor expansion, and the displacement
+ * maps are filtered by a median filter.
+ *
+ * The matching works on the RF samples (scanlines are contiguous in memory), without any copy of the blocks :
+ * - the cost of a candidate is the sum of absolute differences (SAD), the sum of squared differences (SSD) or the
+ * normalized cross-correlation (NCC),
+ * - with SAD and SSD, the cost computation of a candidate stops as soon as it exceeds the best cost found,
+ * - the search can optionally be done first on images decimated by 2 along the scanlines, and refined around the
+ * coarse result (coarse-to-fine, see setCoarseToFine()) : the post-compressed image is decimated with both sampling
+ * phases, so that the coarse search tests every full resolution axial displacement,
+ * - blocks are processed in parallel (OpenMP).
+ *
+ * \code
+ * usBlockMatching blockMatching;
+ * blockMatching.setBlockSize(2, 20);
+ * blockMatching.setSearchRange(2, 120);
+ * blockMatching.run(preCompressed, postCompressed);
+ * vpMatrix V = blockMatching.getV(); // axial displacements, in samples
+ * \endcode
+ */
+class VISP_EXPORT usBlockMatching
+{
+public:
+  /**
+   * Cost functions used to compare blocks.
+   */
+  typedef enum {
+    SAD_METRIC, /**< Sum of absolute differences. */
+    SSD_METRIC, /**< Sum of squared differences. */
+    NCC_METRIC  /**< Normalized cross-correlation. */
+  } usMatchingMetric;
+
+  usBlockMatching();
+  virtual ~usBlockMatching();
+
+  const vpMatrix &getU() const;
+  const vpMatrix &getV() const;
+
+  void run(const usImageRF2D<short int> &pre, const usImageRF2D<short int> &post);
+
+  void setBlockSize(unsigned int width, unsigned int height);
+  void setCoarseToFine(bool coarseToFine);
+  void setEarlyTermination(bool earlyTermination);
+  void setMedianFilterSize(unsigned int width, unsigned int height);
+  void setMetric(usMatchingMetric metric);
+  void setSearchRange(unsigned int width, unsigned int height);
+
+private:
+  double cost(const short int *pre, const short int *post, unsigned int height, int top, int left, int postTop,
+              int postLeft, int blockHeight, int blockWidth, double bound) const;
+  void medianFilter(vpMatrix &M) const;
+  double search(const short int *pre, const short int *post, unsigned int height, int top, int left, int blockHeight,
+              int blockWidth, int dyMin, int dyMax, int dxMin, int dxMax, int &bestDy, int &bestDx) const;
+  void taylorRefinement(const short int *pre, const short int *post, unsigned int height, int top, int left, int dy,
+                        int dx, double &refinementX, double &refinementY) const;
+
+  unsigned int m_blockWidth;
+  unsigned int m_blockHeight;
+  unsigned int m_searchWidth;
+  unsigned int m_searchHeight;
+  unsigned int m_medianWidth;
+  unsigned int m_medianHeight;
+  usMatchingMetric m_metric;
+  bool m_coarseToFine;
+  bool m_earlyTermination;
+
+  // images decimated by 2 along the scanlines, for the coarse search (post-compressed image starting on even and odd
+  // samples)
+  std::vector<short int> m_coarsePre;
+  std::vector<short int> m_coarsePost[2];
+
+  vpMatrix m_U;
+  vpMatrix m_V;
+};
+
+#endif // USTK_HAVE_FFTW
+#endif // __usBlockMatching_h_
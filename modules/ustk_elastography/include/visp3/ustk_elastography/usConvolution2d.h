@@ -43,6 +43,8 @@
 
 #if defined(USTK_HAVE_FFTW)
 
+#include <vector>
+
 #include <fftw3.h>
 #include <visp/vpMath.h>
 #include <visp/vpMatrix.h>
@@ -52,42 +54,82 @@
  * @brief Convolution process for elastography puropse, based on fftw thirdparty library.
  * @ingroup module_ustk_elastography
  *
- * This class performs 2D convolutions on RF images.
+ * This class performs 2D convolutions on RF images. Only the valid part of the convolution is returned : the output
+ * size is (rows(matrix1) - rows(matrix2) + 1) x (cols(matrix1) - cols(matrix2) + 1).
+ *
+ * The convolution method is chosen from the kernel (see setMethod()) :
+ * - separable kernels (as gaussian kernels) are applied as a row filter followed by a column filter,
+ * - small non-separable kernels are applied directly,
+ * - large kernels are applied by multiplication in the Fourier domain, using real-to-complex transforms.
+ *
+ * The kernel analysis and its spectrum are cached, they are only computed again when the kernel or the image size
+ * changes. To filter several images with the same kernel, use the run() overload taking a vector of images : in the
+ * Fourier domain their transforms are batched in a single fftw plan.
  */
 class VISP_EXPORT usConvolution2d
 {
 public:
+  /**
+   * Convolution methods.
+   */
+  typedef enum {
+    AUTO_METHOD,      /**< Choice based on the kernel size and separability. */
+    DIRECT_METHOD,    /**< Direct summation over the kernel. */
+    SEPARABLE_METHOD, /**< Row filter then column filter (rank 1 kernels only, otherwise direct summation is used). */
+    FFT_METHOD        /**< Product in the Fourier domain. */
+  } usConvolutionMethod;
+
   usConvolution2d();
   virtual ~usConvolution2d();
+
+  usConvolutionMethod getMethod() const;
+
   void init(const vpMatrix &matrix1, const vpMatrix &matrix2);
+
+  bool isKernelSeparable() const;
+
   vpMatrix run(const vpMatrix &matrix1, const vpMatrix &matrix2);
+  void run(const std::vector<const vpMatrix *> &matrices, const vpMatrix &kernel, std::vector<vpMatrix> &results);
+
+  void setMethod(usConvolutionMethod method);
 
 private:
-  fftw_complex *outa;
-  fftw_complex *outb;
-  fftw_complex *outc;
-  fftw_complex *out;
-  fftw_complex *ad;
-  fftw_complex *bd;
-  fftw_plan p1;
-  fftw_plan p2;
-  fftw_plan p3;
-
-  bool m_init;
-
-  vpMatrix m_M1;
-  vpMatrix m_M2;
-  vpMatrix m_R;
-  unsigned int h_dst;
-  unsigned int w_dst;
-  unsigned int hf;
-  unsigned int wf;
+  void computeKernelSpectrum();
+  void convolveDirect(const vpMatrix &matrix, vpMatrix &result) const;
+  void convolveFFT(const std::vector<const vpMatrix *> &matrices, std::vector<vpMatrix> &results);
+  void convolveSeparable(const vpMatrix &matrix, vpMatrix &result) const;
+  void initFFT(unsigned int batchSize);
+  void releaseFFT();
+  usConvolutionMethod selectMethod() const;
+  void setKernel(const vpMatrix &kernel);
+
+  usConvolutionMethod m_method;
+
+  // kernel cache
+  vpMatrix m_kernel;
+  bool m_kernelSeparable;
+  std::vector<double> m_kernelFlipped;    // kernel rotated by 180 degrees (direct method)
+  std::vector<double> m_kernelRowFlipped; // separable factors, reversed (separable method)
+  std::vector<double> m_kernelColFlipped;
+  bool m_kernelSpectrumValid;
+
   unsigned int Am; // A row number
   unsigned int An; // A col number
   unsigned int Bm; // B row number
   unsigned int Bn; // B col number
+  unsigned int h_dst;
+  unsigned int w_dst;
 
-  void padding_zeros(void);
+  // fftw buffers and plans, for a batch of m_batchSize images of Am x An (circular convolution is valid on the output)
+  unsigned int m_batchSize;
+  unsigned int m_spectrumCols;
+  double *m_fftIn;
+  fftw_complex *m_fftOut;
+  double *m_kernelIn;
+  fftw_complex *m_kernelSpectrum;
+  fftw_plan m_forwardPlan;
+  fftw_plan m_backwardPlan;
+  fftw_plan m_kernelPlan;
 };
 
 #endif // USTK_HAVE_FFTW
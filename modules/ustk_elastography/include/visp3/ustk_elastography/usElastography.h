@@ -45,7 +45,8 @@
 #include <visp3/core/vpImageTools.h>
 
 #include <visp3/ustk_core/usImageRF2D.h>
-#include <visp3/ustk_elastography/usConvolution2d.h>
+#include <visp3/ustk_elastography/usBlockMatching.h>
+#include <visp3/ustk_elastography/usElastographyWorkspace.h>
 #include <visp3/ustk_elastography/usMotionEstimation.h>
 #include <visp3/ustk_elastography/usSignalProcessing.h>
 
@@ -63,6 +64,8 @@
  */
 class VISP_EXPORT usElastography
 {
+  friend class usElastography3D;
+
 public:
   enum MotionEstimator { OF, BMA_TAYLOR };
   usElastography();
@@ -73,27 +76,39 @@ public:
   double getSamplingFrequency(void) { return m_samplingFrequency; }
 
   vpImage<unsigned char> run();
+  vpImage<unsigned char> run(const usImageRF2D<short int> &pre, const usImageRF2D<short int> &post);
 
   void setDecimationFactor(unsigned int decimationFactor) { m_decimationFactor = decimationFactor; }
   void setFPS(double fps);
   void setSamplingFrequency(double samplingFrequency);
   void setLSQpercentage(double per);
+  void setLSQpercentage(double nearPer, double farPer);
   void setMotionEstimator(MotionEstimator t_mest) { m_mEstimatior = t_mest; }
   void setPostCompression(const usImageRF2D<short> &Post);
   void setPreCompression(const usImageRF2D<short> &Pre);
   void setROI(int tx, int ty, int tw, int th);
+  void setWindowStep(double step);
 
   void updateRF(const usImageRF2D<short int> &image);
   void updateROIPos(int tx, int ty);
 
 private:
-  usImageRF2D<short int> usImageRF_ROI(const usImageRF2D<short int> &M, uint r, uint c, uint nrows, uint ncols);
+  static double solveAxialFlow(double sx2, double sxy, double sy2, double bx, double by);
+  void computeFlowProducts();
+  void computeStrainMap();
+  void estimateFlowDisplacements(const std::vector<vpImage<float> > &blurredProducts);
+  void extractROI(const short int *M, unsigned int height, unsigned int width, usImageRF2D<short int> &roi, uint r,
+                  uint c, uint nrows, uint ncols);
+  vpImage<unsigned char> runOnFrames(const short int *pre, const short int *post, unsigned int height,
+                                     unsigned int width);
+  static void swapRF(usImageRF2D<short int> &a, usImageRF2D<short int> &b);
 
   vpImage<unsigned char> m_StrainMap;
   usImageRF2D<short int> m_Precomp;
   usImageRF2D<short int> m_Postcomp;
 
   double m_Lsqper;
+  double m_LsqperFar;
   bool m_isloadPre;
   bool m_isloadPost;
   double m_FPS;
@@ -113,19 +128,19 @@ private:
   usImageRF2D<short int> m_PreROI;
   usImageRF2D<short int> m_PostROI;
 
-  std::vector<usConvolution2d *> cC;
+  // float processing of the optical flow and strain, in buffers reused from one frame to the other
+  usElastographyWorkspace<float> m_workspace;
 
   // Motion estimation
   MotionEstimator m_mEstimatior;
 
-#if defined(USTK_HAVE_ARMADILLO) && (ARMA_VERSION_MAJOR > 6) && (ARMA_VERSION_MAJOR > 700)
-  usMotionEstimation m_ME;
-#endif
+  usBlockMatching m_blockMatching;
 
   vpMatrix U;
   vpMatrix V;
 
   unsigned int m_decimationFactor;
+  double m_windowStep;
 };
 
 #endif // FFTW
@@ -53,6 +53,12 @@
  *
  * This class produces a strain map based on tissues displacements between 2 input 3D RF images.
  *
+ * The frames of the ROI are processed in parallel (if OpenMP is available), each thread using its own 2D elastography
+ * processor, and the strain maps are written directly in the output volume.
+ * By default the displacements are estimated frame by frame. With setMotionEstimation3D(), the optical flow equations of
+ * the neighbouring frames are added to the ones of each frame, which regularizes the displacements across the
+ * elevation.
+ *
  * The typical use of this class is :
  *  - Set the ROI in the RF image, with setROI()
  *  - Set the pre and post compressed volumes, with setPreCompression() and setPostCompression() or with updateRF().
@@ -74,6 +80,7 @@ public:
   void setFPS(double fps);
   void setSamplingFrequency(double samplingFrequency);
   void setLSQpercentage(double per);
+  void setMotionEstimation3D(bool motionEstimation3D);
   void setMotionEstimator(usElastography::MotionEstimator t_mest);
   void setPostCompression(const usImageRF3D<short> &Post);
   void setPreCompression(const usImageRF3D<short> &Pre);
@@ -83,7 +90,23 @@ public:
   void updateROIPos(int tx, int ty, int tz);
 
 private:
+  // not copyable : the frame processors are owned
+  usElastography3D(const usElastography3D &);
+  usElastography3D &operator=(const usElastography3D &);
+
+  void configureFrameProcessor(usElastography &processor) const;
+  static void copyStrainMap(const usElastography &processor, usImage3D<unsigned char> &outputVolume,
+                            unsigned int frame);
+  usElastography &getFrameProcessor();
+  void runFrames(usImage3D<unsigned char> &outputVolume);
+  void runFrames3D(usImage3D<unsigned char> &outputVolume);
+  static void sumNeighbourProducts(const std::vector<std::vector<vpImage<float> > > &products, int frame,
+                                   std::vector<vpImage<float> > &sum);
+
+  // holds the 2D settings, copied on the frame processors before each run
   usElastography m_elastography2DProcessor;
+  // one 2D processor per thread
+  std::vector<usElastography *> m_frameProcessors;
 
   usImage3D<unsigned char> m_StrainMap;
   usImageRF3D<short int> m_Precomp;
@@ -95,6 +118,7 @@ private:
   bool m_setROI;
   int m_framesInROI;
   int m_frameBeginROI;
+  bool m_motionEstimation3D;
 };
 
 #endif // FFTW
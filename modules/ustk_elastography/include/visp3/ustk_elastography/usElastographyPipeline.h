@@ -0,0 +1,170 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usElastographyPipeline.h
+ * @brief Real-time elastography on a stream of RF frames, computed by a pool of worker threads.
+ */
+
+#ifndef __usElastographyPipeline_h_
+#define __usElastographyPipeline_h_
+
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <visp3/ustk_elastography/usElastography.h>
+
+/**
+ * @class usElastographyPipeline
+ * @brief Computes the strain maps of a stream of RF frames, several frame pairs being processed concurrently.
+ * @ingroup module_ustk_elastography
+ *
+ * Each frame pushed with pushFrame() forms a pair with the previous one. The frames are shared between the pairs
+ * (reference counted, never copied once pushed), and each worker thread owns its own usElastography processor, which
+ * only copies the ROI of the two frames.
+ *
+ * The strain maps are delivered in the order of the frames, with getStrainMap() or with a callback (see
+ * setStrainMapCallback()). When the workers cannot keep up with the acquisition, the oldest pairs waiting for a worker
+ * are dropped (see setMaxPendingPairs()), so that the latency stays bounded. A pair whose strain map cannot be computed
+ * (frames of different sizes, ROI outside of the frames) is skipped and counted by getFailedPairNumber().
+ *
+ * Each pair is traced in usLatencyTracer on the current trace ID of the thread that pushed its second frame : the
+ * workers record the elastography stage and a "strain map" checkpoint on it.
+ *
+ * \code
+ * usElastographyPipeline pipeline(3);
+ * pipeline.setROI(40, 2500, 50, 500);
+ * while (grabbing) {
+ *   pipeline.pushFrame(*grabbedFrame);
+ *   vpImage<unsigned char> strainMap;
+ *   unsigned int pairIndex;
+ *   while (pipeline.getStrainMap(strainMap, pairIndex, false)) {
+ *     // display strainMap
+ *   }
+ * }
+ * \endcode
+ */
+class VISP_EXPORT usElastographyPipeline
+{
+public:
+  /**
+   * Shared RF frame.
+   */
+  typedef std::shared_ptr<const usImageRF2D<short int> > usRFFramePtr;
+
+  /**
+   * Function called for each strain map, with the index of the pair (index of its second frame).
+   */
+  typedef std::function<void(const vpImage<unsigned char> &, unsigned int)> usStrainMapCallback;
+
+  explicit usElastographyPipeline(unsigned int workerNumber = 2);
+  virtual ~usElastographyPipeline();
+
+  unsigned int getDroppedPairNumber() const;
+  unsigned int getFailedPairNumber() const;
+  bool getStrainMap(vpImage<unsigned char> &strainMap, unsigned int &pairIndex, bool blocking = true);
+  unsigned int getWorkerNumber() const;
+
+  unsigned int pushFrame(const usImageRF2D<short int> &frame);
+  unsigned int pushFrame(const usRFFramePtr &frame);
+
+  void setDecimationFactor(unsigned int decimationFactor);
+  void setFPS(double fps);
+  void setLSQpercentage(double per);
+  void setMaxPendingPairs(unsigned int maxPendingPairs);
+  void setMotionEstimator(usElastography::MotionEstimator estimator);
+  void setROI(int tx, int ty, int tw, int th);
+  void setSamplingFrequency(double samplingFrequency);
+  void setStrainMapCallback(const usStrainMapCallback &callback);
+
+  void stop();
+
+private:
+  // elastography settings, applied by the workers on their processor for each pair
+  struct usSettings {
+    unsigned int decimationFactor;
+    double fps;
+    double lsqPercentage;
+    usElastography::MotionEstimator estimator;
+    double samplingFrequency;
+    bool roiSet;
+    int tx, ty, tw, th;
+  };
+
+  struct usPair {
+    unsigned int index;
+    uint64_t traceId; // trace ID of the second frame (see usLatencyTracer)
+    usRFFramePtr pre;
+    usRFFramePtr post;
+    usSettings settings;
+  };
+
+  void deliver();
+  void workerLoop();
+
+  std::vector<std::thread> m_workers;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_pairCondition;
+  std::condition_variable m_resultCondition;
+
+  usSettings m_settings;
+  usRFFramePtr m_previousFrame;
+  unsigned int m_frameCount;
+  std::deque<usPair> m_pendingPairs;
+  unsigned int m_maxPendingPairs;
+  unsigned int m_droppedPairs;
+  unsigned int m_failedPairs;
+
+  // strain maps waiting for the previous pairs (NULL for a dropped pair), and strain maps ready to be read
+  std::map<unsigned int, std::shared_ptr<vpImage<unsigned char> > > m_results;
+  unsigned int m_nextPairToDeliver;
+  std::deque<std::pair<unsigned int, std::shared_ptr<vpImage<unsigned char> > > > m_readyResults;
+  usStrainMapCallback m_callback;
+  // a thread is delivering strain maps : the others leave the delivery to it, to keep the order of the strain maps
+  bool m_delivering;
+
+  bool m_stop;
+};
+
+#endif // USTK_HAVE_FFTW
+#endif // __usElastographyPipeline_h_
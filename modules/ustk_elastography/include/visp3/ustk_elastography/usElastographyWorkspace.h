@@ -0,0 +1,410 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usElastographyWorkspace.h
+ * @brief Preallocated buffers and image processing steps of the optical flow elastography.
+ */
+
+#ifndef __usElastographyWorkspace_h_
+#define __usElastographyWorkspace_h_
+
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <cmath>
+#include <vector>
+
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/ustk_core/usImageRF2D.h>
+#include <visp3/ustk_elastography/usSignalProcessing.h>
+#include <visp3/ustk_elastography/usStrainEstimator.h>
+
+#ifdef VISP_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @class usElastographyWorkspace
+ * @brief Image processing steps of the optical flow elastography, working in preallocated images.
+ * @ingroup module_ustk_elastography
+ *
+ * The workspace holds every intermediate image of the elastography (filtered products, interpolated displacements,
+ * strain). They are allocated at the first frame and reused for the next frames, as long as the ROI size does not change.
+ * All the steps are done in these images, without temporary matrices.
+ *
+ * The processing type is a template parameter : usElastography uses float, which halves the memory traffic and doubles
+ * the vector width compared to double. The sums over the optical flow windows are accumulated in double by
+ * usElastography.
+ *
+ * Steps :
+ * - computeBlurredProducts() : gradients of the pre-compressed image, difference between post and pre-compressed images,
+ * and the 5 products dx2, dy2, dxy, dty, dtx, blurred by a separable gaussian kernel (valid part of the convolution).
+ * The gradients, difference and products are computed in a single pass on the RF samples, by tiles of rows (see
+ * setTileHeight()) : each tile of products is filtered along the rows while it is in cache, and only the row-filtered
+ * products are written in full images, before the column filter.
+ * - computeStrain() : bilinear interpolation of the axial displacements, and LSQ strain estimation along the columns
+ * (see usStrainEstimator, configured with getStrainEstimator()).
+ */
+template <class Type> class usElastographyWorkspace
+{
+public:
+  /**
+   * Indexes of the products in getBlurredProducts().
+   */
+  typedef enum { DX2 = 0, DY2 = 1, DXY = 2, DTY = 3, DTX = 4 } usProductIndex;
+
+  usElastographyWorkspace();
+  virtual ~usElastographyWorkspace();
+
+  void computeBlurredProducts(const usImageRF2D<short int> &pre, const usImageRF2D<short int> &post);
+  void computeStrain(const vpMatrix &displacements, unsigned int width, unsigned int height);
+
+  const std::vector<vpImage<Type> > &getBlurredProducts() const;
+  const vpImage<Type> &getStrain() const;
+  usStrainEstimator<Type> &getStrainEstimator();
+  unsigned int getTileHeight() const;
+
+  void setGaussianKernel(unsigned int height, unsigned int width, double sigma);
+  void setTileHeight(unsigned int tileHeight);
+
+private:
+  void computeProductsTile(const usImageRF2D<short int> &pre, const usImageRF2D<short int> &post, unsigned int firstRow,
+                           unsigned int rowNumber, std::vector<Type> &tile);
+  void filterColumns(const vpImage<Type> &image, vpImage<Type> &blurred) const;
+  void filterTileRows(const std::vector<Type> &tile, unsigned int firstRow, unsigned int rowNumber,
+                      unsigned int width);
+
+  // separable gaussian kernel (symmetric, so no flip is needed for the convolution)
+  std::vector<Type> m_gaussianCol;
+  std::vector<Type> m_gaussianRow;
+
+  // products of a tile of rows, scanline per scanline, for each thread
+  unsigned int m_tileHeight;
+  std::vector<std::vector<Type> > m_tiles;
+  std::vector<vpImage<Type> > m_rowFiltered;
+  std::vector<vpImage<Type> > m_blurredProducts;
+  vpImage<Type> m_displacements;
+  usStrainEstimator<Type> m_strainEstimator;
+  vpImage<Type> m_strain;
+};
+
+/**
+* Default constructor : gaussian kernel of 15 x 5 with a standard deviation of 7.5, as used by usElastography, and tiles
+* of 64 rows.
+*/
+template <class Type>
+usElastographyWorkspace<Type>::usElastographyWorkspace()
+  : m_tileHeight(64), m_tiles(), m_rowFiltered(5), m_blurredProducts(5), m_displacements(), m_strainEstimator(),
+    m_strain()
+{
+  setGaussianKernel(15, 5, 7.5);
+}
+
+/**
+* Destructor.
+*/
+template <class Type> usElastographyWorkspace<Type>::~usElastographyWorkspace() {}
+
+/**
+* Setter for the gaussian kernel used to blur the products. The kernel is the one of usSignalProcessing::GaussianFilter()
+* (normalized to a central value of 1), applied as a column filter and a row filter.
+* @param height Kernel height (odd).
+* @param width Kernel width (odd).
+* @param sigma Standard deviation of the gaussian function.
+*/
+template <class Type>
+void usElastographyWorkspace<Type>::setGaussianKernel(unsigned int height, unsigned int width, double sigma)
+{
+  m_gaussianCol.resize(height);
+  m_gaussianRow.resize(width);
+  int b = ((int)height - 1) / 2;
+  int a = ((int)width - 1) / 2;
+  for (int p = -b; p <= b; p++)
+    m_gaussianCol[p + b] = (Type)exp(-(double)(p * p) / (2.0 * sigma * sigma));
+  for (int q = -a; q <= a; q++)
+    m_gaussianRow[q + a] = (Type)exp(-(double)(q * q) / (2.0 * sigma * sigma));
+}
+
+/**
+* Setter for the number of rows processed together by computeBlurredProducts(). The products of a tile take 5 x
+* tileHeight x width values : the default (64 rows) keeps them in L2 cache for usual ROI widths.
+* @param tileHeight Number of rows of a tile, 0 to process the whole ROI as a single tile.
+*/
+template <class Type> void usElastographyWorkspace<Type>::setTileHeight(unsigned int tileHeight)
+{
+  m_tileHeight = tileHeight;
+}
+
+/**
+* Getter for the number of rows processed together by computeBlurredProducts().
+* @return The tile height, 0 if the whole ROI is processed as a single tile.
+*/
+template <class Type> unsigned int usElastographyWorkspace<Type>::getTileHeight() const { return m_tileHeight; }
+
+/**
+* Optical flow products : gradients of the pre-compressed image, difference with the post-compressed image, and blurred
+* products (see getBlurredProducts()). The results are the same as usSignalProcessing::getXGradient(),
+* usSignalProcessing::getYGradient(), usSignalProcessing::Difference() and usSignalProcessing::HadamardProd() followed
+* by the gaussian filter, but the RF images are read once and the products are never stored as full images.
+* @param pre Pre-compressed RF image.
+* @param post Post-compressed RF image.
+*/
+template <class Type>
+void usElastographyWorkspace<Type>::computeBlurredProducts(const usImageRF2D<short int> &pre,
+                                                           const usImageRF2D<short int> &post)
+{
+  if (pre.getHeight() != post.getHeight() || pre.getWidth() != post.getWidth())
+    throw(vpException(vpException::dimensionError,
+                      "usElastographyWorkspace::computeBlurredProducts(), input images dimentions mismatch."));
+
+  const unsigned int height = pre.getHeight();
+  const unsigned int width = pre.getWidth();
+  const unsigned int outWidth = width - m_gaussianRow.size() + 1;
+  const unsigned int tileHeight = (m_tileHeight == 0 || m_tileHeight > height) ? height : m_tileHeight;
+  const int tileNumber = (height + tileHeight - 1) / tileHeight;
+
+  for (unsigned int q = 0; q < m_rowFiltered.size(); q++) {
+    if (m_rowFiltered[q].getHeight() != height || m_rowFiltered[q].getWidth() != outWidth)
+      m_rowFiltered[q].resize(height, outWidth);
+  }
+
+#ifdef VISP_HAVE_OPENMP
+  m_tiles.resize(std::max(1, omp_get_max_threads()));
+#else
+  m_tiles.resize(1);
+#endif
+  for (unsigned int t = 0; t < m_tiles.size(); t++)
+    m_tiles[t].resize(5 * tileHeight * width);
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int t = 0; t < tileNumber; t++) {
+#ifdef VISP_HAVE_OPENMP
+    std::vector<Type> &tile = m_tiles[omp_get_thread_num()];
+#else
+    std::vector<Type> &tile = m_tiles[0];
+#endif
+    unsigned int firstRow = t * tileHeight;
+    unsigned int rowNumber = std::min(tileHeight, height - firstRow);
+    computeProductsTile(pre, post, firstRow, rowNumber, tile);
+    filterTileRows(tile, firstRow, rowNumber, width);
+  }
+
+  for (unsigned int q = 0; q < m_rowFiltered.size(); q++)
+    filterColumns(m_rowFiltered[q], m_blurredProducts[q]);
+}
+
+/**
+* Fused computation of the gradients, difference and products on a tile of rows. The tile stores the 5 products one
+* after the other, each one scanline per scanline (rowNumber values per scanline), so that the products are computed
+* on contiguous samples. The row filter (filterTileRows()) then reads them with a stride of rowNumber values : the
+* tile stays in cache, but these reads are not contiguous.
+* @param pre Pre-compressed RF image.
+* @param post Post-compressed RF image.
+* @param firstRow First row of the tile.
+* @param rowNumber Number of rows of the tile.
+* @param tile Output products.
+*/
+template <class Type>
+void usElastographyWorkspace<Type>::computeProductsTile(const usImageRF2D<short int> &pre,
+                                                        const usImageRF2D<short int> &post, unsigned int firstRow,
+                                                        unsigned int rowNumber, std::vector<Type> &tile)
+{
+  const unsigned int height = pre.getHeight();
+  const unsigned int width = pre.getWidth();
+  const unsigned int planeSize = rowNumber * width;
+  const unsigned int endRow = firstRow + rowNumber;
+
+  for (unsigned int j = 0; j < width; j++) {
+    // X gradient : centered difference inside, [col(1) - col(0)] and [col(w-2) - col(w-1)] on the borders
+    const short int *right, *left;
+    Type scaleX;
+    if (j == 0) {
+      right = pre.getSignal(1);
+      left = pre.getSignal(0);
+      scaleX = 1;
+    } else if (j == width - 1) {
+      right = pre.getSignal(width - 2);
+      left = pre.getSignal(width - 1);
+      scaleX = 1;
+    } else {
+      right = pre.getSignal(j + 1);
+      left = pre.getSignal(j - 1);
+      scaleX = (Type)0.5;
+    }
+    const short int *center = pre.getSignal(j);
+    const short int *postScanline = post.getSignal(j);
+
+    Type *dx2 = &tile[DX2 * planeSize + j * rowNumber];
+    Type *dy2 = &tile[DY2 * planeSize + j * rowNumber];
+    Type *dxy = &tile[DXY * planeSize + j * rowNumber];
+    Type *dty = &tile[DTY * planeSize + j * rowNumber];
+    Type *dtx = &tile[DTX * planeSize + j * rowNumber];
+
+    // Y gradient : forward / backward differences on the first and last samples of the scanline
+    const unsigned int borders[2] = {0, height - 1};
+    for (unsigned int b = 0; b < 2; b++) {
+      unsigned int i = borders[b];
+      if (i < firstRow || i >= endRow)
+        continue;
+      Type fy = (b == 0) ? (Type)(center[1] - center[0]) : (Type)(center[i] - center[i - 1]);
+      Type fx = (Type)(right[i] - left[i]) * scaleX;
+      Type dt = (Type)(postScanline[i] - center[i]);
+      unsigned int r = i - firstRow;
+      dx2[r] = fx * fx;
+      dy2[r] = fy * fy;
+      dxy[r] = fx * fy;
+      dty[r] = dt * fy;
+      dtx[r] = dt * fx;
+    }
+
+    // centered difference inside the scanline
+    const unsigned int innerBegin = std::max(firstRow, 1u);
+    const unsigned int innerEnd = std::min(endRow, height - 1);
+    for (unsigned int i = innerBegin; i < innerEnd; i++) {
+      Type fy = (Type)(center[i + 1] - center[i - 1]) * (Type)0.5;
+      Type fx = (Type)(right[i] - left[i]) * scaleX;
+      Type dt = (Type)(postScanline[i] - center[i]);
+      unsigned int r = i - firstRow;
+      dx2[r] = fx * fx;
+      dy2[r] = fy * fy;
+      dxy[r] = fx * fy;
+      dty[r] = dt * fy;
+      dtx[r] = dt * fx;
+    }
+  }
+}
+
+/**
+* Gaussian row filter (valid part) of the 5 products of a tile, written in the row-filtered images.
+* @param tile Products of the tile (see computeProductsTile()).
+* @param firstRow First row of the tile.
+* @param rowNumber Number of rows of the tile.
+* @param width ROI width.
+*/
+template <class Type>
+void usElastographyWorkspace<Type>::filterTileRows(const std::vector<Type> &tile, unsigned int firstRow,
+                                                   unsigned int rowNumber, unsigned int width)
+{
+  const unsigned int kernelWidth = m_gaussianRow.size();
+  const unsigned int outWidth = width - kernelWidth + 1;
+  const unsigned int planeSize = rowNumber * width;
+
+  for (unsigned int q = 0; q < m_rowFiltered.size(); q++) {
+    const Type *plane = &tile[q * planeSize];
+    for (unsigned int r = 0; r < rowNumber; r++) {
+      Type *out = m_rowFiltered[q][firstRow + r];
+      for (unsigned int k = 0; k < outWidth; k++) {
+        Type sum = 0;
+        for (unsigned int p = 0; p < kernelWidth; p++)
+          sum += plane[(k + p) * rowNumber + r] * m_gaussianRow[p];
+        out[k] = sum;
+      }
+    }
+  }
+}
+
+/**
+* Gaussian column filter (valid part).
+* @param image Row-filtered image.
+* @param blurred Output image, of size (rows - kernel height + 1) x cols.
+*/
+template <class Type>
+void usElastographyWorkspace<Type>::filterColumns(const vpImage<Type> &image, vpImage<Type> &blurred) const
+{
+  const unsigned int kernelHeight = m_gaussianCol.size();
+  const unsigned int outHeight = image.getHeight() - kernelHeight + 1;
+  const unsigned int width = image.getWidth();
+
+  if (blurred.getHeight() != outHeight || blurred.getWidth() != width)
+    blurred.resize(outHeight, width);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int l = 0; l < (int)outHeight; l++) {
+    Type *out = blurred[l];
+    for (unsigned int k = 0; k < width; k++)
+      out[k] = 0;
+    for (unsigned int p = 0; p < kernelHeight; p++) {
+      const Type coef = m_gaussianCol[p];
+      const Type *in = image[l + p];
+      for (unsigned int k = 0; k < width; k++)
+        out[k] += coef * in[k];
+    }
+  }
+}
+
+/**
+* Strain computation : the displacements are interpolated to the size of the ROI, and the strain is estimated along the
+* columns by the strain estimator (see getStrainEstimator()).
+* @param displacements Axial displacements of the optical flow windows.
+* @param width ROI width.
+* @param height ROI height.
+*/
+template <class Type>
+void usElastographyWorkspace<Type>::computeStrain(const vpMatrix &displacements, unsigned int width,
+                                                  unsigned int height)
+{
+  usSignalProcessing::BilinearInterpolation(displacements, width, height, m_displacements);
+  m_strainEstimator.run(m_displacements, m_strain);
+}
+
+/**
+* Getter for the blurred products, see usProductIndex for their order.
+* @return The 5 blurred products of the last computeBlurredProducts() call.
+*/
+template <class Type> const std::vector<vpImage<Type> > &usElastographyWorkspace<Type>::getBlurredProducts() const
+{
+  return m_blurredProducts;
+}
+
+/**
+* Getter for the strain.
+* @return The strain of the last computeStrain() call.
+*/
+template <class Type> const vpImage<Type> &usElastographyWorkspace<Type>::getStrain() const { return m_strain; }
+
+/**
+* Getter for the strain estimator, to set its window length and scale before computeStrain().
+* @return The strain estimator.
+*/
+template <class Type> usStrainEstimator<Type> &usElastographyWorkspace<Type>::getStrainEstimator()
+{
+  return m_strainEstimator;
+}
+
+#endif // USTK_HAVE_FFTW
+#endif // __usElastographyWorkspace_h_
@@ -39,6 +39,8 @@
 #ifndef __usImageElastography_h_
 #define __usImageElastography_h_
 
+#include <vector>
+
 #include <visp3/core/vpRGBa.h>
 #include <visp3/ustk_core/usImagePostScan2D.h>
 #include <visp3/ustk_core/usImagePreScan2D.h>
@@ -60,6 +62,14 @@ to the tissue strain map of a region of interest in the ultrasound image.
   @warning For internal process reason the ultrasound image has to be set first. And then when the strain map is set,
 the "mix" of the 2 image is done.
 
+  The strain values are converted in colors by a 256 entries color map (see setColorMap(), by default the strain value
+is put in the red channel), and blended with the ultrasound image in the region of the strain map (see
+setStrainOpacity()). Both conversions use precomputed tables.
+
+  The elastography image is updated incrementally : setStrainMap() only recomputes the region of the strain map (and
+restores the ultrasound image where the previous strain map was, if it moved), and setUltrasoundImage() recomputes the
+ultrasound part with the last strain map, so that the image stays complete between two strain maps.
+
   The following figure represents the output of usImageElastography.
   \image html img-usImageElastography.png
  */
@@ -73,13 +83,20 @@ public:
                       unsigned int heightPosition, unsigned int widthPosition);
   virtual ~usImageElastography();
 
+  std::vector<vpRGBa> getColorMap() const;
   vpImage<vpRGBa> getElastoImage();
+  double getStrainOpacity() const;
 
+  void setColorMap(const std::vector<vpRGBa> &colorMap);
   void setStrainMap(const vpImage<unsigned char> &strainMap, unsigned int heightPosition, unsigned int widthPosition);
+  void setStrainOpacity(double opacity);
   void setUltrasoundImage(const vpImage<unsigned char> &ultrasoundImage);
 
 private:
   void computeElastographyImage();
+  void computeStrainRegion();
+  void computeUltrasoundRegion(unsigned int top, unsigned int bottom, unsigned int left, unsigned int right);
+  void updateBlendingTables();
 
   vpImage<unsigned char> m_ultrasoundImage;
   vpImage<unsigned char> m_strainMap;
@@ -87,5 +104,14 @@ private:
 
   unsigned int m_heigthPosition;
   unsigned int m_widthPosition;
+  bool m_strainMapSet;
+
+  // color map, and blending tables : strain color * opacity, gray level * (1 - opacity), in 1/256 units
+  std::vector<vpRGBa> m_colorMap;
+  double m_strainOpacity;
+  unsigned int m_opacity;
+  std::vector<unsigned short> m_colorTerms;
+  std::vector<unsigned short> m_grayTerms;
+  std::vector<vpRGBa> m_grayColors;
 };
 #endif // __usImageElastography_h_
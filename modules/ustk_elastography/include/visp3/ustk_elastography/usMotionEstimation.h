@@ -70,6 +70,9 @@ using namespace arma;
  *  - Run the process with run() method, it computes the displacements of each image block.
  *  - Get the axial displacements, using getV_vp(). They are used to estimate tissues stiffness. Note that you can also
  * get the lateral displacements whith getU_vp() but those are useless for elastography purpose.
+ *
+ * usBlockMatching implements the same search and Taylor refinement directly on the RF samples, in parallel and without
+ * armadillo. It is the estimator used by usElastography.
  */
 class VISP_EXPORT usMotionEstimation
 {
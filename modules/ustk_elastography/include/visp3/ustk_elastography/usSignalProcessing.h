@@ -40,6 +40,7 @@
  * interpolation).
  */
 
+#include <visp3/core/vpImage.h>
 #include <visp3/core/vpMatrix.h>
 #include <visp3/ustk_core/usImageRF2D.h>
 
@@ -81,9 +82,44 @@ public:
   // Diference between usImageRF2D
   static vpMatrix Difference(const usImageRF2D<short int> &A, const usImageRF2D<short int> &B);
   /// Bilinear Interpolation
-  static vpMatrix BilinearInterpolation(vpMatrix In, uint newW, uint newH);
+  static vpMatrix BilinearInterpolation(const vpMatrix &In, uint newW, uint newH);
   /// Element-wise product
-  static vpMatrix HadamardProd(vpMatrix matrix1, vpMatrix matrix2);
+  static vpMatrix HadamardProd(const vpMatrix &matrix1, const vpMatrix &matrix2);
+
+  /// Variant writing in a preallocated image, for float or double processing
+  template <class Type>
+  static void BilinearInterpolation(const vpMatrix &In, uint newW, uint newH, vpImage<Type> &out);
 };
 
+/**
+* Performs a bilinear interpolation on matrix In (see BilinearInterpolation(const vpMatrix &, uint, uint)), in a
+* preallocated image.
+*
+* @param In Input matrix to interpolate.
+* @param newW Output image width.
+* @param newH Output image height.
+* @param out The resulting image of the interpolation.
+*/
+template <class Type>
+void usSignalProcessing::BilinearInterpolation(const vpMatrix &In, uint newW, uint newH, vpImage<Type> &out)
+{
+  out.resize(newH, newW);
+  double tx = (double)(In.getCols() - 1.0) / newW;
+  double ty = (double)(In.getRows() - 1.0) / newH;
+
+  for (uint i = 0; i < newH; i++) {
+    int y = (int)(ty * i);
+    double y_diff = (ty * i) - y;
+    const double *inRow = In[y];
+    const double *inNextRow = In[y + 1];
+    Type *outRow = out[i];
+    for (uint j = 0; j < newW; j++) {
+      int x = (int)(tx * j);
+      double x_diff = (tx * j) - x;
+      outRow[j] = (Type)(inRow[x] * (1.0 - x_diff) * (1.0 - y_diff) + inRow[x + 1] * (x_diff) * (1.0 - y_diff) +
+                         inNextRow[x] * (y_diff) * (1.0 - x_diff) + inNextRow[x + 1] * (x_diff * y_diff));
+    }
+  }
+}
+
 #endif // __usSignalProcessing_h_
@@ -0,0 +1,201 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usStrainEstimator.h
+ * @brief Least-squares strain estimation along the columns of a displacement image.
+ */
+
+#ifndef __usStrainEstimator_h_
+#define __usStrainEstimator_h_
+
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpImage.h>
+
+/**
+ * @class usStrainEstimator
+ * @brief Least-squares (LSQ) strain estimation : slope of the axial displacements over a sliding window, along each
+ * column of a displacement image.
+ * @ingroup module_ustk_elastography
+ *
+ * For a window length L, the window covers N = floor(L) + 1 samples, and the strain at the output row l is
+ * \f[ S(l) = \kappa \frac{12}{L (L^2 - 1)} \sum_{p = 0}^{N - 1} \left(p - \frac{L + 1}{2}\right) d(a + p) \f]
+ * where d is the displacement column, a the first sample of the window and \f$\kappa\f$ the scale set with setScale().
+ * This is the valid convolution by the linear ramp kernel used by usElastography. The ramp is centered on (L + 1) / 2
+ * instead of the center (N - 1) / 2 of the window, so its coefficients sum to N (floor(L) - L - 1) / 2, which is never
+ * zero : besides the slope, S(l) contains a term proportional to the mean displacement over the window.
+ *
+ * The sums over the windows are computed from prefix sums of d and of t.d(t) along each column (accumulated in
+ * double), so the cost per sample does not depend on the window length. The window length can vary linearly with the
+ * depth (setWindowLengthRange()) : the windows of every output row are then centered on the same samples as with the
+ * longest window, and the output has one row per position of the longest window.
+ */
+template <class Type> class usStrainEstimator
+{
+public:
+  usStrainEstimator();
+  virtual ~usStrainEstimator();
+
+  double getScale() const;
+
+  void run(const vpImage<Type> &displacements, vpImage<Type> &strain);
+
+  void setScale(double scale);
+  void setWindowLength(double length);
+  void setWindowLengthRange(double nearLength, double farLength);
+
+private:
+  double m_scale;
+  double m_nearLength;
+  double m_farLength;
+
+  // prefix sums of d(t) and t.d(t), (rows + 1) x cols
+  std::vector<double> m_prefix;
+  std::vector<double> m_weightedPrefix;
+};
+
+/**
+* Default constructor : window length of 2 samples, scale of 1.
+*/
+template <class Type>
+usStrainEstimator<Type>::usStrainEstimator()
+  : m_scale(1.0), m_nearLength(2.0), m_farLength(2.0), m_prefix(), m_weightedPrefix()
+{
+}
+
+/**
+* Destructor.
+*/
+template <class Type> usStrainEstimator<Type>::~usStrainEstimator() {}
+
+/**
+* Getter for the scale applied to the slopes.
+* @return The scale.
+*/
+template <class Type> double usStrainEstimator<Type>::getScale() const { return m_scale; }
+
+/**
+* Setter for the scale applied to the slopes (conversion of the displacement unit in strain).
+* @param scale The scale.
+*/
+template <class Type> void usStrainEstimator<Type>::setScale(double scale) { m_scale = scale; }
+
+/**
+* Setter for a constant window length.
+* @param length Window length L, greater than 1 (the window covers floor(L) + 1 samples).
+*/
+template <class Type> void usStrainEstimator<Type>::setWindowLength(double length)
+{
+  setWindowLengthRange(length, length);
+}
+
+/**
+* Setter for a window length varying linearly from the first output row to the last one.
+* @param nearLength Window length L for the first output row, greater than 1.
+* @param farLength Window length L for the last output row, greater than 1.
+*/
+template <class Type> void usStrainEstimator<Type>::setWindowLengthRange(double nearLength, double farLength)
+{
+  if (nearLength <= 1.0 || farLength <= 1.0)
+    throw(vpException(vpException::badValue, "usStrainEstimator : window length must be greater than 1"));
+  m_nearLength = nearLength;
+  m_farLength = farLength;
+}
+
+/**
+* Strain computation.
+* @param displacements Axial displacements.
+* @param strain Output strain, of size (rows - floor(Lmax)) x cols, with Lmax the longest window length.
+*/
+template <class Type> void usStrainEstimator<Type>::run(const vpImage<Type> &displacements, vpImage<Type> &strain)
+{
+  const unsigned int height = displacements.getHeight();
+  const unsigned int width = displacements.getWidth();
+  const unsigned int maxSpan = (unsigned int)std::max(m_nearLength, m_farLength);
+  if (maxSpan >= height)
+    throw(vpException(vpException::dimensionError, "usStrainEstimator : window longer than the displacement image"));
+  const unsigned int outHeight = height - maxSpan;
+
+  m_prefix.resize((height + 1) * width);
+  m_weightedPrefix.resize((height + 1) * width);
+  std::fill(m_prefix.begin(), m_prefix.begin() + width, 0.0);
+  std::fill(m_weightedPrefix.begin(), m_weightedPrefix.begin() + width, 0.0);
+  for (unsigned int t = 0; t < height; t++) {
+    const Type *in = displacements[t];
+    const double *prefix = &m_prefix[t * width];
+    const double *weightedPrefix = &m_weightedPrefix[t * width];
+    double *nextPrefix = &m_prefix[(t + 1) * width];
+    double *nextWeightedPrefix = &m_weightedPrefix[(t + 1) * width];
+    for (unsigned int k = 0; k < width; k++) {
+      nextPrefix[k] = prefix[k] + in[k];
+      nextWeightedPrefix[k] = weightedPrefix[k] + (double)t * in[k];
+    }
+  }
+
+  if (strain.getHeight() != outHeight || strain.getWidth() != width)
+    strain.resize(outHeight, width);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int l = 0; l < (int)outHeight; l++) {
+    double length = (outHeight > 1) ? m_nearLength + (m_farLength - m_nearLength) * l / (double)(outHeight - 1)
+                                    : m_nearLength;
+    unsigned int span = (unsigned int)length;
+    unsigned int first = l + (maxSpan - span) / 2;
+    unsigned int last = first + span + 1;
+    double center = (length + 1.0) / 2.0;
+    double factor = m_scale * 12.0 / (length * (length * length - 1.0));
+
+    const double *prefixFirst = &m_prefix[first * width];
+    const double *prefixLast = &m_prefix[last * width];
+    const double *weightedFirst = &m_weightedPrefix[first * width];
+    const double *weightedLast = &m_weightedPrefix[last * width];
+    Type *out = strain[l];
+    for (unsigned int k = 0; k < width; k++) {
+      // sums of d(a + p) and p.d(a + p) over the window
+      double sum = prefixLast[k] - prefixFirst[k];
+      double weightedSum = weightedLast[k] - weightedFirst[k] - first * sum;
+      out[k] = (Type)(factor * (weightedSum - center * sum));
+    }
+  }
+}
+
+#endif // USTK_HAVE_FFTW
+#endif // __usStrainEstimator_h_
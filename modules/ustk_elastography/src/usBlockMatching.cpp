@@ -0,0 +1,426 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include <visp3/ustk_elastography/usBlockMatching.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include <visp3/core/vpException.h>
+
+/**
+* Default constructor : blocks of 2 scanlines x 20 samples, searched in a range of +/-2 scanlines and 120 samples, with
+* the sum of absolute differences.
+*/
+usBlockMatching::usBlockMatching()
+  : m_blockWidth(2), m_blockHeight(20), m_searchWidth(2), m_searchHeight(120), m_medianWidth(5), m_medianHeight(7),
+    m_metric(SAD_METRIC), m_coarseToFine(false), m_earlyTermination(true), m_coarsePre(), m_U(), m_V()
+{
+}
+
+/**
+* Destructor.
+*/
+usBlockMatching::~usBlockMatching() {}
+
+/**
+* Lateral displacements computed by the last run().
+* @return Lateral displacement of each block, in scanlines (one row per block row).
+*/
+const vpMatrix &usBlockMatching::getU() const { return m_U; }
+
+/**
+* Axial displacements computed by the last run().
+* @return Axial displacement of each block, in RF samples (one row per block row).
+*/
+const vpMatrix &usBlockMatching::getV() const { return m_V; }
+
+/**
+* Setter for the block size.
+* @param width Block width, in scanlines.
+* @param height Block height, in RF samples.
+*/
+void usBlockMatching::setBlockSize(unsigned int width, unsigned int height)
+{
+  if (width < 2 || height < 2)
+    throw(vpException(vpException::badValue, "usBlockMatching : blocks must be at least 2x2"));
+  m_blockWidth = width;
+  m_blockHeight = height;
+}
+
+/**
+* Enables the coarse-to-fine search : blocks are first searched in images decimated by 2 along the scanlines, and the
+* search at full resolution is restricted to the neighbourhood of the coarse displacement. The post-compressed image is
+* decimated with both sampling phases, so that a block is never compared with a candidate shifted by half a coarse
+* sample. Disabled by default : it is faster, but averaging RF samples attenuates the carrier and the result may differ
+* from the exhaustive search on noisy images.
+* @param coarseToFine True to enable the coarse-to-fine search, false for an exhaustive search.
+*/
+void usBlockMatching::setCoarseToFine(bool coarseToFine) { m_coarseToFine = coarseToFine; }
+
+/**
+* Enables the early termination of the SAD / SSD computation of a candidate, when its partial cost already exceeds the
+* best cost found for the block. It does not change the result. Enabled by default.
+* @param earlyTermination True to enable early termination.
+*/
+void usBlockMatching::setEarlyTermination(bool earlyTermination) { m_earlyTermination = earlyTermination; }
+
+/**
+* Setter for the size of the median filter applied on the displacement maps (5 x 7 by default, 1 x 1 to disable it).
+* @param width Filter width, in blocks.
+* @param height Filter height, in blocks.
+*/
+void usBlockMatching::setMedianFilterSize(unsigned int width, unsigned int height)
+{
+  m_medianWidth = width;
+  m_medianHeight = height;
+}
+
+/**
+* Setter for the block comparison metric.
+* @param metric The cost function.
+*/
+void usBlockMatching::setMetric(usMatchingMetric metric) { m_metric = metric; }
+
+/**
+* Setter for the search range.
+* @param width Lateral range, in scanlines : displacements in [-width, width - 1] are tested.
+* @param height Axial range, in RF samples : displacements in [0, height] are tested.
+*/
+void usBlockMatching::setSearchRange(unsigned int width, unsigned int height)
+{
+  m_searchWidth = width;
+  m_searchHeight = height;
+}
+
+/**
+* Runs the block matching between two RF images.
+* @param pre Pre-compressed RF image.
+* @param post Post-compressed RF image.
+*/
+void usBlockMatching::run(const usImageRF2D<short int> &pre, const usImageRF2D<short int> &post)
+{
+  if (pre.getHeight() != post.getHeight() || pre.getWidth() != post.getWidth())
+    throw(vpException(vpException::dimensionError, "usBlockMatching : images must have the same size"));
+
+  int height = pre.getHeight();
+  int width = pre.getWidth();
+  int Lx = m_blockWidth / 2;
+  int Ly = m_blockHeight / 2;
+  int blockWidth = 2 * Lx;
+  int blockHeight = 2 * Ly;
+  int sw = m_searchWidth;
+  int sh = m_searchHeight;
+
+  // block centers, spaced by the block size, far enough from the borders to search the whole range
+  int nbBlocksX = 0, nbBlocksY = 0;
+  if (width - (sw + Lx) - 1 >= sw + Lx)
+    nbBlocksX = (width - 2 * (sw + Lx) - 1) / (int)m_blockWidth + 1;
+  if (height - (sh + Ly) - 1 >= sh + Ly)
+    nbBlocksY = (height - 2 * (sh + Ly) - 1) / (int)m_blockHeight + 1;
+
+  m_U.resize(nbBlocksY, nbBlocksX);
+  m_V.resize(nbBlocksY, nbBlocksX);
+  if (nbBlocksX == 0 || nbBlocksY == 0)
+    return;
+
+  const short int *preData = pre.getBitmap();
+  const short int *postData = post.getBitmap();
+
+  bool coarseToFine = m_coarseToFine && blockHeight >= 4 && sh >= 4;
+  int coarseHeight = height / 2;
+  if (coarseToFine) {
+    m_coarsePre.resize(coarseHeight * width);
+    m_coarsePost[0].resize(coarseHeight * width);
+    m_coarsePost[1].resize(coarseHeight * width);
+    for (int j = 0; j < width; j++) {
+      const short int *preScanline = preData + j * height;
+      const short int *postScanline = postData + j * height;
+      short int *coarsePreScanline = &m_coarsePre[j * coarseHeight];
+      short int *coarsePostEven = &m_coarsePost[0][j * coarseHeight];
+      short int *coarsePostOdd = &m_coarsePost[1][j * coarseHeight];
+      for (int i = 0; i < coarseHeight; i++) {
+        coarsePreScanline[i] = (short int)((preScanline[2 * i] + preScanline[2 * i + 1]) / 2);
+        coarsePostEven[i] = (short int)((postScanline[2 * i] + postScanline[2 * i + 1]) / 2);
+        coarsePostOdd[i] = (short int)((postScanline[2 * i + 1] + postScanline[std::min(2 * i + 2, height - 1)]) / 2);
+      }
+    }
+  }
+
+  int nbBlocks = nbBlocksX * nbBlocksY;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int b = 0; b < nbBlocks; b++) {
+    int i = b / nbBlocksX;
+    int j = b % nbBlocksX;
+    int xc = sw + Lx + j * m_blockWidth;
+    int yc = sh + Ly + i * m_blockHeight;
+    int top = yc - Ly;
+    int left = xc - Lx;
+
+    int dyMin = 0, dyMax = sh, dxMin = -sw, dxMax = sw - 1;
+    int bestDy = 0, bestDx = 0;
+    if (coarseToFine) {
+      // a coarse candidate dyc of the post-compressed image decimated with the phase p is the full resolution
+      // displacement 2 * dyc + p
+      double bestCost = std::numeric_limits<double>::max();
+      for (int phase = 0; phase < 2; phase++) {
+        int coarseDy, coarseDx;
+        double coarseCost = search(&m_coarsePre[0], &m_coarsePost[phase][0], coarseHeight, top / 2, left,
+                                   blockHeight / 2, blockWidth, 0, (sh - phase) / 2, dxMin, dxMax, coarseDy, coarseDx);
+        if (coarseCost < bestCost) {
+          bestCost = coarseCost;
+          bestDy = 2 * coarseDy + phase;
+          bestDx = coarseDx;
+        }
+      }
+      dyMin = std::max(0, bestDy - 1);
+      dyMax = std::min(sh, bestDy + 1);
+      dxMin = std::max(-sw, bestDx - 1);
+      dxMax = std::min(sw - 1, bestDx + 1);
+    }
+    search(preData, postData, height, top, left, blockHeight, blockWidth, dyMin, dyMax, dxMin, dxMax, bestDy, bestDx);
+
+    double refinementX, refinementY;
+    taylorRefinement(preData, postData, height, top, left, bestDy, bestDx, refinementX, refinementY);
+    m_U[i][j] = -bestDx + refinementX;
+    m_V[i][j] = -bestDy + refinementY;
+  }
+
+  medianFilter(m_U);
+  medianFilter(m_V);
+}
+
+/**
+* Cost of a candidate block in the post-compressed image (scanlines of the images are contiguous in memory).
+* @param pre Pre-compressed image data.
+* @param post Post-compressed image data.
+* @param height Number of samples per scanline.
+* @param top First sample of the block in the pre-compressed image.
+* @param left First scanline of the block in the pre-compressed image.
+* @param postTop First sample of the candidate block in the post-compressed image.
+* @param postLeft First scanline of the candidate block in the post-compressed image.
+* @param blockHeight Block height.
+* @param blockWidth Block width.
+* @param bound Best cost found : with SAD and SSD, the computation stops as soon as the cost exceeds it.
+* @return The cost of the candidate (for NCC, 1 - correlation).
+*/
+double usBlockMatching::cost(const short int *pre, const short int *post, unsigned int height, int top, int left,
+                             int postTop, int postLeft, int blockHeight, int blockWidth, double bound) const
+{
+  if (m_metric == NCC_METRIC) {
+    double sum1 = 0.0, sum2 = 0.0, sum11 = 0.0, sum22 = 0.0, sum12 = 0.0;
+    for (int c = 0; c < blockWidth; c++) {
+      const short int *a = pre + (left + c) * height + top;
+      const short int *b = post + (postLeft + c) * height + postTop;
+      for (int r = 0; r < blockHeight; r++) {
+        double va = a[r];
+        double vb = b[r];
+        sum1 += va;
+        sum2 += vb;
+        sum11 += va * va;
+        sum22 += vb * vb;
+        sum12 += va * vb;
+      }
+    }
+    double n = blockWidth * blockHeight;
+    double var1 = sum11 - sum1 * sum1 / n;
+    double var2 = sum22 - sum2 * sum2 / n;
+    if (var1 <= 0.0 || var2 <= 0.0)
+      return 1.0;
+    return 1.0 - (sum12 - sum1 * sum2 / n) / sqrt(var1 * var2);
+  }
+
+  double total = 0.0;
+  for (int c = 0; c < blockWidth; c++) {
+    const short int *a = pre + (left + c) * height + top;
+    const short int *b = post + (postLeft + c) * height + postTop;
+    if (m_metric == SSD_METRIC) {
+      long long scanlineSum = 0;
+      for (int r = 0; r < blockHeight; r++) {
+        long long d = a[r] - b[r];
+        scanlineSum += d * d;
+      }
+      total += (double)scanlineSum;
+    } else {
+      int scanlineSum = 0;
+      for (int r = 0; r < blockHeight; r++)
+        scanlineSum += std::abs(a[r] - b[r]);
+      total += scanlineSum;
+    }
+    if (m_earlyTermination && total >= bound)
+      return total;
+  }
+  return total;
+}
+
+/**
+* Search of the best candidate for a block. Axial displacements are tested from the largest to the smallest, and the
+* first best candidate is kept.
+* @param pre Pre-compressed image data.
+* @param post Post-compressed image data.
+* @param height Number of samples per scanline.
+* @param top First sample of the block.
+* @param left First scanline of the block.
+* @param blockHeight Block height.
+* @param blockWidth Block width.
+* @param dyMin Minimal axial displacement tested.
+* @param dyMax Maximal axial displacement tested.
+* @param dxMin Minimal lateral displacement tested.
+* @param dxMax Maximal lateral displacement tested.
+* @param bestDy Axial displacement of the best candidate.
+* @param bestDx Lateral displacement of the best candidate.
+* @return The cost of the best candidate.
+*/
+double usBlockMatching::search(const short int *pre, const short int *post, unsigned int height, int top, int left,
+                             int blockHeight, int blockWidth, int dyMin, int dyMax, int dxMin, int dxMax, int &bestDy,
+                             int &bestDx) const
+{
+  double bestCost = std::numeric_limits<double>::max();
+  bestDy = dyMin;
+  bestDx = dxMin;
+  for (int dy = dyMax; dy >= dyMin; dy--) {
+    for (int dx = dxMin; dx <= dxMax; dx++) {
+      double c = cost(pre, post, height, top, left, top + dy, left + dx, blockHeight, blockWidth, bestCost);
+      if (c < bestCost) {
+        bestCost = c;
+        bestDy = dy;
+        bestDx = dx;
+      }
+    }
+  }
+  return bestCost;
+}
+
+/**
+* Sub-sample refinement of a displacement, by a first order Taylor expansion of the pre-compressed block.
+* @param pre Pre-compressed image data.
+* @param post Post-compressed image data.
+* @param height Number of samples per scanline.
+* @param top First sample of the block.
+* @param left First scanline of the block.
+* @param dy Axial displacement found by the search.
+* @param dx Lateral displacement found by the search.
+* @param refinementX Lateral refinement.
+* @param refinementY Axial refinement.
+*/
+void usBlockMatching::taylorRefinement(const short int *pre, const short int *post, unsigned int height, int top,
+                                       int left, int dy, int dx, double &refinementX, double &refinementY) const
+{
+  int blockWidth = 2 * (m_blockWidth / 2);
+  int blockHeight = 2 * (m_blockHeight / 2);
+
+  double a = 0.0, b = 0.0, d = 0.0, p = 0.0, q = 0.0;
+  for (int c = 0; c < blockWidth; c++) {
+    // lateral gradient : centered differences, one-sided on the block borders
+    int cPrev = (c == 0) ? 0 : c - 1;
+    int cNext = (c == blockWidth - 1) ? c : c + 1;
+    double lateralScale = (cNext - cPrev == 2) ? 0.5 : 1.0;
+    const short int *scanline = pre + (left + c) * height + top;
+    const short int *scanlinePrev = pre + (left + cPrev) * height + top;
+    const short int *scanlineNext = pre + (left + cNext) * height + top;
+    const short int *postScanline = post + (left + dx + c) * height + top + dy;
+    for (int r = 0; r < blockHeight; r++) {
+      double fx = lateralScale * (scanlineNext[r] - scanlinePrev[r]);
+      double fy;
+      if (r == 0)
+        fy = scanline[1] - scanline[0];
+      else if (r == blockHeight - 1)
+        fy = scanline[r] - scanline[r - 1];
+      else
+        fy = 0.5 * (scanline[r + 1] - scanline[r - 1]);
+      double z = postScanline[r] - scanline[r];
+      a += fx * fx;
+      b += fx * fy;
+      d += fy * fy;
+      p += z * fx;
+      q += z * fy;
+    }
+  }
+
+  double det = a * d - b * b;
+  if (fabs(det) <= 1e-12 * fabs(a * d) || det == 0.0) {
+    refinementX = 0.0;
+    refinementY = 0.0;
+    return;
+  }
+  refinementX = (d * p - b * q) / det;
+  refinementY = (a * q - b * p) / det;
+}
+
+/**
+* Median filter of a displacement map, with replicated borders.
+* @param M Displacement map filtered in place.
+*/
+void usBlockMatching::medianFilter(vpMatrix &M) const
+{
+  int kw = m_medianWidth;
+  int kh = m_medianHeight;
+  if (kw * kh <= 1)
+    return;
+
+  int rows = M.getRows();
+  int cols = M.getCols();
+  vpMatrix input = M;
+  unsigned int middle = (kw * kh) / 2 + 1;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int row = 0; row < rows; row++) {
+    std::vector<double> window;
+    window.reserve(kw * kh);
+    for (int col = 0; col < cols; col++) {
+      window.clear();
+      for (int r = -kh / 2; r < kh / 2; r++) {
+        for (int c = -kw / 2; c < kw / 2; c++) {
+          int i = std::min(std::max(row + r, 0), rows - 1);
+          int j = std::min(std::max(col + c, 0), cols - 1);
+          window.push_back(input[i][j]);
+        }
+      }
+      if (window.empty()) {
+        M[row][col] = input[row][col];
+        continue;
+      }
+      unsigned int k = std::min<unsigned int>(middle, window.size()) - 1;
+      std::nth_element(window.begin(), window.begin() + k, window.end());
+      M[row][col] = window[k];
+    }
+  }
+}
+
+#endif // USTK_HAVE_FFTW
@@ -35,12 +35,24 @@
 
 #if defined(USTK_HAVE_FFTW)
 
+#include <cstring>
+#include <mutex>
+
+#include <visp3/core/vpException.h>
+
+// the fftw planner is not thread-safe : plans of the convolutions used by different threads are created and destroyed one
+// at a time
+static std::mutex s_fftwPlannerMutex;
+
 /**
 * Default constructor.
 * It only initializes the pointers class members to NULL.
 */
 usConvolution2d::usConvolution2d()
-  : outa(NULL), outb(NULL), outc(NULL), out(NULL), ad(NULL), bd(NULL), p1(), p2(), p3(), m_init(false)
+  : m_method(AUTO_METHOD), m_kernel(), m_kernelSeparable(false), m_kernelFlipped(), m_kernelRowFlipped(),
+    m_kernelColFlipped(), m_kernelSpectrumValid(false), Am(0), An(0), Bm(0), Bn(0), h_dst(0), w_dst(0), m_batchSize(0),
+    m_spectrumCols(0), m_fftIn(NULL), m_fftOut(NULL), m_kernelIn(NULL), m_kernelSpectrum(NULL), m_forwardPlan(NULL),
+    m_backwardPlan(NULL), m_kernelPlan(NULL)
 {
 }
 
@@ -48,128 +60,370 @@ usConvolution2d::usConvolution2d()
 * Destructor.
 * Clear memory allocations.
 */
-usConvolution2d::~usConvolution2d()
-{
-  fftw_destroy_plan(p1);
-  fftw_destroy_plan(p2);
-  fftw_destroy_plan(p3);
-  delete[] outa;
-  delete[] outb;
-  delete[] outc;
-  delete[] out;
-  delete[] ad;
-  delete[] bd;
-}
+usConvolution2d::~usConvolution2d() { releaseFFT(); }
+
+/**
+* Get the convolution method set by setMethod().
+* @return The convolution method.
+*/
+usConvolution2d::usConvolutionMethod usConvolution2d::getMethod() const { return m_method; }
 
 /**
 * Initialization of the convolution process with the matrix dimentions specified (if not already done), and storage of
-* convolution inputs.
+* convolution inputs. The kernel is analysed only if it changed since the last call.
 *
 * @param matrix1 Input matrix for the convolution.
 * @param matrix2 Convolution filter to apply on matrix1.
 */
 void usConvolution2d::init(const vpMatrix &matrix1, const vpMatrix &matrix2)
 {
-  // check matrix dimentions
-  if (Am != matrix1.getRows() || An != matrix1.getCols() || Bm != matrix2.getRows() || Bn != matrix2.getCols()) {
-
-    // memory de-allocation to avoid leak
-    delete[] outa;
-    delete[] outb;
-    delete[] outc;
-    delete[] out;
-    delete[] ad;
-    delete[] bd;
+  if (matrix2.getRows() == 0 || matrix2.getCols() == 0 || matrix2.getRows() > matrix1.getRows() ||
+      matrix2.getCols() > matrix1.getCols())
+    throw(vpException(vpException::dimensionError, "usConvolution2d : kernel larger than the input matrix"));
 
-    fftw_destroy_plan(p1);
-    fftw_destroy_plan(p2);
-    fftw_destroy_plan(p3);
-
-    // re-allocation with new matrices dimentions
+  // check matrix dimentions
+  if (Am != matrix1.getRows() || An != matrix1.getCols()) {
+    // fftw buffers are sized on the input matrix
+    releaseFFT();
     Am = matrix1.getRows();
     An = matrix1.getCols();
-    Bm = matrix2.getRows();
-    Bn = matrix2.getCols();
-
-    h_dst = Am - Bm + 1; // Valid convolution
-    w_dst = An - Bn + 1;
-    hf = Am + Bm - 1; // Full convolution
-    wf = An + Bn - 1;
-
-    m_R.resize(h_dst, w_dst);
-    m_M1 = matrix1;
-    m_M2 = matrix2;
-
-    // fftw inputs/outputs arrays
-    ad = new fftw_complex[hf * wf];
-    bd = new fftw_complex[hf * wf];
-    outa = new fftw_complex[hf * wf];
-    outb = new fftw_complex[hf * wf];
-    outc = new fftw_complex[hf * wf];
-    out = new fftw_complex[hf * wf];
-
-    // fftw plans
-    p1 = fftw_plan_dft_2d(wf, hf, ad, outa, FFTW_FORWARD, FFTW_ESTIMATE);
-    p2 = fftw_plan_dft_2d(wf, hf, bd, outb, FFTW_FORWARD, FFTW_ESTIMATE);
-    p3 = fftw_plan_dft_2d(wf, hf, outc, out, FFTW_BACKWARD, FFTW_ESTIMATE);
-  } else { // init already done with correct matrix dimentions
-    m_M1 = matrix1;
-    m_M2 = matrix2;
   }
 
-  padding_zeros();
-  m_init = true;
+  setKernel(matrix2);
+
+  h_dst = Am - Bm + 1; // Valid convolution
+  w_dst = An - Bn + 1;
 }
 
+/**
+* Tells if the kernel given to the last init() or run() is of rank 1, i.e. the separable method can apply it as a row
+* filter followed by a column filter.
+* @return True if the kernel is separable.
+*/
+bool usConvolution2d::isKernelSeparable() const { return m_kernelSeparable; }
+
 /**
 * Run the convolution.
 *
 * @param matrix1 Input matrix for the convolution.
 * @param matrix2 Convolution filter to apply on matrix1.
+* @return The valid part of the convolution.
 */
 vpMatrix usConvolution2d::run(const vpMatrix &matrix1, const vpMatrix &matrix2)
 {
-  init(matrix1, matrix2);
+  std::vector<const vpMatrix *> matrices(1, &matrix1);
+  std::vector<vpMatrix> results;
+  run(matrices, matrix2, results);
+  return results.front();
+}
 
-  fftw_execute(p1);
-  fftw_execute(p2);
-  // Complex product
-  for (unsigned int i = 0; i < wf * hf; ++i) {
-    outc[i][0] = (outa[i][0] * outb[i][0]) - (outa[i][1] * outb[i][1]);
-    outc[i][1] = (outa[i][0] * outb[i][1]) + (outa[i][1] * outb[i][0]);
+/**
+* Run the convolution of several matrices of the same size with the same kernel.
+*
+* @param matrices Input matrices for the convolution.
+* @param kernel Convolution filter to apply on the matrices.
+* @param results Valid part of the convolution of each matrix.
+*/
+void usConvolution2d::run(const std::vector<const vpMatrix *> &matrices, const vpMatrix &kernel,
+                          std::vector<vpMatrix> &results)
+{
+  results.resize(matrices.size());
+  if (matrices.empty())
+    return;
+
+  for (unsigned int i = 1; i < matrices.size(); i++) {
+    if (matrices.at(i)->getRows() != matrices.front()->getRows() ||
+        matrices.at(i)->getCols() != matrices.front()->getCols())
+      throw(vpException(vpException::dimensionError, "usConvolution2d : matrices of a batch must have the same size"));
   }
-  fftw_execute(p3);
-  // Storing only the valid convolution
-  int startX = vpMath::round((double)(wf - w_dst) / 2.0);
-  int startY = vpMath::round((double)(hf - h_dst) / 2.0);
-  int endX = startX + w_dst;
-  int endY = startY + h_dst;
-  int k = 0;
-  int l;
-  for (int i = startX; i < endX; ++i) {
-    l = 0;
-    for (int j = startY; j < endY; ++j) {
-      // the output of the convolution array (out) is extracted column by column.
-      m_R[l][k] = out[j + i * hf][0] / (double)(wf * hf);
-      l++;
+
+  init(*matrices.front(), kernel);
+
+  switch (selectMethod()) {
+  case SEPARABLE_METHOD:
+    for (unsigned int i = 0; i < matrices.size(); i++)
+      convolveSeparable(*matrices.at(i), results.at(i));
+    break;
+  case FFT_METHOD:
+    convolveFFT(matrices, results);
+    break;
+  default:
+    for (unsigned int i = 0; i < matrices.size(); i++)
+      convolveDirect(*matrices.at(i), results.at(i));
+    break;
+  }
+}
+
+/**
+* Set the convolution method. By default (AUTO_METHOD), separable kernels use the separable method, small kernels the
+* direct method, and other kernels the Fourier domain.
+* @param method The convolution method.
+*/
+void usConvolution2d::setMethod(usConvolutionMethod method) { m_method = method; }
+
+/**
+* Stores the kernel, and computes its separable factors if it is of rank 1. Nothing is done if the kernel did not
+* change.
+* @param kernel Convolution kernel.
+*/
+void usConvolution2d::setKernel(const vpMatrix &kernel)
+{
+  if (kernel.getRows() == Bm && kernel.getCols() == Bn && m_kernel.getRows() == Bm && m_kernel.getCols() == Bn &&
+      memcmp(kernel.data, m_kernel.data, Bm * Bn * sizeof(double)) == 0)
+    return;
+
+  m_kernel = kernel;
+  Bm = kernel.getRows();
+  Bn = kernel.getCols();
+  m_kernelSpectrumValid = false;
+
+  m_kernelFlipped.resize(Bm * Bn);
+  for (unsigned int p = 0; p < Bm; p++)
+    for (unsigned int q = 0; q < Bn; q++)
+      m_kernelFlipped[p * Bn + q] = kernel[Bm - 1 - p][Bn - 1 - q];
+
+  // rank 1 test : kernel(p, q) = kernel(p, q0) * kernel(p0, q) / kernel(p0, q0), with the largest coefficient as pivot
+  unsigned int p0 = 0, q0 = 0;
+  double maxAbs = 0.0;
+  for (unsigned int p = 0; p < Bm; p++) {
+    for (unsigned int q = 0; q < Bn; q++) {
+      if (fabs(kernel[p][q]) > maxAbs) {
+        maxAbs = fabs(kernel[p][q]);
+        p0 = p;
+        q0 = q;
+      }
+    }
+  }
+  m_kernelSeparable = maxAbs > 0.0;
+  for (unsigned int p = 0; p < Bm && m_kernelSeparable; p++)
+    for (unsigned int q = 0; q < Bn && m_kernelSeparable; q++)
+      m_kernelSeparable =
+          fabs(kernel[p][q] - kernel[p][q0] * kernel[p0][q] / kernel[p0][q0]) <= 1e-12 * maxAbs;
+
+  if (m_kernelSeparable) {
+    m_kernelColFlipped.resize(Bm);
+    m_kernelRowFlipped.resize(Bn);
+    for (unsigned int p = 0; p < Bm; p++)
+      m_kernelColFlipped[p] = kernel[Bm - 1 - p][q0];
+    for (unsigned int q = 0; q < Bn; q++)
+      m_kernelRowFlipped[q] = kernel[p0][Bn - 1 - q] / kernel[p0][q0];
+  }
+}
+
+/**
+* Method used by run(), from the method set and the kernel. The costs per output pixel are about Bm + Bn for the
+* separable method, Bm * Bn for the direct method, and a few tens of operations for the Fourier domain.
+* @return The convolution method to use.
+*/
+usConvolution2d::usConvolutionMethod usConvolution2d::selectMethod() const
+{
+  if (m_method == SEPARABLE_METHOD)
+    return m_kernelSeparable ? SEPARABLE_METHOD : DIRECT_METHOD;
+  if (m_method != AUTO_METHOD)
+    return m_method;
+
+  if (m_kernelSeparable && Bm + Bn <= 64)
+    return SEPARABLE_METHOD;
+  if (Bm * Bn <= 64)
+    return DIRECT_METHOD;
+  return FFT_METHOD;
+}
+
+/**
+* Direct valid convolution.
+* @param matrix Input matrix.
+* @param result Output of the convolution.
+*/
+void usConvolution2d::convolveDirect(const vpMatrix &matrix, vpMatrix &result) const
+{
+  result.resize(h_dst, w_dst, false);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int l = 0; l < (int)h_dst; l++) {
+    double *resultRow = result[l];
+    for (unsigned int k = 0; k < w_dst; k++)
+      resultRow[k] = 0.0;
+    for (unsigned int p = 0; p < Bm; p++) {
+      const double *inputRow = matrix[l + p];
+      const double *kernelRow = &m_kernelFlipped[p * Bn];
+      for (unsigned int q = 0; q < Bn; q++) {
+        double coef = kernelRow[q];
+        const double *input = inputRow + q;
+        for (unsigned int k = 0; k < w_dst; k++)
+          resultRow[k] += coef * input[k];
+      }
     }
-    k++;
   }
+}
 
-  return m_R;
+/**
+* Separable valid convolution : row filter on every row, then column filter.
+* @param matrix Input matrix.
+* @param result Output of the convolution.
+*/
+void usConvolution2d::convolveSeparable(const vpMatrix &matrix, vpMatrix &result) const
+{
+  vpMatrix rowFiltered(Am, w_dst);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < (int)Am; i++) {
+    const double *inputRow = matrix[i];
+    double *outputRow = rowFiltered[i];
+    for (unsigned int k = 0; k < w_dst; k++) {
+      double sum = 0.0;
+      for (unsigned int q = 0; q < Bn; q++)
+        sum += inputRow[k + q] * m_kernelRowFlipped[q];
+      outputRow[k] = sum;
+    }
+  }
+
+  result.resize(h_dst, w_dst, false);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int l = 0; l < (int)h_dst; l++) {
+    double *resultRow = result[l];
+    for (unsigned int k = 0; k < w_dst; k++)
+      resultRow[k] = 0.0;
+    for (unsigned int p = 0; p < Bm; p++) {
+      double coef = m_kernelColFlipped[p];
+      const double *inputRow = rowFiltered[l + p];
+      for (unsigned int k = 0; k < w_dst; k++)
+        resultRow[k] += coef * inputRow[k];
+    }
+  }
 }
 
-void usConvolution2d::padding_zeros()
+/**
+* Allocation of the fftw buffers and plans, if not already done for this size of batch.
+* @param batchSize Number of matrices transformed together.
+*/
+void usConvolution2d::initFFT(unsigned int batchSize)
 {
-  // Padding the two arrays with zeros
-  for (unsigned int i = 0; i < wf; ++i) {
-    for (unsigned int j = 0; j < hf; ++j) {
-      // fftw intput arrays (ad, bd) are filled scanline per scanline (column by column)
-      ad[j + i * hf][0] = ((j < Am) && (i < An)) ? m_M1[j][i] : 0.0;
-      ad[j + i * hf][1] = 0.0;
-      bd[j + i * hf][0] = ((j < Bm) && (i < Bn)) ? m_M2[j][i] : 0.0;
-      bd[j + i * hf][1] = 0.0;
+  m_spectrumCols = An / 2 + 1;
+
+  std::lock_guard<std::mutex> plannerLock(s_fftwPlannerMutex);
+  if (m_kernelPlan == NULL) {
+    m_kernelIn = fftw_alloc_real(Am * An);
+    m_kernelSpectrum = fftw_alloc_complex(Am * m_spectrumCols);
+    m_kernelPlan = fftw_plan_dft_r2c_2d(Am, An, m_kernelIn, m_kernelSpectrum, FFTW_ESTIMATE);
+    m_kernelSpectrumValid = false;
+  }
+
+  if (m_forwardPlan != NULL && m_batchSize == batchSize)
+    return;
+
+  if (m_forwardPlan != NULL) {
+    fftw_destroy_plan(m_forwardPlan);
+    fftw_destroy_plan(m_backwardPlan);
+    fftw_free(m_fftIn);
+    fftw_free(m_fftOut);
+  }
+
+  m_batchSize = batchSize;
+  int n[2] = {(int)Am, (int)An};
+  int realDist = Am * An;
+  int complexDist = Am * m_spectrumCols;
+  m_fftIn = fftw_alloc_real(m_batchSize * realDist);
+  m_fftOut = fftw_alloc_complex(m_batchSize * complexDist);
+  m_forwardPlan = fftw_plan_many_dft_r2c(2, n, m_batchSize, m_fftIn, NULL, 1, realDist, m_fftOut, NULL, 1, complexDist,
+                                         FFTW_ESTIMATE);
+  m_backwardPlan = fftw_plan_many_dft_c2r(2, n, m_batchSize, m_fftOut, NULL, 1, complexDist, m_fftIn, NULL, 1,
+                                          realDist, FFTW_ESTIMATE);
+}
+
+/**
+* Free the fftw buffers and plans.
+*/
+void usConvolution2d::releaseFFT()
+{
+  std::lock_guard<std::mutex> plannerLock(s_fftwPlannerMutex);
+  if (m_forwardPlan != NULL) {
+    fftw_destroy_plan(m_forwardPlan);
+    fftw_destroy_plan(m_backwardPlan);
+    fftw_free(m_fftIn);
+    fftw_free(m_fftOut);
+  }
+  if (m_kernelPlan != NULL) {
+    fftw_destroy_plan(m_kernelPlan);
+    fftw_free(m_kernelIn);
+    fftw_free(m_kernelSpectrum);
+  }
+  m_forwardPlan = NULL;
+  m_backwardPlan = NULL;
+  m_kernelPlan = NULL;
+  m_fftIn = NULL;
+  m_fftOut = NULL;
+  m_kernelIn = NULL;
+  m_kernelSpectrum = NULL;
+  m_batchSize = 0;
+  m_kernelSpectrumValid = false;
+}
+
+/**
+* Transform of the kernel, zero-padded to the input size. Done only when the kernel or the input size changes.
+*/
+void usConvolution2d::computeKernelSpectrum()
+{
+  if (m_kernelSpectrumValid)
+    return;
+
+  memset(m_kernelIn, 0, Am * An * sizeof(double));
+  for (unsigned int p = 0; p < Bm; p++)
+    memcpy(m_kernelIn + p * An, m_kernel[p], Bn * sizeof(double));
+  fftw_execute(m_kernelPlan);
+
+  // normalisation of the backward transform folded into the kernel spectrum
+  double scale = 1.0 / (double)(Am * An);
+  for (unsigned int i = 0; i < Am * m_spectrumCols; i++) {
+    m_kernelSpectrum[i][0] *= scale;
+    m_kernelSpectrum[i][1] *= scale;
+  }
+  m_kernelSpectrumValid = true;
+}
+
+/**
+* Valid convolution in the Fourier domain. The transforms have the size of the input : the circular wrap only affects
+* the first Bm - 1 rows and Bn - 1 columns of the output, which are not part of the valid convolution.
+* @param matrices Input matrices, of the same size.
+* @param results Outputs of the convolution.
+*/
+void usConvolution2d::convolveFFT(const std::vector<const vpMatrix *> &matrices, std::vector<vpMatrix> &results)
+{
+  initFFT(matrices.size());
+  computeKernelSpectrum();
+
+  unsigned int realDist = Am * An;
+  unsigned int complexDist = Am * m_spectrumCols;
+  for (unsigned int b = 0; b < m_batchSize; b++)
+    memcpy(m_fftIn + b * realDist, matrices.at(b)->data, realDist * sizeof(double));
+
+  fftw_execute(m_forwardPlan);
+
+  // Complex product
+  for (unsigned int b = 0; b < m_batchSize; b++) {
+    fftw_complex *spectrum = m_fftOut + b * complexDist;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int i = 0; i < (int)complexDist; ++i) {
+      double re = (spectrum[i][0] * m_kernelSpectrum[i][0]) - (spectrum[i][1] * m_kernelSpectrum[i][1]);
+      double im = (spectrum[i][0] * m_kernelSpectrum[i][1]) + (spectrum[i][1] * m_kernelSpectrum[i][0]);
+      spectrum[i][0] = re;
+      spectrum[i][1] = im;
     }
   }
+
+  fftw_execute(m_backwardPlan);
+
+  // Storing only the valid convolution
+  for (unsigned int b = 0; b < m_batchSize; b++) {
+    const double *convolution = m_fftIn + b * realDist;
+    results.at(b).resize(h_dst, w_dst, false);
+    for (unsigned int l = 0; l < h_dst; l++)
+      memcpy(results.at(b)[l], convolution + (l + Bm - 1) * An + (Bn - 1), w_dst * sizeof(double));
+  }
 }
 #endif // USTK_HAVE_FFTW
@@ -32,6 +32,10 @@
  *****************************************************************************/
 
 #include <visp3/ustk_elastography/usElastography.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
+
+#include <algorithm>
+#include <cstring>
 
 #if defined(USTK_HAVE_FFTW)
 
@@ -39,31 +43,13 @@
 * Default constructor.
 */
 usElastography::usElastography()
+  : m_StrainMap(), m_Precomp(), m_Postcomp(), m_Lsqper(0.01), m_LsqperFar(0.01), m_isloadPre(false),
+    m_isloadPost(false), m_FPS(24.0), m_samplingFrequency(40e6), m_c(1540.0), m_min_str(0.0), m_max_str(0.0),
+    m_max_abs(0.0), m_h_m(0), m_w_m(0), m_ix(0), m_iy(0), m_rw(0), m_rh(0), m_setROI(false), m_PreROI(), m_PostROI(),
+    m_workspace(), m_mEstimatior(OF), m_blockMatching(), U(), V(), m_decimationFactor(10), m_windowStep(0.75)
 {
-  // Using default percentage of LSQ strain
-  // If you want to change this value use
-  // setLSQpercentage(double per);
-  m_Lsqper = 0.01; // 0.08 BMA //Just OF 0.01
-  // Frame rate in fps
-  m_FPS = 24.0;
-  // Sampling frequency
-  m_samplingFrequency = 40e6;
-  // speed of the sound
-  m_c = 1540.0;
-  m_isloadPre = false;
-  m_isloadPost = false;
-  m_setROI = false;
-  // Using OF by default
-  m_mEstimatior = OF;
-#if defined(USTK_HAVE_ARMADILLO) && (ARMA_VERSION_MAJOR > 6) && (ARMA_VERSION_MAJOR > 700)
-  m_ME = usMotionEstimation();
-#endif
-
-  m_decimationFactor = 10;
-
-  // Avoiding leaking memory with the convolutions on cpu
-  for (uint i = 0; i < 6; i++)
-    cC.push_back(new usConvolution2d);
+  m_blockMatching.setBlockSize(2, 20);
+  m_blockMatching.setSearchRange(2, 120);
 }
 
 /**
@@ -73,29 +59,19 @@ usElastography::usElastography()
 * @param Post Post-compresssed RF image.
 */
 usElastography::usElastography(usImageRF2D<short int> &Pre, usImageRF2D<short int> &Post)
+  : m_StrainMap(), m_Precomp(Pre), m_Postcomp(Post), m_Lsqper(0.01), m_LsqperFar(0.01), m_isloadPre(true),
+    m_isloadPost(true), m_FPS(24.0), m_samplingFrequency(40e6), m_c(1540.0), m_min_str(0.0), m_max_str(0.0),
+    m_max_abs(0.0), m_h_m(0), m_w_m(0), m_ix(0), m_iy(0), m_rw(0), m_rh(0), m_setROI(false), m_PreROI(), m_PostROI(),
+    m_workspace(), m_mEstimatior(OF), m_blockMatching(), U(), V(), m_decimationFactor(10), m_windowStep(0.75)
 {
-  setPreCompression(Pre);
-  setPostCompression(Post);
-  m_Lsqper = 0.01;
-  m_FPS = 24.0;
-  m_samplingFrequency = 40e6;
-  m_c = 1540.0;
-  m_setROI = false;
-  m_mEstimatior = OF;
-
-  for (uint i = 0; i < 6; i++)
-    cC.push_back(new usConvolution2d);
+  m_blockMatching.setBlockSize(2, 20);
+  m_blockMatching.setSearchRange(2, 120);
 }
 
 /**
-* Destructor, free memory.
+* Destructor.
 */
-usElastography::~usElastography()
-{
-  // Delete the convolution objects
-  for (uint i = 0; i < 6; i++)
-    delete cC.at(i);
-}
+usElastography::~usElastography() {}
 
 /**
 * Pre-compresssed RF image setter.
@@ -118,10 +94,27 @@ void usElastography::setPostCompression(const usImageRF2D<short int> &Post)
 }
 
 /**
-* Setter for LSQ strain percentage.
+* Setter for LSQ strain percentage : the strain is the slope of the displacements over a window of this fraction of the
+* ROI height.
 * @param per LSQ strain percentage.
 */
-void usElastography::setLSQpercentage(double per) { m_Lsqper = per; }
+void usElastography::setLSQpercentage(double per)
+{
+  m_Lsqper = per;
+  m_LsqperFar = per;
+}
+
+/**
+* Setter for a LSQ strain percentage varying with the depth : the window length grows (or shrinks) linearly from the top
+* to the bottom of the ROI, for example to average more at depth where the signal is weaker.
+* @param nearPer LSQ strain percentage at the top of the ROI.
+* @param farPer LSQ strain percentage at the bottom of the ROI.
+*/
+void usElastography::setLSQpercentage(double nearPer, double farPer)
+{
+  m_Lsqper = nearPer;
+  m_LsqperFar = farPer;
+}
 
 /**
 * Setter for frames per second parameter of the acquisition.
@@ -129,6 +122,19 @@ void usElastography::setLSQpercentage(double per) { m_Lsqper = per; }
 */
 void usElastography::setFPS(double fps) { m_FPS = fps; }
 
+/**
+* Setter for the step between two consecutive windows of the optical flow estimation, as a fraction of the window size.
+* The window sums are computed in constant time, so steps smaller than the default 0.75 give denser displacement maps at
+* a small cost.
+* @param step Window step, in ]0, 1].
+*/
+void usElastography::setWindowStep(double step)
+{
+  if (step <= 0.0 || step > 1.0)
+    throw(vpException(vpException::badValue, "usElastography::setWindowStep : step must be in ]0, 1]"));
+  m_windowStep = step;
+}
+
 /**
 * Setter for sampling frequency of the ultrasound wave.
 * @param samplingFrequency Sampling frequency in Hertz.
@@ -146,7 +152,7 @@ void usElastography::updateRF(const usImageRF2D<short> &image)
     setPreCompression(image);
   } else {
     if (m_isloadPost)
-      setPreCompression(m_Postcomp);
+      swapRF(m_Precomp, m_Postcomp); // the old post-compressed image becomes the pre-compressed one, without copy
     setPostCompression(image);
   }
 }
@@ -178,19 +184,85 @@ void usElastography::updateROIPos(int tx, int ty)
   m_iy = ty;
 }
 
-usImageRF2D<short int> usElastography::usImageRF_ROI(const usImageRF2D<short int> &M, uint r, uint c, uint nrows,
-                                                     uint ncols)
+/**
+* Copy of a ROI of a RF frame, scanline per scanline. The output memory is reused if the ROI size did not change.
+* @param M Input RF samples, stored scanline per scanline.
+* @param height Number of RF samples per scanline.
+* @param width Number of scanlines.
+* @param roi Output ROI image.
+* @param r First row of the ROI.
+* @param c First column of the ROI.
+* @param nrows ROI height.
+* @param ncols ROI width.
+*/
+void usElastography::extractROI(const short int *M, unsigned int height, unsigned int width,
+                                usImageRF2D<short int> &roi, uint r, uint c, uint nrows, uint ncols)
 {
-  uint rnrows = r + nrows;
-  uint cncols = c + ncols;
-  usImageRF2D<short int> t_Mout;
-  assert(rnrows < M.getHeight() || cncols < M.getWidth());
-  t_Mout.resize(nrows, ncols);
-  for (unsigned int i = r; i < rnrows; i++)
-    for (unsigned int j = c; j < cncols; j++)
-      t_Mout(i - r, j - c, M(i, j));
-
-  return t_Mout;
+  if (r + nrows > height || c + ncols > width)
+    throw(vpException(vpException::dimensionError, "usElastography : ROI outside of the RF image"));
+
+  roi.resize(nrows, ncols);
+  for (unsigned int j = 0; j < ncols; j++)
+    memcpy(roi.col[j], M + (c + j) * height + r, nrows * sizeof(short int));
+}
+
+/**
+* Exchanges the content of two RF images without copying their samples.
+* @param a First image.
+* @param b Second image.
+*/
+void usElastography::swapRF(usImageRF2D<short int> &a, usImageRF2D<short int> &b)
+{
+  std::swap(a.bitmap, b.bitmap);
+  std::swap(a.col, b.col);
+  std::swap(a.npixels, b.npixels);
+  std::swap(a.width, b.width);
+  std::swap(a.height, b.height);
+  usImagePreScanSettings settings = a;
+  static_cast<usImagePreScanSettings &>(a) = b;
+  static_cast<usImagePreScanSettings &>(b) = settings;
+}
+
+/**
+* Solves the optical flow system of a window, [sx2 sxy ; sxy sy2] * X = [bx ; by], as the 2x2 pseudo-inverse would
+* (singular values below 1e-6 times the largest are ignored), in closed form.
+* @param sx2 Sum of the squared lateral gradients in the window.
+* @param sxy Sum of the products of lateral and axial gradients in the window.
+* @param sy2 Sum of the squared axial gradients in the window.
+* @param bx Lateral right-hand term.
+* @param by Axial right-hand term.
+* @return Axial component of the solution.
+*/
+double usElastography::solveAxialFlow(double sx2, double sxy, double sy2, double bx, double by)
+{
+  // eigenvalues of the symmetric matrix
+  double halfTrace = 0.5 * (sx2 + sy2);
+  double delta = sqrt(0.25 * (sx2 - sy2) * (sx2 - sy2) + sxy * sxy);
+  double lambda1 = halfTrace + delta;
+  double lambda2 = halfTrace - delta;
+  double lambdaMax = (fabs(lambda1) >= fabs(lambda2)) ? lambda1 : lambda2;
+  double lambdaMin = (fabs(lambda1) >= fabs(lambda2)) ? lambda2 : lambda1;
+
+  if (lambdaMax == 0.0)
+    return 0.0;
+
+  if (fabs(lambdaMin) > 1e-6 * fabs(lambdaMax)) { // full rank : inverse
+    double det = sx2 * sy2 - sxy * sxy;
+    return (sx2 * by - sxy * bx) / det;
+  }
+
+  // rank 1 : projection on the eigenvector of the largest eigenvalue
+  double vx1 = sxy, vy1 = lambdaMax - sx2;
+  double vx2 = lambdaMax - sy2, vy2 = sxy;
+  double vx = vx1, vy = vy1;
+  if (vx2 * vx2 + vy2 * vy2 > vx1 * vx1 + vy1 * vy1) {
+    vx = vx2;
+    vy = vy2;
+  }
+  double norm2 = vx * vx + vy * vy;
+  if (norm2 == 0.0)
+    return 0.0;
+  return vy * (vx * bx + vy * by) / (norm2 * lambdaMax);
 }
 
 /**
@@ -199,133 +271,189 @@ usImageRF2D<short int> usElastography::usImageRF_ROI(const usImageRF2D<short int
 */
 vpImage<unsigned char> usElastography::run()
 {
+  if (m_isloadPre == true && m_isloadPost == true)
+    return run(m_Precomp, m_Postcomp);
+  return m_StrainMap;
+}
+
+/**
+* Run the elastography computation on two RF images, without storing them as pre/post-compressed images.
+* @param pre Pre-compressed RF image.
+* @param post Post-compressed RF image.
+* @return The elastography image of the ROI (dark = hard tissues, white = soft).
+*/
+vpImage<unsigned char> usElastography::run(const usImageRF2D<short int> &pre, const usImageRF2D<short int> &post)
+{
+  if (pre.getHeight() != post.getHeight() || pre.getWidth() != post.getWidth())
+    throw(vpException(vpException::dimensionError, "usElastography : pre and post-compressed images sizes differ"));
+  return runOnFrames(pre.getBitmap(), post.getBitmap(), pre.getHeight(), pre.getWidth());
+}
+
+/**
+* Run the elastography computation on two RF frames stored scanline per scanline (as usImageRF2D, or as the frames of
+* usImageRF3D).
+* @param pre Pre-compressed RF samples.
+* @param post Post-compressed RF samples.
+* @param height Number of RF samples per scanline.
+* @param width Number of scanlines.
+* @return The elastography image of the ROI (dark = hard tissues, white = soft).
+*/
+vpImage<unsigned char> usElastography::runOnFrames(const short int *pre, const short int *post, unsigned int height,
+                                                   unsigned int width)
+{
+  usLatencyTracer::usScope traceScope("elastography");
 
-  if (m_isloadPre == true && m_isloadPost == true && m_setROI == true) {
-    m_PreROI = usImageRF_ROI(m_Precomp, m_iy, m_ix, m_rh, m_rw);
-    m_PostROI = usImageRF_ROI(m_Postcomp, m_iy, m_ix, m_rh, m_rw);
-    assert(m_PreROI.getWidth() == m_PostROI.getWidth());
-    assert(m_PreROI.getHeight() == m_PostROI.getHeight());
+  if (m_setROI == true) {
+    extractROI(pre, height, width, m_PreROI, m_iy, m_ix, m_rh, m_rw);
+    extractROI(post, height, width, m_PostROI, m_iy, m_ix, m_rh, m_rw);
     if (m_mEstimatior == BMA_TAYLOR) {
-#if defined(USTK_HAVE_ARMADILLO) && (ARMA_VERSION_MAJOR > 6) && (ARMA_VERSION_MAJOR > 700)
       // Step 0: BMA
-      m_ME.init(m_PreROI, m_PostROI, 2, 20, 2, 120);
-      m_ME.run();
-      // U = m_ME.getU_vp() * (m_c * (m_PRF / (2.0 * m_samplingFrequency)));
-      V = m_ME.getV_vp() * (m_c * (m_FPS / (2.0 * m_samplingFrequency)));
+      m_blockMatching.run(m_PreROI, m_PostROI);
+      // U = m_blockMatching.getU() * (m_c * (m_PRF / (2.0 * m_samplingFrequency)));
+      V = m_blockMatching.getV() * (m_c * (m_FPS / (2.0 * m_samplingFrequency)));
       m_h_m = m_PreROI.getHeight();
       m_w_m = m_PreROI.getWidth();
-#else
-      throw vpException(vpException::fatalError,
-                        "usElastography : cannot use block-matching algorithm, armadillo is missing.");
-#endif
     } else {
-      // Step 1: Numerical gradients
-      vpMatrix Fx = usSignalProcessing::getXGradient(m_PreROI);
-      vpMatrix Fy = usSignalProcessing::getYGradient(m_PreROI);
-      // Difference
-      // vpMatrix Dt = m_Postcomp-m_Precomp;
-      vpMatrix Dt = usSignalProcessing::Difference(m_PostROI, m_PreROI);
-      // Step 2: computing the quadratic functions
-      vpMatrix dx2 = usSignalProcessing::HadamardProd(Fx, Fx);
-      vpMatrix dy2 = usSignalProcessing::HadamardProd(Fy, Fy);
-      vpMatrix dxy = usSignalProcessing::HadamardProd(Fx, Fy);
-      vpMatrix dtx = usSignalProcessing::HadamardProd(Dt, Fx);
-      vpMatrix dty = usSignalProcessing::HadamardProd(Dt, Fy);
-      // Step 3: blur the 5 images
-      vpMatrix h_gauss = usSignalProcessing::GaussianFilter(15, 5, 7.5); //(51,35,5); //21 good-phantom
-
-      vpMatrix gdx2 = cC[0]->run(dx2, h_gauss);
-      vpMatrix gdy2 = cC[1]->run(dy2, h_gauss);
-      vpMatrix gdxy = cC[2]->run(dxy, h_gauss);
-      vpMatrix gdty = cC[3]->run(dty, h_gauss);
-      vpMatrix gdtx = cC[4]->run(dtx, h_gauss);
-
-      // Step 4: compute the u, v components of the displacement
-      // usign windows of size Wsizex, Wsizey
-      m_h_m = gdx2.getRows();
-      m_w_m = gdx2.getCols();
-      int Wsizex = vpMath::round(0.1 * m_w_m); // 0.07
-      int Wsizey = vpMath::round(0.1 * m_h_m); // 0.07
-      int Wincx = vpMath::round(0.75 * Wsizex);
-      int Wincy = vpMath::round(0.75 * Wsizey);
-      int h_w = vpMath::round((double)(m_h_m - Wsizey) / (double)Wincy);
-      int w_w = vpMath::round((double)(m_w_m - Wsizex) / (double)Wincx);
-
-      assert(w_w > 1);
-      assert(h_w > 1);
-
-      // U.resize(h_w, w_w);
-      V.resize(h_w, w_w);
-      vpMatrix b(2, 1);
-      vpMatrix M(2, 2);
-      vpMatrix X(2, 1);
-      uint k = 0, l;
-      for (uint n = 0; n < (uint)(m_w_m - Wsizex - Wincx); n += Wincx) {
-        l = 0;
-        for (uint m = 0; m < (uint)(m_h_m - Wsizey - Wincy); m += Wincy) {
-          double sgdx2_w = 0.0;
-          double sgdy2_w = 0.0;
-          double sgdxy_w = 0.0;
-          double sgdtx_w = 0.0;
-          double sgdty_w = 0.0;
-          for (uint i = m; i < (m + Wsizey); i++) {
-            for (uint j = n; j < (n + Wsizex); j++) {
-              sgdx2_w += gdx2[i][j];
-              sgdy2_w += gdy2[i][j];
-              sgdxy_w += gdxy[i][j];
-              sgdtx_w += gdtx[i][j];
-              sgdty_w += gdty[i][j];
-            }
-          }
-          M.data[0] = sgdx2_w;
-          M.data[1] = sgdxy_w;
-          M.data[2] = sgdxy_w;
-          M.data[3] = sgdy2_w;
-          b.data[0] = -sgdtx_w;
-          b.data[1] = -sgdty_w;
-
-          X = M.pseudoInverse() * b;
-          // U[l][k] = X.data[0] * (m_c * (m_PRF / (2.0 * m_samplingFrequency))); //lateral displacements
-          V[l][k] = X.data[1] * (m_c * (m_FPS / (2.0 * m_samplingFrequency))); // axial displacements
-          l++;
-        }
-        k++;
-      }
+      computeFlowProducts();
+      estimateFlowDisplacements(m_workspace.getBlurredProducts());
     }
+    computeStrainMap();
+  }
+  return m_StrainMap;
+}
+
+/**
+* Optical flow, steps 1 to 3 : gradients of the pre-compressed ROI, temporal difference, and blurred products, computed
+* in the workspace (see usElastographyWorkspace::getBlurredProducts()).
+*/
+void usElastography::computeFlowProducts()
+{
+  // gaussian kernel of 15 x 5, sigma 7.5 (51,35,5 ; 21 good-phantom), set in the workspace
+  m_workspace.computeBlurredProducts(m_PreROI, m_PostROI);
+}
 
-    vpMatrix vV(m_h_m, m_w_m, true);
-    vV = usSignalProcessing::BilinearInterpolation(V, m_w_m, m_h_m);
-    /// Strain estimation
-    /// "LSQ strain estimation"
-    double kappa = (2.0 * m_samplingFrequency) / (m_c * m_FPS);
-    double d_m = m_Lsqper * m_h_m; // 20.0; //Good value in phantom
-    double n = d_m + 1;
-    // Filter kernel
-    vpMatrix h((uint)n + 1, 1, true);
-    double xi = kappa * 12.0 / (n * (n * n - 1));
-    uint j = 0;
-    for (int i = (int)n; i >= 0; i--) {
-      h[j][0] = xi * (i - (n + 1) / 2.0);
-      j++;
+/**
+* Optical flow, step 4 : axial displacements of the windows, from the blurred products (see computeFlowProducts()).
+* @param blurredProducts The 5 blurred products : dx2, dy2, dxy, dty, dtx. Products summed over several frames give a
+* 3D estimation.
+*/
+void usElastography::estimateFlowDisplacements(const std::vector<vpImage<float> > &blurredProducts)
+{
+  const vpImage<float> &gdx2 = blurredProducts[usElastographyWorkspace<float>::DX2];
+  const vpImage<float> &gdy2 = blurredProducts[usElastographyWorkspace<float>::DY2];
+  const vpImage<float> &gdxy = blurredProducts[usElastographyWorkspace<float>::DXY];
+  const vpImage<float> &gdty = blurredProducts[usElastographyWorkspace<float>::DTY];
+  const vpImage<float> &gdtx = blurredProducts[usElastographyWorkspace<float>::DTX];
+
+  // Step 4: compute the u, v components of the displacement
+  // usign windows of size Wsizex, Wsizey
+  m_h_m = gdx2.getHeight();
+  m_w_m = gdx2.getWidth();
+  int Wsizex = vpMath::round(0.1 * m_w_m); // 0.07
+  int Wsizey = vpMath::round(0.1 * m_h_m); // 0.07
+  int Wincx = std::max(1, vpMath::round(m_windowStep * Wsizex));
+  int Wincy = std::max(1, vpMath::round(m_windowStep * Wsizey));
+  int h_w = vpMath::round((double)(m_h_m - Wsizey) / (double)Wincy);
+  int w_w = vpMath::round((double)(m_w_m - Wsizex) / (double)Wincx);
+
+  assert(w_w > 1);
+  assert(h_w > 1);
+
+  // Summed-area tables of the 5 blurred images, interleaved : each window sum is then computed with 4 lookups.
+  // sat[((i * (m_w_m + 1)) + j) * 5 + q] is the sum of the quantity q over the rows < i and columns < j.
+  unsigned int satWidth = m_w_m + 1;
+  std::vector<double> sat((m_h_m + 1) * satWidth * 5, 0.0);
+  for (int i = 0; i < m_h_m; i++) {
+    double rowSum[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+    const float *p_dx2 = gdx2[i];
+    const float *p_dy2 = gdy2[i];
+    const float *p_dxy = gdxy[i];
+    const float *p_dtx = gdtx[i];
+    const float *p_dty = gdty[i];
+    const double *satUp = &sat[(i * satWidth + 1) * 5];
+    double *satRow = &sat[((i + 1) * satWidth + 1) * 5];
+    for (int j = 0; j < m_w_m; j++) {
+      rowSum[0] += p_dx2[j];
+      rowSum[1] += p_dy2[j];
+      rowSum[2] += p_dxy[j];
+      rowSum[3] += p_dtx[j];
+      rowSum[4] += p_dty[j];
+      for (unsigned int q = 0; q < 5; q++)
+        satRow[5 * j + q] = satUp[5 * j + q] + rowSum[q];
     }
+  }
 
-    /// Strain matrix S
-    vpMatrix strainMatrix = cC[5]->run(vV, h);
+  // same window grid as the sliding windows : n < m_w_m - Wsizex - Wincx, m < m_h_m - Wsizey - Wincy
+  int nbWindowsX = std::max(0, (m_w_m - Wsizex - Wincx + Wincx - 1) / Wincx);
+  int nbWindowsY = std::max(0, (m_h_m - Wsizey - Wincy + Wincy - 1) / Wincy);
+  nbWindowsX = std::min(nbWindowsX, w_w);
+  nbWindowsY = std::min(nbWindowsY, h_w);
 
-    m_StrainMap.resize((unsigned int)(strainMatrix.getRows() / (double)m_decimationFactor), strainMatrix.getCols());
+  // U.resize(h_w, w_w);
+  V.resize(h_w, w_w);
+  double displacementFactor = m_c * (m_FPS / (2.0 * m_samplingFrequency));
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int l = 0; l < nbWindowsY; l++) {
+    unsigned int m = l * Wincy;
+    const double *satTop = &sat[m * satWidth * 5];
+    const double *satBottom = &sat[(m + Wsizey) * satWidth * 5];
+    for (int k = 0; k < nbWindowsX; k++) {
+      unsigned int n = k * Wincx;
+      double windowSum[5];
+      for (unsigned int q = 0; q < 5; q++)
+        windowSum[q] = satBottom[(n + Wsizex) * 5 + q] - satBottom[n * 5 + q] - satTop[(n + Wsizex) * 5 + q] +
+                       satTop[n * 5 + q];
 
-    m_min_str = std::abs(strainMatrix.getMinValue());
-    m_max_str = std::abs(strainMatrix.getMaxValue());
-    m_max_abs = (m_min_str > m_max_str) ? m_min_str : m_max_str;
+      // U[l][k] = lateral displacements
+      V[l][k] = solveAxialFlow(windowSum[0], windowSum[2], windowSum[1], -windowSum[3], -windowSum[4]) *
+                displacementFactor; // axial displacements
+    }
+  }
+}
+
+/**
+* LSQ strain estimation from the axial displacements, and conversion to the strain map image.
+*/
+void usElastography::computeStrainMap()
+{
+  /// Strain estimation
+  /// "LSQ strain estimation", window length as a percentage of the ROI height
+  double kappa = (2.0 * m_samplingFrequency) / (m_c * m_FPS);
+  double d_m = m_Lsqper * m_h_m; // 20.0; //Good value in phantom
+  double d_mFar = m_LsqperFar * m_h_m;
+  usStrainEstimator<float> &strainEstimator = m_workspace.getStrainEstimator();
+  strainEstimator.setScale(kappa);
+  strainEstimator.setWindowLengthRange(d_m + 1, d_mFar + 1);
+
+  /// Strain matrix S : interpolation of the displacements on the ROI, and LSQ slopes
+  m_workspace.computeStrain(V, m_w_m, m_h_m);
+  const vpImage<float> &strainMatrix = m_workspace.getStrain();
+
+  m_StrainMap.resize((unsigned int)(strainMatrix.getHeight() / (double)m_decimationFactor), strainMatrix.getWidth());
+
+  float minStrain = 0.f, maxStrain = 0.f;
+  bool first = true;
+  for (unsigned int k = 0; k < strainMatrix.getSize(); k++) {
+    float value = strainMatrix.bitmap[k];
+    if (std::isnan(value))
+      continue;
+    if (first || value < minStrain)
+      minStrain = value;
+    if (first || value > maxStrain)
+      maxStrain = value;
+    first = false;
+  }
+  m_min_str = std::abs(minStrain);
+  m_max_str = std::abs(maxStrain);
+  m_max_abs = (m_min_str > m_max_str) ? m_min_str : m_max_str;
+  for (unsigned int yIndex = 0; yIndex < m_StrainMap.getRows(); ++yIndex) {
+    const float *strainRow = strainMatrix[yIndex * m_decimationFactor];
+    unsigned char *strainMapRow = m_StrainMap[yIndex];
     for (unsigned int xIndex = 0; xIndex < m_StrainMap.getCols(); ++xIndex) {
-      for (unsigned int yIndex = 0; yIndex < m_StrainMap.getRows(); ++yIndex) {
-        m_StrainMap[yIndex][xIndex] =
-            std::isnan(strainMatrix[yIndex * m_decimationFactor][xIndex])
-                ? 0.0
-                : 254 * (fabs(strainMatrix[yIndex * m_decimationFactor][xIndex]) / (m_max_abs));
-      }
+      strainMapRow[xIndex] = std::isnan(strainRow[xIndex]) ? 0 : 254 * (fabs(strainRow[xIndex]) / (m_max_abs));
     }
   }
-  return m_StrainMap;
 }
 #endif // QT
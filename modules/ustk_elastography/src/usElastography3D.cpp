@@ -31,9 +31,17 @@
  *****************************************************************************/
 
 #include <visp3/ustk_elastography/usElastography3D.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 #if defined(USTK_HAVE_FFTW)
 
+#include <algorithm>
+#include <cstring>
+
+#ifdef VISP_HAVE_OPENMP
+#include <omp.h>
+#endif
+
 /**
 * Default constructor.
 */
@@ -43,6 +51,8 @@ usElastography3D::usElastography3D()
   m_isloadPost = false;
   m_setROI = false;
   m_framesInROI = 0;
+  m_frameBeginROI = 0;
+  m_motionEstimation3D = false;
 }
 
 /**
@@ -57,12 +67,19 @@ usElastography3D::usElastography3D(usImageRF3D<short int> &Pre, usImageRF3D<shor
   setPostCompression(Post);
 
   m_setROI = false;
+  m_framesInROI = 0;
+  m_frameBeginROI = 0;
+  m_motionEstimation3D = false;
 }
 
 /**
-* Destructor.
+* Destructor, free memory.
 */
-usElastography3D::~usElastography3D() {}
+usElastography3D::~usElastography3D()
+{
+  for (unsigned int i = 0; i < m_frameProcessors.size(); i++)
+    delete m_frameProcessors[i];
+}
 
 /**
 * Pre-compresssed RF volume setter.
@@ -105,6 +122,15 @@ void usElastography3D::setSamplingFrequency(double samplingFrequency)
   m_elastography2DProcessor.setSamplingFrequency(samplingFrequency);
 }
 
+/**
+* Enables the 3D motion estimation : the optical flow equations of the frames k-1 and k+1 are added to the ones of the
+* frame k before solving the displacements of each window, which regularizes the strain across the elevation.
+* Only used with the optical flow estimator (usElastography::OF).
+* @param motionEstimation3D True to estimate the displacements on 3D windows, false (default) to process each frame
+* independently.
+*/
+void usElastography3D::setMotionEstimation3D(bool motionEstimation3D) { m_motionEstimation3D = motionEstimation3D; }
+
 void usElastography3D::setMotionEstimator(usElastography::MotionEstimator t_mest)
 {
   m_elastography2DProcessor.setMotionEstimator(t_mest);
@@ -164,31 +190,183 @@ void usElastography3D::updateROIPos(int tx, int ty, int tz)
   m_frameBeginROI = tz;
 }
 
+/**
+* Copy the settings of the 2D processor on a frame processor.
+* @param processor Processor used on the frames of one thread.
+*/
+void usElastography3D::configureFrameProcessor(usElastography &processor) const
+{
+  const usElastography &settings = m_elastography2DProcessor;
+  processor.setDecimationFactor(settings.m_decimationFactor);
+  processor.setFPS(settings.m_FPS);
+  processor.setSamplingFrequency(settings.m_samplingFrequency);
+  processor.setLSQpercentage(settings.m_Lsqper, settings.m_LsqperFar);
+  processor.setMotionEstimator(settings.m_mEstimatior);
+  processor.setWindowStep(settings.m_windowStep);
+  processor.setROI(settings.m_ix, settings.m_iy, settings.m_rw, settings.m_rh);
+}
+
+/**
+* Processor of the calling thread.
+* @return The 2D processor to use in the current thread.
+*/
+usElastography &usElastography3D::getFrameProcessor()
+{
+#ifdef VISP_HAVE_OPENMP
+  return *m_frameProcessors[omp_get_thread_num()];
+#else
+  return *m_frameProcessors[0];
+#endif
+}
+
+/**
+* Copy the strain map of a processor in a frame of the output volume.
+* @param processor Processor on which the strain map was computed.
+* @param outputVolume Output volume, already allocated.
+* @param frame Frame of the output volume to fill.
+*/
+void usElastography3D::copyStrainMap(const usElastography &processor, usImage3D<unsigned char> &outputVolume,
+                                     unsigned int frame)
+{
+  memcpy(outputVolume.getData(0, 0, frame), processor.m_StrainMap.bitmap,
+         processor.m_StrainMap.getSize() * sizeof(unsigned char));
+}
+
+/**
+* Sum of the blurred optical flow products of a frame and of its neighbours in the ROI.
+* @param products Blurred products of each frame of the ROI.
+* @param frame Frame index in the ROI.
+* @param sum Products of the 3D window.
+*/
+void usElastography3D::sumNeighbourProducts(const std::vector<std::vector<vpImage<float> > > &products, int frame,
+                                            std::vector<vpImage<float> > &sum)
+{
+  sum = products[frame];
+  for (int k = std::max(0, frame - 1); k <= std::min((int)products.size() - 1, frame + 1); k++) {
+    if (k == frame)
+      continue;
+    for (unsigned int q = 0; q < sum.size(); q++) {
+      const float *neighbour = products[k][q].bitmap;
+      float *out = sum[q].bitmap;
+      for (unsigned int n = 0; n < sum[q].getSize(); n++)
+        out[n] += neighbour[n];
+    }
+  }
+}
+
+/**
+* Frame by frame elastography : each frame of the ROI is processed independently.
+* The first frame gives the size of the strain maps, the output volume is then allocated once and the other frames are
+* processed in parallel.
+* @param outputVolume Output strain volume.
+*/
+void usElastography3D::runFrames(usImage3D<unsigned char> &outputVolume)
+{
+  const unsigned int height = m_Precomp.getHeight();
+  const unsigned int width = m_Precomp.getWidth();
+  const unsigned int frameSize = height * width;
+  const short int *pre = m_Precomp.getConstData() + m_frameBeginROI * frameSize;
+  const short int *post = m_Postcomp.getConstData() + m_frameBeginROI * frameSize;
+
+  usElastography &firstProcessor = *m_frameProcessors[0];
+  firstProcessor.runOnFrames(pre, post, height, width);
+  outputVolume.resize(firstProcessor.m_StrainMap.getHeight(), firstProcessor.m_StrainMap.getWidth(), m_framesInROI);
+  copyStrainMap(firstProcessor, outputVolume, 0);
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int k = 1; k < m_framesInROI; k++) {
+    usElastography &processor = getFrameProcessor();
+    processor.runOnFrames(pre + k * frameSize, post + k * frameSize, height, width);
+    copyStrainMap(processor, outputVolume, k);
+  }
+}
+
+/**
+* Elastography with 3D motion estimation : the blurred optical flow products of all the frames of the ROI are computed
+* first, then the displacements of each frame are solved on the products summed with the ones of the neighbouring
+* frames.
+* @param outputVolume Output strain volume.
+*/
+void usElastography3D::runFrames3D(usImage3D<unsigned char> &outputVolume)
+{
+  const unsigned int height = m_Precomp.getHeight();
+  const unsigned int width = m_Precomp.getWidth();
+  const unsigned int frameSize = height * width;
+  const short int *pre = m_Precomp.getConstData() + m_frameBeginROI * frameSize;
+  const short int *post = m_Postcomp.getConstData() + m_frameBeginROI * frameSize;
+  const usElastography &settings = m_elastography2DProcessor;
+
+  std::vector<std::vector<vpImage<float> > > products(m_framesInROI);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int k = 0; k < m_framesInROI; k++) {
+    usElastography &processor = getFrameProcessor();
+    processor.extractROI(pre + k * frameSize, height, width, processor.m_PreROI, settings.m_iy, settings.m_ix,
+                         settings.m_rh, settings.m_rw);
+    processor.extractROI(post + k * frameSize, height, width, processor.m_PostROI, settings.m_iy, settings.m_ix,
+                         settings.m_rh, settings.m_rw);
+    processor.computeFlowProducts();
+    products[k] = processor.m_workspace.getBlurredProducts();
+  }
+
+  std::vector<vpImage<float> > windowProducts;
+  usElastography &firstProcessor = *m_frameProcessors[0];
+  sumNeighbourProducts(products, 0, windowProducts);
+  firstProcessor.estimateFlowDisplacements(windowProducts);
+  firstProcessor.computeStrainMap();
+  outputVolume.resize(firstProcessor.m_StrainMap.getHeight(), firstProcessor.m_StrainMap.getWidth(), m_framesInROI);
+  copyStrainMap(firstProcessor, outputVolume, 0);
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for firstprivate(windowProducts)
+#endif
+  for (int k = 1; k < m_framesInROI; k++) {
+    usElastography &processor = getFrameProcessor();
+    sumNeighbourProducts(products, k, windowProducts);
+    processor.estimateFlowDisplacements(windowProducts);
+    processor.computeStrainMap();
+    copyStrainMap(processor, outputVolume, k);
+  }
+}
+
 /**
 * Run the elastography computation.
-* @return The elastography image of the ROI (dark = hard tissues, white = soft).
+* @return The elastography volume of the ROI (dark = hard tissues, white = soft).
 */
 usImage3D<unsigned char> usElastography3D::run()
 {
-  usImageRF2D<short int> preCompressedFrame, postCompressedFrame;
+  usLatencyTracer::usScope traceScope("elastography 3D");
+
   usImage3D<unsigned char> outputVolume;
-  vpImage<unsigned char> outputFrame;
-
-  if (m_isloadPre == true && m_isloadPost == true && m_setROI == true) {
-    for (int i = m_frameBeginROI; i < m_frameBeginROI + m_framesInROI; i++) {
-      m_Precomp.getFrame(preCompressedFrame, i);
-      m_Postcomp.getFrame(postCompressedFrame, i);
-      m_elastography2DProcessor.setPreCompression(preCompressedFrame);
-      m_elastography2DProcessor.setPostCompression(postCompressedFrame);
-
-      outputFrame = m_elastography2DProcessor.run();
-      outputVolume.resize(outputFrame.getHeight(), outputFrame.getWidth(), m_framesInROI);
-      for (unsigned int row = 0; row < outputFrame.getHeight(); row++) {
-        for (unsigned int col = 0; col < outputFrame.getWidth(); col++) {
-          outputVolume(row, col, i - m_frameBeginROI, outputFrame[row][col]);
-        }
-      }
-    }
+
+  if (m_isloadPre == true && m_isloadPost == true && m_setROI == true && m_framesInROI > 0) {
+    const usElastography &settings = m_elastography2DProcessor;
+    if (m_Precomp.getHeight() != m_Postcomp.getHeight() || m_Precomp.getWidth() != m_Postcomp.getWidth() ||
+        m_Precomp.getNumberOfFrames() != m_Postcomp.getNumberOfFrames())
+      throw(vpException(vpException::dimensionError, "usElastography3D : pre and post-compressed volumes sizes differ"));
+    if (m_frameBeginROI < 0 || m_frameBeginROI + m_framesInROI > (int)m_Precomp.getNumberOfFrames() ||
+        settings.m_ix < 0 || settings.m_iy < 0 || settings.m_ix + settings.m_rw > (int)m_Precomp.getWidth() ||
+        settings.m_iy + settings.m_rh > (int)m_Precomp.getHeight())
+      throw(vpException(vpException::dimensionError, "usElastography3D : ROI outside of the RF volume"));
+
+    // one processor per thread, keeping its elastography workspace and ROI buffers from one run to the other
+#ifdef VISP_HAVE_OPENMP
+    unsigned int threadNumber = omp_get_max_threads();
+#else
+    unsigned int threadNumber = 1;
+#endif
+    while (m_frameProcessors.size() < threadNumber)
+      m_frameProcessors.push_back(new usElastography);
+    for (unsigned int i = 0; i < m_frameProcessors.size(); i++)
+      configureFrameProcessor(*m_frameProcessors[i]);
+
+    if (m_motionEstimation3D && settings.m_mEstimatior == usElastography::OF)
+      runFrames3D(outputVolume);
+    else
+      runFrames(outputVolume);
   }
 
   return outputVolume;
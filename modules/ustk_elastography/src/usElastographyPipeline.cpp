@@ -0,0 +1,390 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include <visp3/ustk_elastography/usElastographyPipeline.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <visp3/core/vpException.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
+
+/**
+* Constructor, starts the worker threads.
+* @param workerNumber Number of frame pairs processed concurrently.
+*/
+usElastographyPipeline::usElastographyPipeline(unsigned int workerNumber)
+  : m_workers(), m_mutex(), m_pairCondition(), m_resultCondition(), m_settings(), m_previousFrame(), m_frameCount(0),
+    m_pendingPairs(), m_maxPendingPairs(0), m_droppedPairs(0), m_failedPairs(0), m_results(), m_nextPairToDeliver(1),
+    m_readyResults(), m_callback(), m_delivering(false), m_stop(false)
+{
+  if (workerNumber == 0)
+    throw(vpException(vpException::badValue, "usElastographyPipeline : at least one worker is needed"));
+
+  // same default settings as usElastography
+  m_settings.decimationFactor = 10;
+  m_settings.fps = 24.0;
+  m_settings.lsqPercentage = 0.01;
+  m_settings.estimator = usElastography::OF;
+  m_settings.samplingFrequency = 40e6;
+  m_settings.roiSet = false;
+  m_settings.tx = m_settings.ty = m_settings.tw = m_settings.th = 0;
+
+  m_maxPendingPairs = workerNumber;
+
+  for (unsigned int i = 0; i < workerNumber; i++)
+    m_workers.push_back(std::thread(&usElastographyPipeline::workerLoop, this));
+}
+
+/**
+* Destructor, stops the worker threads.
+*/
+usElastographyPipeline::~usElastographyPipeline() { stop(); }
+
+/**
+* Number of pairs dropped because the workers were late : pairs waiting for a worker when newer pairs arrived, or
+* strain maps not read when newer ones were delivered.
+* @return Number of dropped pairs.
+*/
+unsigned int usElastographyPipeline::getDroppedPairNumber() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_droppedPairs;
+}
+
+/**
+* Number of pairs whose strain map could not be computed : frames of different sizes, ROI outside of the frames or
+* empty strain map. These pairs are skipped, the following strain maps are still delivered.
+* @return Number of failed pairs.
+*/
+unsigned int usElastographyPipeline::getFailedPairNumber() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_failedPairs;
+}
+
+/**
+* Get the next strain map, in the order of the frames. Not available if a callback is set.
+* @param strainMap The strain map.
+* @param pairIndex Index of the pair (index of its second frame, as returned by pushFrame()).
+* @param blocking If true, waits for the next strain map ; otherwise returns false if none is available.
+* @return True if a strain map was returned, false if none was available or if the pipeline was stopped.
+*/
+bool usElastographyPipeline::getStrainMap(vpImage<unsigned char> &strainMap, unsigned int &pairIndex, bool blocking)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (blocking)
+    m_resultCondition.wait(lock, [this] { return m_stop || !m_readyResults.empty(); });
+  if (m_readyResults.empty())
+    return false;
+
+  pairIndex = m_readyResults.front().first;
+  strainMap = *m_readyResults.front().second;
+  m_readyResults.pop_front();
+  return true;
+}
+
+/**
+* Get the number of worker threads.
+* @return The number of worker threads.
+*/
+unsigned int usElastographyPipeline::getWorkerNumber() const { return (unsigned int)m_workers.size(); }
+
+/**
+* Push a new RF frame : a strain map is computed between the previous frame and this one.
+* The frame is copied once, use the usRFFramePtr overload to avoid this copy.
+* @param frame New RF frame.
+* @return Index of the frame (0 for the first frame).
+*/
+unsigned int usElastographyPipeline::pushFrame(const usImageRF2D<short int> &frame)
+{
+  return pushFrame(usRFFramePtr(new usImageRF2D<short int>(frame)));
+}
+
+/**
+* Push a new RF frame : a strain map is computed between the previous frame and this one. The frame must not be
+* modified afterwards, it is shared with the workers.
+* @param frame New RF frame.
+* @return Index of the frame (0 for the first frame).
+*/
+unsigned int usElastographyPipeline::pushFrame(const usRFFramePtr &frame)
+{
+  bool dropped = false;
+  unsigned int index;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    index = m_frameCount++;
+    if (m_previousFrame) {
+      // drop-stale policy : the oldest pair waiting for a worker is abandoned
+      if (m_pendingPairs.size() >= m_maxPendingPairs) {
+        m_results[m_pendingPairs.front().index] = std::shared_ptr<vpImage<unsigned char> >();
+        m_pendingPairs.pop_front();
+        m_droppedPairs++;
+        dropped = true;
+      }
+      usPair pair;
+      pair.index = index;
+      pair.traceId = usLatencyTracer::getCurrentTraceId();
+      pair.pre = m_previousFrame;
+      pair.post = frame;
+      pair.settings = m_settings;
+      m_pendingPairs.push_back(pair);
+    }
+    m_previousFrame = frame;
+  }
+  m_pairCondition.notify_one();
+
+  if (dropped)
+    deliver();
+  return index;
+}
+
+/**
+* Setter for the decimation factor of the strain maps (see usElastography::setDecimationFactor()).
+* @param decimationFactor Decimation factor.
+*/
+void usElastographyPipeline::setDecimationFactor(unsigned int decimationFactor)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_settings.decimationFactor = decimationFactor;
+}
+
+/**
+* Setter for frames per second parameter of the acquisition.
+* @param fps Frames per second.
+*/
+void usElastographyPipeline::setFPS(double fps)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_settings.fps = fps;
+}
+
+/**
+* Setter for LSQ strain percentage.
+* @param per LSQ strain percentage.
+*/
+void usElastographyPipeline::setLSQpercentage(double per)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_settings.lsqPercentage = per;
+}
+
+/**
+* Setter for the number of pairs which can wait for a worker, and of strain maps which can wait to be read. Older ones
+* are dropped. By default, it is the number of workers.
+* @param maxPendingPairs Maximal number of pending pairs (at least 1).
+*/
+void usElastographyPipeline::setMaxPendingPairs(unsigned int maxPendingPairs)
+{
+  if (maxPendingPairs == 0)
+    throw(vpException(vpException::badValue, "usElastographyPipeline : at least one pending pair must be allowed"));
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_maxPendingPairs = maxPendingPairs;
+}
+
+/**
+* Setter for the motion estimation method.
+* @param estimator Motion estimator.
+*/
+void usElastographyPipeline::setMotionEstimator(usElastography::MotionEstimator estimator)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_settings.estimator = estimator;
+}
+
+/**
+* ROI setter: the ROI is the region in the RF image in which to compute the elastography. Applies to the pairs formed
+* after this call.
+* @param tx Top left column of the ROI.
+* @param ty Top left row of the ROI.
+* @param tw ROI width in px.
+* @param th ROI height in px.
+*/
+void usElastographyPipeline::setROI(int tx, int ty, int tw, int th)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_settings.tx = tx;
+  m_settings.ty = ty;
+  m_settings.tw = tw;
+  m_settings.th = th;
+  m_settings.roiSet = true;
+}
+
+/**
+* Setter for sampling frequency of the ultrasound wave.
+* @param samplingFrequency Sampling frequency in Hertz.
+*/
+void usElastographyPipeline::setSamplingFrequency(double samplingFrequency)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_settings.samplingFrequency = samplingFrequency;
+}
+
+/**
+* Set a function called for every strain map, in the order of the frames, instead of storing them for getStrainMap().
+* It is called without any lock held, from a worker thread (or from pushFrame() when a pair is dropped), and should
+* return quickly. It may push frames. An exception thrown by the callback in a worker thread is ignored.
+* @param callback Function called for each strain map.
+*/
+void usElastographyPipeline::setStrainMapCallback(const usStrainMapCallback &callback)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_callback = callback;
+}
+
+/**
+* Stops the workers. Pairs not processed yet are abandoned.
+*/
+void usElastographyPipeline::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_pendingPairs.clear();
+  }
+  m_pairCondition.notify_all();
+  m_resultCondition.notify_all();
+  for (unsigned int i = 0; i < m_workers.size(); i++) {
+    if (m_workers.at(i).joinable())
+      m_workers.at(i).join();
+  }
+}
+
+/**
+* Moves the strain maps whose previous pairs are all done to the ready list (or passes them to the callback). A single
+* thread delivers at a time : if another one is delivering, it also delivers the strain maps completed meanwhile. The
+* callback is called after releasing the lock, so that it can push frames.
+*/
+void usElastographyPipeline::deliver()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_delivering)
+    return;
+  m_delivering = true;
+
+  while (true) {
+    std::vector<std::pair<unsigned int, std::shared_ptr<vpImage<unsigned char> > > > delivered;
+    while (!m_results.empty() && m_results.begin()->first == m_nextPairToDeliver) {
+      if (m_results.begin()->second)
+        delivered.push_back(*m_results.begin());
+      m_results.erase(m_results.begin());
+      m_nextPairToDeliver++;
+    }
+    if (delivered.empty()) {
+      m_delivering = false;
+      return;
+    }
+
+    usStrainMapCallback callback = m_callback;
+    if (!callback) {
+      for (unsigned int i = 0; i < delivered.size(); i++)
+        m_readyResults.push_back(delivered.at(i));
+      while (m_readyResults.size() > m_maxPendingPairs) {
+        m_readyResults.pop_front();
+        m_droppedPairs++;
+      }
+      m_resultCondition.notify_all();
+      continue;
+    }
+
+    lock.unlock();
+    try {
+      for (unsigned int i = 0; i < delivered.size(); i++)
+        callback(*delivered.at(i).second, delivered.at(i).first);
+    } catch (...) {
+      lock.lock();
+      m_delivering = false;
+      throw;
+    }
+    lock.lock();
+  }
+}
+
+/**
+* Worker thread : computes the strain maps of the pending pairs with its own elastography processor.
+*/
+void usElastographyPipeline::workerLoop()
+{
+  usElastography elastography;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_pairCondition.wait(lock, [this] { return m_stop || !m_pendingPairs.empty(); });
+    if (m_stop)
+      return;
+
+    usPair pair = m_pendingPairs.front();
+    m_pendingPairs.pop_front();
+    lock.unlock();
+
+    usLatencyTracer::setCurrentTraceId(pair.traceId);
+    std::shared_ptr<vpImage<unsigned char> > strainMap;
+    bool failed = false;
+    if (pair.settings.roiSet) {
+      elastography.setDecimationFactor(pair.settings.decimationFactor);
+      elastography.setFPS(pair.settings.fps);
+      elastography.setLSQpercentage(pair.settings.lsqPercentage);
+      elastography.setMotionEstimator(pair.settings.estimator);
+      elastography.setSamplingFrequency(pair.settings.samplingFrequency);
+      elastography.setROI(pair.settings.tx, pair.settings.ty, pair.settings.tw, pair.settings.th);
+      try {
+        strainMap.reset(new vpImage<unsigned char>(elastography.run(*pair.pre, *pair.post)));
+        if (strainMap->getHeight() == 0 || strainMap->getWidth() == 0) {
+          strainMap.reset();
+          failed = true;
+        }
+      } catch (...) {
+        // vpException, std::bad_alloc... : the pair is skipped, the worker goes on
+        strainMap.reset();
+        failed = true;
+      }
+    }
+    if (strainMap)
+      usLatencyTracer::checkpoint("strain map");
+    // release the frames before waiting for the next pair
+    pair.pre.reset();
+    pair.post.reset();
+
+    lock.lock();
+    m_results[pair.index] = strainMap;
+    if (failed)
+      m_failedPairs++;
+    lock.unlock();
+    try {
+      deliver();
+    } catch (...) {
+      // exception of the callback : nothing to give it back to in a worker thread
+    }
+    lock.lock();
+  }
+}
+
+#endif // USTK_HAVE_FFTW
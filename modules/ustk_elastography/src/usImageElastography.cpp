@@ -32,12 +32,19 @@
 
 #include <visp3/ustk_elastography/usImageElastography.h>
 
+#include <visp3/core/vpMath.h>
+
 /*!
   \brief Constructor.
 */
 usImageElastography::usImageElastography()
-  : m_ultrasoundImage(), m_strainMap(), m_elastoImage(), m_heigthPosition(0), m_widthPosition(0)
+  : m_ultrasoundImage(), m_strainMap(), m_elastoImage(), m_heigthPosition(0), m_widthPosition(0),
+    m_strainMapSet(false), m_colorMap(256), m_strainOpacity(1.0), m_opacity(256), m_colorTerms(), m_grayTerms(),
+    m_grayColors()
 {
+  for (unsigned int s = 0; s < 256; s++)
+    m_colorMap[s] = vpRGBa(s, 0, 0, 255);
+  updateBlendingTables();
 }
 
 /**
@@ -53,8 +60,20 @@ usImageElastography::usImageElastography(const vpImage<unsigned char> &ultrasoun
                                          const vpImage<unsigned char> &strainMap, unsigned int heightPosition,
                                          unsigned int widthPosition)
   : m_ultrasoundImage(ultrasoundImage), m_strainMap(strainMap), m_elastoImage(), m_heigthPosition(heightPosition),
-    m_widthPosition(widthPosition)
+    m_widthPosition(widthPosition), m_strainMapSet(true), m_colorMap(256), m_strainOpacity(1.0), m_opacity(256),
+    m_colorTerms(), m_grayTerms(), m_grayColors()
 {
+  // image dimension check
+  if (ultrasoundImage.getHeight() < strainMap.getHeight() + heightPosition ||
+      ultrasoundImage.getWidth() < strainMap.getWidth() + widthPosition) {
+    throw(vpException(vpException::dimensionError,
+                      "usImageElastography : the strainMap position is out of ultrasound image bounds !"));
+  }
+
+  for (unsigned int s = 0; s < 256; s++)
+    m_colorMap[s] = vpRGBa(s, 0, 0, 255);
+  updateBlendingTables();
+  m_elastoImage.resize(m_ultrasoundImage.getHeight(), m_ultrasoundImage.getWidth());
   computeElastographyImage();
 }
 
@@ -63,12 +82,40 @@ usImageElastography::usImageElastography(const vpImage<unsigned char> &ultrasoun
 */
 usImageElastography::~usImageElastography() {}
 
+/**
+* Get the color map used to display the strain values.
+* @return The 256 colors, indexed by strain value.
+*/
+std::vector<vpRGBa> usImageElastography::getColorMap() const { return m_colorMap; }
+
 /**
 * Get the resulting image, combinig ultrasound and elastography.
 * @return The image resulting of the mix of ultrasound image and the strain map of a region of interest.
 */
 vpImage<vpRGBa> usImageElastography::getElastoImage() { return m_elastoImage; }
 
+/**
+* Get the opacity of the strain colors over the ultrasound image.
+* @return The opacity, in [0, 1].
+*/
+double usImageElastography::getStrainOpacity() const { return m_strainOpacity; }
+
+/**
+* Color map setter : the strain value s is displayed with the color colorMap[s]. By default, the strain value is put in
+* the red channel.
+* @param colorMap The 256 colors, indexed by strain value.
+*/
+void usImageElastography::setColorMap(const std::vector<vpRGBa> &colorMap)
+{
+  if (colorMap.size() != 256)
+    throw(vpException(vpException::dimensionError, "usImageElastography::setColorMap : the color map must have 256 "
+                                                   "entries !"));
+  m_colorMap = colorMap;
+  updateBlendingTables();
+  if (m_strainMapSet)
+    computeStrainRegion();
+}
+
 /**
 * Strain map image setter.
 * @warning Make sure you already set the ultrasound image with setUltrasoundImage() before calling this method.
@@ -87,10 +134,33 @@ void usImageElastography::setStrainMap(const vpImage<unsigned char> &strainMap,
                     "usImageElastography::setStrainMap : the strainMap position is out of ultrasound image bounds !"));
   }
 
+  // the previous strain map region is restored to the ultrasound image if the new one does not cover it
+  if (m_strainMapSet && (heightPosition != m_heigthPosition || widthPosition != m_widthPosition ||
+                         strainMap.getHeight() != m_strainMap.getHeight() ||
+                         strainMap.getWidth() != m_strainMap.getWidth()))
+    computeUltrasoundRegion(m_heigthPosition, m_heigthPosition + m_strainMap.getHeight(), m_widthPosition,
+                            m_widthPosition + m_strainMap.getWidth());
+
   m_strainMap = strainMap;
   m_heigthPosition = heightPosition;
   m_widthPosition = widthPosition;
-  computeElastographyImage();
+  m_strainMapSet = true;
+  computeStrainRegion();
+}
+
+/**
+* Setter for the opacity of the strain colors : in the strain map region, the displayed color is opacity * strain color
+* + (1 - opacity) * ultrasound gray level.
+* @param opacity The opacity, in [0, 1] (1 by default : the ultrasound image is hidden by the strain map).
+*/
+void usImageElastography::setStrainOpacity(double opacity)
+{
+  if (opacity < 0.0 || opacity > 1.0)
+    throw(vpException(vpException::badValue, "usImageElastography::setStrainOpacity : opacity must be in [0, 1] !"));
+  m_strainOpacity = opacity;
+  updateBlendingTables();
+  if (m_strainMapSet)
+    computeStrainRegion();
 }
 
 /**
@@ -99,28 +169,108 @@ void usImageElastography::setStrainMap(const vpImage<unsigned char> &strainMap,
 */
 void usImageElastography::setUltrasoundImage(const vpImage<unsigned char> &ultrasoundImage)
 {
+  if (ultrasoundImage.getHeight() != m_elastoImage.getHeight() ||
+      ultrasoundImage.getWidth() != m_elastoImage.getWidth()) {
+    m_elastoImage.resize(ultrasoundImage.getHeight(), ultrasoundImage.getWidth(), vpRGBa(0, 0, 0, 255));
+    // the last strain map is kept only if it fits in the new image
+    m_strainMapSet = m_strainMapSet && ultrasoundImage.getHeight() >= m_strainMap.getHeight() + m_heigthPosition &&
+                     ultrasoundImage.getWidth() >= m_strainMap.getWidth() + m_widthPosition;
+  }
   m_ultrasoundImage = ultrasoundImage;
-  m_elastoImage.resize(m_ultrasoundImage.getHeight(), m_ultrasoundImage.getWidth(), vpRGBa(0, 0, 0, 255));
+  computeElastographyImage();
 }
 
+/**
+* Computes the whole elastography image : ultrasound image outside of the strain map region, and strain colors inside.
+*/
 void usImageElastography::computeElastographyImage()
 {
+  if (!m_strainMapSet) {
+    computeUltrasoundRegion(0, m_elastoImage.getHeight(), 0, m_elastoImage.getWidth());
+    return;
+  }
+
+  const unsigned int top = m_heigthPosition;
+  const unsigned int bottom = m_heigthPosition + m_strainMap.getHeight();
+  const unsigned int left = m_widthPosition;
+  const unsigned int right = m_widthPosition + m_strainMap.getWidth();
+  computeUltrasoundRegion(0, top, 0, m_elastoImage.getWidth());
+  computeUltrasoundRegion(bottom, m_elastoImage.getHeight(), 0, m_elastoImage.getWidth());
+  computeUltrasoundRegion(top, bottom, 0, left);
+  computeUltrasoundRegion(top, bottom, right, m_elastoImage.getWidth());
+  computeStrainRegion();
+}
+
+/**
+* Computes the strain map region of the elastography image, from the blending tables.
+*/
+void usImageElastography::computeStrainRegion()
+{
+  const unsigned int width = m_strainMap.getWidth();
+  const vpRGBa *colorMap = &m_colorMap[0];
+  const unsigned short *colorTerms = &m_colorTerms[0];
+  const unsigned short *grayTerms = &m_grayTerms[0];
+
 #ifdef VISP_HAVE_OPENMP
 #pragma omp parallel for
 #endif
-  for (int i = 0; i < (int)m_elastoImage.getHeight(); i++) {
-    for (unsigned int j = 0; j < m_elastoImage.getWidth(); j++) {
-      vpRGBa newColor;
-      // inside of the strainMap ROI
-      if (i >= (int)m_heigthPosition && i < (int)(m_heigthPosition + m_strainMap.getHeight()) && j >= m_widthPosition &&
-          j < m_widthPosition + m_strainMap.getWidth()) {
-        newColor.R = m_strainMap[i - m_heigthPosition][j - m_widthPosition];
-      } else { // oustide
-        newColor.R = m_ultrasoundImage[i][j];
-        newColor.G = m_ultrasoundImage[i][j];
-        newColor.B = m_ultrasoundImage[i][j];
+  for (int i = 0; i < (int)m_strainMap.getHeight(); i++) {
+    const unsigned char *strain = m_strainMap[i];
+    vpRGBa *out = m_elastoImage[i + m_heigthPosition] + m_widthPosition;
+    if (m_opacity == 256) {
+      for (unsigned int j = 0; j < width; j++)
+        out[j] = colorMap[strain[j]];
+    } else {
+      const unsigned char *gray = m_ultrasoundImage[i + m_heigthPosition] + m_widthPosition;
+      for (unsigned int j = 0; j < width; j++) {
+        const unsigned short *color = colorTerms + 3 * strain[j];
+        unsigned short background = grayTerms[gray[j]];
+        out[j].R = (unsigned char)((color[0] + background) >> 8);
+        out[j].G = (unsigned char)((color[1] + background) >> 8);
+        out[j].B = (unsigned char)((color[2] + background) >> 8);
+        out[j].A = 255;
       }
-      m_elastoImage[i][j] = newColor;
     }
   }
 }
+
+/**
+* Copies the ultrasound image in a region of the elastography image (gray levels).
+* @param top First row of the region.
+* @param bottom Row after the last row of the region.
+* @param left First column of the region.
+* @param right Column after the last column of the region.
+*/
+void usImageElastography::computeUltrasoundRegion(unsigned int top, unsigned int bottom, unsigned int left,
+                                                  unsigned int right)
+{
+  const vpRGBa *grayColors = &m_grayColors[0];
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = (int)top; i < (int)bottom; i++) {
+    const unsigned char *gray = m_ultrasoundImage[i];
+    vpRGBa *out = m_elastoImage[i];
+    for (unsigned int j = left; j < right; j++)
+      out[j] = grayColors[gray[j]];
+  }
+}
+
+/**
+* Computes the tables used by the blending, from the color map and the opacity. The opacity is rounded to a multiple of
+* 1/256.
+*/
+void usImageElastography::updateBlendingTables()
+{
+  m_opacity = (unsigned int)vpMath::round(m_strainOpacity * 256.0);
+  m_colorTerms.resize(3 * 256);
+  m_grayTerms.resize(256);
+  m_grayColors.resize(256);
+  for (unsigned int s = 0; s < 256; s++) {
+    m_colorTerms[3 * s] = (unsigned short)(m_colorMap[s].R * m_opacity);
+    m_colorTerms[3 * s + 1] = (unsigned short)(m_colorMap[s].G * m_opacity);
+    m_colorTerms[3 * s + 2] = (unsigned short)(m_colorMap[s].B * m_opacity);
+    m_grayTerms[s] = (unsigned short)(s * (256 - m_opacity));
+    m_grayColors[s] = vpRGBa(s, s, s, 255);
+  }
+}
@@ -149,7 +149,7 @@ vpMatrix usSignalProcessing::Difference(const usImageRF2D<short int> &A, const u
 * @param newH Output matrix height.
 * @return The resulting matrix of the interpolation.
 */
-vpMatrix usSignalProcessing::BilinearInterpolation(vpMatrix In, uint newW, uint newH)
+vpMatrix usSignalProcessing::BilinearInterpolation(const vpMatrix &In, uint newW, uint newH)
 {
   vpMatrix ivec(newH, newW);
   double tx = (double)(In.getCols() - 1.0) / newW;
@@ -185,7 +185,7 @@ vpMatrix usSignalProcessing::BilinearInterpolation(vpMatrix In, uint newW, uint
 * @param matrix2 Second input matrix to multiply.
 * @return The resulting matrix of the product.
 */
-vpMatrix usSignalProcessing::HadamardProd(vpMatrix matrix1, vpMatrix matrix2)
+vpMatrix usSignalProcessing::HadamardProd(const vpMatrix &matrix1, const vpMatrix &matrix2)
 {
   assert(matrix1.getRows() == matrix2.getRows());
   assert(matrix1.getCols() == matrix2.getCols());
@@ -0,0 +1,549 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/*!
+  \example perfUsElastography.cpp
+
+  USTK elastography benchmark.
+
+  Synthetic pre and post-compressed RF frames are simulated from a known axial strain field (layered or inclusion
+  phantom), then the strain map is computed for each configuration of motion estimator, LSQ strain window percentage and
+  optical flow window step. For each configuration, one comma separated line gives the computation time per frame, and
+  the accuracy of the strain map :
+  - strain_rmse : RMS error between the strain map and the true strain, both normalized by their maximum (in % of the
+    full scale),
+  - strain_correlation : correlation coefficient between the strain map and the true strain,
+  - snr : elastographic SNR (mean / standard deviation of the strain map in a homogeneous background region),
+  - cnr : elastographic CNR (2 (mean_t - mean_b)^2 / (var_t + var_b), between the target region - the middle layer or the
+    inclusion - and the background).
+
+  The LSQ strain kernel is not centered on its window (see usStrainEstimator) : part of the strain map follows the
+  axial displacement, which grows with the depth, so even a uniform strain gives a strain map growing with the depth.
+  The default configuration runs in a few seconds, this benchmark being run with the tests.
+*/
+
+#include <iostream>
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpTime.h>
+#include <visp3/core/vpUniRand.h>
+#include <visp3/io/vpParseArgv.h>
+#include <visp3/ustk_elastography/usElastography.h>
+
+/* -------------------------------------------------------------------------- */
+/*                         COMMAND LINE OPTIONS                               */
+/* -------------------------------------------------------------------------- */
+
+// List of allowed command line options
+#define GETOPTARGS "cde:hl:n:o:p:r:s:w:"
+
+struct usBenchmarkOptions {
+  std::string phantoms;
+  std::string estimators;
+  std::string lsqPercentages;
+  std::string windowSteps;
+  unsigned int frames;
+  unsigned int rows;
+  unsigned int scanlines;
+  std::string output;
+};
+
+void usage(const char *name, const char *badparam, const usBenchmarkOptions &options);
+bool getOptions(int argc, const char **argv, usBenchmarkOptions &options);
+
+/*!
+
+Print the program options.
+
+\param name : Program name.
+\param badparam : Bad parameter name.
+\param options : Default options.
+
+ */
+void usage(const char *name, const char *badparam, const usBenchmarkOptions &options)
+{
+  fprintf(stdout, "\n\
+Benchmark of the elastography on synthetic compression phantoms.\n\
+\n\
+SYNOPSIS\n\
+  %s [-p <phantoms>] [-e <estimators>] [-l <LSQ percentages>]\n\
+     [-s <window steps>] [-n <frames>] [-r <rows>] [-w <scanlines>]\n\
+     [-o <csv file>] [-h]\n",
+          name);
+
+  fprintf(stdout, "\n\
+OPTIONS:                                               Default\n\
+  -p <phantoms>                                        %s\n\
+     Comma separated phantoms : layered, inclusion.\n\
+\n\
+  -e <estimators>                                      %s\n\
+     Comma separated motion estimators : OF, BMA_TAYLOR.\n\
+\n\
+  -l <LSQ percentages>                                 %s\n\
+     Comma separated LSQ strain window lengths, in\n\
+     fraction of the ROI height.\n\
+\n\
+  -s <window steps>                                    %s\n\
+     Comma separated optical flow window steps.\n\
+\n\
+  -n <frames>                                          %u\n\
+     Number of timed frames per configuration.\n\
+\n\
+  -r <rows>                                            %u\n\
+     Number of RF samples per scanline.\n\
+\n\
+  -w <scanlines>                                       %u\n\
+     Number of scanlines.\n\
+\n\
+  -o <csv file>\n\
+     Write the results in this file instead of the\n\
+     standard output.\n\
+\n\
+  -h\n\
+     Print the help.\n\n",
+          options.phantoms.c_str(), options.estimators.c_str(), options.lsqPercentages.c_str(),
+          options.windowSteps.c_str(), options.frames, options.rows, options.scanlines);
+
+  if (badparam) {
+    fprintf(stderr, "ERROR: \n");
+    fprintf(stderr, "\nBad parameter [%s]\n", badparam);
+  }
+}
+
+/*!
+  Set the program options.
+
+  \param argc : Command line number of parameters.
+  \param argv : Array of command line parameters.
+  \param options : Benchmark options.
+  \return false if the program has to be stopped, true otherwise.
+*/
+bool getOptions(int argc, const char **argv, usBenchmarkOptions &options)
+{
+  const char *optarg_;
+  int c;
+  while ((c = vpParseArgv::parse(argc, argv, GETOPTARGS, &optarg_)) > 1) {
+
+    switch (c) {
+    case 'e':
+      options.estimators = optarg_;
+      break;
+    case 'l':
+      options.lsqPercentages = optarg_;
+      break;
+    case 'n':
+      options.frames = (unsigned int)atoi(optarg_);
+      break;
+    case 'o':
+      options.output = optarg_;
+      break;
+    case 'p':
+      options.phantoms = optarg_;
+      break;
+    case 'r':
+      options.rows = (unsigned int)atoi(optarg_);
+      break;
+    case 's':
+      options.windowSteps = optarg_;
+      break;
+    case 'w':
+      options.scanlines = (unsigned int)atoi(optarg_);
+      break;
+    case 'h':
+      usage(argv[0], NULL, options);
+      return false;
+      break;
+
+    case 'c':
+    case 'd':
+      break;
+
+    default:
+      usage(argv[0], optarg_, options);
+      return false;
+      break;
+    }
+  }
+
+  if ((c == 1) || (c == -1)) {
+    // standalone param or error
+    usage(argv[0], NULL, options);
+    std::cerr << "ERROR: " << std::endl;
+    std::cerr << "  Bad argument " << optarg_ << std::endl << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               PHANTOMS                                     */
+/* -------------------------------------------------------------------------- */
+
+// regions used for the SNR and CNR
+#define REGION_NONE 0
+#define REGION_TARGET 1
+#define REGION_BACKGROUND 2
+
+/*!
+  Split a comma separated list.
+*/
+std::vector<std::string> splitList(const std::string &list)
+{
+  std::vector<std::string> items;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    if (!item.empty())
+      items.push_back(item);
+  return items;
+}
+
+/*!
+  Axial strain field of a phantom, for a compression applied from the probe (row 0), and the regions where the SNR and
+  CNR are measured.
+
+  - layered : three horizontal layers with frame to frame strains of 0.5 %, 0.2 % (hard layer) and 0.8 %. The target is
+  the center of the middle layer, the background the center of the top layer.
+  - inclusion : hard elliptic inclusion (0.15 %) in the center of a 0.5 % background.
+
+  \param phantom : Phantom name.
+  \param strain : Output strain field, the size of which gives the size of the phantom.
+  \param regions : Output regions (REGION_NONE, REGION_TARGET, REGION_BACKGROUND).
+*/
+void createPhantom(const std::string &phantom, vpImage<double> &strain, vpImage<unsigned char> &regions)
+{
+  const unsigned int height = strain.getHeight();
+  const unsigned int width = strain.getWidth();
+  regions.resize(height, width, REGION_NONE);
+
+  if (phantom == "layered") {
+    for (unsigned int i = 0; i < height; i++) {
+      unsigned int layer = (3 * i) / height;
+      double inLayer = (3.0 * i) / height - layer; // position in the layer, in [0, 1[
+      double layerStrain = (layer == 0) ? 0.001 : ((layer == 1) ? 0.0004 : 0.0016);
+      unsigned char region = REGION_NONE;
+      if (inLayer > 0.2 && inLayer < 0.8)
+        region = (layer == 1) ? REGION_TARGET : ((layer == 0) ? REGION_BACKGROUND : REGION_NONE);
+      for (unsigned int j = 0; j < width; j++) {
+        strain[i][j] = layerStrain;
+        regions[i][j] = region;
+      }
+    }
+  } else if (phantom == "inclusion") {
+    for (unsigned int i = 0; i < height; i++) {
+      for (unsigned int j = 0; j < width; j++) {
+        double di = (i - 0.5 * height) / (height / 6.0);
+        double dj = (j - 0.5 * width) / (width / 6.0);
+        double r = sqrt(di * di + dj * dj);
+        strain[i][j] = (r < 1.0) ? 0.0003 : 0.001;
+        regions[i][j] = (r < 0.7) ? REGION_TARGET : ((r > 1.3) ? REGION_BACKGROUND : REGION_NONE);
+      }
+    }
+  } else {
+    throw(vpException(vpException::badValue, "unknown phantom " + phantom));
+  }
+}
+
+/*!
+  Add a RF pulse (5 MHz at 40 MHz sampling frequency : 8 samples per period, gaussian envelope) to a scanline.
+*/
+void addPulse(double *scanline, unsigned int height, double center, double amplitude)
+{
+  const double samplesPerPeriod = 8.0;
+  const double sigma = 1.5 * samplesPerPeriod;
+  int first = std::max(0, (int)ceil(center - 3.0 * sigma));
+  int last = std::min((int)height - 1, (int)floor(center + 3.0 * sigma));
+  for (int i = first; i <= last; i++) {
+    double t = i - center;
+    scanline[i] += amplitude * cos(2.0 * M_PI * t / samplesPerPeriod) * exp(-t * t / (2.0 * sigma * sigma));
+  }
+}
+
+/*!
+  Simulate the pre and post-compressed RF frames of a phantom : random scatterers (2 per 4 samples of a scanline) are
+  convolved with the RF pulse and a lateral gaussian beam profile, before and after the axial displacement given by the
+  integral of the strain from the probe.
+
+  \param strain : Axial strain field.
+  \param seed : Seed of the scatterer positions.
+  \param pre : Output pre-compressed frame.
+  \param post : Output post-compressed frame.
+*/
+void simulateRF(const vpImage<double> &strain, long seed, usImageRF2D<short int> &pre, usImageRF2D<short int> &post)
+{
+  const unsigned int height = strain.getHeight();
+  const unsigned int width = strain.getWidth();
+
+  // axial displacement of the top of each sample (in samples), the probe being fixed
+  std::vector<double> displacement((height + 1) * width, 0.0);
+  for (unsigned int j = 0; j < width; j++) {
+    double *u = &displacement[j * (height + 1)];
+    for (unsigned int i = 0; i < height; i++)
+      u[i + 1] = u[i] - strain[i][j];
+  }
+
+  std::vector<double> preRF(height * width, 0.0);
+  std::vector<double> postRF(height * width, 0.0);
+  const double lateralSigma = 0.8;
+  vpUniRand random(seed);
+  const unsigned int scatterers = height * width / 2;
+  for (unsigned int k = 0; k < scatterers; k++) {
+    double z = random() * height;
+    double x = random() * width;
+    double amplitude = 2.0 * random() - 1.0;
+
+    unsigned int row = std::min(height - 1, (unsigned int)z);
+    const double *u = &displacement[std::min(width - 1, (unsigned int)x) * (height + 1)];
+    double zPost = z + u[row] + (z - row) * (u[row + 1] - u[row]);
+
+    int firstCol = std::max(0, (int)ceil(x - 0.5 - 3.0 * lateralSigma));
+    int lastCol = std::min((int)width - 1, (int)floor(x - 0.5 + 3.0 * lateralSigma));
+    for (int j = firstCol; j <= lastCol; j++) {
+      double dx = j + 0.5 - x;
+      double weight = amplitude * exp(-dx * dx / (2.0 * lateralSigma * lateralSigma));
+      addPulse(&preRF[j * height], height, z, weight);
+      addPulse(&postRF[j * height], height, zPost, weight);
+    }
+  }
+
+  double maxAbs = 0.0;
+  for (unsigned int k = 0; k < preRF.size(); k++)
+    maxAbs = std::max(maxAbs, std::max(fabs(preRF[k]), fabs(postRF[k])));
+  double scale = (maxAbs > 0.0) ? 8000.0 / maxAbs : 0.0;
+
+  pre.resize(height, width);
+  post.resize(height, width);
+  for (unsigned int j = 0; j < width; j++) {
+    for (unsigned int i = 0; i < height; i++) {
+      pre(i, j, (short int)vpMath::round(scale * preRF[j * height + i]));
+      post(i, j, (short int)vpMath::round(scale * postRF[j * height + i]));
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               METRICS                                      */
+/* -------------------------------------------------------------------------- */
+
+struct usStrainMetrics {
+  double rmse;
+  double correlation;
+  double snr;
+  double cnr;
+};
+
+/*!
+  Compare a strain map of the ROI with the true strain. The strain map can be smaller than the ROI (optical flow
+  filtering, LSQ windows), it is centered in the ROI.
+
+  \param strainMap : Strain map computed by usElastography (without decimation).
+  \param strain : True strain of the whole frame.
+  \param regions : Target and background regions of the whole frame.
+  \param roiTop : First row of the ROI.
+  \param roiLeft : First column of the ROI.
+  \param roiHeight : Height of the ROI.
+  \param roiWidth : Width of the ROI.
+  \return The metrics.
+*/
+usStrainMetrics evaluate(const vpImage<unsigned char> &strainMap, const vpImage<double> &strain,
+                         const vpImage<unsigned char> &regions, unsigned int roiTop, unsigned int roiLeft,
+                         unsigned int roiHeight, unsigned int roiWidth)
+{
+  const unsigned int top = roiTop + (roiHeight - strainMap.getHeight()) / 2;
+  const unsigned int left = roiLeft + (roiWidth - strainMap.getWidth()) / 2;
+
+  double maxStrain = 0.0;
+  for (unsigned int i = 0; i < strainMap.getHeight(); i++)
+    for (unsigned int j = 0; j < strainMap.getWidth(); j++)
+      maxStrain = std::max(maxStrain, fabs(strain[top + i][left + j]));
+
+  double n = 0.0, sumE = 0.0, sumT = 0.0, sumEE = 0.0, sumTT = 0.0, sumET = 0.0, sumErr2 = 0.0;
+  double count[3] = {0.0, 0.0, 0.0}, sum[3] = {0.0, 0.0, 0.0}, sum2[3] = {0.0, 0.0, 0.0};
+  for (unsigned int i = 0; i < strainMap.getHeight(); i++) {
+    for (unsigned int j = 0; j < strainMap.getWidth(); j++) {
+      double e = strainMap[i][j] / 254.0;
+      double t = fabs(strain[top + i][left + j]) / maxStrain;
+      n += 1.0;
+      sumE += e;
+      sumT += t;
+      sumEE += e * e;
+      sumTT += t * t;
+      sumET += e * t;
+      sumErr2 += (e - t) * (e - t);
+      unsigned char region = regions[top + i][left + j];
+      count[region] += 1.0;
+      sum[region] += strainMap[i][j];
+      sum2[region] += strainMap[i][j] * strainMap[i][j];
+    }
+  }
+
+  usStrainMetrics metrics;
+  metrics.rmse = 100.0 * sqrt(sumErr2 / n);
+  double covariance = sumET / n - (sumE / n) * (sumT / n);
+  double varE = sumEE / n - (sumE / n) * (sumE / n);
+  double varT = sumTT / n - (sumT / n) * (sumT / n);
+  metrics.correlation = (varE > 0.0 && varT > 0.0) ? covariance / sqrt(varE * varT) : 0.0;
+
+  double meanT = sum[REGION_TARGET] / count[REGION_TARGET];
+  double meanB = sum[REGION_BACKGROUND] / count[REGION_BACKGROUND];
+  double varianceT = sum2[REGION_TARGET] / count[REGION_TARGET] - meanT * meanT;
+  double varianceB = sum2[REGION_BACKGROUND] / count[REGION_BACKGROUND] - meanB * meanB;
+  metrics.snr = (varianceB > 0.0) ? meanB / sqrt(varianceB) : 0.0;
+  metrics.cnr = (varianceT + varianceB > 0.0) ? 2.0 * (meanT - meanB) * (meanT - meanB) / (varianceT + varianceB) : 0.0;
+  return metrics;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               MAIN FUNCTION                                */
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, const char **argv)
+{
+  try {
+    usBenchmarkOptions options;
+    options.phantoms = "layered,inclusion";
+    options.estimators = "OF,BMA_TAYLOR";
+    options.lsqPercentages = "0.02,0.05,0.1";
+    options.windowSteps = "0.75";
+    options.frames = 3;
+    options.rows = 1024;
+    options.scanlines = 64;
+
+    // Read the command line options
+    if (getOptions(argc, argv, options) == false) {
+      exit(-1);
+    }
+    if (options.frames == 0 || options.rows < 64 || options.scanlines < 16) {
+      std::cerr << "ERROR: at least 1 frame, 64 rows and 16 scanlines are needed" << std::endl;
+      exit(-1);
+    }
+
+    std::ofstream file;
+    if (!options.output.empty()) {
+      file.open(options.output.c_str());
+      if (!file.is_open()) {
+        std::cerr << "ERROR: cannot open " << options.output << std::endl;
+        exit(-1);
+      }
+    }
+    std::ostream &csv = options.output.empty() ? std::cout : file;
+
+    // ROI : central 3/4 of the frame
+    const unsigned int roiTop = options.rows / 8;
+    const unsigned int roiLeft = options.scanlines / 8;
+    const unsigned int roiHeight = options.rows - 2 * roiTop;
+    const unsigned int roiWidth = options.scanlines - 2 * roiLeft;
+
+    csv << "phantom,estimator,lsq_percentage,window_step,rows,scanlines,frames,ms_per_frame,strain_rmse,"
+           "strain_correlation,snr,cnr"
+        << std::endl;
+
+    std::vector<std::string> phantoms = splitList(options.phantoms);
+    std::vector<std::string> estimators = splitList(options.estimators);
+    std::vector<std::string> lsqPercentages = splitList(options.lsqPercentages);
+    std::vector<std::string> windowSteps = splitList(options.windowSteps);
+
+    for (unsigned int p = 0; p < phantoms.size(); p++) {
+      vpImage<double> strain(options.rows, options.scanlines);
+      vpImage<unsigned char> regions;
+      createPhantom(phantoms[p], strain, regions);
+      usImageRF2D<short int> pre, post;
+      simulateRF(strain, 42, pre, post);
+
+      for (unsigned int e = 0; e < estimators.size(); e++) {
+        usElastography::MotionEstimator estimator;
+        if (estimators[e] == "OF")
+          estimator = usElastography::OF;
+        else if (estimators[e] == "BMA_TAYLOR")
+          estimator = usElastography::BMA_TAYLOR;
+        else
+          throw(vpException(vpException::badValue, "unknown motion estimator " + estimators[e]));
+
+        for (unsigned int l = 0; l < lsqPercentages.size(); l++) {
+          // the window step is only used by the optical flow
+          unsigned int stepNumber = (estimator == usElastography::OF) ? (unsigned int)windowSteps.size() : 1;
+          for (unsigned int s = 0; s < stepNumber; s++) {
+            usElastography elastography;
+            elastography.setMotionEstimator(estimator);
+            elastography.setDecimationFactor(1);
+            elastography.setLSQpercentage(atof(lsqPercentages[l].c_str()));
+            if (estimator == usElastography::OF)
+              elastography.setWindowStep(atof(windowSteps[s].c_str()));
+            elastography.setROI(roiLeft, roiTop, roiWidth, roiHeight);
+
+            // first frame not timed : buffers allocation
+            vpImage<unsigned char> strainMap = elastography.run(pre, post);
+            double t = vpTime::measureTimeMs();
+            for (unsigned int f = 0; f < options.frames; f++)
+              strainMap = elastography.run(pre, post);
+            double msPerFrame = (vpTime::measureTimeMs() - t) / options.frames;
+
+            if (strainMap.getWidth() > roiWidth || strainMap.getHeight() > roiHeight)
+              throw(vpException(vpException::dimensionError, "unexpected strain map size"));
+            usStrainMetrics metrics = evaluate(strainMap, strain, regions, roiTop, roiLeft, roiHeight, roiWidth);
+
+            csv << phantoms[p] << "," << estimators[e] << "," << lsqPercentages[l] << ","
+                << ((estimator == usElastography::OF) ? windowSteps[s] : std::string("")) << "," << options.rows
+                << "," << options.scanlines << "," << options.frames << "," << msPerFrame << "," << metrics.rmse
+                << "," << metrics.correlation << "," << metrics.snr << "," << metrics.cnr << std::endl;
+          }
+        }
+      }
+    }
+    return 0;
+  } catch (const vpException &e) {
+    std::cerr << "Catch an exception: " << e.getMessage() << std::endl;
+    return 1;
+  }
+}
+
+#else
+int main()
+{
+  std::cout << "You should intall FFTW to run this test" << std::endl;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,193 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Author:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+#include <iostream>
+
+/*!
+  \example testUsBlockMatching.cpp
+
+  Test of the block matching on synthetic RF images, the post-compressed image being the pre-compressed one shifted
+  along the scanlines :
+  - an integer shift is recovered exactly by every metric, with and without early termination,
+  - a sub-sample shift is recovered by the Taylor refinement,
+  - the coarse-to-fine search gives the same displacements as the exhaustive search.
+*/
+
+#include <iostream>
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpUniRand.h>
+#include <visp3/ustk_elastography/usBlockMatching.h>
+
+/*!
+  RF images of band-limited scanlines (sums of sinusoids, random on each scanline), the post-compressed scanlines being
+  the pre-compressed ones delayed by a given number of samples.
+*/
+void simulateRF(unsigned int height, unsigned int width, double shift, usImageRF2D<short int> &pre,
+                usImageRF2D<short int> &post)
+{
+  vpUniRand random(11);
+  const unsigned int components = 6;
+  pre.resize(height, width);
+  post.resize(height, width);
+  for (unsigned int j = 0; j < width; j++) {
+    std::vector<double> frequency(components), phase(components), amplitude(components);
+    for (unsigned int k = 0; k < components; k++) {
+      frequency[k] = 0.3 + 0.4 * random(); // radians per sample, a carrier well below the Nyquist frequency
+      phase[k] = 2.0 * M_PI * random();
+      amplitude[k] = 1000.0 * (0.5 + random());
+    }
+    for (unsigned int i = 0; i < height; i++) {
+      double preValue = 0.0, postValue = 0.0;
+      for (unsigned int k = 0; k < components; k++) {
+        preValue += amplitude[k] * sin(frequency[k] * i + phase[k]);
+        postValue += amplitude[k] * sin(frequency[k] * (i - shift) + phase[k]);
+      }
+      pre(i, j, (short int)vpMath::round(preValue));
+      post(i, j, (short int)vpMath::round(postValue));
+    }
+  }
+}
+
+/*!
+  Largest difference between the displacements and the expected values.
+*/
+double maxError(const vpMatrix &M, double expected)
+{
+  double error = 0.0;
+  for (unsigned int i = 0; i < M.getRows(); i++)
+    for (unsigned int j = 0; j < M.getCols(); j++)
+      error = std::max(error, std::fabs(M[i][j] - expected));
+  return error;
+}
+
+/*!
+  Tells if two displacement maps are identical.
+*/
+bool equal(const vpMatrix &A, const vpMatrix &B)
+{
+  if (A.getRows() != B.getRows() || A.getCols() != B.getCols())
+    return false;
+  for (unsigned int i = 0; i < A.getRows(); i++)
+    for (unsigned int j = 0; j < A.getCols(); j++)
+      if (A[i][j] != B[i][j])
+        return false;
+  return true;
+}
+
+int main()
+{
+  const unsigned int height = 400;
+  const unsigned int width = 16;
+  bool success = true;
+
+  usImageRF2D<short int> pre, post;
+
+  // integer shift : the candidate matches exactly, and the refinement is null
+  simulateRF(height, width, 7.0, pre, post);
+  usBlockMatching::usMatchingMetric metrics[] = {usBlockMatching::SAD_METRIC, usBlockMatching::SSD_METRIC,
+                                                 usBlockMatching::NCC_METRIC};
+  const char *metricNames[] = {"SAD", "SSD", "NCC"};
+  for (unsigned int m = 0; m < 3; m++) {
+    for (unsigned int earlyTermination = 0; earlyTermination < 2; earlyTermination++) {
+      usBlockMatching blockMatching;
+      blockMatching.setSearchRange(2, 30);
+      blockMatching.setMetric(metrics[m]);
+      blockMatching.setEarlyTermination(earlyTermination == 1);
+      blockMatching.run(pre, post);
+      if (blockMatching.getV().getRows() == 0 || blockMatching.getV().getCols() == 0) {
+        std::cout << "No block matched" << std::endl;
+        return 1;
+      }
+      if (maxError(blockMatching.getV(), -7.0) != 0.0 || maxError(blockMatching.getU(), 0.0) != 0.0) {
+        std::cout << metricNames[m] << (earlyTermination ? " with" : " without")
+                  << " early termination : integer shift not recovered, axial error "
+                  << maxError(blockMatching.getV(), -7.0) << std::endl;
+        success = false;
+      }
+    }
+  }
+
+  // sub-sample shifts, without median filter : every block is refined
+  double shifts[] = {7.0, 7.3, 12.5, 20.8};
+  for (unsigned int s = 0; s < 4; s++) {
+    simulateRF(height, width, shifts[s], pre, post);
+
+    usBlockMatching exhaustive;
+    exhaustive.setSearchRange(2, 30);
+    exhaustive.setMedianFilterSize(1, 1);
+    exhaustive.run(pre, post);
+    double axialError = maxError(exhaustive.getV(), -shifts[s]);
+    double lateralError = maxError(exhaustive.getU(), 0.0);
+    if (axialError > 0.1 || lateralError > 0.1) {
+      std::cout << "Shift " << shifts[s] << " : errors " << axialError << " (axial), " << lateralError << " (lateral)"
+                << std::endl;
+      success = false;
+    }
+
+    // an odd search height starts the blocks on odd samples
+    for (unsigned int searchHeight = 30; searchHeight <= 31; searchHeight++) {
+      exhaustive.setSearchRange(2, searchHeight);
+      exhaustive.run(pre, post);
+      usBlockMatching coarseToFine;
+      coarseToFine.setSearchRange(2, searchHeight);
+      coarseToFine.setMedianFilterSize(1, 1);
+      coarseToFine.setCoarseToFine(true);
+      coarseToFine.run(pre, post);
+      if (!equal(coarseToFine.getU(), exhaustive.getU()) || !equal(coarseToFine.getV(), exhaustive.getV())) {
+        std::cout << "Shift " << shifts[s] << ", search height " << searchHeight
+                  << " : the coarse-to-fine search differs from the exhaustive search" << std::endl;
+        success = false;
+      }
+    }
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Test succeeded" << std::endl;
+  return 0;
+}
+
+#else
+int main()
+{
+  std::cout << "You should intall FFTW to run this test" << std::endl;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,211 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Author:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+#include <iostream>
+
+/*!
+  \example testUsConvolution2d.cpp
+
+  Test of the valid 2D convolution, against a naive summation over the kernel :
+  - the direct, separable and Fourier domain methods (and the automatic choice) give the same result, for separable and
+    non-separable kernels,
+  - rank 1 kernels are detected as separable, kernels close to rank 1 are not,
+  - the kernel cache and the fftw buffers follow the changes of kernel, of input size and of batch size.
+*/
+
+#include <iostream>
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpUniRand.h>
+#include <visp3/ustk_elastography/usConvolution2d.h>
+
+/*!
+  Valid convolution, summed over the kernel.
+*/
+vpMatrix naiveConvolution(const vpMatrix &A, const vpMatrix &K)
+{
+  unsigned int Bm = K.getRows(), Bn = K.getCols();
+  vpMatrix C(A.getRows() - Bm + 1, A.getCols() - Bn + 1);
+  for (unsigned int l = 0; l < C.getRows(); l++)
+    for (unsigned int k = 0; k < C.getCols(); k++)
+      for (unsigned int p = 0; p < Bm; p++)
+        for (unsigned int q = 0; q < Bn; q++)
+          C[l][k] += A[l + p][k + q] * K[Bm - 1 - p][Bn - 1 - q];
+  return C;
+}
+
+vpMatrix randomMatrix(unsigned int rows, unsigned int cols, vpUniRand &random)
+{
+  vpMatrix M(rows, cols);
+  for (unsigned int i = 0; i < rows; i++)
+    for (unsigned int j = 0; j < cols; j++)
+      M[i][j] = 2.0 * random() - 1.0;
+  return M;
+}
+
+vpMatrix outerProduct(const std::vector<double> &column, const std::vector<double> &row)
+{
+  vpMatrix M((unsigned int)column.size(), (unsigned int)row.size());
+  for (unsigned int i = 0; i < M.getRows(); i++)
+    for (unsigned int j = 0; j < M.getCols(); j++)
+      M[i][j] = column[i] * row[j];
+  return M;
+}
+
+/*!
+  Checks the size of a convolution and its difference with the naive convolution.
+*/
+bool check(const vpMatrix &C, const vpMatrix &expected, const std::string &name)
+{
+  if (C.getRows() != expected.getRows() || C.getCols() != expected.getCols()) {
+    std::cout << name << " : wrong size " << C.getRows() << "x" << C.getCols() << std::endl;
+    return false;
+  }
+  double maxError = 0.0;
+  for (unsigned int i = 0; i < C.getRows(); i++)
+    for (unsigned int j = 0; j < C.getCols(); j++)
+      maxError = std::max(maxError, std::fabs(C[i][j] - expected[i][j]));
+  if (maxError > 1e-9) {
+    std::cout << name << " : error " << maxError << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main()
+{
+  bool success = true;
+  vpUniRand random(7);
+  vpMatrix A = randomMatrix(24, 20, random);
+
+  std::vector<double> gaussianRow(7), gaussianColumn(5);
+  for (int q = 0; q < 7; q++)
+    gaussianRow[q] = std::exp(-(q - 3) * (q - 3) / 4.0);
+  for (int p = 0; p < 5; p++)
+    gaussianColumn[p] = std::exp(-(p - 2) * (p - 2) / 2.0);
+  double signedColumn[] = {1.0, -2.0, 0.0, 3.0};
+  double signedRow[] = {0.0, 0.5, -1.0};
+
+  std::vector<vpMatrix> kernels;
+  std::vector<std::string> names;
+  std::vector<bool> separable;
+  kernels.push_back(outerProduct(gaussianColumn, gaussianRow));
+  names.push_back("gaussian");
+  separable.push_back(true);
+  // rank 1 with negative and null coefficients : the pivot must not be a null coefficient
+  kernels.push_back(outerProduct(std::vector<double>(signedColumn, signedColumn + 4),
+                                 std::vector<double>(signedRow, signedRow + 3)));
+  names.push_back("signed rank 1");
+  separable.push_back(true);
+  kernels.push_back(kernels.front());
+  kernels.back()[1][4] += 1e-6;
+  names.push_back("perturbed gaussian");
+  separable.push_back(false);
+  vpMatrix identity(3, 3);
+  identity[0][0] = identity[1][1] = identity[2][2] = 1.0;
+  kernels.push_back(identity);
+  names.push_back("identity");
+  separable.push_back(false);
+  kernels.push_back(randomMatrix(9, 11, random));
+  names.push_back("random");
+  separable.push_back(false);
+  kernels.push_back(randomMatrix(24, 1, random));
+  names.push_back("full height column");
+  separable.push_back(true);
+
+  usConvolution2d::usConvolutionMethod methods[] = {usConvolution2d::AUTO_METHOD, usConvolution2d::DIRECT_METHOD,
+                                                   usConvolution2d::SEPARABLE_METHOD, usConvolution2d::FFT_METHOD};
+  const char *methodNames[] = {"auto", "direct", "separable", "fft"};
+
+  // the same convolution object goes through every kernel and method : the cached kernel must follow the changes
+  usConvolution2d convolution;
+  for (unsigned int k = 0; k < kernels.size(); k++) {
+    vpMatrix expected = naiveConvolution(A, kernels.at(k));
+    for (unsigned int m = 0; m < 4; m++) {
+      convolution.setMethod(methods[m]);
+      success &= check(convolution.run(A, kernels.at(k)), expected, names.at(k) + " kernel, " + methodNames[m]);
+    }
+    if (convolution.isKernelSeparable() != separable.at(k)) {
+      std::cout << names.at(k) << " kernel should" << (separable.at(k) ? "" : " not") << " be detected as separable"
+                << std::endl;
+      success = false;
+    }
+  }
+
+  // batches of different sizes, and a new input size, with the same kernel
+  const vpMatrix &kernel = kernels.front();
+  for (unsigned int m = 0; m < 4; m++) {
+    convolution.setMethod(methods[m]);
+    for (unsigned int batchSize = 1; batchSize <= 3; batchSize++) {
+      unsigned int rows = 16 + 4 * batchSize, cols = 12 + batchSize;
+      std::vector<vpMatrix> inputs;
+      for (unsigned int b = 0; b < batchSize; b++)
+        inputs.push_back(randomMatrix(rows, cols, random));
+      std::vector<const vpMatrix *> batch;
+      for (unsigned int b = 0; b < batchSize; b++)
+        batch.push_back(&inputs.at(b));
+      std::vector<vpMatrix> results;
+      convolution.run(batch, kernel, results);
+      for (unsigned int b = 0; b < batchSize; b++)
+        success &= check(results.at(b), naiveConvolution(inputs.at(b), kernel),
+                         std::string("batch of ") + std::to_string(batchSize) + ", " + methodNames[m]);
+    }
+  }
+
+  // a kernel larger than the input is rejected
+  try {
+    convolution.run(randomMatrix(4, 4, random), kernel);
+    std::cout << "A kernel larger than the input should be rejected" << std::endl;
+    success = false;
+  } catch (const vpException &) {
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Test succeeded" << std::endl;
+  return 0;
+}
+
+#else
+int main()
+{
+  std::cout << "You should intall FFTW to run this test" << std::endl;
+  return 0;
+}
+
+#endif
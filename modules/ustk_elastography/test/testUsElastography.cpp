@@ -34,6 +34,9 @@
 
 #if defined(USTK_HAVE_FFTW)
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <visp3/io/vpImageIo.h>
 #include <visp3/ustk_core/usImageIo.h>
 #include <visp3/ustk_elastography/usElastography.h>
@@ -65,11 +68,26 @@ int main()
       us::getDataSetPath() + std::string("/ustk-tests-groudTruth/testElasto_imgRFElasto12&15_ROI-40-2500-50-500.png");
   vpImageIo::read(groundTruthStrainImage, groundTruthFileName.c_str());
 
-  // compare
-  if (strainImage == groundTruthStrainImage)
+  // compare : the optical flow is computed in single precision, while the ground truth was computed in double
+  // precision : a pixel whose 254 * |strain| / max|strain| value is close to an integer may be truncated to the
+  // neighbouring grey level, so a difference of one grey level is accepted
+  if (strainImage.getHeight() != groundTruthStrainImage.getHeight() ||
+      strainImage.getWidth() != groundTruthStrainImage.getWidth()) {
+    std::cout << "Test failed : strain map of " << strainImage.getHeight() << " x " << strainImage.getWidth()
+              << ", ground truth of " << groundTruthStrainImage.getHeight() << " x "
+              << groundTruthStrainImage.getWidth() << std::endl;
+    return 1;
+  }
+  const int tolerance = 1;
+  int maxError = 0;
+  for (unsigned int i = 0; i < strainImage.getHeight(); i++) {
+    for (unsigned int j = 0; j < strainImage.getWidth(); j++)
+      maxError = std::max(maxError, std::abs((int)strainImage[i][j] - (int)groundTruthStrainImage[i][j]));
+  }
+  if (maxError <= tolerance)
     return 0;
 
-  std::cout << "Test failed !\n";
+  std::cout << "Test failed : maximal difference of " << maxError << " grey levels with the ground truth\n";
   return 1;
 }
 
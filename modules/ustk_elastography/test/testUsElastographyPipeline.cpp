@@ -0,0 +1,286 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Author:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+#include <iostream>
+
+/*!
+  \example testUsElastographyPipeline.cpp
+
+  Test of the elastography pipeline on synthetic RF frames, alternating between a pre and a post-compressed frame :
+  - every strain map is delivered, in the order of the frames, and equals the strain map of the same pair computed
+    by usElastography,
+  - with a single pending pair, the oldest pairs are dropped but the last one is always delivered,
+  - the callback can push frames, even when they drop pairs,
+  - a pair of frames of different sizes is counted as failed and does not block the following pairs.
+*/
+
+#include <iostream>
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpTime.h>
+#include <visp3/core/vpUniRand.h>
+#include <visp3/ustk_elastography/usElastography.h>
+#include <visp3/ustk_elastography/usElastographyPipeline.h>
+
+/*!
+  Synthetic RF frames : random scatterers smoothed along the scanlines, and the same scatterers axially compressed by
+  1 %.
+*/
+void simulateRF(unsigned int height, unsigned int width, usImageRF2D<short int> &pre, usImageRF2D<short int> &post)
+{
+  vpUniRand random(42);
+  std::vector<double> scatterers(height + 4);
+  pre.resize(height, width);
+  post.resize(height, width);
+  for (unsigned int j = 0; j < width; j++) {
+    for (unsigned int i = 0; i < scatterers.size(); i++)
+      scatterers[i] = 2.0 * random() - 1.0;
+    for (unsigned int i = 0; i < height; i++) {
+      double z = 0.99 * i;
+      unsigned int k = (unsigned int)z;
+      double a = z - k;
+      double preValue = scatterers[i] + 2.0 * scatterers[i + 1] + scatterers[i + 2];
+      double postValue = (1.0 - a) * (scatterers[k] + 2.0 * scatterers[k + 1] + scatterers[k + 2]) +
+                         a * (scatterers[k + 1] + 2.0 * scatterers[k + 2] + scatterers[k + 3]);
+      pre(i, j, (short int)vpMath::round(2000.0 * preValue));
+      post(i, j, (short int)vpMath::round(2000.0 * postValue));
+    }
+  }
+}
+
+/*!
+  Strain maps received through the callback of the pipeline.
+*/
+struct usReceivedMaps {
+  std::mutex mutex;
+  std::vector<unsigned int> indices;
+  std::vector<vpImage<unsigned char> > maps;
+
+  void receive(const vpImage<unsigned char> &strainMap, unsigned int pairIndex)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    indices.push_back(pairIndex);
+    maps.push_back(strainMap);
+  }
+
+  size_t size()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return indices.size();
+  }
+};
+
+int main()
+{
+  const unsigned int height = 800;
+  const unsigned int width = 64;
+  const unsigned int frameNumber = 9;
+  const double timeout = 60000.0; // ms
+  bool success = true;
+
+  usImageRF2D<short int> pre, post;
+  simulateRF(height, width, pre, post);
+
+  // strain maps of the two kinds of pairs, computed serially
+  usElastography elastography;
+  elastography.setROI(4, 100, 50, 500);
+  vpImage<unsigned char> strainPrePost = elastography.run(pre, post);
+  vpImage<unsigned char> strainPostPre = elastography.run(post, pre);
+
+  // in-order delivery : no pair is dropped, every strain map arrives in the order of the frames
+  {
+    usReceivedMaps received;
+    usElastographyPipeline pipeline(3);
+    pipeline.setROI(4, 100, 50, 500);
+    pipeline.setMaxPendingPairs(frameNumber);
+    pipeline.setStrainMapCallback(
+        std::bind(&usReceivedMaps::receive, &received, std::placeholders::_1, std::placeholders::_2));
+    for (unsigned int n = 0; n < frameNumber; n++)
+      pipeline.pushFrame(n % 2 == 0 ? pre : post);
+
+    double t0 = vpTime::measureTimeMs();
+    while (received.size() < frameNumber - 1 && vpTime::measureTimeMs() - t0 < timeout)
+      vpTime::wait(1);
+    pipeline.stop();
+
+    if (received.indices.size() != frameNumber - 1 || pipeline.getDroppedPairNumber() != 0 ||
+        pipeline.getFailedPairNumber() != 0) {
+      std::cout << "in-order delivery : " << received.indices.size() << " strain maps received, "
+                << pipeline.getDroppedPairNumber() << " dropped, " << pipeline.getFailedPairNumber() << " failed"
+                << std::endl;
+      success = false;
+    } else {
+      for (unsigned int i = 0; i < received.indices.size(); i++) {
+        const vpImage<unsigned char> &expected = (received.indices[i] % 2 == 1) ? strainPrePost : strainPostPre;
+        if (received.indices[i] != i + 1 || !(received.maps[i] == expected)) {
+          std::cout << "in-order delivery : strain map " << i << " is not the strain map of pair " << i + 1
+                    << std::endl;
+          success = false;
+        }
+      }
+    }
+  }
+
+  // drop-stale : a single worker and a single pending pair. The worker is held in the callback of the first strain map
+  // while the next frames are pushed, so that every pair but the last one is dropped.
+  {
+    usReceivedMaps received;
+    std::mutex gateMutex;
+    std::condition_variable gateCondition;
+    bool entered = false, released = false;
+    usElastographyPipeline pipeline(1);
+    pipeline.setROI(4, 100, 50, 500);
+    pipeline.setMaxPendingPairs(1);
+    pipeline.setStrainMapCallback([&](const vpImage<unsigned char> &strainMap, unsigned int pairIndex) {
+      received.receive(strainMap, pairIndex);
+      std::unique_lock<std::mutex> lock(gateMutex);
+      entered = true;
+      gateCondition.notify_all();
+      gateCondition.wait(lock, [&] { return released; });
+    });
+    pipeline.pushFrame(pre);
+    pipeline.pushFrame(post);
+    {
+      std::unique_lock<std::mutex> lock(gateMutex);
+      gateCondition.wait(lock, [&] { return entered; });
+    }
+    // the pushes dropping a pair must not wait for the callback
+    for (unsigned int n = 2; n < frameNumber; n++)
+      pipeline.pushFrame(n % 2 == 0 ? pre : post);
+    unsigned int droppedWhileBlocked = pipeline.getDroppedPairNumber();
+    {
+      std::lock_guard<std::mutex> lock(gateMutex);
+      released = true;
+    }
+    gateCondition.notify_all();
+
+    double t0 = vpTime::measureTimeMs();
+    while (received.size() < 2 && vpTime::measureTimeMs() - t0 < timeout)
+      vpTime::wait(1);
+    pipeline.stop();
+
+    // pairs 2 to frameNumber - 2 are dropped, the last one is delivered
+    if (droppedWhileBlocked != frameNumber - 3 || pipeline.getDroppedPairNumber() != frameNumber - 3 ||
+        received.indices.size() != 2 || received.indices[0] != 1 || received.indices[1] != frameNumber - 1) {
+      std::cout << "drop-stale : " << received.indices.size() << " strain maps received, "
+                << pipeline.getDroppedPairNumber() << " dropped" << std::endl;
+      success = false;
+    }
+  }
+
+  // a callback pushing frames : the second push of each call drops the first pair, and delivers from the callback
+  {
+    usReceivedMaps received;
+    usElastographyPipeline pipeline(1);
+    unsigned int pushed = 2; // frames pushed, only counted by the callback once the first pair is formed
+    pipeline.setROI(4, 100, 50, 500);
+    pipeline.setMaxPendingPairs(1);
+    pipeline.setStrainMapCallback([&](const vpImage<unsigned char> &strainMap, unsigned int pairIndex) {
+      received.receive(strainMap, pairIndex);
+      if (pairIndex + 2 < frameNumber) {
+        for (unsigned int n = 0; n < 2; n++, pushed++)
+          pipeline.pushFrame(pushed % 2 == 0 ? pre : post);
+      }
+    });
+    pipeline.pushFrame(pre);
+    pipeline.pushFrame(post);
+
+    double t0 = vpTime::measureTimeMs();
+    while (received.size() < frameNumber / 2 && vpTime::measureTimeMs() - t0 < timeout)
+      vpTime::wait(1);
+    pipeline.stop();
+
+    bool odd = true;
+    for (unsigned int i = 0; i < received.indices.size(); i++)
+      odd = odd && received.indices[i] == 2 * i + 1;
+    if (received.indices.size() != frameNumber / 2 || !odd || pipeline.getDroppedPairNumber() != frameNumber / 2 - 1) {
+      std::cout << "callback pushing frames : " << received.indices.size() << " strain maps received, "
+                << pipeline.getDroppedPairNumber() << " dropped" << std::endl;
+      success = false;
+    }
+  }
+
+  // failed pair : frames of different sizes
+  {
+    usImageRF2D<short int> shorterPre(height - 100, width), shorterPost(height - 100, width);
+    for (unsigned int j = 0; j < width; j++) {
+      for (unsigned int i = 0; i < height - 100; i++) {
+        shorterPre(i, j, pre(i, j));
+        shorterPost(i, j, post(i, j));
+      }
+    }
+
+    usReceivedMaps received;
+    usElastographyPipeline pipeline(2);
+    pipeline.setROI(4, 100, 50, 500);
+    pipeline.setStrainMapCallback(
+        std::bind(&usReceivedMaps::receive, &received, std::placeholders::_1, std::placeholders::_2));
+    pipeline.pushFrame(pre);
+    pipeline.pushFrame(shorterPost);
+    pipeline.pushFrame(shorterPre);
+
+    double t0 = vpTime::measureTimeMs();
+    while (received.size() < 1 && vpTime::measureTimeMs() - t0 < timeout)
+      vpTime::wait(1);
+    unsigned int failed = pipeline.getFailedPairNumber();
+    pipeline.stop();
+
+    if (failed != 1 || received.indices.size() != 1 || received.indices[0] != 2) {
+      std::cout << "failed pair : " << failed << " failed, " << received.indices.size() << " strain maps received"
+                << std::endl;
+      success = false;
+    }
+  }
+
+  if (!success) {
+    std::cout << "Test failed !" << std::endl;
+    return 1;
+  }
+  std::cout << "Test succeeded" << std::endl;
+  return 0;
+}
+
+#else
+int main()
+{
+  std::cout << "You should intall FFTW to run this test" << std::endl;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,196 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Author:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/*!
+  \example testUsImageElastography.cpp
+
+  Test of the elastography image, against a blending in floating point of the strain colors and of the ultrasound gray
+  levels on a small image :
+  - the table driven blending, for the default color map and for a random one, with several opacities,
+  - the incremental updates : strain map moved or resized, new ultrasound image of the same size, of a size in which
+    the strain map still fits, and of a size in which it does not fit anymore,
+  - the bounds checks of the constructor and of the setters.
+*/
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpRGBa.h>
+#include <visp3/core/vpUniRand.h>
+#include <visp3/ustk_elastography/usImageElastography.h>
+
+/*!
+  Random gray level image.
+*/
+vpImage<unsigned char> randomImage(unsigned int height, unsigned int width, vpUniRand &random)
+{
+  vpImage<unsigned char> I(height, width);
+  for (unsigned int i = 0; i < height; i++)
+    for (unsigned int j = 0; j < width; j++)
+      I[i][j] = (unsigned char)(256.0 * random());
+  return I;
+}
+
+/*!
+  Checks the elastography image against opacity * strain color + (1 - opacity) * gray level, computed in floating
+  point. The table driven blending truncates the sum, with the opacity rounded to 1/256 : it can be up to 1.5 gray level
+  away.
+*/
+bool check(const vpImage<vpRGBa> &elasto, const vpImage<unsigned char> &ultrasound, const vpImage<unsigned char> *strain,
+           unsigned int top, unsigned int left, const std::vector<vpRGBa> &colorMap, double opacity,
+           const std::string &name)
+{
+  if (elasto.getHeight() != ultrasound.getHeight() || elasto.getWidth() != ultrasound.getWidth()) {
+    std::cout << name << " : elastography image of size " << elasto.getHeight() << "x" << elasto.getWidth()
+              << " instead of " << ultrasound.getHeight() << "x" << ultrasound.getWidth() << std::endl;
+    return false;
+  }
+  for (unsigned int i = 0; i < elasto.getHeight(); i++) {
+    for (unsigned int j = 0; j < elasto.getWidth(); j++) {
+      double gray = ultrasound[i][j];
+      double expected[3] = {gray, gray, gray};
+      if (strain != NULL && i >= top && i < top + strain->getHeight() && j >= left && j < left + strain->getWidth()) {
+        const vpRGBa &color = colorMap[(*strain)[i - top][j - left]];
+        expected[0] = opacity * color.R + (1.0 - opacity) * gray;
+        expected[1] = opacity * color.G + (1.0 - opacity) * gray;
+        expected[2] = opacity * color.B + (1.0 - opacity) * gray;
+      }
+      const vpRGBa &value = elasto[i][j];
+      if (std::fabs(value.R - expected[0]) > 1.5 || std::fabs(value.G - expected[1]) > 1.5 ||
+          std::fabs(value.B - expected[2]) > 1.5 || value.A != 255) {
+        std::cout << name << " : color (" << (int)value.R << ", " << (int)value.G << ", " << (int)value.B << ", "
+                  << (int)value.A << ") instead of (" << expected[0] << ", " << expected[1] << ", " << expected[2]
+                  << ", 255) at (" << i << ", " << j << ")" << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main()
+{
+  bool success = true;
+  vpUniRand random(0x5eed);
+
+  vpImage<unsigned char> ultrasound = randomImage(12, 10, random);
+  vpImage<unsigned char> strain = randomImage(5, 4, random);
+  std::vector<vpRGBa> redMap(256), randomMap(256);
+  for (unsigned int s = 0; s < 256; s++) {
+    redMap[s] = vpRGBa(s, 0, 0, 255);
+    randomMap[s] = vpRGBa((unsigned char)(256.0 * random()), (unsigned char)(256.0 * random()),
+                          (unsigned char)(256.0 * random()), 255);
+  }
+
+  // initializing constructor : opaque red strain map
+  usImageElastography elasto(ultrasound, strain, 3, 2);
+  success &= check(elasto.getElastoImage(), ultrasound, &strain, 3, 2, redMap, 1.0, "Initializing constructor");
+
+  // opacities and color maps
+  const double opacities[] = {0.5, 0.3, 0.0, 0.75};
+  for (unsigned int o = 0; o < 4; o++) {
+    elasto.setStrainOpacity(opacities[o]);
+    success &= check(elasto.getElastoImage(), ultrasound, &strain, 3, 2, redMap, opacities[o],
+                     "Red color map, opacity " + std::to_string(opacities[o]));
+  }
+  elasto.setColorMap(randomMap);
+  success &= check(elasto.getElastoImage(), ultrasound, &strain, 3, 2, randomMap, 0.75, "Random color map");
+
+  // strain map moved and resized : the previous region goes back to the ultrasound image
+  vpImage<unsigned char> strain2 = randomImage(6, 3, random);
+  elasto.setStrainMap(strain2, 6, 7);
+  success &= check(elasto.getElastoImage(), ultrasound, &strain2, 6, 7, randomMap, 0.75, "Moved strain map");
+  strain2 = randomImage(6, 3, random);
+  elasto.setStrainMap(strain2, 6, 7);
+  success &= check(elasto.getElastoImage(), ultrasound, &strain2, 6, 7, randomMap, 0.75, "New strain map");
+
+  // new ultrasound images, with the last strain map
+  ultrasound = randomImage(12, 10, random);
+  elasto.setUltrasoundImage(ultrasound);
+  success &= check(elasto.getElastoImage(), ultrasound, &strain2, 6, 7, randomMap, 0.75, "New ultrasound image");
+  ultrasound = randomImage(15, 11, random);
+  elasto.setUltrasoundImage(ultrasound);
+  success &= check(elasto.getElastoImage(), ultrasound, &strain2, 6, 7, randomMap, 0.75, "Larger ultrasound image");
+  ultrasound = randomImage(8, 11, random);
+  elasto.setUltrasoundImage(ultrasound);
+  success &= check(elasto.getElastoImage(), ultrasound, NULL, 0, 0, randomMap, 0.75, "Strain map out of the image");
+  elasto.setStrainMap(strain, 3, 7);
+  success &= check(elasto.getElastoImage(), ultrasound, &strain, 3, 7, randomMap, 0.75, "Strain map set back");
+
+  // default constructor : ultrasound image first, then strain map
+  usImageElastography elasto2;
+  elasto2.setUltrasoundImage(ultrasound);
+  success &= check(elasto2.getElastoImage(), ultrasound, NULL, 0, 0, redMap, 1.0, "Default constructor");
+  elasto2.setStrainMap(strain, 0, 0);
+  success &= check(elasto2.getElastoImage(), ultrasound, &strain, 0, 0, redMap, 1.0, "Strain map in the corner");
+
+  // bounds checks
+  unsigned int rejected = 0;
+  try {
+    usImageElastography outOfBounds(ultrasound, strain, 4, 0);
+  } catch (const vpException &) {
+    rejected++;
+  }
+  try {
+    usImageElastography outOfBounds(ultrasound, strain, 0, 8);
+  } catch (const vpException &) {
+    rejected++;
+  }
+  try {
+    elasto.setStrainMap(strain, 0, 8);
+  } catch (const vpException &) {
+    rejected++;
+  }
+  try {
+    elasto.setColorMap(std::vector<vpRGBa>(255));
+  } catch (const vpException &) {
+    rejected++;
+  }
+  try {
+    elasto.setStrainOpacity(1.5);
+  } catch (const vpException &) {
+    rejected++;
+  }
+  if (rejected != 5) {
+    std::cout << 5 - rejected << " invalid parameters were not rejected" << std::endl;
+    success = false;
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Test succeeded" << std::endl;
+  return 0;
+}
@@ -0,0 +1,196 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Author:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/*!
+  \example testUsStrainEstimator.cpp
+
+  Test of the LSQ strain estimation on a random displacement field :
+  - with a constant window, the prefix sum estimation gives the valid convolution by the ramp kernel that
+    usElastography used before (for integer and non integer window lengths),
+  - with a window length varying with the depth, each output row is the ramp convolution with its own window length,
+    centered on the samples of the longest window : the first and last rows match the constant window estimations
+    with the near and far lengths,
+  - invalid window lengths are rejected.
+*/
+
+#include <iostream>
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_FFTW)
+
+#include <cmath>
+#include <string>
+
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpUniRand.h>
+#include <visp3/ustk_elastography/usStrainEstimator.h>
+
+/*!
+  Ramp kernel of the former LSQ strain estimation of usElastography, for a window length n.
+*/
+vpMatrix rampKernel(double n, double kappa)
+{
+  vpMatrix h((unsigned int)n + 1, 1, true);
+  double xi = kappa * 12.0 / (n * (n * n - 1));
+  unsigned int j = 0;
+  for (int i = (int)n; i >= 0; i--) {
+    h[j][0] = xi * (i - (n + 1) / 2.0);
+    j++;
+  }
+  return h;
+}
+
+/*!
+  Valid convolution of the column k of d by the column kernel h, at the output row l.
+*/
+double rampConvolution(const vpImage<double> &d, const vpMatrix &h, unsigned int l, unsigned int k)
+{
+  unsigned int size = h.getRows();
+  double value = 0.0;
+  for (unsigned int p = 0; p < size; p++)
+    value += d[l + p][k] * h[size - 1 - p][0];
+  return value;
+}
+
+bool check(double value, double expected, const std::string &name, unsigned int l, unsigned int k)
+{
+  if (std::fabs(value - expected) > 1e-9 * (1.0 + std::fabs(expected))) {
+    std::cout << name << " : strain " << value << " instead of " << expected << " at (" << l << ", " << k << ")"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main()
+{
+  bool success = true;
+  const unsigned int rows = 120, cols = 7;
+  const double kappa = 3.5;
+
+  vpUniRand random(0x5eed);
+  vpImage<double> displacements(rows, cols);
+  for (unsigned int i = 0; i < rows; i++)
+    for (unsigned int j = 0; j < cols; j++)
+      displacements[i][j] = 20.0 * random() - 10.0;
+
+  usStrainEstimator<double> estimator;
+  estimator.setScale(kappa);
+  vpImage<double> strain;
+
+  // constant window : the former ramp convolution
+  const double lengths[] = {2.0, 5.0, 7.6, 31.25};
+  for (unsigned int n = 0; n < 4; n++) {
+    const std::string name = "window of " + std::to_string(lengths[n]);
+    estimator.setWindowLength(lengths[n]);
+    estimator.run(displacements, strain);
+    vpMatrix h = rampKernel(lengths[n], kappa);
+    if (strain.getHeight() != rows + 1 - h.getRows() || strain.getWidth() != cols) {
+      std::cout << name << " : strain of size " << strain.getHeight() << "x" << strain.getWidth() << " instead of "
+                << rows + 1 - h.getRows() << "x" << cols << std::endl;
+      success = false;
+      continue;
+    }
+    for (unsigned int l = 0; l < strain.getHeight(); l++)
+      for (unsigned int k = 0; k < cols; k++)
+        success &= check(strain[l][k], rampConvolution(displacements, h, l, k), name, l, k);
+  }
+
+  // window length growing with the depth, from 4 to 17.5 samples
+  const double nearLength = 4.0, farLength = 17.5;
+  const unsigned int maxSpan = (unsigned int)farLength;
+  estimator.setWindowLengthRange(nearLength, farLength);
+  estimator.run(displacements, strain);
+  const unsigned int outHeight = rows - maxSpan;
+  if (strain.getHeight() != outHeight || strain.getWidth() != cols) {
+    std::cout << "Depth varying window : strain of size " << strain.getHeight() << "x" << strain.getWidth()
+              << " instead of " << outHeight << "x" << cols << std::endl;
+    return 1;
+  }
+  for (unsigned int l = 0; l < outHeight; l++) {
+    double length = nearLength + (farLength - nearLength) * l / (double)(outHeight - 1);
+    vpMatrix h = rampKernel(length, kappa);
+    unsigned int first = l + (maxSpan - (unsigned int)length) / 2;
+    for (unsigned int k = 0; k < cols; k++)
+      success &= check(strain[l][k], rampConvolution(displacements, h, first, k), "Depth varying window", l, k);
+  }
+
+  // the first row uses the near window, the last row the far window
+  vpImage<double> nearStrain, farStrain;
+  estimator.setWindowLength(nearLength);
+  estimator.run(displacements, nearStrain);
+  estimator.setWindowLength(farLength);
+  estimator.run(displacements, farStrain);
+  const unsigned int nearOffset = (maxSpan - (unsigned int)nearLength) / 2;
+  bool changed = false;
+  for (unsigned int k = 0; k < cols; k++) {
+    success &= check(strain[0][k], nearStrain[nearOffset][k], "First row of the depth varying window", 0, k);
+    success &= check(strain[outHeight - 1][k], farStrain[outHeight - 1][k], "Last row of the depth varying window",
+                     outHeight - 1, k);
+    changed |= std::fabs(strain[0][k] - farStrain[0][k]) > 1e-6;
+  }
+  if (!changed) {
+    std::cout << "The depth varying window should not use the far window length on the first row" << std::endl;
+    success = false;
+  }
+
+  // invalid window lengths
+  try {
+    estimator.setWindowLengthRange(4.0, 1.0);
+    std::cout << "A window length of 1 should be rejected" << std::endl;
+    success = false;
+  } catch (const vpException &) {
+  }
+  try {
+    estimator.setWindowLength(rows);
+    estimator.run(displacements, strain);
+    std::cout << "A window longer than the displacements should be rejected" << std::endl;
+    success = false;
+  } catch (const vpException &) {
+  }
+
+  if (!success)
+    return 1;
+  std::cout << "Test succeeded" << std::endl;
+  return 0;
+}
+
+#else
+int main()
+{
+  std::cout << "You should intall FFTW to run this test" << std::endl;
+  return 0;
+}
+
+#endif
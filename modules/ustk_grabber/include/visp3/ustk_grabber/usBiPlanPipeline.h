@@ -0,0 +1,124 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usBiPlanPipeline.h
+ * @brief Parallel processing of the two planes acquired by the bi-plane grabber.
+ */
+
+#ifndef __usBiPlanPipeline_h_
+#define __usBiPlanPipeline_h_
+
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT)
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <visp3/ustk_grabber/usNetworkGrabberPostScanBiPlan.h>
+
+/**
+ * @class usBiPlanPipeline
+ * @brief Runs a processing (confidence map, tracking, ...) on each plane of the pairs acquired with
+ * usNetworkGrabberPostScanBiPlan, the two planes being processed in parallel.
+ * @ingroup module_ustk_grabber
+ *
+ * The processing of the first plane runs on a worker thread owned by the pipeline, the processing of the second plane
+ * runs in the calling thread. process() returns once both are done, so the results of the two planes always refer to
+ * the same acquisition. The frames are processed in place, without copy.
+ *
+ * A plane with no processing set is skipped. The two processings run concurrently : they must not share objects with
+ * internal buffers (converters, confidence map processors...), use one per plane. An exception thrown by the
+ * processing of the first plane is caught on the worker thread and thrown again by process().
+ * \code
+ * usNetworkGrabberPostScanBiPlan grabber;
+ * usPostScanToPreScan2DConverter converter1, converter2;
+ * usScanlineConfidence2D confidence1, confidence2;
+ * usImagePreScan2D<unsigned char> preScan1, preScan2, confidenceMap1, confidenceMap2;
+ * usBiPlanPipeline pipeline;
+ * pipeline.setPlaneProcessing(1, [&](usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > &frame) {
+ *   converter1.convert(frame, preScan1, 480);
+ *   confidence1.run(confidenceMap1, preScan1);
+ * });
+ * pipeline.setPlaneProcessing(2, [&](usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > &frame) {
+ *   converter2.convert(frame, preScan2, 480);
+ *   confidence2.run(confidenceMap2, preScan2);
+ * });
+ * // ... connection and acquisition initialisation
+ * while (running) {
+ *   pipeline.process(grabber.acquirePair());
+ *   // confidenceMap1 and confidenceMap2 are computed on the same acquisition
+ * }
+ * \endcode
+ */
+class VISP_EXPORT usBiPlanPipeline
+{
+public:
+  /**
+   * Processing applied on the frame of a plane.
+   */
+  typedef std::function<void(usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > &)> usPlaneProcessing;
+
+  usBiPlanPipeline();
+  virtual ~usBiPlanPipeline();
+
+  quint32 getLastPairIndex() const;
+
+  void process(const usNetworkGrabberPostScanBiPlan::usFramePair &pair);
+
+  void setPlaneProcessing(unsigned int plane, const usPlaneProcessing &processing);
+
+private:
+  void waitWorker();
+  void workerLoop();
+
+  usPlaneProcessing m_processing1;
+  usPlaneProcessing m_processing2;
+
+  quint32 m_lastPairIndex;
+
+  // worker thread processing the first plane
+  std::thread m_worker;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *m_workerFrame;
+  std::exception_ptr m_workerException;
+  bool m_workerDone;
+  bool m_stop;
+};
+
+#endif // QT4 || QT5
+#endif // __usBiPlanPipeline_h_
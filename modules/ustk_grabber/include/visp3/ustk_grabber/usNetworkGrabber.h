@@ -57,7 +57,7 @@
 
 /**
  * @class usNetworkGrabber
- * @brief Generic abstract class to manage tcp connection to grab ultrasound frames (on port 8080).
+ * @brief Generic abstract class to manage tcp connection to grab ultrasound frames (on port 8080 by default).
  * @ingroup module_ustk_grabber
 
 
@@ -153,6 +153,8 @@ public:
   bool sendAcquisitionParameters();
 
   void setIPAddress(const std::string &s_ip) { m_ip = s_ip; }
+  void setPort(quint16 port) { m_port = port; }
+  void setSharedThread(QThread *thread);
 
   void setMotorActivation(bool activateMotor);
   void setStepsPerFrame(usAcquisitionParameters::usMotorStep stepsPerFrame);
@@ -176,6 +178,7 @@ signals:
   void sendAcquisitionParametersSignal();
   void endConnection();
   void acquisitionInitialized(bool);
+  void serverDisconnected();
 
 public slots:
   void center3DProbeMotor();
@@ -188,6 +191,7 @@ public slots:
   void handleError(QAbstractSocket::SocketError err);
   void initAcquisitionSlot(usNetworkGrabber::usInitHeaderSent header);
   void processConnectionToServer();
+  void releaseSharedThread(QThread *thread);
   void runAcquisition();
   void stopAcquisition();
 
@@ -203,6 +207,7 @@ protected:
   QTcpSocket *m_tcpSocket;
   bool m_connect;
   std::string m_ip;
+  quint16 m_port;
 
   // bytes to read until image end
   int m_bytesLeftToRead;
@@ -216,6 +221,9 @@ protected:
   // received headers
   usInitHeaderConfirmation m_confirmHeader;
   us::usImageHeader m_imageHeader;
+  // latency tracing : stream number of the grabber, and trace ID of the frame being received
+  unsigned int m_traceStream;
+  uint64_t m_traceId;
 
   // grabber state
   bool m_isInit;
@@ -223,6 +231,8 @@ protected:
 
   // separated thread to run the event loop
   QThread *m_thread;
+  // event loop thread shared with other grabbers (not owned), see setSharedThread()
+  bool m_useSharedThread;
 };
 
 #endif // QT4 || QT5
@@ -0,0 +1,199 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usNetworkGrabberManager.h
+ * @brief Concurrent acquisition of several ultrasound streams, with grabbers sharing event loop threads.
+ */
+
+#ifndef __usNetworkGrabberManager_h_
+#define __usNetworkGrabberManager_h_
+
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT)
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <QtCore/QObject>
+#include <QtCore/QThread>
+
+#include <visp3/ustk_grabber/usNetworkGrabberPostScan2D.h>
+#include <visp3/ustk_grabber/usNetworkGrabberPreScan2D.h>
+#include <visp3/ustk_grabber/usNetworkGrabberRF2D.h>
+
+class usNetworkGrabberManager;
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+/**
+ * Forwards the newFrameAvailable() and serverDisconnected() signals of the grabber of a stream to the manager, with
+ * the index of the stream. The slots run in the thread emitting the signal (direct connection).
+ */
+class VISP_EXPORT usNetworkGrabberStreamRelay : public QObject
+{
+  Q_OBJECT
+public:
+  usNetworkGrabberStreamRelay(usNetworkGrabberManager *manager, unsigned int streamId);
+
+public slots:
+  void disconnected();
+  void frameAvailable();
+
+private:
+  usNetworkGrabberManager *m_manager;
+  unsigned int m_streamId;
+};
+#endif // DOXYGEN_SHOULD_SKIP_THIS
+
+/**
+ * @class usNetworkGrabberManager
+ * @brief Runs several grabber connections (several probes / stations, or several streams of a station) in one event
+ * loop thread, or a small pool of threads, and gives a unified access to the frames of all the streams.
+ * @ingroup module_ustk_grabber
+ *
+ * By default, every grabber creates its own thread in runAcquisition(). The manager instead distributes the grabbers
+ * over a fixed number of threads : each thread runs one Qt event loop multiplexing the sockets of its grabbers (the
+ * event dispatcher relies on the system poll / epoll).
+ *
+ * Each stream keeps its own buffers (the buffers of its grabber). Frames are accessed with :
+ * - acquireAny() : next frame arrived on any stream (the stream which waits for the longest time first),
+ * - acquireAll() : one new frame of every stream, aligned on their timestamps.
+ *
+ * A frame returned stays valid until the next acquisition on its stream.
+ *
+ * Both methods wait at most the timeout set with setTimeout() for a stream to deliver a frame, and throw a vpException
+ * (vpException::ioError) if it does not, if its grabber is disconnected from the server, or if stopAcquisition() is
+ * called meanwhile (waiting threads are woken up).
+ *
+ * Usage : connect each grabber (usNetworkGrabber::setPort() to reach several servers on the same host) and init its
+ * acquisition, add it to the manager with addStream(), then call runAcquisition(). The manager must be deleted before
+ * the grabbers (they are moved back to the thread which added them to the manager).
+ * \code
+ * usNetworkGrabberManager manager(1);
+ * usNetworkGrabberPreScan2D grabber1, grabber2;
+ * grabber1.setIPAddress("127.0.0.1"); grabber1.setPort(8080); grabber1.connectToServer();
+ * grabber2.setIPAddress("127.0.0.1"); grabber2.setPort(8081); grabber2.connectToServer();
+ * grabber1.initAcquisition(header); grabber2.initAcquisition(header);
+ * manager.addStream(&grabber1);
+ * manager.addStream(&grabber2);
+ * manager.runAcquisition();
+ * std::vector<usNetworkGrabberManager::usStreamFrame> frameSet;
+ * try {
+ *   while (true) {
+ *     manager.acquireAll(frameSet, 20.0);
+ *     // process frameSet.at(0).preScan2D and frameSet.at(1).preScan2D
+ *   }
+ * } catch (const vpException &e) {
+ *   // a stream timed out or was disconnected, or the acquisition was stopped
+ * }
+ * \endcode
+ */
+class VISP_EXPORT usNetworkGrabberManager : public QObject
+{
+  Q_OBJECT
+public:
+  /**
+   * Frame acquired on a stream. Only the pointer matching the image type of the stream is set.
+   */
+  struct usStreamFrame {
+    usStreamFrame()
+      : streamId(0), imageType(us::NOT_SET), frameCount(0), timeStamp(0), preScan2D(NULL), postScan2D(NULL), rf2D(NULL)
+    {
+    }
+    unsigned int streamId; /**< Index of the stream (returned by addStream()). */
+    us::ImageType imageType; /**< PRESCAN_2D, POSTSCAN_2D or RF_2D. */
+    quint32 frameCount;      /**< Frame count of the frame on its stream. */
+    quint64 timeStamp;       /**< Timestamp of the frame (ms, ultrasound station clock). */
+    usFrameGrabbedInfo<usImagePreScan2D<unsigned char> > *preScan2D;   /**< Pre-scan frame. */
+    usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *postScan2D; /**< Post-scan frame. */
+    usFrameGrabbedInfo<usImageRF2D<short int> > *rf2D;                 /**< RF frame. */
+  };
+
+  explicit usNetworkGrabberManager(unsigned int threadNumber = 1, QObject *parent = 0);
+  ~usNetworkGrabberManager();
+
+  bool acquireAll(std::vector<usStreamFrame> &frameSet, double tolerance);
+  usStreamFrame acquireAny();
+
+  unsigned int addStream(usNetworkGrabberPreScan2D *grabber);
+  unsigned int addStream(usNetworkGrabberPostScan2D *grabber);
+  unsigned int addStream(usNetworkGrabberRF2D *grabber);
+
+  unsigned int getStreamNumber() const;
+  unsigned int getThreadNumber() const;
+  double getTimeout() const;
+
+  bool isFrameAvailable(unsigned int streamId);
+
+  void runAcquisition();
+
+  void setTimeout(double timeout);
+
+  void stopAcquisition();
+
+private:
+  friend class usNetworkGrabberStreamRelay;
+
+  struct usStream {
+    us::ImageType imageType;
+    usNetworkGrabber *grabber;
+    usNetworkGrabberPreScan2D *preScanGrabber;
+    usNetworkGrabberPostScan2D *postScanGrabber;
+    usNetworkGrabberRF2D *rfGrabber;
+    bool pending;   // a frame not acquired yet is available
+    bool connected; // false once the grabber is disconnected from the server
+    QThread *ownerThread; // thread of the grabber before it was moved to an event loop thread
+  };
+
+  unsigned int addStream(const usStream &stream);
+  usStreamFrame acquireStream(unsigned int streamId);
+  void frameAvailable(unsigned int streamId);
+  void streamDisconnected(unsigned int streamId);
+  void waitFrame(unsigned int streamId);
+
+  std::vector<QThread *> m_threads;
+  std::vector<usStream> m_streams;
+  std::vector<usNetworkGrabberStreamRelay *> m_relays;
+
+  // streams with a pending frame, by arrival order
+  std::deque<unsigned int> m_pendingStreams;
+  std::mutex m_mutex;
+  std::condition_variable m_frameCondition;
+  bool m_stopped;
+  double m_timeout; // ms
+};
+
+#endif // QT4 || QT5
+#endif // __usNetworkGrabberManager_h_
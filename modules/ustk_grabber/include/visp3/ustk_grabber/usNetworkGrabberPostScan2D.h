@@ -85,7 +85,7 @@ public:
 
 signals:
   void newFrameAvailable();
-  void newFrame(usImagePostScan2D<unsigned char> image);
+  void newFrame(usImagePostScan2D<unsigned char> image, quint64 traceId);
 
 private:
   // Output images
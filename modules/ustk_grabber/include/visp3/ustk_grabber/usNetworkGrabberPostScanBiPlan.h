@@ -42,6 +42,8 @@
 
 #if defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT)
 
+#include <condition_variable>
+#include <mutex>
 #include <vector>
 
 #include <visp3/ustk_core/usImagePostScan2D.h>
@@ -58,19 +60,35 @@
  * \image html img-usNetworkGrabber.png
  *
  * This grabber manages a buffer system to avoid multiple copy of the frames.
- * The acquire() method returns a pointer on a new frame, you can acess and modify the frame (it is thread-safe).
- * Acquire() can be blocking, the behaviour depends on how often you call it :
- * - If you call acquire() faster than the frames are arriving on the network, it is blocking to wait next frame coming.
- * - If you call it slower you will loose frames, but you will get the last frame available.
+ * The acquirePair() method returns pointers on the two planes of a new acquisition, you can acess and modify the frames
+ * (it is thread-safe). The planes are swapped together in the buffers once the second plane is received, so the two
+ * frames of a pair always come from the same acquisition.
+ * AcquirePair() can be blocking, the behaviour depends on how often you call it :
+ * - If you call acquirePair() faster than the frames are arriving on the network, it is blocking to wait next pair.
+ * - If you call it slower you will loose frames, but you will get the last pair available.
+ *
+ * The frames of a pair stay valid until the next call to acquirePair(). To process the two planes in parallel, see
+ * usBiPlanPipeline.
  */
 class VISP_EXPORT usNetworkGrabberPostScanBiPlan : public usNetworkGrabber
 {
   Q_OBJECT
 public:
+  /**
+   * Pair of frames of the two planes acquired at the same time.
+   */
+  struct usFramePair {
+    usFramePair() : index(0), plane1(NULL), plane2(NULL) {}
+    quint32 index; /**< Acquisition index of the pair (incremented for each pair received). */
+    usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *plane1; /**< Frame of the first plane. */
+    usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *plane2; /**< Frame of the second plane. */
+  };
+
   explicit usNetworkGrabberPostScanBiPlan(usNetworkGrabber *parent = 0);
   ~usNetworkGrabberPostScanBiPlan();
 
   std::vector<usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *> acquire();
+  usFramePair acquirePair();
 
   void dataArrived();
 
@@ -79,15 +97,30 @@ public:
 signals:
   void newFrameAvailable();
 
-private:
+protected:
+  void completeFrame();
+
   // Output images
   std::vector<usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *> m_outputBuffer1;
   std::vector<usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *> m_outputBuffer2;
 
   int m_bufferToFill;
 
+private:
+  // the planes are traced as two streams, their frames may have the same frame count
+  unsigned int m_plane2TraceStream;
+
   bool m_firstFrameAvailable;
 
+  // acquisition index of the pairs at OUTPUT and MOST_RECENT positions
+  quint32 m_outputPairIndex;
+  quint32 m_mostRecentPairIndex;
+  quint32 m_pairCount;
+
+  // protects the swaps involving MOST_RECENT positions (network thread / acquisition thread)
+  std::mutex m_pairMutex;
+  // signaled with m_pairMutex held when a new pair is at MOST_RECENT position
+  std::condition_variable m_pairCondition;
 };
 
 #endif // QT4 || QT5
@@ -85,7 +85,7 @@ public:
 
 signals:
   void newFrameAvailable();
-  void newFrame(usImagePreScan2D<unsigned char> image);
+  void newFrame(usImagePreScan2D<unsigned char> image, quint64 traceId);
 
 protected:
   void invertRowsCols();
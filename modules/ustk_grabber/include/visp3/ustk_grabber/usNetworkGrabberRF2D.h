@@ -83,7 +83,7 @@ public:
 
 signals:
   void newFrameAvailable();
-  void newFrame(usImageRF2D<short int> &);
+  void newFrame(usImageRF2D<short int> &image, quint64 traceId);
 
 private:
   // Image buffer
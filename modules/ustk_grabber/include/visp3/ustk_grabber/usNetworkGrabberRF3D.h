@@ -105,6 +105,10 @@ private:
   bool m_firstFrameAvailable;
   bool m_firstVolumeAvailable;
 
+  // latency tracing: trace IDs (frame count of the last frame received) of the output and most recent volumes
+  uint64_t m_outputTraceId;
+  uint64_t m_mostRecentTraceId;
+
   // to manage the recording process
   bool m_recordingOn;
   usMHDSequenceWriter m_sequenceWriter;
@@ -0,0 +1,168 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include <visp3/ustk_grabber/usBiPlanPipeline.h>
+
+#if defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT)
+
+#include <utility>
+
+#include <visp3/core/vpException.h>
+
+/**
+* Constructor. Starts the worker thread used for the first plane.
+*/
+usBiPlanPipeline::usBiPlanPipeline()
+  : m_processing1(), m_processing2(), m_lastPairIndex(0), m_worker(), m_mutex(), m_condition(), m_workerFrame(NULL),
+    m_workerException(), m_workerDone(true), m_stop(false)
+{
+  m_worker = std::thread(&usBiPlanPipeline::workerLoop, this);
+}
+
+/**
+* Destructor. Stops the worker thread.
+*/
+usBiPlanPipeline::~usBiPlanPipeline()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_condition.notify_all();
+  m_worker.join();
+}
+
+/**
+* Get the acquisition index of the last pair processed.
+* @return Index of the last pair passed to process() (0 before the first call).
+*/
+quint32 usBiPlanPipeline::getLastPairIndex() const { return m_lastPairIndex; }
+
+/**
+* Processes the two planes of a pair in parallel, and waits for both processings to finish.
+* @param pair Pair of frames returned by usNetworkGrabberPostScanBiPlan::acquirePair().
+* @throw The exception thrown by the processing of a plane (the one of the second plane if both throw), once both
+* processings are finished.
+*/
+void usBiPlanPipeline::process(const usNetworkGrabberPostScanBiPlan::usFramePair &pair)
+{
+  if (pair.plane1 == NULL || pair.plane2 == NULL)
+    throw(vpException(vpException::badValue, "usBiPlanPipeline::process : invalid frame pair"));
+
+  // first plane on the worker thread
+  if (m_processing1) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_workerFrame = pair.plane1;
+    m_workerDone = false;
+  }
+  m_condition.notify_all();
+
+  // second plane in the calling thread
+  try {
+    if (m_processing2)
+      m_processing2(*pair.plane2);
+  } catch (...) {
+    waitWorker(); // the worker must not be running on the frame when the exception reaches the caller
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_workerException = std::exception_ptr();
+    throw;
+  }
+
+  // synchronisation of the results
+  waitWorker();
+  std::exception_ptr workerException;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::swap(workerException, m_workerException);
+  }
+  if (workerException)
+    std::rethrow_exception(workerException);
+  m_lastPairIndex = pair.index;
+}
+
+/**
+* Set the processing applied on the frames of a plane.
+* @param plane Plane index : 1 or 2.
+* @param processing Processing to apply, or an empty function to skip the plane.
+* @note Must not be called while process() is running.
+*/
+void usBiPlanPipeline::setPlaneProcessing(unsigned int plane, const usPlaneProcessing &processing)
+{
+  if (plane == 1) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_processing1 = processing;
+  } else if (plane == 2) {
+    m_processing2 = processing;
+  } else {
+    throw(vpException(vpException::badValue, "usBiPlanPipeline::setPlaneProcessing : plane must be 1 or 2"));
+  }
+}
+
+/**
+* Waits until the worker thread has processed its frame.
+*/
+void usBiPlanPipeline::waitWorker()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_condition.wait(lock, [this] { return m_workerDone; });
+}
+
+/**
+* Worker thread : processes the frames of the first plane.
+*/
+void usBiPlanPipeline::workerLoop()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_condition.wait(lock, [this] { return m_stop || !m_workerDone; });
+    if (m_stop)
+      return;
+
+    usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *frame = m_workerFrame;
+    lock.unlock();
+    std::exception_ptr exception;
+    try {
+      m_processing1(*frame);
+    } catch (...) {
+      // given back to the calling thread by process()
+      exception = std::current_exception();
+    }
+    lock.lock();
+
+    m_workerException = exception;
+
+    m_workerDone = true;
+    m_condition.notify_all();
+  }
+}
+
+#endif
@@ -38,6 +38,7 @@
 #include <fstream>
 #include <iostream>
 #include <visp3/io/vpImageIo.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 #include <QtCore/QDataStream>
 #include <QtCore/QEventLoop>
@@ -51,6 +52,7 @@ using namespace std;
 usNetworkGrabber::usNetworkGrabber(QObject *parent) : QObject(parent)
 {
   m_ip = "192.168.100.2";
+  m_port = 8080;
 
   m_tcpSocket = new QTcpSocket(this);
 
@@ -63,11 +65,14 @@ usNetworkGrabber::usNetworkGrabber(QObject *parent) : QObject(parent)
   m_acquisitionParameters = usAcquisitionParameters();
   m_confirmHeader = usInitHeaderConfirmation();
   m_imageHeader = us::usImageHeader();
+  m_traceStream = usLatencyTracer::newStream();
+  m_traceId = 0;
 
   m_isInit = false;
   m_isRunning = false;
   
   m_thread = NULL;
+  m_useSharedThread = false;
 
   QObject::connect(this, SIGNAL(serverUpdateEnded(bool)), this, SLOT(serverUpdated(bool)));
   QObject::connect(this, SIGNAL(runAcquisitionSignal(bool)), this, SLOT(sendRunSignal(bool)));
@@ -132,7 +137,7 @@ void usNetworkGrabber::processConnectionToServer()
     if (m_verbose)
       std::cout << "ip listening : " << m_ip.c_str() << std::endl;
     QHostAddress addr(m_ip.c_str());
-    m_tcpSocket->connectToHost(addr, 8080);
+    m_tcpSocket->connectToHost(addr, m_port);
 
     connect(m_tcpSocket, SIGNAL(connected()), this, SLOT(connected()));
     connect(this, SIGNAL(endConnection()), this, SLOT(disconnected()));
@@ -174,13 +179,15 @@ void usNetworkGrabber::connected()
 }
 
 /**
-* Slot called when the grabber is disconnected from the server. Prints information, and closes socket.
+* Slot called when the grabber is disconnected from the server. Prints information, closes socket, and emits
+* serverDisconnected().
 */
 void usNetworkGrabber::disconnected()
 {
   if (m_verbose)
     std::cout << "Disconnected .... \n";
   m_tcpSocket->close();
+  emit(serverDisconnected());
 }
 
 /**
@@ -650,7 +657,7 @@ void usNetworkGrabber::setTransmitFrequency(int transmitFrequency)
 */
 void usNetworkGrabber::runAcquisition()
 {
-  if (m_thread == NULL) {
+  if (m_thread == NULL && !m_useSharedThread) {
     m_thread = new QThread;
     this->moveToThread(m_thread);
     m_thread->start();
@@ -660,6 +667,30 @@ void usNetworkGrabber::runAcquisition()
   //vpTime::wait(10); // workaround to allow calling run / stop methods one just after another
 }
 
+/**
+* Moves the grabber in an event loop thread shared with other grabbers (see usNetworkGrabberManager), instead of the
+* thread created by runAcquisition(). To call after initAcquisition(), and before runAcquisition().
+* @param thread The running thread, owned by the caller (must outlive the acquisition).
+*/
+void usNetworkGrabber::setSharedThread(QThread *thread)
+{
+  if (m_thread != NULL)
+    throw(vpException(vpException::fatalError, "usNetworkGrabber : the grabber already runs in its own thread"));
+  m_useSharedThread = true;
+  this->moveToThread(thread);
+}
+
+/**
+* Moves the grabber out of the shared event loop thread given to setSharedThread(), before this thread is stopped.
+* Must run in the shared thread (blocking queued call from the owner of the thread).
+* @param thread The thread the grabber is moved to.
+*/
+void usNetworkGrabber::releaseSharedThread(QThread *thread)
+{
+  m_useSharedThread = false;
+  this->moveToThread(thread);
+}
+
 /**
 * Sends the command to stop the acquisition on the ulstrasound station.
 * The server will stop to send data, but the grabber is still connected : you can then perform a runAcquisition() to
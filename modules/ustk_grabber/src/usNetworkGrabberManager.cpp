@@ -0,0 +1,396 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include <visp3/ustk_grabber/usNetworkGrabberManager.h>
+
+#if defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT)
+
+#include <algorithm>
+#include <chrono>
+
+#include <QtCore/QMetaObject>
+
+#include <visp3/core/vpException.h>
+
+/**
+* Constructor.
+* @param manager The manager of the stream.
+* @param streamId Index of the stream.
+*/
+usNetworkGrabberStreamRelay::usNetworkGrabberStreamRelay(usNetworkGrabberManager *manager, unsigned int streamId)
+  : QObject(), m_manager(manager), m_streamId(streamId)
+{
+}
+
+/**
+* Slot called when the grabber of the stream is disconnected from the server.
+*/
+void usNetworkGrabberStreamRelay::disconnected() { m_manager->streamDisconnected(m_streamId); }
+
+/**
+* Slot called in the event loop thread of the grabber of the stream when it has a new frame.
+*/
+void usNetworkGrabberStreamRelay::frameAvailable() { m_manager->frameAvailable(m_streamId); }
+
+/**
+* Constructor. Starts the event loop threads shared by the grabbers.
+* @param threadNumber Number of threads running the grabbers (grabbers are distributed over them in turn).
+* @param parent The optionnal QObject parent.
+*/
+usNetworkGrabberManager::usNetworkGrabberManager(unsigned int threadNumber, QObject *parent)
+  : QObject(parent), m_threads(), m_streams(), m_relays(), m_pendingStreams(), m_mutex(), m_frameCondition(),
+    m_stopped(false), m_timeout(1000.0)
+{
+  if (threadNumber == 0)
+    throw(vpException(vpException::badValue, "usNetworkGrabberManager : at least one thread is needed"));
+
+  for (unsigned int i = 0; i < threadNumber; i++) {
+    m_threads.push_back(new QThread);
+    m_threads.back()->start();
+  }
+}
+
+/**
+* Destructor. Stops the acquisition, moves the grabbers back to the threads which added them, and stops the event loop
+* threads (the grabbers must still exist).
+*/
+usNetworkGrabberManager::~usNetworkGrabberManager()
+{
+  stopAcquisition();
+  // a QObject can only be pushed to another thread from its own thread
+  for (unsigned int i = 0; i < m_streams.size(); i++)
+    QMetaObject::invokeMethod(m_streams.at(i).grabber, "releaseSharedThread", Qt::BlockingQueuedConnection,
+                              Q_ARG(QThread *, m_streams.at(i).ownerThread));
+  for (unsigned int i = 0; i < m_threads.size(); i++) {
+    m_threads.at(i)->quit();
+    m_threads.at(i)->wait();
+    delete m_threads.at(i);
+  }
+  for (unsigned int i = 0; i < m_relays.size(); i++)
+    delete m_relays.at(i);
+}
+
+/**
+* Acquires one new frame on every stream, aligned on their timestamps : streams whose frame is older than the most
+* recent frame of the set by more than the tolerance are acquired again (the set is given back after a few tries even
+* if it is not aligned, in case of clock offset between the stations).
+* @param [out] frameSet The frames acquired, in the order of the streams.
+* @param [in] tolerance Maximal timestamp difference between the frames of the set (milliseconds).
+* @return True if the frames are aligned within the tolerance.
+* @throw vpException::ioError If a stream has no new frame within the timeout, is disconnected, or if the acquisition
+* is stopped.
+*/
+bool usNetworkGrabberManager::acquireAll(std::vector<usStreamFrame> &frameSet, double tolerance)
+{
+  if (m_streams.empty())
+    throw(vpException(vpException::notInitialized, "usNetworkGrabberManager : no stream to acquire"));
+
+  const unsigned int maxTries = 8;
+  frameSet.resize(m_streams.size());
+  std::vector<bool> toAcquire(m_streams.size(), true);
+
+  for (unsigned int tries = 0; tries < maxTries; tries++) {
+    for (unsigned int i = 0; i < m_streams.size(); i++) {
+      if (toAcquire.at(i)) {
+        waitFrame(i);
+        frameSet.at(i) = acquireStream(i);
+        toAcquire.at(i) = false;
+      }
+    }
+
+    quint64 newest = 0;
+    for (unsigned int i = 0; i < frameSet.size(); i++)
+      newest = std::max(newest, frameSet.at(i).timeStamp);
+
+    bool aligned = true;
+    for (unsigned int i = 0; i < frameSet.size(); i++) {
+      if (frameSet.at(i).timeStamp + tolerance < newest) {
+        toAcquire.at(i) = true;
+        aligned = false;
+      }
+    }
+    if (aligned)
+      return true;
+  }
+  return false;
+}
+
+/**
+* Acquires the next frame arrived on any stream. If several streams have a new frame, the stream whose frame waits for
+* the longest time is acquired first. Blocking until a frame is available, or the timeout (see setTimeout()).
+* @return The frame acquired.
+* @throw vpException::ioError If no stream has a new frame within the timeout, if all the streams are disconnected, or
+* if the acquisition is stopped.
+*/
+usNetworkGrabberManager::usStreamFrame usNetworkGrabberManager::acquireAny()
+{
+  if (m_streams.empty())
+    throw(vpException(vpException::notInitialized, "usNetworkGrabberManager : no stream to acquire"));
+
+  unsigned int streamId;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    bool signaled = m_frameCondition.wait_for(lock, std::chrono::duration<double, std::milli>(m_timeout), [this]() {
+      if (!m_pendingStreams.empty() || m_stopped)
+        return true;
+      for (unsigned int i = 0; i < m_streams.size(); i++)
+        if (m_streams.at(i).connected)
+          return false;
+      return true;
+    });
+    if (m_pendingStreams.empty()) {
+      if (!signaled)
+        throw(vpException(vpException::ioError, "usNetworkGrabberManager : no frame received before the timeout"));
+      throw(vpException(vpException::ioError, "usNetworkGrabberManager : acquisition stopped, or no stream connected"));
+    }
+    streamId = m_pendingStreams.front();
+  }
+  return acquireStream(streamId);
+}
+
+/**
+* Acquires the last frame of a stream, and marks the stream as acquired.
+* @param streamId Index of the stream.
+*/
+usNetworkGrabberManager::usStreamFrame usNetworkGrabberManager::acquireStream(unsigned int streamId)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_streams.at(streamId).pending = false;
+    m_pendingStreams.erase(std::remove(m_pendingStreams.begin(), m_pendingStreams.end(), streamId),
+                           m_pendingStreams.end());
+  }
+
+  usStream &stream = m_streams.at(streamId);
+  usStreamFrame frame;
+  frame.streamId = streamId;
+  frame.imageType = stream.imageType;
+  if (stream.imageType == us::PRESCAN_2D) {
+    frame.preScan2D = stream.preScanGrabber->acquire();
+    frame.frameCount = frame.preScan2D->getFrameCount();
+    frame.timeStamp = frame.preScan2D->getTimeStamp();
+  } else if (stream.imageType == us::POSTSCAN_2D) {
+    frame.postScan2D = stream.postScanGrabber->acquire();
+    frame.frameCount = frame.postScan2D->getFrameCount();
+    frame.timeStamp = frame.postScan2D->getTimeStamp();
+  } else {
+    frame.rf2D = stream.rfGrabber->acquire();
+    frame.frameCount = frame.rf2D->getFrameCount();
+    frame.timeStamp = frame.rf2D->getTimeStamp();
+  }
+  return frame;
+}
+
+/**
+* Adds a pre-scan stream. The grabber must be connected and its acquisition initialized.
+* @param grabber The grabber of the stream (not owned).
+* @return The index of the stream.
+*/
+unsigned int usNetworkGrabberManager::addStream(usNetworkGrabberPreScan2D *grabber)
+{
+  usStream stream;
+  stream.imageType = us::PRESCAN_2D;
+  stream.grabber = grabber;
+  stream.preScanGrabber = grabber;
+  stream.postScanGrabber = NULL;
+  stream.rfGrabber = NULL;
+  return addStream(stream);
+}
+
+/**
+* Adds a post-scan stream. The grabber must be connected and its acquisition initialized.
+* @param grabber The grabber of the stream (not owned).
+* @return The index of the stream.
+*/
+unsigned int usNetworkGrabberManager::addStream(usNetworkGrabberPostScan2D *grabber)
+{
+  usStream stream;
+  stream.imageType = us::POSTSCAN_2D;
+  stream.grabber = grabber;
+  stream.preScanGrabber = NULL;
+  stream.postScanGrabber = grabber;
+  stream.rfGrabber = NULL;
+  return addStream(stream);
+}
+
+/**
+* Adds a RF stream. The grabber must be connected and its acquisition initialized.
+* @param grabber The grabber of the stream (not owned).
+* @return The index of the stream.
+*/
+unsigned int usNetworkGrabberManager::addStream(usNetworkGrabberRF2D *grabber)
+{
+  usStream stream;
+  stream.imageType = us::RF_2D;
+  stream.grabber = grabber;
+  stream.preScanGrabber = NULL;
+  stream.postScanGrabber = NULL;
+  stream.rfGrabber = grabber;
+  return addStream(stream);
+}
+
+/**
+* Registers a stream, and moves its grabber in one of the event loop threads. The newFrameAvailable() signal of the
+* grabber is forwarded with the stream index by a relay, since several grabber threads signal the manager concurrently
+* (QObject::sender() is not valid from another thread).
+*/
+unsigned int usNetworkGrabberManager::addStream(const usStream &stream)
+{
+  unsigned int streamId;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    streamId = (unsigned int)m_streams.size();
+    m_streams.push_back(stream);
+    m_streams.back().pending = false;
+    m_streams.back().connected = true;
+    m_streams.back().ownerThread = stream.grabber->thread();
+    m_relays.push_back(new usNetworkGrabberStreamRelay(this, streamId));
+  }
+  connect(stream.grabber, SIGNAL(newFrameAvailable()), m_relays.back(), SLOT(frameAvailable()),
+          Qt::DirectConnection);
+  connect(stream.grabber, SIGNAL(serverDisconnected()), m_relays.back(), SLOT(disconnected()),
+          Qt::DirectConnection);
+  stream.grabber->setSharedThread(m_threads.at(streamId % m_threads.size()));
+  return streamId;
+}
+
+/**
+* Marks a stream as having a new frame. Called in the event loop thread of the grabber of the stream.
+* @param streamId Index of the stream.
+*/
+void usNetworkGrabberManager::frameAvailable(unsigned int streamId)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_streams.at(streamId).pending) {
+    m_streams.at(streamId).pending = true;
+    m_pendingStreams.push_back(streamId);
+  }
+  m_frameCondition.notify_all();
+}
+
+/**
+* Getter for the number of streams.
+*/
+unsigned int usNetworkGrabberManager::getStreamNumber() const { return (unsigned int)m_streams.size(); }
+
+/**
+* Getter for the number of event loop threads.
+*/
+unsigned int usNetworkGrabberManager::getThreadNumber() const { return (unsigned int)m_threads.size(); }
+
+/**
+* Getter for the maximal time waited for a frame by acquireAll() and acquireAny().
+* @return The timeout (milliseconds).
+*/
+double usNetworkGrabberManager::getTimeout() const { return m_timeout; }
+
+/**
+* Tells if a stream has a frame not acquired yet (non blocking).
+* @param streamId Index of the stream.
+*/
+bool usNetworkGrabberManager::isFrameAvailable(unsigned int streamId)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_streams.at(streamId).pending;
+}
+
+/**
+* Runs the acquisition of every stream.
+*/
+void usNetworkGrabberManager::runAcquisition()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = false;
+  }
+  for (unsigned int i = 0; i < m_streams.size(); i++)
+    m_streams.at(i).grabber->runAcquisition();
+}
+
+/**
+* Setter for the maximal time waited for a frame by acquireAll() and acquireAny() (1000 ms by default).
+* @param timeout The timeout (milliseconds).
+*/
+void usNetworkGrabberManager::setTimeout(double timeout)
+{
+  if (timeout <= 0)
+    throw(vpException(vpException::badValue, "usNetworkGrabberManager : the timeout must be positive"));
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_timeout = timeout;
+}
+
+/**
+* Stops the acquisition of every stream, and wakes up the threads waiting for a frame.
+*/
+void usNetworkGrabberManager::stopAcquisition()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = true;
+  }
+  m_frameCondition.notify_all();
+  for (unsigned int i = 0; i < m_streams.size(); i++)
+    m_streams.at(i).grabber->stopAcquisition();
+}
+
+/**
+* Marks a stream as disconnected, and wakes up the threads waiting for a frame.
+* @param streamId Index of the stream.
+*/
+void usNetworkGrabberManager::streamDisconnected(unsigned int streamId)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_streams.at(streamId).connected = false;
+  m_frameCondition.notify_all();
+}
+
+/**
+* Waits until the stream has a frame not acquired yet.
+* @param streamId Index of the stream.
+* @throw vpException::ioError If the stream has no new frame within the timeout, is disconnected, or if the
+* acquisition is stopped.
+*/
+void usNetworkGrabberManager::waitFrame(unsigned int streamId)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  const usStream &stream = m_streams.at(streamId);
+  bool signaled = m_frameCondition.wait_for(lock, std::chrono::duration<double, std::milli>(m_timeout), [&]() {
+    return stream.pending || !stream.connected || m_stopped;
+  });
+  if (!stream.pending) {
+    if (!signaled)
+      throw(vpException(vpException::ioError, "usNetworkGrabberManager : no frame received before the timeout"));
+    throw(vpException(vpException::ioError, "usNetworkGrabberManager : acquisition stopped, or stream disconnected"));
+  }
+}
+
+#endif
@@ -36,7 +36,9 @@
 #if defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT)
 
 #include <QtCore/QDataStream>
-#include <QtCore/QEventLoop>
+#include <visp3/ustk_core/usLatencyTracer.h>
+
+#include <algorithm>
 
 /**
 * Constructor. Inititializes the image, and manages Qt signal.
@@ -52,9 +54,14 @@ usNetworkGrabberPostScanBiPlan::usNetworkGrabberPostScanBiPlan(usNetworkGrabber
   m_outputBuffer2.push_back(new usFrameGrabbedInfo<usImagePostScan2D<unsigned char> >);
 
   m_bufferToFill = 1;
+  m_plane2TraceStream = usLatencyTracer::newStream();
 
   m_firstFrameAvailable = false;
 
+  m_outputPairIndex = 0;
+  m_mostRecentPairIndex = 0;
+  m_pairCount = 0;
+
   connect(m_tcpSocket, SIGNAL(readyRead()), this, SLOT(dataArrived()));
 }
 
@@ -120,6 +127,9 @@ void usNetworkGrabberPostScanBiPlan::dataArrived()
   else if (headerType == m_imageHeader.headerId) {
     // read whole header
     in >> m_imageHeader.frameCount;
+    m_traceId = usLatencyTracer::getTraceId(m_bufferToFill == 1 ? m_traceStream : m_plane2TraceStream,
+                                            m_imageHeader.frameCount);
+    usLatencyTracer::startTrace(m_traceId, "socket receive");
     quint64 timestamp;
     in >> timestamp;
     m_imageHeader.timeStamp = timestamp;
@@ -210,20 +220,8 @@ void usNetworkGrabberPostScanBiPlan::dataArrived()
                                         m_imageHeader.dataLength);
 
     if (m_bytesLeftToRead == 0) { // we've read all the frame in 1 packet.
-      // Now CURRENT_FILLED_FRAME_POSITION_IN_VEC has become the last frame received
-      // So we switch pointers beween MOST_RECENT_FRAME_POSITION_IN_VEC and CURRENT_FILLED_FRAME_POSITION_IN_VEC
-      {
-        usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *savePtr =
-            refOnBufferToFill->at(CURRENT_FILLED_FRAME_POSITION_IN_VEC);
-        refOnBufferToFill->at(CURRENT_FILLED_FRAME_POSITION_IN_VEC) =
-            refOnBufferToFill->at(MOST_RECENT_FRAME_POSITION_IN_VEC);
-        refOnBufferToFill->at(MOST_RECENT_FRAME_POSITION_IN_VEC) = savePtr;
-      }
-      m_bufferToFill = (m_bufferToFill == 1) ? 2 : 1;
-      if (m_bufferToFill == 1) { // we just read image 2
-        m_firstFrameAvailable = true;
-        emit(newFrameAvailable());
-      }
+      usLatencyTracer::checkpoint(m_traceId, "frame complete");
+      completeFrame();
     }
     if (m_verbose)
       std::cout << "Bytes left to read for whole frame = " << m_bytesLeftToRead << std::endl;
@@ -243,57 +241,87 @@ void usNetworkGrabberPostScanBiPlan::dataArrived()
                        m_bytesLeftToRead);
 
     if (m_bytesLeftToRead == 0) { // we've read the last part of the frame.
-      // Now CURRENT_FILLED_FRAME_POSITION_IN_VEC has become the last frame received
-      // So we switch pointers beween MOST_RECENT_FRAME_POSITION_IN_VEC and CURRENT_FILLED_FRAME_POSITION_IN_VEC
-      usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *savePtr =
-          refOnBufferToFill->at(CURRENT_FILLED_FRAME_POSITION_IN_VEC);
-      refOnBufferToFill->at(CURRENT_FILLED_FRAME_POSITION_IN_VEC) =
-          refOnBufferToFill->at(MOST_RECENT_FRAME_POSITION_IN_VEC);
-      refOnBufferToFill->at(MOST_RECENT_FRAME_POSITION_IN_VEC) = savePtr;
-      m_bufferToFill = (m_bufferToFill == 1) ? 2 : 1;
-      if (m_bufferToFill == 1) { // we just read image 2
-        m_firstFrameAvailable = true;
-        emit(newFrameAvailable());
-      }
+      usLatencyTracer::checkpoint(m_traceId, "frame complete");
+      completeFrame();
     }
   }
 }
 
 /**
-* Method to get the last frame received. The grabber is designed to avoid data copy (it is why you get a pointer on the
-* data).
-* @note This method is designed to be thread-safe, you can call it from another thread.
-* @return Pointer to the last frame acquired.
+* Called when a whole frame is received. The first plane stays at CURRENT_FILLED_FRAME_POSITION_IN_VEC until the second
+* plane is received : the two planes are then moved together to MOST_RECENT_FRAME_POSITION_IN_VEC, so that a pair is
+* never made of frames of different acquisitions.
 */
-std::vector<usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *> usNetworkGrabberPostScanBiPlan::acquire()
+void usNetworkGrabberPostScanBiPlan::completeFrame()
 {
-  // manage first frame or if user grabs too fast
-  if (!m_firstFrameAvailable ||
-      (m_outputBuffer1.at(OUTPUT_FRAME_POSITION_IN_VEC)->getFrameCount() >=
-           m_outputBuffer1.at(MOST_RECENT_FRAME_POSITION_IN_VEC)->getFrameCount() &&
-       m_outputBuffer2.at(OUTPUT_FRAME_POSITION_IN_VEC)->getFrameCount() >=
-           m_outputBuffer2.at(MOST_RECENT_FRAME_POSITION_IN_VEC)->getFrameCount())) {
-    // we wait until a new frame is available
-    QEventLoop loop;
-    loop.connect(this, SIGNAL(newFrameAvailable()), SLOT(quit()));
-    loop.exec();
+  if (m_bufferToFill == 1) { // we just read image 1, wait for image 2
+    m_bufferToFill = 2;
+    return;
   }
+  m_bufferToFill = 1;
 
-  // switch pointers
-  usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *savePtr = m_outputBuffer1.at(OUTPUT_FRAME_POSITION_IN_VEC);
-  m_outputBuffer1.at(OUTPUT_FRAME_POSITION_IN_VEC) = m_outputBuffer1.at(MOST_RECENT_FRAME_POSITION_IN_VEC);
-  m_outputBuffer1.at(MOST_RECENT_FRAME_POSITION_IN_VEC) = savePtr;
+  {
+    std::lock_guard<std::mutex> lock(m_pairMutex);
+    // Now CURRENT_FILLED_FRAME_POSITION_IN_VEC has become the last pair received
+    // So we switch pointers beween MOST_RECENT_FRAME_POSITION_IN_VEC and CURRENT_FILLED_FRAME_POSITION_IN_VEC
+    std::swap(m_outputBuffer1.at(CURRENT_FILLED_FRAME_POSITION_IN_VEC),
+              m_outputBuffer1.at(MOST_RECENT_FRAME_POSITION_IN_VEC));
+    std::swap(m_outputBuffer2.at(CURRENT_FILLED_FRAME_POSITION_IN_VEC),
+              m_outputBuffer2.at(MOST_RECENT_FRAME_POSITION_IN_VEC));
+    m_mostRecentPairIndex = ++m_pairCount;
+    m_firstFrameAvailable = true;
+    m_pairCondition.notify_all();
+  }
+  emit(newFrameAvailable());
+}
 
-  savePtr = m_outputBuffer2.at(OUTPUT_FRAME_POSITION_IN_VEC);
-  m_outputBuffer2.at(OUTPUT_FRAME_POSITION_IN_VEC) = m_outputBuffer2.at(MOST_RECENT_FRAME_POSITION_IN_VEC);
-  m_outputBuffer2.at(MOST_RECENT_FRAME_POSITION_IN_VEC) = savePtr;
+/**
+* Method to get the last frames received. The grabber is designed to avoid data copy (it is why you get pointers on the
+* data).
+* @note This method is designed to be thread-safe, you can call it from another thread.
+* @return Pointers to the two planes of the last pair acquired (see acquirePair()).
+*/
+std::vector<usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *> usNetworkGrabberPostScanBiPlan::acquire()
+{
+  usFramePair pair = acquirePair();
 
   // return the pointers on the two images
   std::vector<usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *> ret;
-  ret.push_back(m_outputBuffer1.at(OUTPUT_FRAME_POSITION_IN_VEC));
-  ret.push_back(m_outputBuffer2.at(OUTPUT_FRAME_POSITION_IN_VEC));
-  
+  ret.push_back(pair.plane1);
+  ret.push_back(pair.plane2);
   return ret;
 }
 
+/**
+* Method to get the last pair of frames received. The two planes come from the same acquisition, and are returned
+* without copy : they stay valid until the next call to acquirePair() or acquire().
+* @note This method is designed to be thread-safe, you can call it from another thread.
+* @return Pair of pointers on the two planes of the last acquisition, with its acquisition index.
+*/
+usNetworkGrabberPostScanBiPlan::usFramePair usNetworkGrabberPostScanBiPlan::acquirePair()
+{
+  usFramePair pair;
+  {
+    // manage first frame or if user grabs too fast : we wait until a new pair is available (the condition is checked
+    // under the mutex of the swaps, so a pair completed meanwhile cannot be missed)
+    std::unique_lock<std::mutex> lock(m_pairMutex);
+    m_pairCondition.wait(lock, [this] { return m_firstFrameAvailable && m_mostRecentPairIndex > m_outputPairIndex; });
+
+    // switch pointers of both planes
+    std::swap(m_outputBuffer1.at(OUTPUT_FRAME_POSITION_IN_VEC), m_outputBuffer1.at(MOST_RECENT_FRAME_POSITION_IN_VEC));
+    std::swap(m_outputBuffer2.at(OUTPUT_FRAME_POSITION_IN_VEC), m_outputBuffer2.at(MOST_RECENT_FRAME_POSITION_IN_VEC));
+    m_outputPairIndex = m_mostRecentPairIndex;
+
+    pair.index = m_outputPairIndex;
+    pair.plane1 = m_outputBuffer1.at(OUTPUT_FRAME_POSITION_IN_VEC);
+    pair.plane2 = m_outputBuffer2.at(OUTPUT_FRAME_POSITION_IN_VEC);
+  }
+
+  // processing done on this pair in the calling thread is traced on its second plane, received last
+  usLatencyTracer::setCurrentTraceId(usLatencyTracer::getTraceId(m_plane2TraceStream, pair.plane2->getFrameCount()));
+  usLatencyTracer::checkpoint("acquire");
+
+  return pair;
+}
+
 #endif
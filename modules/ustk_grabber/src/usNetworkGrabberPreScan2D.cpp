@@ -37,6 +37,7 @@
 
 #include <QtCore/QDataStream>
 #include <QtCore/QEventLoop>
+#include <visp3/ustk_core/usLatencyTracer.h>
 #include <visp3/ustk_core/usImageIo.h>
 
 /**
@@ -112,6 +113,8 @@ void usNetworkGrabberPreScan2D::dataArrived()
   else if (headerType == m_imageHeader.headerId) {
     // read whole header
     in >> m_imageHeader.frameCount;
+    m_traceId = usLatencyTracer::getTraceId(m_traceStream, m_imageHeader.frameCount);
+    usLatencyTracer::startTrace(m_traceId, "socket receive");
     quint64 timestamp;
     in >> timestamp;
     m_imageHeader.timeStamp = timestamp;
@@ -190,6 +193,7 @@ void usNetworkGrabberPreScan2D::dataArrived()
     m_bytesLeftToRead -= in.readRawData((char *)m_grabbedImage.bitmap, m_imageHeader.dataLength);
 
     if (m_bytesLeftToRead == 0) { // we've read all the frame in 1 packet.
+      usLatencyTracer::checkpoint(m_traceId, "frame complete");
       invertRowsCols();
     }
     if (m_verbose)
@@ -207,6 +211,7 @@ void usNetworkGrabberPreScan2D::dataArrived()
                                         m_bytesLeftToRead);
 
     if (m_bytesLeftToRead == 0) { // we've read the last part of the frame.
+      usLatencyTracer::checkpoint(m_traceId, "frame complete");
       invertRowsCols();
     }
   }
@@ -244,7 +249,7 @@ void usNetworkGrabberPreScan2D::invertRowsCols()
 
   m_firstFrameAvailable = true;
   emit(newFrameAvailable());
-  emit(newFrame(*m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC)));
+  emit(newFrame(*m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC), m_traceId));
 }
 
 /**
@@ -270,6 +275,11 @@ usFrameGrabbedInfo<usImagePreScan2D<unsigned char> > *usNetworkGrabberPreScan2D:
   m_outputBuffer.at(OUTPUT_FRAME_POSITION_IN_VEC) = m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC);
   m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC) = savePtr;
 
+  // processing done on this frame in the calling thread is traced on its frame count
+  usLatencyTracer::setCurrentTraceId(
+      usLatencyTracer::getTraceId(m_traceStream, m_outputBuffer.at(OUTPUT_FRAME_POSITION_IN_VEC)->getFrameCount()));
+  usLatencyTracer::checkpoint("acquire");
+
   return m_outputBuffer.at(OUTPUT_FRAME_POSITION_IN_VEC);
 }
 
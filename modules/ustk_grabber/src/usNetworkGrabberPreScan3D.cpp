@@ -35,8 +35,11 @@
 
 #if defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT)
 
+#include <algorithm>
+
 #include <QtCore/QDataStream>
 #include <QtCore/QEventLoop>
+#include <visp3/ustk_core/usLatencyTracer.h>
 /**
 * Constructor. Inititializes the image, and manages Qt signal.
 */
@@ -52,6 +55,8 @@ usNetworkGrabberPreScan3D::usNetworkGrabberPreScan3D(usNetworkGrabber *parent)
 
   m_firstFrameAvailable = false;
   m_firstVolumeAvailable = false;
+  m_outputTraceId = 0;
+  m_mostRecentTraceId = 0;
 
   m_recordingOn = false;
   m_firstImageTimestamp = 0;
@@ -114,6 +119,8 @@ void usNetworkGrabberPreScan3D::dataArrived()
   else if (headerType == m_imageHeader.headerId) {
     // read whole header
     in >> m_imageHeader.frameCount;
+    m_traceId = usLatencyTracer::getTraceId(m_traceStream, m_imageHeader.frameCount);
+    usLatencyTracer::startTrace(m_traceId, "socket receive");
     quint64 timestamp;
     in >> timestamp;
     m_imageHeader.timeStamp = timestamp;
@@ -199,6 +206,7 @@ void usNetworkGrabberPreScan3D::dataArrived()
     m_bytesLeftToRead -= in.readRawData((char *)m_grabbedImage.bitmap, m_imageHeader.dataLength);
 
     if (m_bytesLeftToRead == 0) { // we've read all the frame in 1 packet.
+      usLatencyTracer::checkpoint(m_traceId, "frame complete");
       includeFrameInVolume();
     }
     if (m_verbose)
@@ -216,6 +224,7 @@ void usNetworkGrabberPreScan3D::dataArrived()
                                         m_bytesLeftToRead);
 
     if (m_bytesLeftToRead == 0) { // we've read the last part of the frame.
+      usLatencyTracer::checkpoint(m_traceId, "frame complete");
       includeFrameInVolume();
     }
   }
@@ -294,6 +303,8 @@ void usNetworkGrabberPreScan3D::includeFrameInVolume()
       m_sequenceWriter.write(*m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC), timestampsToWrite);
     }
     
+    // the volume is traced on the frame count of its last frame, as received in the frame header
+    m_mostRecentTraceId = m_traceId;
     m_firstVolumeAvailable = true;
     emit(newVolumeAvailable());
   }
@@ -346,6 +357,11 @@ usVolumeGrabbedInfo<usImagePreScan3D<unsigned char> > *usNetworkGrabberPreScan3D
   usVolumeGrabbedInfo<usImagePreScan3D<unsigned char> > *savePtr = m_outputBuffer.at(OUTPUT_FRAME_POSITION_IN_VEC);
   m_outputBuffer.at(OUTPUT_FRAME_POSITION_IN_VEC) = m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC);
   m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC) = savePtr;
+  std::swap(m_outputTraceId, m_mostRecentTraceId);
+
+  // processing done on this volume in the calling thread is traced on the frame count of its last frame
+  usLatencyTracer::setCurrentTraceId(m_outputTraceId);
+  usLatencyTracer::checkpoint("acquire");
 
   return m_outputBuffer.at(OUTPUT_FRAME_POSITION_IN_VEC);
 }
@@ -37,6 +37,7 @@
 
 #include <QtCore/QDataStream>
 #include <QtCore/QEventLoop>
+#include <visp3/ustk_core/usLatencyTracer.h>
 /**
 * Constructor. Inititializes the image, and manages Qt signal.
 */
@@ -109,6 +110,8 @@ void usNetworkGrabberRF2D::dataArrived()
   else if (headerType == m_imageHeader.headerId) {
     // read whole header
     in >> m_imageHeader.frameCount;
+    m_traceId = usLatencyTracer::getTraceId(m_traceStream, m_imageHeader.frameCount);
+    usLatencyTracer::startTrace(m_traceId, "socket receive");
     quint64 timestamp;
     in >> timestamp;
     m_imageHeader.timeStamp = timestamp;
@@ -195,6 +198,7 @@ void usNetworkGrabberRF2D::dataArrived()
                                         m_imageHeader.dataLength);
 
     if (m_bytesLeftToRead == 0) { // we've read all the frame in 1 packet.
+      usLatencyTracer::checkpoint(m_traceId, "frame complete");
       // Now CURRENT_FILLED_FRAME_POSITION_IN_VEC has become the last frame received
       // So we switch pointers beween MOST_RECENT_FRAME_POSITION_IN_VEC and CURRENT_FILLED_FRAME_POSITION_IN_VEC
       usFrameGrabbedInfo<usImageRF2D<short int> > *savePtr = m_outputBuffer.at(CURRENT_FILLED_FRAME_POSITION_IN_VEC);
@@ -207,7 +211,7 @@ void usNetworkGrabberRF2D::dataArrived()
 
       m_firstFrameAvailable = true;
       emit(newFrameAvailable());
-      emit(newFrame(*m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC)));
+      emit(newFrame(*m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC), m_traceId));
     }
     if (m_verbose)
       std::cout << "Bytes left to read for whole frame = " << m_bytesLeftToRead << std::endl;
@@ -230,6 +234,7 @@ void usNetworkGrabberRF2D::dataArrived()
       std::cout << "Bytes left to read for whole frame = " << m_bytesLeftToRead << std::endl;
 
     if (m_bytesLeftToRead == 0) { // we've read the last part of the frame.
+      usLatencyTracer::checkpoint(m_traceId, "frame complete");
       // Now CURRENT_FILLED_FRAME_POSITION_IN_VEC has become the last frame received
       // So we switch pointers beween MOST_RECENT_FRAME_POSITION_IN_VEC and CURRENT_FILLED_FRAME_POSITION_IN_VEC
       usFrameGrabbedInfo<usImageRF2D<short int> > *savePtr = m_outputBuffer.at(CURRENT_FILLED_FRAME_POSITION_IN_VEC);
@@ -242,7 +247,7 @@ void usNetworkGrabberRF2D::dataArrived()
 
       m_firstFrameAvailable = true;
       emit(newFrameAvailable());
-      emit(newFrame(*m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC)));
+      emit(newFrame(*m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC), m_traceId));
     }
   }
 }
@@ -270,6 +275,11 @@ usFrameGrabbedInfo<usImageRF2D<short int> > *usNetworkGrabberRF2D::acquire()
   m_outputBuffer.at(OUTPUT_FRAME_POSITION_IN_VEC) = m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC);
   m_outputBuffer.at(MOST_RECENT_FRAME_POSITION_IN_VEC) = savePtr;
 
+  // processing done on this frame in the calling thread is traced on its frame count
+  usLatencyTracer::setCurrentTraceId(
+      usLatencyTracer::getTraceId(m_traceStream, m_outputBuffer.at(OUTPUT_FRAME_POSITION_IN_VEC)->getFrameCount()));
+  usLatencyTracer::checkpoint("acquire");
+
   return m_outputBuffer.at(OUTPUT_FRAME_POSITION_IN_VEC);
 }
 
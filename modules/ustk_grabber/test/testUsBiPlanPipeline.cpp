@@ -0,0 +1,192 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include <iostream>
+
+#include <iostream>
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT)
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <QtCore/QCoreApplication>
+
+#include <visp3/core/vpException.h>
+#include <visp3/ustk_grabber/usBiPlanPipeline.h>
+
+/**
+ * Bi-plane grabber receiving its planes from the test instead of the network.
+ */
+class usTestGrabberBiPlan : public usNetworkGrabberPostScanBiPlan
+{
+public:
+  // fills the two planes of an acquisition in the buffers, as dataArrived() does
+  void receivePair(quint32 frameCount)
+  {
+    for (unsigned int plane = 0; plane < 2; plane++) {
+      std::vector<usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *> &buffer =
+          m_bufferToFill == 1 ? m_outputBuffer1 : m_outputBuffer2;
+      buffer.at(CURRENT_FILLED_FRAME_POSITION_IN_VEC)->setFrameCount(frameCount);
+      completeFrame();
+    }
+  }
+};
+
+/* -------------------------------------------------------------------------- */
+/*                               MAIN FUNCTION                                */
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+  QCoreApplication app(argc, argv);
+
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << "  testUsBiPlanPipeline.cpp" << std::endl << std::endl;
+  std::cout << "  The test feeds pairs of planes to the bi-plane grabber and processes them with the pipeline. It"
+               "  checks the order of the pairs, that a slow consumer gets the last pair, and the shutdown of the"
+               "  pipeline (no network connection needed)."
+            << std::endl;
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << std::endl;
+
+  bool testFailed = false;
+
+  usTestGrabberBiPlan grabber;
+  std::vector<quint32> plane1Counts, plane2Counts;
+  {
+    usBiPlanPipeline pipeline;
+    pipeline.setPlaneProcessing(1, [&](usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > &frame) {
+      plane1Counts.push_back(frame.getFrameCount());
+    });
+    pipeline.setPlaneProcessing(2, [&](usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > &frame) {
+      plane2Counts.push_back(frame.getFrameCount());
+    });
+
+    // pairs acquired as fast as they arrive are processed in order, both planes of the same acquisition
+    for (quint32 n = 1; n <= 10; n++) {
+      grabber.receivePair(100 + n);
+      usNetworkGrabberPostScanBiPlan::usFramePair pair = grabber.acquirePair();
+      pipeline.process(pair);
+      if (pair.index != n || pipeline.getLastPairIndex() != n || plane1Counts.back() != 100 + n ||
+          plane2Counts.back() != 100 + n) {
+        std::cout << "Pair " << n << " : wrong index " << pair.index << " or frames " << plane1Counts.back() << ", "
+                  << plane2Counts.back() << std::endl;
+        testFailed = true;
+      }
+    }
+
+    // a slow consumer drops the pairs received meanwhile, and gets the last one
+    for (quint32 n = 11; n <= 15; n++)
+      grabber.receivePair(100 + n);
+    usNetworkGrabberPostScanBiPlan::usFramePair pair = grabber.acquirePair();
+    pipeline.process(pair);
+    if (pair.index != 15 || plane1Counts.back() != 115 || plane2Counts.back() != 115 || plane1Counts.size() != 11) {
+      std::cout << "The slow consumer should get pair 15 only, got pair " << pair.index << std::endl;
+      testFailed = true;
+    }
+
+    // acquirePair() waits for the next pair, received from another thread
+    std::atomic<bool> acquired(false);
+    std::thread consumer([&]() {
+      pair = grabber.acquirePair();
+      acquired = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    if (acquired) {
+      std::cout << "acquirePair() should wait for a new pair" << std::endl;
+      testFailed = true;
+    }
+    grabber.receivePair(116);
+    consumer.join();
+    if (pair.index != 16 || pair.plane1->getFrameCount() != 116 || pair.plane2->getFrameCount() != 116) {
+      std::cout << "acquirePair() should return pair 16, got pair " << pair.index << std::endl;
+      testFailed = true;
+    }
+
+    // concurrent network thread and slow consumer : increasing indexes, planes of the same acquisition, and the last
+    // pair is always acquired (no lost wake-up)
+    const quint32 lastCount = 1000;
+    std::thread network([&]() {
+      for (quint32 n = 117; n <= lastCount; n++) {
+        grabber.receivePair(n);
+        if (n % 16 == 0)
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    });
+    pipeline.setPlaneProcessing(1, [&](usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > &frame) {
+      plane1Counts.push_back(frame.getFrameCount());
+      std::this_thread::sleep_for(std::chrono::microseconds(300));
+    });
+    quint32 lastIndex = pair.index;
+    do {
+      pair = grabber.acquirePair();
+      pipeline.process(pair);
+      if (pair.index <= lastIndex || plane1Counts.back() != plane2Counts.back() ||
+          plane1Counts.back() != pair.index + 100) {
+        std::cout << "Pair " << pair.index << " out of order, or planes of different acquisitions" << std::endl;
+        testFailed = true;
+      }
+      lastIndex = pair.index;
+    } while (plane2Counts.back() != lastCount && !testFailed);
+    network.join();
+
+    // an exception of a plane processing reaches the caller once both planes are processed
+    pipeline.setPlaneProcessing(1, [](usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > &) {
+      throw(vpException(vpException::fatalError, "plane 1 failure"));
+    });
+    size_t plane2Size = plane2Counts.size();
+    grabber.receivePair(lastCount + 1);
+    try {
+      pipeline.process(grabber.acquirePair());
+      std::cout << "The exception of the first plane should be thrown by process()" << std::endl;
+      testFailed = true;
+    } catch (const vpException &) {
+    }
+    if (plane2Counts.size() != plane2Size + 1) {
+      std::cout << "The second plane should be processed" << std::endl;
+      testFailed = true;
+    }
+  } // the pipeline stops its worker thread
+
+  if (testFailed)
+    return 1;
+  std::cout << "Test succeeded" << std::endl;
+  return 0;
+}
+
+#else
+int main() { std::cout << "Install Qt5 to run this test." << std::endl; }
+#endif
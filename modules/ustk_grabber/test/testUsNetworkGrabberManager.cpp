@@ -0,0 +1,154 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include <iostream>
+
+#include <visp3/ustk_core/usConfig.h>
+
+#if defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT)
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QMetaObject>
+
+#include <visp3/core/vpException.h>
+#include <visp3/ustk_grabber/usNetworkGrabberManager.h>
+
+/* -------------------------------------------------------------------------- */
+/*                               MAIN FUNCTION                                */
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+  QCoreApplication app(argc, argv);
+
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << "  testUsNetworkGrabberManager.cpp" << std::endl << std::endl;
+  std::cout << "  The test signals new frames on two of three streams from concurrent threads, and checks that the"
+               "  manager marks the right streams. It then checks that waiting for a frame times out, and that"
+               "  stopping the acquisition wakes up the waiting thread (no network connection needed)."
+            << std::endl;
+  std::cout << "-------------------------------------------------------" << std::endl;
+  std::cout << std::endl;
+
+  bool testFailed = false;
+
+  usNetworkGrabberPreScan2D preScanGrabber;
+  usNetworkGrabberPostScan2D postScanGrabber;
+  usNetworkGrabberRF2D rfGrabber;
+  {
+    usNetworkGrabberManager manager(2);
+    if (manager.addStream(&preScanGrabber) != 0 || manager.addStream(&postScanGrabber) != 1 ||
+        manager.addStream(&rfGrabber) != 2) {
+      std::cout << "Wrong stream indexes" << std::endl;
+      return 1;
+    }
+    if (manager.getStreamNumber() != 3 || manager.getThreadNumber() != 2) {
+      std::cout << "Wrong stream or thread number" << std::endl;
+      return 1;
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+      if (manager.isFrameAvailable(i)) {
+        std::cout << "Stream " << i << " has a frame before any signal" << std::endl;
+        testFailed = true;
+      }
+    }
+
+    // the grabbers signal their frames from their own threads, concurrently
+    std::vector<QObject *> signaling;
+    signaling.push_back(&preScanGrabber);
+    signaling.push_back(&rfGrabber);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < signaling.size(); t++) {
+      QObject *grabber = signaling.at(t);
+      threads.push_back(std::thread([grabber]() {
+        for (unsigned int n = 0; n < 1000; n++)
+          QMetaObject::invokeMethod(grabber, "newFrameAvailable", Qt::DirectConnection);
+      }));
+    }
+    for (unsigned int t = 0; t < threads.size(); t++)
+      threads.at(t).join();
+
+    bool expected[3] = {true, false, true};
+    for (unsigned int i = 0; i < 3; i++) {
+      if (manager.isFrameAvailable(i) != expected[i]) {
+        std::cout << "Stream " << i << (expected[i] ? " should" : " should not") << " have a frame available"
+                  << std::endl;
+        testFailed = true;
+      }
+    }
+  }
+
+  // the grabber is back in the main thread, and can be managed again
+  {
+    usNetworkGrabberManager manager(1);
+    manager.addStream(&preScanGrabber);
+    manager.setTimeout(50);
+    std::vector<usNetworkGrabberManager::usStreamFrame> frameSet;
+    try {
+      manager.acquireAll(frameSet, 20.0);
+      std::cout << "acquireAll() should time out without frames" << std::endl;
+      testFailed = true;
+    } catch (const vpException &) {
+    }
+
+    manager.setTimeout(60000);
+    std::thread stopping([&manager]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      manager.stopAcquisition();
+    });
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try {
+      manager.acquireAny();
+      std::cout << "acquireAny() should throw once the acquisition is stopped" << std::endl;
+      testFailed = true;
+    } catch (const vpException &) {
+    }
+    stopping.join();
+    if (std::chrono::steady_clock::now() - start > std::chrono::seconds(10)) {
+      std::cout << "stopAcquisition() did not wake up acquireAny()" << std::endl;
+      testFailed = true;
+    }
+  }
+
+  if (testFailed)
+    return 1;
+  std::cout << "Test succeeded" << std::endl;
+  return 0;
+}
+
+#else
+int main() { std::cout << "Install Qt5 to run this test." << std::endl; }
+#endif
@@ -43,6 +43,7 @@
 
 #if (defined(USTK_HAVE_VTK_QT) || defined(USTK_HAVE_QT5)) && defined(VISP_HAVE_MODULE_USTK_CONFIDENCE_MAP)
 
+#include <visp3/ustk_confidence_map/usRandomWalkConfidence2D.h>
 #include <visp3/ustk_confidence_map/usScanlineConfidence2D.h>
 
 #include <QObject>
@@ -71,13 +72,16 @@ signals:
 public slots:
   void updateImage(usImagePreScan2D<unsigned char> image);
   void activateController(bool activate);
+  void activateRandomWalkConfidence(bool activate);
 
 private:
   usScanlineConfidence2D m_confidenceProcessor;
+  usRandomWalkConfidence2D m_randomWalkProcessor;
   usImagePreScan2D<unsigned char> m_confidenceMap;
 
   double m_gain;
   bool m_activated;
+  bool m_randomWalk;
 };
 #endif
 #endif // __uusConfidenceMapController_h_
@@ -68,6 +68,7 @@ public:
 
 public slots:
   void updateFrame(const vpImage<vpRGBa> elastographyImage);
+  void updateFrame(const vpImage<vpRGBa> elastographyImage, quint64 traceId);
 
 private:
   QLabel *m_label;
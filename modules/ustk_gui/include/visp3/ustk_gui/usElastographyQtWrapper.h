@@ -44,19 +44,22 @@
 #if (defined(USTK_HAVE_VTK_QT) || defined(USTK_HAVE_QT5)) && defined(VISP_HAVE_MODULE_USTK_ELASTOGRAPHY)
 
 #include <QObject>
-#include <visp3/ustk_elastography/usElastography.h>
+#include <visp3/ustk_elastography/usElastographyPipeline.h>
 
 /**
  * @class usElastographyQtWrapper
  * @brief Qt wrapper for usElastography class.
  * @ingroup module_ustk_gui
+ *
+ * The strain maps are computed by a usElastographyPipeline : updateFrame() returns immediately, and elastoReady() is
+ * emitted from a worker thread for each strain map, in the order of the frames.
  */
 
 class VISP_EXPORT usElastographyQtWrapper : public QObject
 {
   Q_OBJECT
 public:
-  usElastographyQtWrapper();
+  explicit usElastographyQtWrapper(unsigned int workerNumber = 2);
   ~usElastographyQtWrapper();
 
   void setROI(int tx, int ty, int tw, int th);
@@ -68,7 +71,7 @@ signals:
   void elastoReady(vpImage<unsigned char>);
 
 private:
-  usElastography m_elastography;
+  usElastographyPipeline m_elastography;
 };
 #endif // QT && FFTW
 #endif // __usElastographyQtWrapper_h_
@@ -72,6 +72,9 @@ public slots:
   void updateFrame(const vpImage<unsigned char> img);
   void updateFrame(const usImagePreScan2D<unsigned char> img);
   void updateFrame(const usImagePostScan2D<unsigned char> img);
+  void updateFrame(const vpImage<unsigned char> img, quint64 traceId);
+  void updateFrame(const usImagePreScan2D<unsigned char> img, quint64 traceId);
+  void updateFrame(const usImagePostScan2D<unsigned char> img, quint64 traceId);
 
 protected:
   QLabel *m_label;
@@ -65,6 +65,7 @@ public:
 
 public slots:
   void updateFrame(usImageRF2D<short int> &img);
+  void updateFrame(usImageRF2D<short int> &img, quint64 traceId);
   void setROI(unsigned int i, unsigned int j, unsigned int height, unsigned int width);
 
 private slots:
@@ -43,7 +43,8 @@
 * Constructor.
 */
 usConfidenceMapController::usConfidenceMapController(QObject *parent)
-  : QObject(parent), m_confidenceProcessor(), m_confidenceMap(), m_gain(5), m_activated(false)
+  : QObject(parent), m_confidenceProcessor(), m_randomWalkProcessor(), m_confidenceMap(), m_gain(5), m_activated(false),
+    m_randomWalk(false)
 {
 }
 
@@ -51,7 +52,10 @@ usConfidenceMapController::~usConfidenceMapController() {}
 
 void usConfidenceMapController::updateImage(usImagePreScan2D<unsigned char> image)
 {
-  m_confidenceProcessor.run(m_confidenceMap, image);
+  if (m_randomWalk)
+    m_randomWalkProcessor.run(m_confidenceMap, image);
+  else
+    m_confidenceProcessor.run(m_confidenceMap, image);
 
   // robot orientation control law
 
@@ -87,4 +91,16 @@ double usConfidenceMapController::getPropotionnalControlGain() const { return m_
 
 void usConfidenceMapController::activateController(bool activate) { m_activated = activate; }
 
+/**
+* Choose the confidence map used by the control law.
+* @param activate If true, the random walk confidence map (usRandomWalkConfidence2D) is used instead of the scanline
+* confidence map (usScanlineConfidence2D).
+*/
+void usConfidenceMapController::activateRandomWalkConfidence(bool activate)
+{
+  if (activate && !m_randomWalk)
+    m_randomWalkProcessor.reset();
+  m_randomWalk = activate;
+}
+
 #endif
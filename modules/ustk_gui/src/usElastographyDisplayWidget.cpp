@@ -36,6 +36,7 @@
 */
 
 #include <visp3/ustk_gui/usElastographyDisplayWidget.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 #ifdef VISP_HAVE_OPENMP
 #include <omp.h>
 #endif
@@ -89,6 +90,19 @@ void usElastographyDisplayWidget::updateFrame(const vpImage<vpRGBa> elastography
   m_label->update();
 }
 
+/**
+* Slot called to update the elastography image to display, recording the "display" checkpoint of the frame in
+* usLatencyTracer. The trace ID is given explicitly since the slot usually runs in the GUI thread, not in the thread
+* that acquired the frame.
+* @param elastographyImage New elastography image to display.
+* @param traceId Trace ID of the frame (see usLatencyTracer::getTraceId()).
+*/
+void usElastographyDisplayWidget::updateFrame(const vpImage<vpRGBa> elastographyImage, quint64 traceId)
+{
+  updateFrame(elastographyImage);
+  usLatencyTracer::checkpoint(traceId, "display");
+}
+
 void usElastographyDisplayWidget::resizeEvent(QResizeEvent *event)
 {
   m_label->resize(event->size());
@@ -41,13 +41,20 @@
 
 /**
 * Constructor.
+* @param workerNumber Number of frame pairs processed concurrently.
 */
-usElastographyQtWrapper::usElastographyQtWrapper() : QObject(), m_elastography() {}
+usElastographyQtWrapper::usElastographyQtWrapper(unsigned int workerNumber) : QObject(), m_elastography(workerNumber)
+{
+  // the strain maps are emitted from the worker threads
+  qRegisterMetaType<vpImage<unsigned char> >("vpImage<unsigned char>");
+  m_elastography.setStrainMapCallback(
+      [this](const vpImage<unsigned char> &strainMap, unsigned int) { emit elastoReady(strainMap); });
+}
 
 /**
 * Destructor.
 */
-usElastographyQtWrapper::~usElastographyQtWrapper() {}
+usElastographyQtWrapper::~usElastographyQtWrapper() { m_elastography.stop(); }
 
 /**
 * ROI setter, coordinates are set in RF image pixel coordinates.
@@ -60,15 +67,9 @@ void usElastographyQtWrapper::setROI(int tx, int ty, int tw, int th) { m_elastog
 
 /**
 * Slot to update the RF frame as input for elastography. The elastography is computed between the previous frame and the
-* new one.
+* new one, elastoReady() is emitted when it is available.
 * @param img New RF image input for elastography computation.
 */
-void usElastographyQtWrapper::updateFrame(const usImageRF2D<short int> &img)
-{
-  m_elastography.updateRF(img);
-  vpImage<unsigned char> elasto = m_elastography.run();
-  if (elasto.getHeight() != 0 && elasto.getWidth() != 0)
-    emit elastoReady(elasto);
-}
+void usElastographyQtWrapper::updateFrame(const usImageRF2D<short int> &img) { m_elastography.pushFrame(img); }
 
 #endif
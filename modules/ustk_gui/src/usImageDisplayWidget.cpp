@@ -36,6 +36,7 @@
 */
 
 #include <visp3/ustk_gui/usImageDisplayWidget.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
 
 #if (defined(USTK_HAVE_VTK_QT) || defined(USTK_HAVE_QT5))
 
@@ -113,6 +114,43 @@ void usImageDisplayWidget::updateFrame(const usImagePreScan2D<unsigned char> img
   m_label->update();
 }
 
+/**
+* Slot called to update the ultrasound image to display, recording the "display" checkpoint of the frame in
+* usLatencyTracer. The trace ID is given explicitly since the slot usually runs in the GUI thread, not in the thread
+* that acquired the frame.
+* @param img New ultrasound image to display.
+* @param traceId Trace ID of the frame (see usNetworkGrabberPreScan2D::newFrame() and usLatencyTracer::getTraceId()).
+*/
+void usImageDisplayWidget::updateFrame(const vpImage<unsigned char> img, quint64 traceId)
+{
+  updateFrame(img);
+  usLatencyTracer::checkpoint(traceId, "display");
+}
+
+/**
+* Slot called to update the pre-scan image to display, recording the "display" checkpoint of the frame in
+* usLatencyTracer.
+* @param img New ultrasound image to display.
+* @param traceId Trace ID of the frame (see usLatencyTracer::getTraceId()).
+*/
+void usImageDisplayWidget::updateFrame(const usImagePreScan2D<unsigned char> img, quint64 traceId)
+{
+  updateFrame(img);
+  usLatencyTracer::checkpoint(traceId, "display");
+}
+
+/**
+* Slot called to update the post-scan image to display, recording the "display" checkpoint of the frame in
+* usLatencyTracer.
+* @param img New ultrasound image to display.
+* @param traceId Trace ID of the frame (see usLatencyTracer::getTraceId()).
+*/
+void usImageDisplayWidget::updateFrame(const usImagePostScan2D<unsigned char> img, quint64 traceId)
+{
+  updateFrame(img);
+  usLatencyTracer::checkpoint(traceId, "display");
+}
+
 void usImageDisplayWidget::resizeEvent(QResizeEvent *event)
 {
   m_label->resize(event->size());
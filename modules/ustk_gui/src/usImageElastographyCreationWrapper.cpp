@@ -40,6 +40,8 @@
 
 #if (defined(USTK_HAVE_VTK_QT) || defined(USTK_HAVE_QT5)) && defined(VISP_HAVE_MODULE_USTK_ELASTOGRAPHY)
 
+#include <visp3/ustk_core/usLatencyTracer.h>
+
 /**
 * Constructor.
 */
@@ -82,6 +84,18 @@ void usImageElastographyCreationWrapper::updateFrame(usImageRF2D<short int> &img
   qApp->processEvents();
 }
 
+/**
+* Slot to update the RF frame, tracing the RF conversion and the elastography of the frame in usLatencyTracer. The
+* trace ID is given explicitly since the slot usually runs in another thread than the grabber.
+* @param img New RF image input for elastography computation and RF conversion.
+* @param traceId Trace ID of the frame (see usNetworkGrabberRF2D::newFrame() and usLatencyTracer::getTraceId()).
+*/
+void usImageElastographyCreationWrapper::updateFrame(usImageRF2D<short int> &img, quint64 traceId)
+{
+  usLatencyTracer::setCurrentTraceId(traceId);
+  updateFrame(img);
+}
+
 /**
 * Private slot called when the strain map is ready.
 * @param image New strain map computed by usElastographyQtWrapper.
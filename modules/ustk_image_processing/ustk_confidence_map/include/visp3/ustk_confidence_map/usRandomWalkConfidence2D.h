@@ -0,0 +1,134 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Pierre Chatelain
+ * Alexandre Krupa
+ *
+ *****************************************************************************/
+
+#ifndef __usRandomWalkConfidence2D_h_
+#define __usRandomWalkConfidence2D_h_
+
+#include <vector>
+
+#include <visp3/ustk_core/usImagePreScan2D.h>
+
+/**
+* @class usRandomWalkConfidence2D
+* @brief Process a pre-scan image to determine the random walk confidence map.
+* @ingroup module_ustk_confidence_map
+*
+* The confidence of a sample is the probability that a random walk starting from it reaches the transducer (first
+* row of the pre-scan image) before the end of the scanlines (last row), see \cite Karamalis12a. The walks follow the
+* graph of the 8-connected samples, whose edges are weighted by the similarity of the attenuation-compensated
+* intensities, the edges across the scanlines being penalized.
+*
+* The probabilities are the solution of a sparse linear system built on the Laplacian of the graph, directly in
+* pre-scan geometry. The weights span several orders of magnitude (speckle, shadows) and the edges along the scanlines
+* are much stronger than the ones across them, so the system is solved by a conjugate gradient preconditioned by a
+* geometric multigrid V-cycle designed for this case :
+* - relaxation by scanline (exact solve of the tridiagonal system of each scanline, even and odd scanlines
+*   alternately),
+* - coarsening across the scanlines only, the scanlines being merged by pairs until a single one remains,
+* - interpolation weighted by the couplings between the scanlines, and Galerkin coarse operators.
+*
+* The solution of the previous frame is used as initial guess, so that only a few iterations are needed on a
+* sequence.
+*
+* The result can be used instead of usScanlineConfidence2D, for instance to control the probe orientation (see
+* usConfidenceMapController).
+*/
+class VISP_EXPORT usRandomWalkConfidence2D
+{
+
+public:
+  usRandomWalkConfidence2D();
+
+  virtual ~usRandomWalkConfidence2D();
+
+  double getAlpha() const;
+  double getBeta() const;
+  double getGamma() const;
+  unsigned int getIterationNumber() const;
+  unsigned int getMaxIterationNumber() const;
+  double getTolerance() const;
+
+  void reset();
+
+  void run(usImagePreScan2D<unsigned char> &preScanConfidence, const usImagePreScan2D<unsigned char> &preScanImage);
+
+  void setAlpha(double alpha);
+  void setBeta(double beta);
+  void setGamma(double gamma);
+  void setMaxIterationNumber(unsigned int maxIterationNumber);
+  void setTolerance(double tolerance);
+
+private:
+  /**
+  * Grid of the multigrid hierarchy. The unknowns are ordered scanline by scanline (index j * height + i), each one
+  * having a 9-point stencil (index (di + 1) * 3 + dj + 1 for the neighbour (i + di, j + dj)).
+  */
+  struct usLevel {
+    unsigned int height;
+    unsigned int width;
+    std::vector<double> stencil;
+    std::vector<double> lineFactor;     /**< Upper coefficients of the factorized scanline systems */
+    std::vector<double> lineInvPivot;   /**< Inverse pivots of the factorized scanline systems */
+    std::vector<double> interpolationW; /**< Weight of the coarse scanline j / 2 in the interpolation of j */
+    std::vector<double> interpolationE; /**< Weight of the coarse scanline j / 2 + 1 in the interpolation of j */
+    std::vector<double> solution;
+    std::vector<double> rhs;
+    std::vector<double> residual;
+  };
+
+  void applyOperator(const usLevel &level, const std::vector<double> &x, std::vector<double> &y) const;
+  void buildGraph(const usImagePreScan2D<unsigned char> &preScanImage);
+  void buildHierarchy();
+  double dot(const std::vector<double> &x, const std::vector<double> &y) const;
+  void factorizeScanlines(usLevel &level) const;
+  void relax(usLevel &level, unsigned int firstParity) const;
+  void relaxScanline(usLevel &level, unsigned int j) const;
+  void vCycle(unsigned int l);
+
+  double m_alpha;                    /**< Attenuation coefficient */
+  double m_beta;                     /**< Sensitivity of the weights to the intensity differences */
+  double m_gamma;                    /**< Penalty of the edges across the scanlines */
+  double m_tolerance;                /**< Relative residual at which the solver stops */
+  unsigned int m_maxIterationNumber; /**< Maximal number of iterations of the solver */
+  unsigned int m_iterationNumber;    /**< Number of iterations of the last run */
+
+  std::vector<usLevel> m_levels;  /**< Multigrid hierarchy, the finest grid being the samples between the seeds */
+  std::vector<double> m_solution; /**< Probabilities, kept as initial guess for the next image */
+  std::vector<double> m_rhs;      /**< Contribution of the seeds */
+  std::vector<double> m_residual;
+  std::vector<double> m_direction;
+  std::vector<double> m_product;
+  std::vector<double> m_zero; /**< Null scanline, neighbour of the border scanlines */
+};
+
+#endif // __usRandomWalkConfidence2D_h_
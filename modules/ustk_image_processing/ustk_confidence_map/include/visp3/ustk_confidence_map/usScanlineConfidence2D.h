@@ -36,6 +36,7 @@
 
 #include <cfloat>
 #include <iostream>
+#include <vector>
 
 #include <visp3/ustk_core/usImagePreScan2D.h>
 
@@ -45,6 +46,9 @@
 * @ingroup module_ustk_confidence_map
 *
 * See \cite Chatelain15a, \cite Chatelain16a and \cite Chatelain17a for more details.
+*
+* All the scanlines are integrated at once, row by row, the squared normalized intensities being read in a lookup
+* table. The maps of successive images can be smoothed in time (see setTemporalSmoothing()).
 */
 class VISP_EXPORT usScanlineConfidence2D
 {
@@ -54,7 +58,20 @@ public:
 
   virtual ~usScanlineConfidence2D();
 
+  double getTemporalSmoothing() const;
+
+  void reset();
+
   void run(usImagePreScan2D<unsigned char> &preScanConfidence, const usImagePreScan2D<unsigned char> &preScanImage);
+
+  void setTemporalSmoothing(double smoothing);
+
+private:
+  double m_smoothing;              /**< Weight of the previous confidence map in the temporal smoothing */
+  std::vector<double> m_sum;       /**< Integral of each scanline */
+  std::vector<double> m_remaining; /**< Integral of each scanline below the current row */
+  std::vector<float> m_state;      /**< Smoothed confidence map of the previous images */
+  unsigned int m_stateHeight;      /**< Height of the smoothed confidence map */
 };
 
 #endif // __usScanlineConfidence2D_h_
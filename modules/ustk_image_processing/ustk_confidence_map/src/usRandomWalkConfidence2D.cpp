@@ -0,0 +1,613 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Pierre Chatelain
+ * Alexandre Krupa
+ *
+ *****************************************************************************/
+
+#include <visp3/ustk_confidence_map/usRandomWalkConfidence2D.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+/**
+* Product of the 9-point stencil S of a sample and the values of the previous, current and next scanlines, without the
+* current sample if center is false.
+*/
+inline double stencilProduct(const double *S, const double *xw, const double *xc, const double *xe, unsigned int i,
+                             unsigned int h, bool center)
+{
+  double sum = S[3] * xw[i] + S[5] * xe[i];
+  if (center)
+    sum += S[4] * xc[i];
+  if (i > 0)
+    sum += S[0] * xw[i - 1] + S[1] * xc[i - 1] + S[2] * xe[i - 1];
+  if (i + 1 < h)
+    sum += S[6] * xw[i + 1] + S[7] * xc[i + 1] + S[8] * xe[i + 1];
+  return sum;
+}
+} // namespace
+
+/**
+* Default constructor, with the parameters of \cite Karamalis12a : alpha = 2, beta = 90, gamma = 0.05.
+*/
+usRandomWalkConfidence2D::usRandomWalkConfidence2D()
+  : m_alpha(2.0), m_beta(90.0), m_gamma(0.05), m_tolerance(1e-7), m_maxIterationNumber(100), m_iterationNumber(0),
+    m_levels(), m_solution(), m_rhs(), m_residual(), m_direction(), m_product(), m_zero()
+{
+}
+
+/**
+* Default destructor.
+*/
+usRandomWalkConfidence2D::~usRandomWalkConfidence2D() {}
+
+/**
+* Multiply a vector by the operator of a grid.
+* @param [in] level The grid.
+* @param [in] x The vector.
+* @param [out] y The product.
+*/
+void usRandomWalkConfidence2D::applyOperator(const usLevel &level, const std::vector<double> &x,
+                                             std::vector<double> &y) const
+{
+  const unsigned int h = level.height;
+  const unsigned int w = level.width;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int jj = 0; jj < (int)w; jj++) {
+    const unsigned int j = (unsigned int)jj;
+    const double *xw = (j > 0) ? &x[(j - 1) * h] : &m_zero[0];
+    const double *xe = (j + 1 < w) ? &x[(j + 1) * h] : &m_zero[0];
+    const double *S = &level.stencil[9 * j * h];
+    for (unsigned int i = 0; i < h; i++, S += 9)
+      y[j * h + i] = stencilProduct(S, xw, &x[j * h], xe, i, h, true);
+  }
+}
+
+/**
+* Build the graph of the image : the operator of the finest grid (the Laplacian restricted to the samples between
+* the seeds, which are the first and the last rows) and the contribution of the seeds.
+* @param [in] preScanImage Pre-scan image to process, of height at least 3.
+*/
+void usRandomWalkConfidence2D::buildGraph(const usImagePreScan2D<unsigned char> &preScanImage)
+{
+  const unsigned int H = preScanImage.getHeight();
+  const unsigned int W = preScanImage.getWidth();
+  const unsigned int N = H * W;
+
+  // normalized intensities, compensated for the attenuation along the scanlines
+  unsigned char min = 255;
+  unsigned char max = 0;
+  for (unsigned int i = 0; i < H; ++i)
+    for (unsigned int j = 0; j < W; ++j) {
+      if (preScanImage(i, j) < min)
+        min = preScanImage(i, j);
+      if (preScanImage(i, j) > max)
+        max = preScanImage(i, j);
+    }
+  const double scale = (max > min) ? 1.0 / (max - min) : 0.0;
+  std::vector<double> attenuation(H);
+  for (unsigned int i = 0; i < H; i++)
+    attenuation[i] = std::exp(-m_alpha * i / (H - 1)) * scale;
+  std::vector<double> intensity(N);
+  for (unsigned int i = 0; i < H; i++)
+    for (unsigned int j = 0; j < W; j++)
+      intensity[j * H + i] = (preScanImage(i, j) - min) * attenuation[i];
+
+  // absolute differences along the edges starting from each sample, towards (i + 1, j), (i, j + 1), (i + 1, j + 1),
+  // and from (i + 1, j) towards (i, j + 1)
+  std::vector<double> weightI(N, 0.0), weightJ(N, 0.0), weightIJ(N, 0.0), weightJI(N, 0.0);
+  double maxDifference = 0.0;
+  for (unsigned int j = 0; j < W; j++)
+    for (unsigned int i = 0; i < H; i++) {
+      const unsigned int q = j * H + i;
+      if (i + 1 < H)
+        weightI[q] = std::fabs(intensity[q] - intensity[q + 1]);
+      if (j + 1 < W)
+        weightJ[q] = std::fabs(intensity[q] - intensity[q + H]);
+      if (i + 1 < H && j + 1 < W) {
+        weightIJ[q] = std::fabs(intensity[q] - intensity[q + H + 1]);
+        weightJI[q] = std::fabs(intensity[q + 1] - intensity[q + H]);
+      }
+      maxDifference = std::max(maxDifference,
+                               std::max(std::max(weightI[q], weightJ[q]), std::max(weightIJ[q], weightJI[q])));
+    }
+  const double normalization = (maxDifference > 0.0) ? 1.0 / maxDifference : 0.0;
+
+  // w = exp(-beta * (difference + penalty)) + epsilon, the epsilon keeping the graph connected
+  const double epsilon = 1e-6;
+  const double penaltyJ = m_gamma;
+  const double penaltyDiagonal = std::sqrt(2.0) * m_gamma;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int jj = 0; jj < (int)W; jj++) {
+    const unsigned int j = (unsigned int)jj;
+    for (unsigned int i = 0; i < H; i++) {
+      const unsigned int q = j * H + i;
+      weightI[q] = std::exp(-m_beta * weightI[q] * normalization) + epsilon;
+      weightJ[q] = std::exp(-m_beta * (weightJ[q] * normalization + penaltyJ)) + epsilon;
+      weightIJ[q] = std::exp(-m_beta * (weightIJ[q] * normalization + penaltyDiagonal)) + epsilon;
+      weightJI[q] = std::exp(-m_beta * (weightJI[q] * normalization + penaltyDiagonal)) + epsilon;
+    }
+  }
+
+  // Laplacian of the samples between the seeds, the edges towards the transducer giving the right-hand side
+  usLevel &level = m_levels[0];
+  const unsigned int h = level.height;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int jj = 0; jj < (int)W; jj++) {
+    const unsigned int j = (unsigned int)jj;
+    for (unsigned int i = 1; i + 1 < H; i++) {
+      const unsigned int p = j * h + i - 1;
+      const unsigned int q = j * H + i;
+      double *S = &level.stencil[9 * p];
+      double degree = 0.0;
+      double rhs = 0.0;
+      for (unsigned int k = 0; k < 9; k++)
+        S[k] = 0.0;
+
+      // (i - 1, j - 1), (i - 1, j), (i - 1, j + 1)
+      const double weightN[3] = {(j > 0) ? weightIJ[q - H - 1] : 0.0, weightI[q - 1],
+                                 (j + 1 < W) ? weightJI[q - 1] : 0.0};
+      // (i + 1, j - 1), (i + 1, j), (i + 1, j + 1)
+      const double weightS[3] = {(j > 0) ? weightJI[q - H] : 0.0, weightI[q], (j + 1 < W) ? weightIJ[q] : 0.0};
+      for (unsigned int k = 0; k < 3; k++) {
+        degree += weightN[k] + weightS[k];
+        if (i > 1)
+          S[k] = -weightN[k];
+        else
+          rhs += weightN[k];
+        if (i + 2 < H)
+          S[6 + k] = -weightS[k];
+      }
+      if (j > 0) {
+        S[3] = -weightJ[q - H];
+        degree += weightJ[q - H];
+      }
+      if (j + 1 < W) {
+        S[5] = -weightJ[q];
+        degree += weightJ[q];
+      }
+      S[4] = degree;
+      m_rhs[p] = rhs;
+    }
+  }
+}
+
+/**
+* Build the coarse grids : the scanlines are merged by pairs (the even scanlines are kept) until a single one
+* remains. The scanline j of a grid is interpolated from the coarse scanlines j / 2 and j / 2 + 1 : the even scanlines
+* are copied, and the odd ones are weighted by the couplings with their neighbours. The coarse operators are the
+* Galerkin products R A P, R being the transpose of the interpolation P.
+*/
+void usRandomWalkConfidence2D::buildHierarchy()
+{
+  factorizeScanlines(m_levels[0]);
+  for (unsigned int l = 0; l + 1 < m_levels.size(); l++) {
+    usLevel &fine = m_levels[l];
+    usLevel &coarse = m_levels[l + 1];
+    const unsigned int h = fine.height;
+    const unsigned int w = fine.width;
+    const unsigned int wc = coarse.width;
+
+    // interpolation of an odd scanline : probabilities that a walk along the scanline leaves it towards each
+    // neighbouring scanline, obtained by solving the scanline system with the couplings as right-hand sides
+    for (unsigned int j = 0; j < w; j += 2) {
+      std::fill(fine.interpolationW.begin() + j * h, fine.interpolationW.begin() + (j + 1) * h, 1.0);
+      std::fill(fine.interpolationE.begin() + j * h, fine.interpolationE.begin() + (j + 1) * h, 0.0);
+    }
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int jj = 1; jj < (int)w; jj += 2) {
+      const unsigned int j = (unsigned int)jj;
+      double *u = &fine.interpolationW[j * h];
+      double *v = &fine.interpolationE[j * h];
+      for (unsigned int i = 0; i < h; i++) {
+        const unsigned int p = j * h + i;
+        const double *S = &fine.stencil[9 * p];
+        const double couplingW = std::max(-(S[0] + S[3] + S[6]), 0.0);
+        const double couplingE = (j + 1 < w) ? std::max(-(S[2] + S[5] + S[8]), 0.0) : 0.0;
+        u[i] = (couplingW - ((i > 0) ? S[1] * u[i - 1] : 0.0)) * fine.lineInvPivot[p];
+        v[i] = (couplingE - ((i > 0) ? S[1] * v[i - 1] : 0.0)) * fine.lineInvPivot[p];
+      }
+      for (unsigned int i = h - 1; i-- > 0;) {
+        u[i] -= fine.lineFactor[j * h + i] * u[i + 1];
+        v[i] -= fine.lineFactor[j * h + i] * v[i + 1];
+      }
+      for (unsigned int i = 0; i < h; i++) {
+        const double sum = u[i] + v[i];
+        if (sum > 0.0) {
+          u[i] /= sum;
+          v[i] /= sum;
+        } else {
+          u[i] = (j + 1 < w) ? 0.5 : 1.0;
+          v[i] = (j + 1 < w) ? 0.5 : 0.0;
+        }
+      }
+    }
+
+    // each coarse scanline J gathers the contributions of the fine scanlines 2J - 1, 2J and 2J + 1
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int JJ = 0; JJ < (int)wc; JJ++) {
+      const unsigned int J = (unsigned int)JJ;
+      std::fill(coarse.stencil.begin() + 9 * J * h, coarse.stencil.begin() + 9 * (J + 1) * h, 0.0);
+      for (unsigned int j = (J > 0) ? 2 * J - 1 : 0; j <= 2 * J + 1 && j < w; j++) {
+        const double *weight = (j / 2 == J) ? &fine.interpolationW[j * h] : &fine.interpolationE[j * h];
+        for (int dj = -1; dj <= 1; dj++) {
+          if ((dj < 0 && j == 0) || (dj > 0 && j + 1 == w))
+            continue;
+          // coarse scanlines interpolating the neighbouring scanline
+          const unsigned int jn = j + dj;
+          const int dJ = (int)(jn / 2) - (int)J;
+          const double *weightW = &fine.interpolationW[jn * h];
+          const double *weightE = (dJ <= 0 && jn / 2 + 1 < wc) ? &fine.interpolationE[jn * h] : NULL;
+          for (unsigned int i = 0; i < h; i++) {
+            if (weight[i] == 0.0)
+              continue;
+            const double *S = &fine.stencil[9 * (j * h + i)];
+            double *C = &coarse.stencil[9 * (J * h + i)];
+            for (int di = -1; di <= 1; di++) {
+              if ((di < 0 && i == 0) || (di > 0 && i + 1 == h))
+                continue;
+              const double a = weight[i] * S[(di + 1) * 3 + dj + 1];
+              C[(di + 1) * 3 + dJ + 1] += a * weightW[i + di];
+              if (weightE != NULL)
+                C[(di + 1) * 3 + dJ + 2] += a * weightE[i + di];
+            }
+          }
+        }
+      }
+    }
+    factorizeScanlines(coarse);
+  }
+}
+
+/**
+* Scalar product of two vectors.
+* @param [in] x First vector.
+* @param [in] y Second vector.
+* @return The scalar product.
+*/
+double usRandomWalkConfidence2D::dot(const std::vector<double> &x, const std::vector<double> &y) const
+{
+  const int N = (int)x.size();
+  double sum = 0.0;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for reduction(+ : sum)
+#endif
+  for (int p = 0; p < N; p++)
+    sum += x[p] * y[p];
+  return sum;
+}
+
+/**
+* LU factorization of the tridiagonal system of each scanline of a grid (Thomas algorithm).
+* @param [in, out] level The grid.
+*/
+void usRandomWalkConfidence2D::factorizeScanlines(usLevel &level) const
+{
+  const unsigned int h = level.height;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int jj = 0; jj < (int)level.width; jj++) {
+    double factor = 0.0;
+    for (unsigned int i = 0; i < h; i++) {
+      const unsigned int p = (unsigned int)jj * h + i;
+      const double *S = &level.stencil[9 * p];
+      const double pivot = S[4] - ((i > 0) ? S[1] * factor : 0.0);
+      level.lineInvPivot[p] = 1.0 / pivot;
+      factor = (i + 1 < h) ? S[7] / pivot : 0.0;
+      level.lineFactor[p] = factor;
+    }
+  }
+}
+
+/**
+* Get the attenuation coefficient.
+* @return The attenuation coefficient.
+*/
+double usRandomWalkConfidence2D::getAlpha() const { return m_alpha; }
+
+/**
+* Get the sensitivity of the weights to the intensity differences.
+* @return The beta parameter.
+*/
+double usRandomWalkConfidence2D::getBeta() const { return m_beta; }
+
+/**
+* Get the penalty of the edges across the scanlines.
+* @return The gamma parameter.
+*/
+double usRandomWalkConfidence2D::getGamma() const { return m_gamma; }
+
+/**
+* Get the number of iterations of the solver during the last run.
+* @return The number of iterations.
+*/
+unsigned int usRandomWalkConfidence2D::getIterationNumber() const { return m_iterationNumber; }
+
+/**
+* Get the maximal number of iterations of the solver.
+* @return The maximal number of iterations.
+*/
+unsigned int usRandomWalkConfidence2D::getMaxIterationNumber() const { return m_maxIterationNumber; }
+
+/**
+* Get the relative residual at which the solver stops.
+* @return The tolerance.
+*/
+double usRandomWalkConfidence2D::getTolerance() const { return m_tolerance; }
+
+/**
+* Relax the scanlines of a grid, the even and odd scanlines alternately.
+* @param [in, out] level The grid, whose solution is updated.
+* @param [in] firstParity Parity of the scanlines relaxed first (0 for the even ones).
+*/
+void usRandomWalkConfidence2D::relax(usLevel &level, unsigned int firstParity) const
+{
+  for (unsigned int parity = 0; parity < 2; parity++) {
+    const int first = (int)((firstParity + parity) % 2);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int j = first; j < (int)level.width; j += 2)
+      relaxScanline(level, (unsigned int)j);
+  }
+}
+
+/**
+* Solve the tridiagonal system of a scanline, the other scanlines being fixed.
+* @param [in, out] level The grid, whose solution is updated.
+* @param [in] j The scanline.
+*/
+void usRandomWalkConfidence2D::relaxScanline(usLevel &level, unsigned int j) const
+{
+  const unsigned int h = level.height;
+  const unsigned int w = level.width;
+  double *x = &level.solution[j * h];
+  const double *xw = (j > 0) ? x - h : &m_zero[0];
+  const double *xe = (j + 1 < w) ? x + h : &m_zero[0];
+
+  // forward substitution, the neighbouring scanlines being moved to the right-hand side
+  const double *S = &level.stencil[9 * j * h];
+  for (unsigned int i = 0; i < h; i++, S += 9) {
+    // the current scanline is only read before i, where it holds the forward substitution
+    const double b = level.rhs[j * h + i] - stencilProduct(S, xw, &m_zero[0], xe, i, h, false);
+    x[i] = (b - ((i > 0) ? S[1] * x[i - 1] : 0.0)) * level.lineInvPivot[j * h + i];
+  }
+  // back substitution
+  for (unsigned int i = h - 1; i-- > 0;)
+    x[i] -= level.lineFactor[j * h + i] * x[i + 1];
+}
+
+/**
+* Forget the solution of the previous image, so that the next run starts from scratch.
+*/
+void usRandomWalkConfidence2D::reset() { m_solution.clear(); }
+
+/**
+* Run the confidence map processor on pre-scan image. The solution is used as initial guess by the next run if the
+* image dimensions do not change.
+* @param [out] preScanConfidence Confidence image computed.
+* @param [in] preScanImage Pre-scan image to process.
+*/
+void usRandomWalkConfidence2D::run(usImagePreScan2D<unsigned char> &preScanConfidence,
+                                   const usImagePreScan2D<unsigned char> &preScanImage)
+{
+  usLatencyTracer::usScope traceScope("random walk confidence 2D");
+
+  preScanConfidence.setImagePreScanSettings(preScanImage);
+  const unsigned int H = preScanImage.getHeight();
+  const unsigned int W = preScanImage.getWidth();
+  if (H == 0 || W == 0)
+    throw(vpException(vpException::notInitialized, "pre-scan image dimension is 0"));
+
+  preScanConfidence.resize(H, W);
+  m_iterationNumber = 0;
+  for (unsigned int j = 0; j < W; j++) {
+    preScanConfidence(0, j, 255);
+    if (H > 1)
+      preScanConfidence(H - 1, j, 0);
+  }
+  if (H < 3)
+    return;
+
+  const unsigned int h = H - 2;
+  const unsigned int n = h * W;
+  if (m_levels.empty() || m_levels[0].height != h || m_levels[0].width != W || m_solution.size() != n) {
+    m_levels.clear();
+    for (unsigned int w = W;; w = (w + 1) / 2) {
+      usLevel level;
+      level.height = h;
+      level.width = w;
+      level.stencil.resize(9 * h * w);
+      level.lineFactor.resize(h * w);
+      level.lineInvPivot.resize(h * w);
+      level.interpolationW.resize(h * w);
+      level.interpolationE.resize(h * w);
+      level.solution.resize(h * w);
+      level.rhs.resize(h * w);
+      level.residual.resize(h * w);
+      m_levels.push_back(level);
+      if (w == 1)
+        break;
+    }
+    m_rhs.resize(n);
+    m_residual.resize(n);
+    m_direction.resize(n);
+    m_product.resize(n);
+    m_zero.assign(h, 0.0);
+    // no previous solution : linear decrease along the scanlines
+    m_solution.resize(n);
+    for (unsigned int j = 0; j < W; j++)
+      for (unsigned int i = 0; i < h; i++)
+        m_solution[j * h + i] = 1.0 - (i + 1.0) / (H - 1);
+  }
+  buildGraph(preScanImage);
+  buildHierarchy();
+
+  // conjugate gradient, preconditioned by a V-cycle
+  usLevel &finest = m_levels[0];
+  const int N = (int)n;
+  applyOperator(finest, m_solution, m_residual);
+  for (int p = 0; p < N; p++)
+    m_residual[p] = m_rhs[p] - m_residual[p];
+  const double rhsNorm = std::sqrt(dot(m_rhs, m_rhs));
+  double residualNorm = std::sqrt(dot(m_residual, m_residual));
+  double rz = 0.0;
+  while (m_iterationNumber < m_maxIterationNumber && residualNorm > m_tolerance * rhsNorm) {
+    finest.rhs = m_residual;
+    std::fill(finest.solution.begin(), finest.solution.end(), 0.0);
+    vCycle(0);
+    const double rzNext = dot(m_residual, finest.solution);
+    const double beta = (m_iterationNumber > 0) ? rzNext / rz : 0.0;
+    rz = rzNext;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int p = 0; p < N; p++)
+      m_direction[p] = finest.solution[p] + beta * m_direction[p];
+
+    applyOperator(finest, m_direction, m_product);
+    const double step = rz / dot(m_direction, m_product);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int p = 0; p < N; p++) {
+      m_solution[p] += step * m_direction[p];
+      m_residual[p] -= step * m_product[p];
+    }
+    residualNorm = std::sqrt(dot(m_residual, m_residual));
+    m_iterationNumber++;
+  }
+
+  for (unsigned int i = 1; i + 1 < H; i++)
+    for (unsigned int j = 0; j < W; j++) {
+      const double confidence = std::min(std::max(m_solution[j * h + i - 1], 0.0), 1.0);
+      preScanConfidence(i, j, (unsigned char)(confidence * 255 + 0.5));
+    }
+}
+
+/**
+* Set the attenuation coefficient : the intensities are weighted by exp(-alpha * d), d being the normalized depth.
+* @param alpha The attenuation coefficient.
+*/
+void usRandomWalkConfidence2D::setAlpha(double alpha) { m_alpha = alpha; }
+
+/**
+* Set the sensitivity of the weights to the intensity differences.
+* @param beta The beta parameter.
+*/
+void usRandomWalkConfidence2D::setBeta(double beta) { m_beta = beta; }
+
+/**
+* Set the penalty of the edges across the scanlines.
+* @param gamma The gamma parameter.
+*/
+void usRandomWalkConfidence2D::setGamma(double gamma) { m_gamma = gamma; }
+
+/**
+* Set the maximal number of iterations of the solver.
+* @param maxIterationNumber The maximal number of iterations.
+*/
+void usRandomWalkConfidence2D::setMaxIterationNumber(unsigned int maxIterationNumber)
+{
+  m_maxIterationNumber = maxIterationNumber;
+}
+
+/**
+* Set the relative residual at which the solver stops.
+* @param tolerance The tolerance.
+*/
+void usRandomWalkConfidence2D::setTolerance(double tolerance) { m_tolerance = tolerance; }
+
+/**
+* Multigrid V-cycle, starting from a null solution : relaxation, correction computed on the coarser grid from the
+* residual, then relaxation in the reverse order, so that the cycle is a symmetric preconditioner.
+* @param [in] l Index of the grid, whose right-hand side is set.
+*/
+void usRandomWalkConfidence2D::vCycle(unsigned int l)
+{
+  usLevel &level = m_levels[l];
+  if (l + 1 == m_levels.size()) {
+    // a single scanline : exact solve
+    relaxScanline(level, 0);
+    return;
+  }
+
+  const unsigned int h = level.height;
+  const unsigned int w = level.width;
+  usLevel &coarse = m_levels[l + 1];
+
+  relax(level, 0);
+  applyOperator(level, level.solution, level.residual);
+
+  // restriction, transpose of the interpolation
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int JJ = 0; JJ < (int)coarse.width; JJ++) {
+    const unsigned int J = (unsigned int)JJ;
+    for (unsigned int i = 0; i < h; i++)
+      coarse.rhs[J * h + i] = 0.0;
+    for (unsigned int j = (J > 0) ? 2 * J - 1 : 0; j <= 2 * J + 1 && j < w; j++) {
+      const double *weight = (j / 2 == J) ? &level.interpolationW[j * h] : &level.interpolationE[j * h];
+      for (unsigned int i = 0; i < h; i++)
+        coarse.rhs[J * h + i] += weight[i] * (level.rhs[j * h + i] - level.residual[j * h + i]);
+    }
+  }
+  std::fill(coarse.solution.begin(), coarse.solution.end(), 0.0);
+  vCycle(l + 1);
+
+  // interpolation of the correction
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int jj = 0; jj < (int)w; jj++) {
+    const unsigned int j = (unsigned int)jj;
+    const double *xW = &coarse.solution[j / 2 * h];
+    const double *xE = (j / 2 + 1 < coarse.width) ? xW + h : &m_zero[0];
+    for (unsigned int i = 0; i < h; i++)
+      level.solution[j * h + i] += level.interpolationW[j * h + i] * xW[i] + level.interpolationE[j * h + i] * xE[i];
+  }
+
+  relax(level, 1);
+}
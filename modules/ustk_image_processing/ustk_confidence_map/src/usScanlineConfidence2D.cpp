@@ -32,17 +32,34 @@
  *****************************************************************************/
 
 #include <visp3/ustk_confidence_map/usScanlineConfidence2D.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
+
+#include <algorithm>
 
 /**
-* Default constructor.
+* Default constructor, without temporal smoothing.
 */
-usScanlineConfidence2D::usScanlineConfidence2D() {}
+usScanlineConfidence2D::usScanlineConfidence2D()
+  : m_smoothing(0.0), m_sum(), m_remaining(), m_state(), m_stateHeight(0)
+{
+}
 
 /**
 * Default destructor.
 */
 usScanlineConfidence2D::~usScanlineConfidence2D() {}
 
+/**
+* Get the weight of the previous confidence maps in the temporal smoothing.
+* @return The smoothing factor, 0 if the temporal smoothing is disabled.
+*/
+double usScanlineConfidence2D::getTemporalSmoothing() const { return m_smoothing; }
+
+/**
+* Forget the previous confidence maps, so that the temporal smoothing restarts from the next image.
+*/
+void usScanlineConfidence2D::reset() { m_state.clear(); }
+
 /**
 * Run the confidence map processor on pre-scan image.
 * @param [out] preScanConfidence Confidence image computed.
@@ -51,6 +68,8 @@ usScanlineConfidence2D::~usScanlineConfidence2D() {}
 void usScanlineConfidence2D::run(usImagePreScan2D<unsigned char> &preScanConfidence,
                                  const usImagePreScan2D<unsigned char> &preScanImage)
 {
+  usLatencyTracer::usScope traceScope("scanline confidence 2D");
+
   preScanConfidence.setImagePreScanSettings(preScanImage);
   unsigned int AN = preScanImage.getHeight();
   unsigned int LN = preScanImage.getWidth();
@@ -60,27 +79,71 @@ void usScanlineConfidence2D::run(usImagePreScan2D<unsigned char> &preScanConfide
   preScanConfidence.resize(AN, LN);
 
   // Find min and max
-  double min = 255.0;
-  double max = 0.0;
-  for (unsigned int i = 0; i < AN; ++i)
+  const unsigned char *bitmap = preScanImage[0];
+  unsigned char minValue = 255;
+  unsigned char maxValue = 0;
+  for (unsigned int n = 0; n < AN * LN; ++n) {
+    minValue = std::min(minValue, bitmap[n]);
+    maxValue = std::max(maxValue, bitmap[n]);
+  }
+  const double min = minValue;
+  const double max = maxValue;
+
+  // Squared normalized intensities
+  double sqr[256];
+  for (unsigned int v = 0; v < 256; ++v)
+    sqr[v] = (max > min) ? vpMath::sqr((v - min) / (max - min)) : 0.0;
+
+  // Integrate scan lines, all the scanlines of a row at once
+  m_sum.assign(LN, 0.0);
+  double *sum = &m_sum[0];
+  for (unsigned int i = 0; i < AN; ++i) {
+    const unsigned char *row = preScanImage[i];
+    for (unsigned int j = 0; j < LN; ++j)
+      sum[j] += sqr[row[j]];
+  }
+
+  m_remaining = m_sum;
+  double *val = &m_remaining[0];
+  unsigned char *confidence = preScanConfidence[0];
+  for (unsigned int j = 0; j < LN; ++j)
+    confidence[j] = 255;
+  for (unsigned int i = 1; i < AN; ++i) {
+    const unsigned char *previousRow = preScanImage[i - 1];
+    confidence = preScanConfidence[i];
     for (unsigned int j = 0; j < LN; ++j) {
-      if (static_cast<double>(preScanImage(i, j)) < min)
-        min = static_cast<double>(preScanImage(i, j));
-      if (static_cast<double>(preScanImage(i, j)) > max)
-        max = static_cast<double>(preScanImage(i, j));
+      val[j] -= sqr[previousRow[j]];
+      // uniform scanline : full confidence
+      confidence[j] = (sum[j] > 0.0) ? (unsigned char)(val[j] / sum[j] * 255) : 255;
     }
+  }
 
-  // Integrate scan lines
-  for (unsigned int j = 0; j < LN; ++j) {
-    double sum = 0.0;
-    for (unsigned int i = 0; i < AN; ++i)
-      sum += vpMath::sqr((preScanImage(i, j) - min) / (max - min));
-
-    double val = sum;
-    preScanConfidence(0, j, 255);
-    for (unsigned int i = 1; i < AN; ++i) {
-      val -= vpMath::sqr((preScanImage(i - 1, j) - min) / (max - min));
-      preScanConfidence(i, j, (unsigned char)(val / sum * 255));
+  // Exponential smoothing with the previous maps
+  if (m_smoothing > 0.0) {
+    unsigned char *bitmapConfidence = preScanConfidence[0];
+    if (m_state.size() != AN * LN || m_stateHeight != AN) {
+      m_state.assign(bitmapConfidence, bitmapConfidence + AN * LN);
+      m_stateHeight = AN;
+    }
+    const float a = (float)m_smoothing;
+    for (unsigned int n = 0; n < AN * LN; ++n) {
+      m_state[n] = a * m_state[n] + (1.0f - a) * bitmapConfidence[n];
+      bitmapConfidence[n] = (unsigned char)(m_state[n] + 0.5f);
     }
   }
 }
+
+/**
+* Set the temporal smoothing of the confidence maps : the map of an image is blended with the map of the previous
+* images, C(t) = s C(t - 1) + (1 - s) c(t). The smoothed map is kept from an image to the next one, and reset when the
+* image size changes (see also reset()).
+* @param smoothing The weight s of the previous maps, in [0, 1[ (0 disables the smoothing).
+*/
+void usScanlineConfidence2D::setTemporalSmoothing(double smoothing)
+{
+  if (smoothing < 0.0 || smoothing >= 1.0)
+    throw(vpException(vpException::badValue, "temporal smoothing factor should be in [0, 1["));
+  if (smoothing == 0.0)
+    m_state.clear();
+  m_smoothing = smoothing;
+}
@@ -31,13 +31,109 @@
  *****************************************************************************/
 #include <iostream>
 
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <visp3/core/vpUniRand.h>
 #include <visp3/ustk_confidence_map/usScanlineConfidence2D.h>
 #include <visp3/ustk_core/usImageIo.h>
 #include <visp3/ustk_core/usImagePreScan2D.h>
 
 #if defined(VISP_HAVE_XML2)
+/*!
+  Random pre-scan image.
+*/
+usImagePreScan2D<unsigned char> randomImage(unsigned int height, unsigned int width, vpUniRand &random)
+{
+  usImagePreScan2D<unsigned char> image(height, width);
+  for (unsigned int i = 0; i < height; i++)
+    for (unsigned int j = 0; j < width; j++)
+      image(i, j, (unsigned char)(40 + 160 * random()));
+  return image;
+}
+
+/*!
+  Checks a smoothed confidence map against the rounded state.
+*/
+bool checkState(const usImagePreScan2D<unsigned char> &confidence, const std::vector<double> &state,
+                const std::string &name)
+{
+  for (unsigned int i = 0; i < confidence.getHeight(); i++)
+    for (unsigned int j = 0; j < confidence.getWidth(); j++) {
+      // the processor keeps the state in single precision : the rounding can differ by one level
+      double expected = state[i * confidence.getWidth() + j];
+      if (std::fabs(confidence(i, j) - std::floor(expected + 0.5)) > 1.0) {
+        std::cout << name << " : confidence " << (int)confidence(i, j) << " instead of " << expected << " at (" << i
+                  << ", " << j << ")" << std::endl;
+        return false;
+      }
+    }
+  return true;
+}
+
+/*!
+  Temporal smoothing of the confidence maps of different images, against the state C(t) = s C(t - 1) + (1 - s) c(t)
+  computed from the maps c(t) of the images without smoothing. The state restarts from the map of the image after
+  reset() and after a change of image size.
+*/
+bool checkTemporalSmoothing()
+{
+  bool success = true;
+  const double s = 0.8;
+  vpUniRand random(7);
+  usScanlineConfidence2D process, smoothedProcess;
+  smoothedProcess.setTemporalSmoothing(s);
+  usImagePreScan2D<unsigned char> confidence, smoothed;
+
+  std::vector<double> state;
+  bool smoothingVisible = false;
+  for (unsigned int t = 0; t < 4; t++) {
+    usImagePreScan2D<unsigned char> image = randomImage(40, 12, random);
+    process.run(confidence, image);
+    smoothedProcess.run(smoothed, image);
+    for (unsigned int i = 0; i < 40; i++)
+      for (unsigned int j = 0; j < 12; j++) {
+        double c = confidence(i, j);
+        if (t == 0)
+          state.push_back(c);
+        else
+          state[i * 12 + j] = s * state[i * 12 + j] + (1 - s) * c;
+        smoothingVisible |= std::fabs(smoothed(i, j) - c) > 1.0;
+      }
+    success &= checkState(smoothed, state, "Smoothed map " + std::to_string(t));
+  }
+  if (!smoothingVisible) {
+    std::cout << "The smoothed maps should differ from the maps of the images" << std::endl;
+    success = false;
+  }
+
+  // after reset() and after a change of size, the smoothed map is the map of the image
+  usImagePreScan2D<unsigned char> image = randomImage(40, 12, random);
+  smoothedProcess.reset();
+  smoothedProcess.run(smoothed, image);
+  process.run(confidence, image);
+  if (!(smoothed == confidence)) {
+    std::cout << "The smoothing should restart after reset()" << std::endl;
+    success = false;
+  }
+  image = randomImage(30, 16, random);
+  smoothedProcess.run(smoothed, image);
+  process.run(confidence, image);
+  if (!(smoothed == confidence)) {
+    std::cout << "The smoothing should restart when the image size changes" << std::endl;
+    success = false;
+  }
+  return success;
+}
+
 int main()
 {
+  if (!checkTemporalSmoothing()) {
+    std::cout << "Test failed\n";
+    return 1;
+  }
+
   std::string filename, filenameConfidence;
 
   // Get the ustk-dataset package path or USTK_DATASET_PATH environment variable value
@@ -0,0 +1,222 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Pierre Chatelain
+ * Alexandre Krupa
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpTime.h>
+#include <visp3/core/vpUniRand.h>
+#include <visp3/ustk_confidence_map/usRandomWalkConfidence2D.h>
+#include <visp3/ustk_core/usImagePreScan2D.h>
+
+/*!
+  Reference confidence map : the random walk system of the 8-connected graph (see usRandomWalkConfidence2D) is built as
+  a dense matrix and solved with its pseudo-inverse.
+*/
+void denseConfidence(const usImagePreScan2D<unsigned char> &image, double alpha, double beta, double gamma,
+                     usImagePreScan2D<unsigned char> &confidence)
+{
+  const int H = (int)image.getHeight();
+  const int W = (int)image.getWidth();
+
+  // attenuation-compensated intensities, normalized by the intensity range
+  unsigned char min = 255, max = 0;
+  for (int i = 0; i < H; i++)
+    for (int j = 0; j < W; j++) {
+      min = std::min(min, image(i, j));
+      max = std::max(max, image(i, j));
+    }
+  std::vector<double> intensity(H * W);
+  for (int i = 0; i < H; i++)
+    for (int j = 0; j < W; j++)
+      intensity[i * W + j] = (image(i, j) - min) * std::exp(-alpha * i / (H - 1)) / (max - min);
+
+  // the 4 edge directions starting from a sample, the other ones being their opposites
+  const int di[4] = {1, 0, 1, 1};
+  const int dj[4] = {0, 1, 1, -1};
+  double maxDifference = 0.0;
+  for (int i = 0; i < H; i++)
+    for (int j = 0; j < W; j++)
+      for (int e = 0; e < 4; e++)
+        if (i + di[e] < H && j + dj[e] >= 0 && j + dj[e] < W)
+          maxDifference =
+              std::max(maxDifference, std::fabs(intensity[i * W + j] - intensity[(i + di[e]) * W + j + dj[e]]));
+
+  // Laplacian of the samples between the first row (confidence 1) and the last one (confidence 0)
+  const int n = (H - 2) * W;
+  vpMatrix L(n, n, 0.0);
+  vpColVector b(n, 0.0);
+  for (int i = 0; i < H; i++)
+    for (int j = 0; j < W; j++)
+      for (int e = 0; e < 4; e++) {
+        const int i2 = i + di[e], j2 = j + dj[e];
+        if (i2 >= H || j2 < 0 || j2 >= W)
+          continue;
+        const double penalty = (dj[e] == 0) ? 0.0 : ((di[e] == 0) ? gamma : std::sqrt(2.0) * gamma);
+        const double difference = std::fabs(intensity[i * W + j] - intensity[i2 * W + j2]) / maxDifference;
+        const double weight = std::exp(-beta * (difference + penalty)) + 1e-6;
+        const int p = (i - 1) * W + j, q = (i2 - 1) * W + j2;
+        const bool pUnknown = i > 0 && i + 1 < H, qUnknown = i2 > 0 && i2 + 1 < H;
+        if (pUnknown) {
+          L[p][p] += weight;
+          if (qUnknown)
+            L[p][q] -= weight;
+          else if (i2 == 0)
+            b[p] += weight;
+        }
+        if (qUnknown) {
+          L[q][q] += weight;
+          if (pUnknown)
+            L[q][p] -= weight;
+          else if (i == 0)
+            b[q] += weight;
+        }
+      }
+  vpColVector x = L.pseudoInverse(1e-15) * b;
+
+  confidence.resize(H, W);
+  for (int j = 0; j < W; j++) {
+    confidence(0, j, 255);
+    confidence(H - 1, j, 0);
+  }
+  for (int i = 1; i + 1 < H; i++)
+    for (int j = 0; j < W; j++)
+      confidence(i, j, (unsigned char)(std::min(std::max(x[(i - 1) * W + j], 0.0), 1.0) * 255 + 0.5));
+}
+
+int main()
+{
+  bool testFailed = false;
+
+  // accuracy : the multigrid preconditioned conjugate gradient gives the confidence of the dense solve, within one
+  // grey level, on a small image
+  {
+    const unsigned int samples = 12, scanlines = 8;
+    usImagePreScan2D<unsigned char> image(samples, scanlines);
+    vpUniRand random(3);
+    for (unsigned int i = 0; i < samples; i++)
+      for (unsigned int j = 0; j < scanlines; j++)
+        image(i, j, (unsigned char)(40 + 160 * random()));
+
+    usRandomWalkConfidence2D confidenceProcess;
+    usImagePreScan2D<unsigned char> confidence, reference;
+    confidenceProcess.run(confidence, image);
+    denseConfidence(image, confidenceProcess.getAlpha(), confidenceProcess.getBeta(), confidenceProcess.getGamma(),
+                    reference);
+    int maxError = 0;
+    for (unsigned int i = 0; i < samples; i++)
+      for (unsigned int j = 0; j < scanlines; j++)
+        maxError = std::max(maxError, std::abs((int)confidence(i, j) - (int)reference(i, j)));
+    std::cout << "dense solve : maximal difference of " << maxError << " grey level(s)" << std::endl;
+    if (maxError > 1) {
+      std::cout << "ERROR : the confidence map differs from the dense solve !" << std::endl;
+      testFailed = true;
+    }
+  }
+
+  // synthetic speckle, correlated along the scanlines, with a strong reflector on the central scanlines that casts
+  // an acoustic shadow
+  const unsigned int samples = 480, scanlines = 128;
+  const unsigned int reflectorDepth = 160;
+  usImagePreScan2D<unsigned char> image(samples, scanlines);
+  std::vector<double> speckle((samples + 3) * scanlines);
+  vpUniRand random(1);
+  for (unsigned int k = 0; k < speckle.size(); k++)
+    speckle[k] = random();
+  for (unsigned int i = 0; i < samples; i++)
+    for (unsigned int j = 0; j < scanlines; j++) {
+      double s = 0.0;
+      for (unsigned int k = 0; k < 4; k++)
+        s += speckle[(i + k) * scanlines + j] / 4;
+      double value = 40 + 60 * s;
+      if (j >= 54 && j < 74) {
+        if (i >= reflectorDepth && i < reflectorDepth + 6)
+          value = 255;
+        else if (i >= reflectorDepth + 6)
+          value = 5 * s;
+      }
+      image(i, j, (unsigned char)value);
+    }
+
+  usRandomWalkConfidence2D confidenceProcess;
+  usImagePreScan2D<unsigned char> confidence;
+
+  double t0 = vpTime::measureTimeMs();
+  confidenceProcess.run(confidence, image);
+  double t1 = vpTime::measureTimeMs();
+  unsigned int coldIterations = confidenceProcess.getIterationNumber();
+  std::cout << "cold start : " << coldIterations << " iterations, " << t1 - t0 << " ms" << std::endl;
+
+  // next frame of a sequence, with a little noise
+  for (unsigned int i = 0; i < samples; i += 7)
+    for (unsigned int j = 0; j < scanlines; j += 5)
+      image(i, j, (unsigned char)(image(i, j) / 2 + 30));
+  t0 = vpTime::measureTimeMs();
+  confidenceProcess.run(confidence, image);
+  t1 = vpTime::measureTimeMs();
+  unsigned int warmIterations = confidenceProcess.getIterationNumber();
+  std::cout << "warm start : " << warmIterations << " iterations, " << t1 - t0 << " ms" << std::endl;
+
+  if (confidence.getHeight() != samples || confidence.getWidth() != scanlines) {
+    std::cout << "ERROR : wrong confidence map size !" << std::endl;
+    return 1;
+  }
+  for (unsigned int j = 0; j < scanlines; j++)
+    if (confidence(0, j) != 255 || confidence(samples - 1, j) != 0) {
+      std::cout << "ERROR : the seeds are not respected on scanline " << j << " !" << std::endl;
+      testFailed = true;
+      break;
+    }
+  if (2 * confidence(reflectorDepth + 40, 64) >= confidence(reflectorDepth + 40, 20)) {
+    std::cout << "ERROR : no shadow below the reflector (" << (int)confidence(reflectorDepth + 40, 64) << " / "
+              << (int)confidence(reflectorDepth + 40, 20) << ") !" << std::endl;
+    testFailed = true;
+  }
+  if (confidence(samples / 2, 20) >= confidence(samples / 4, 20)) {
+    std::cout << "ERROR : the confidence does not decrease with depth !" << std::endl;
+    testFailed = true;
+  }
+  if (warmIterations >= coldIterations) {
+    std::cout << "ERROR : the previous solution does not speed up the solver !" << std::endl;
+    testFailed = true;
+  }
+
+  if (!testFailed)
+    std::cout << "Test passed" << std::endl;
+  return testFailed;
+}
@@ -0,0 +1,415 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Pierre Chatelain
+ * Alexandre Krupa
+ *
+ *****************************************************************************/
+
+#ifndef __usNeedleDetector3D_h_
+#define __usNeedleDetector3D_h_
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <stdint.h>
+
+// ViSP
+#include <visp3/core/vpTime.h>
+#include <visp3/core/vpUniRand.h>
+
+// UsTK
+#include <visp3/ustk_core/usImage3D.h>
+#include <visp3/ustk_core/usLatencyTracer.h>
+#include <visp3/ustk_core/usPolynomialCurve3D.h>
+
+/**
+ * @class usNeedleDetector3D
+ * @brief Needle detection in 3D volumes based on RANSAC.
+ * @ingroup module_ustk_needle_detection
+ *
+ * This class defines a needle detection pipeline for 3D volumes, working in voxel coordinates (i, j, k):
+ * - thresholding: the getMaxCandidateNumber() brightest voxels of the region of interest that are above
+ *   getThreshold() are kept as candidates. The volume can be the intensity volume, or a needle response such as a
+ *   vesselness volume (see usVolumeProcessing::frangiMultiScale()).
+ * - hashing: the candidates are stored in a spatial hash of cubic cells of 2 * getInlierDistance() voxels, and the
+ *   candidates having less than two other candidates in their neighbouring cells (speckle) are discarded.
+ * - RANSAC: getIterationNumber() polynomial curves of order getOrder() (straight lines by default) are fitted on
+ *   random samples of candidates, in parallel when OpenMP is available. Each hypothesis is scored by its number of
+ *   candidates closer than getInlierDistance(), found by visiting only the cells along the curve.
+ * - refinement: the inliers of the best hypothesis are binned along the needle, and a usPolynomialCurve3D is fitted
+ *   on the bin centroids. The curve is extended while it gathers new inliers.
+ *
+ * Once the needle is found, the next detection is restricted to its bounding box enlarged by getRegionOfInterestMargin()
+ * voxels. If no needle is found in this region, or if the needle reaches its border, the detection is done again on the
+ * whole volume.
+ *
+ * The duration of each stage of the last detection is given by getStageTime(), the stages are also recorded by
+ * usLatencyTracer.
+ *
+ * \code
+ * usNeedleDetector3D detector;
+ * detector.setOrder(2);
+ * while (!reader.end()) {
+ *   reader.acquire(volume);
+ *   if (detector.detect(volume))
+ *     std::cout << "tip: " << detector.getNeedle().getEndPoint().t() << std::endl;
+ * }
+ * \endcode
+ */
+class VISP_EXPORT usNeedleDetector3D
+{
+public:
+  /**
+   * Stages of the detection, see getStageTime().
+   */
+  typedef enum { THRESHOLDING_STAGE, HASHING_STAGE, RANSAC_STAGE, REFINEMENT_STAGE, STAGE_NUMBER } usDetectionStage;
+
+  /**
+   * Default constructor.
+   */
+  usNeedleDetector3D();
+
+  /**
+   * Destructor.
+   */
+  virtual ~usNeedleDetector3D();
+
+  /**
+   * Detects the needle in a volume.
+   *
+   * @param V The volume, the needle being brighter than the background.
+   * @return True if a needle with at least getMinInlierNumber() inliers was found, false otherwise.
+   */
+  template <class Type> bool detect(const usImage3D<Type> &V);
+
+  /**
+   * Returns the number of candidate voxels of the last detection, after the removal of the isolated ones.
+   */
+  unsigned int getCandidateNumber() const;
+
+  /**
+   * Returns the maximal distance (in voxels) between an inlier and the needle.
+   */
+  double getInlierDistance() const;
+
+  /**
+   * Returns the number of inliers of the detected needle.
+   */
+  unsigned int getInlierNumber() const;
+
+  /**
+   * Returns the number of RANSAC hypotheses.
+   */
+  unsigned int getIterationNumber() const;
+
+  /**
+   * Returns the maximal number of candidate voxels.
+   */
+  unsigned int getMaxCandidateNumber() const;
+
+  /**
+   * Returns the minimal number of inliers of a detected needle.
+   */
+  unsigned int getMinInlierNumber() const;
+
+  /**
+   * Returns the last detected needle, in voxel coordinates (i, j, k).
+   *
+   * The curve goes in the direction of the previous detection. For the first detection, it goes along its main
+   * axis in the increasing coordinates, use usPolynomialCurve3D::reverse() if the needle enters on the other side.
+   */
+  const usPolynomialCurve3D &getNeedle() const;
+
+  /**
+   * Returns the order of the polynomial needle model.
+   */
+  unsigned int getOrder() const;
+
+  /**
+   * Returns the region of interest of the next detection.
+   *
+   * @param roi The first and last + 1 indexes along i, j and k: {i0, i1, j0, j1, k0, k1}.
+   */
+  void getRegionOfInterest(unsigned int roi[6]) const;
+
+  /**
+   * Returns the margin (in voxels) added around the needle to get the region of interest of the next detection.
+   */
+  unsigned int getRegionOfInterestMargin() const;
+
+  /**
+   * Returns true if the detection is restricted around the previous needle.
+   */
+  bool getRegionOfInterestTracking() const;
+
+  /**
+   * Returns the duration (in ms) of a stage of the last detection.
+   */
+  double getStageTime(usDetectionStage stage) const;
+
+  /**
+   * Returns the minimal value of a candidate voxel.
+   */
+  double getThreshold() const;
+
+  /**
+   * Forgets the previous needle, the next detection is done on the whole volume.
+   */
+  void reset();
+
+  /**
+   * Sets the maximal distance (in voxels) between an inlier and the needle, 2 by default.
+   */
+  void setInlierDistance(double distance);
+
+  /**
+   * Sets the number of RANSAC hypotheses, 500 by default.
+   */
+  void setIterationNumber(unsigned int iterationNumber);
+
+  /**
+   * Sets the maximal number of candidate voxels, 2000 by default.
+   */
+  void setMaxCandidateNumber(unsigned int candidateNumber);
+
+  /**
+   * Sets the minimal number of inliers of a detected needle, 30 by default.
+   */
+  void setMinInlierNumber(unsigned int inlierNumber);
+
+  /**
+   * Sets the order of the polynomial needle model, 1 (straight line) by default.
+   */
+  void setOrder(unsigned int order);
+
+  /**
+   * Sets the margin (in voxels) added around the needle to get the region of interest of the next detection, 15 by
+   * default.
+   */
+  void setRegionOfInterestMargin(unsigned int margin);
+
+  /**
+   * Enables or disables the restriction of the detection around the previous needle, enabled by default.
+   */
+  void setRegionOfInterestTracking(bool tracking);
+
+  /**
+   * Sets the minimal value of a candidate voxel (excluded), 0 by default.
+   */
+  void setThreshold(double threshold);
+
+private:
+  /**
+   * Cell of the spatial hash, whose candidates are m_cellPoints[begin] to m_cellPoints[begin + count - 1].
+   */
+  struct usCell {
+    uint64_t key;
+    unsigned int begin;
+    unsigned int count;
+  };
+
+  /**
+   * Scratch buffers of a thread.
+   */
+  struct usWorkspace {
+    std::vector<unsigned int> stamps; /**< Last hypothesis for which each candidate was counted as an inlier */
+    unsigned int stamp;
+    std::vector<double> vertices; /**< Polyline sampling the current hypothesis */
+  };
+
+  void buildHash();
+  bool buildHypothesis(const unsigned int *sample, std::vector<double> &vertices) const;
+  unsigned int computeFrameOffsets(bool withTies);
+  template <class Type> double computeThreshold(const usImage3D<Type> &V, bool &withTies);
+  double computeThreshold(const usImage3D<unsigned char> &V, bool &withTies);
+  unsigned int countInliers(usWorkspace &workspace, std::vector<unsigned int> *inliers) const;
+  const usCell *findCell(int ci, int cj, int ck) const;
+  bool findNeedle();
+  unsigned int fitCurve(const std::vector<unsigned int> &inliers, const vpColVector &direction,
+                        usPolynomialCurve3D &curve);
+  void removeIsolatedCandidates();
+  void resetRegionOfInterest();
+  bool sampleCurve(const usPolynomialCurve3D &curve, double extension, std::vector<double> &vertices) const;
+  template <class Type> void selectCandidates(const usImage3D<Type> &V);
+  double selectThreshold(double quantile, bool &withTies) const;
+  void startDetection(unsigned int height, unsigned int width, unsigned int frameNumber);
+  usWorkspace &workspace();
+
+  // Parameters
+  double m_inlierDistance;
+  unsigned int m_iterationNumber;
+  unsigned int m_maxCandidateNumber;
+  unsigned int m_minInlierNumber;
+  unsigned int m_order;
+  unsigned int m_roiMargin;
+  bool m_roiTracking;
+  double m_threshold;
+
+  // Detection state
+  unsigned int m_dims[3]; /**< Height, width and number of frames of the volume */
+  unsigned int m_roi[6];
+  bool m_needleFound;
+  usPolynomialCurve3D m_needle;
+  unsigned int m_inlierNumber;
+  bool m_needleClipped; /**< True if the needle reaches the border of the region of interest it was detected in */
+  double m_stageTimes[STAGE_NUMBER];
+  vpUniRand m_random;
+
+  // Candidates and spatial hash
+  std::vector<double> m_points;            /**< Candidate coordinates (i, j, k) */
+  std::vector<float> m_values;             /**< Copy of the region of interest for the quantile computation */
+  std::vector<unsigned int> m_frameCounts; /**< Per frame of the region of interest, candidates and ties counts */
+  std::vector<unsigned int> m_histograms;  /**< Per frame histograms of unsigned char volumes */
+  std::vector<usCell> m_cells;             /**< Open addressing table of the non empty cells */
+  std::vector<unsigned int> m_cellPoints;  /**< Candidate indexes, sorted by cell */
+  std::vector<unsigned int> m_pointSlots;  /**< Table slot of the cell of each candidate */
+  double m_bounds[6];                      /**< Bounding box of the candidates, enlarged by the inlier distance */
+
+  // RANSAC
+  std::vector<unsigned int> m_samples; /**< Candidate indexes of the minimal sample of each hypothesis */
+  std::vector<unsigned int> m_scores;
+  std::vector<usWorkspace> m_workspaces;
+  std::vector<unsigned int> m_inliers;
+  std::vector<double> m_bins;
+};
+
+template <class Type> bool usNeedleDetector3D::detect(const usImage3D<Type> &V)
+{
+  usLatencyTracer::usScope traceScope("needle detection 3D");
+  startDetection(V.getHeight(), V.getWidth(), V.getNumberOfFrames());
+  bool roiRestricted = (m_roi[0] > 0) || (m_roi[1] < m_dims[0]) || (m_roi[2] > 0) || (m_roi[3] < m_dims[1]) ||
+                       (m_roi[4] > 0) || (m_roi[5] < m_dims[2]);
+
+  selectCandidates(V);
+  bool found = findNeedle();
+
+  // The needle left the region of interest, was lost, or may be clipped by the region: search again in the whole
+  // volume
+  if (roiRestricted && (!found || m_needleClipped)) {
+    resetRegionOfInterest();
+    selectCandidates(V);
+    found = findNeedle();
+  }
+  return found;
+}
+
+/*
+ * Threshold giving the m_maxCandidateNumber brightest voxels of the region of interest, found with a partial sort
+ * of a copy of the region.
+ */
+template <class Type> double usNeedleDetector3D::computeThreshold(const usImage3D<Type> &V, bool &withTies)
+{
+  unsigned int height = m_roi[1] - m_roi[0];
+  unsigned int width = m_roi[3] - m_roi[2];
+  int frameNumber = static_cast<int>(m_roi[5] - m_roi[4]);
+  size_t frameSize = static_cast<size_t>(height) * width;
+  size_t size = frameSize * frameNumber;
+
+  double quantile = -std::numeric_limits<double>::max();
+  if (m_maxCandidateNumber < size) {
+    m_values.resize(size);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (int f = 0; f < frameNumber; ++f) {
+      float *values = &m_values[f * frameSize];
+      for (unsigned int i = m_roi[0]; i < m_roi[1]; ++i)
+        for (unsigned int j = m_roi[2]; j < m_roi[3]; ++j)
+          *values++ = static_cast<float>(V(i, j, m_roi[4] + f));
+    }
+    std::vector<float>::iterator nth = m_values.begin() + (size - m_maxCandidateNumber);
+    std::nth_element(m_values.begin(), nth, m_values.end());
+    quantile = *nth;
+  }
+  return selectThreshold(quantile, withTies);
+}
+
+/*
+ * Thresholding stage: fills m_points with the voxels of the region of interest above the threshold. When the
+ * threshold is the quantile, the voxels equal to it are regularly subsampled to complete the m_maxCandidateNumber
+ * candidates. The frames are processed in parallel, each one writing its candidates at an offset given by the counts
+ * of the previous frames.
+ */
+template <class Type> void usNeedleDetector3D::selectCandidates(const usImage3D<Type> &V)
+{
+  double t0 = vpTime::measureTimeMs();
+  usLatencyTracer::usScope traceScope("needle 3D thresholding");
+
+  bool withTies = false;
+  double threshold = computeThreshold(V, withTies);
+
+  int frameNumber = static_cast<int>(m_roi[5] - m_roi[4]);
+  m_frameCounts.resize(2 * frameNumber);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int f = 0; f < frameNumber; ++f) {
+    unsigned int above = 0;
+    unsigned int ties = 0;
+    for (unsigned int i = m_roi[0]; i < m_roi[1]; ++i) {
+      for (unsigned int j = m_roi[2]; j < m_roi[3]; ++j) {
+        double value = static_cast<double>(V(i, j, m_roi[4] + f));
+        if (value > threshold)
+          ++above;
+        else if (value == threshold)
+          ++ties;
+      }
+    }
+    m_frameCounts[2 * f] = above;
+    m_frameCounts[2 * f + 1] = ties;
+  }
+
+  unsigned int tieStride = computeFrameOffsets(withTies);
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int f = 0; f < frameNumber; ++f) {
+    unsigned int k = m_roi[4] + f;
+    // the offset is m_points.size() for the trailing frames without candidates
+    double *point = m_points.data() + 3 * m_frameCounts[2 * f];
+    unsigned int tie = m_frameCounts[2 * f + 1];
+    for (unsigned int i = m_roi[0]; i < m_roi[1]; ++i) {
+      for (unsigned int j = m_roi[2]; j < m_roi[3]; ++j) {
+        double value = static_cast<double>(V(i, j, k));
+        if ((value > threshold) || ((value == threshold) && (tieStride > 0) && (tie++ % tieStride == 0))) {
+          point[0] = i;
+          point[1] = j;
+          point[2] = k;
+          point += 3;
+        }
+      }
+    }
+  }
+
+  m_stageTimes[THRESHOLDING_STAGE] += vpTime::measureTimeMs() - t0;
+}
+
+#endif // __usNeedleDetector3D_h_
@@ -114,12 +114,19 @@ public:
 
   /**
    * Resample the particles proportionnaly to their weights.
+   *
+   * Systematic resampling is used: a single uniform draw positions N evenly spaced pointers over the cumulative
+   * weights, which are then swept once. The selected particles are copied into a preallocated buffer that is swapped
+   * with the current particle set, so that no allocation occurs.
    */
   void resample();
 
   /**
    * Runs the needle detection process with the current post-scan volume.
    *
+   * The image region covered by the particles is smoothed once per call, then the particle likelihoods are evaluated
+   * in parallel when OpenMP is available.
+   *
    * @param I The input image.
    * @param v The insertion velocity.
    */
@@ -141,11 +148,21 @@ public:
   void setSigma2(double s);
 
 private:
+  double computeSmoothedLikelihood(const usPolynomialCurve2D &model, const vpImage<unsigned char> &I) const;
+  void release();
+  void updateControlPoints(unsigned int i);
+
   unsigned int m_nParticles;
   unsigned int m_nPoints;
   unsigned int m_nPointsCurrent;
   usPolynomialCurve2D *m_needleModel;
-  usPolynomialCurve2D **m_particles;
+  usPolynomialCurve2D *m_particles;
+  usPolynomialCurve2D *m_particlesBuffer;
+  // Control points of all the particles, stored contiguously as one 2 x m_nPoints row-major block per particle
+  double *m_controlPoints;
+  double *m_controlPointsBuffer;
+  double *m_noiseBuffer;
+  vpMatrix m_controlPointsMatrix;
   double *m_weights;
   vpGaussRand m_noise;
   vpUniRand m_sample;
@@ -154,6 +171,8 @@ private:
 
   // Image parameters
   unsigned int m_dims[2];
+  vpImage<double> m_smoothedImage;
+  unsigned int m_smoothedRegion[4]; // first row, first column, last row + 1, last column + 1
   double m_fgMean;
   double m_bgMean;
 };
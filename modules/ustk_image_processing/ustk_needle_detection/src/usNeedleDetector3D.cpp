@@ -0,0 +1,809 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Pierre Chatelain
+ * Alexandre Krupa
+ *
+ *****************************************************************************/
+
+#include <visp3/ustk_needle_detection/usNeedleDetector3D.h>
+
+#include <cmath>
+
+#include <visp3/core/vpException.h>
+#include <visp3/core/vpMath.h>
+
+#ifdef VISP_HAVE_OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+const uint64_t usEmptyCell = ~static_cast<uint64_t>(0);
+const int usMaxCellCoordinate = 1 << 21;
+
+// Number of consecutive empty bins along the needle that separates it from outliers aligned with it
+const unsigned int usMaxBinGap = 3;
+
+// Maximal number of refinement iterations
+const unsigned int usMaxRefinementNumber = 10;
+
+uint64_t cellKey(int ci, int cj, int ck)
+{
+  return (static_cast<uint64_t>(ci) << 42) | (static_cast<uint64_t>(cj) << 21) | static_cast<uint64_t>(ck);
+}
+
+size_t cellSlot(uint64_t key, size_t mask) { return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask; }
+
+double squaredDistanceToSegment(const double *p, const double *a, const double *b)
+{
+  double ab[3];
+  double ap[3];
+  double ab2 = 0.0;
+  double dot = 0.0;
+  for (unsigned int k = 0; k < 3; ++k) {
+    ab[k] = b[k] - a[k];
+    ap[k] = p[k] - a[k];
+    ab2 += ab[k] * ab[k];
+    dot += ap[k] * ab[k];
+  }
+  double t = (ab2 > 0.0) ? std::min(1.0, std::max(0.0, dot / ab2)) : 0.0;
+  double d2 = 0.0;
+  for (unsigned int k = 0; k < 3; ++k) {
+    double e = ap[k] - t * ab[k];
+    d2 += e * e;
+  }
+  return d2;
+}
+} // namespace
+
+usNeedleDetector3D::usNeedleDetector3D()
+  : m_inlierDistance(2.0), m_iterationNumber(500), m_maxCandidateNumber(2000), m_minInlierNumber(30), m_order(1),
+    m_roiMargin(15), m_roiTracking(true), m_threshold(0.0), m_needleFound(false), m_needle(1), m_inlierNumber(0),
+    m_needleClipped(false), m_random(42)
+{
+  for (unsigned int k = 0; k < 3; ++k)
+    m_dims[k] = 0;
+  for (unsigned int k = 0; k < 6; ++k) {
+    m_roi[k] = 0;
+    m_bounds[k] = 0.0;
+  }
+  std::fill(m_stageTimes, m_stageTimes + STAGE_NUMBER, 0.0);
+}
+
+usNeedleDetector3D::~usNeedleDetector3D() {}
+
+unsigned int usNeedleDetector3D::getCandidateNumber() const { return m_points.size() / 3; }
+
+double usNeedleDetector3D::getInlierDistance() const { return m_inlierDistance; }
+
+unsigned int usNeedleDetector3D::getInlierNumber() const { return m_inlierNumber; }
+
+unsigned int usNeedleDetector3D::getIterationNumber() const { return m_iterationNumber; }
+
+unsigned int usNeedleDetector3D::getMaxCandidateNumber() const { return m_maxCandidateNumber; }
+
+unsigned int usNeedleDetector3D::getMinInlierNumber() const { return m_minInlierNumber; }
+
+const usPolynomialCurve3D &usNeedleDetector3D::getNeedle() const { return m_needle; }
+
+unsigned int usNeedleDetector3D::getOrder() const { return m_order; }
+
+void usNeedleDetector3D::getRegionOfInterest(unsigned int roi[6]) const
+{
+  for (unsigned int k = 0; k < 6; ++k)
+    roi[k] = m_roi[k];
+}
+
+unsigned int usNeedleDetector3D::getRegionOfInterestMargin() const { return m_roiMargin; }
+
+bool usNeedleDetector3D::getRegionOfInterestTracking() const { return m_roiTracking; }
+
+double usNeedleDetector3D::getStageTime(usDetectionStage stage) const
+{
+  if (stage >= STAGE_NUMBER)
+    throw(vpException(vpException::badValue, "usNeedleDetector3D::getStageTime: unknown stage"));
+  return m_stageTimes[stage];
+}
+
+double usNeedleDetector3D::getThreshold() const { return m_threshold; }
+
+void usNeedleDetector3D::reset()
+{
+  m_needleFound = false;
+  m_inlierNumber = 0;
+  resetRegionOfInterest();
+}
+
+void usNeedleDetector3D::setInlierDistance(double distance)
+{
+  if (distance <= 0.0)
+    throw(vpException(vpException::badValue, "usNeedleDetector3D::setInlierDistance: the distance should be positive"));
+  m_inlierDistance = distance;
+}
+
+void usNeedleDetector3D::setIterationNumber(unsigned int iterationNumber)
+{
+  if (iterationNumber == 0)
+    throw(vpException(vpException::badValue, "usNeedleDetector3D::setIterationNumber: at least one iteration needed"));
+  m_iterationNumber = iterationNumber;
+}
+
+void usNeedleDetector3D::setMaxCandidateNumber(unsigned int candidateNumber)
+{
+  if (candidateNumber == 0)
+    throw(vpException(vpException::badValue,
+                      "usNeedleDetector3D::setMaxCandidateNumber: at least one candidate needed"));
+  m_maxCandidateNumber = candidateNumber;
+}
+
+void usNeedleDetector3D::setMinInlierNumber(unsigned int inlierNumber) { m_minInlierNumber = inlierNumber; }
+
+void usNeedleDetector3D::setOrder(unsigned int order)
+{
+  if (order == 0)
+    throw(vpException(vpException::badValue, "usNeedleDetector3D::setOrder: the order should be at least 1"));
+  m_order = order;
+}
+
+void usNeedleDetector3D::setRegionOfInterestMargin(unsigned int margin) { m_roiMargin = margin; }
+
+void usNeedleDetector3D::setRegionOfInterestTracking(bool tracking)
+{
+  m_roiTracking = tracking;
+  if (!tracking)
+    resetRegionOfInterest();
+}
+
+void usNeedleDetector3D::setThreshold(double threshold) { m_threshold = threshold; }
+
+/*
+ * Spatial hash of the candidates: the non empty cells are stored in an open addressing table, and the candidate
+ * indexes are sorted by cell (counting sort) so that each cell is a range of m_cellPoints.
+ */
+void usNeedleDetector3D::buildHash()
+{
+  unsigned int n = m_points.size() / 3;
+  double cellSize = 2.0 * m_inlierDistance;
+
+  size_t tableSize = 16;
+  while (tableSize < 2 * static_cast<size_t>(n))
+    tableSize *= 2;
+  size_t mask = tableSize - 1;
+  usCell emptyCell = {usEmptyCell, 0, 0};
+  m_cells.assign(tableSize, emptyCell);
+  m_pointSlots.resize(n);
+
+  for (unsigned int k = 0; k < 3; ++k) {
+    m_bounds[2 * k] = std::numeric_limits<double>::max();
+    m_bounds[2 * k + 1] = -std::numeric_limits<double>::max();
+  }
+
+  for (unsigned int p = 0; p < n; ++p) {
+    const double *point = &m_points[3 * p];
+    uint64_t key = cellKey(static_cast<int>(point[0] / cellSize), static_cast<int>(point[1] / cellSize),
+                           static_cast<int>(point[2] / cellSize));
+    size_t slot = cellSlot(key, mask);
+    while (m_cells[slot].key != usEmptyCell && m_cells[slot].key != key)
+      slot = (slot + 1) & mask;
+    m_cells[slot].key = key;
+    ++m_cells[slot].count;
+    m_pointSlots[p] = slot;
+    for (unsigned int k = 0; k < 3; ++k) {
+      m_bounds[2 * k] = std::min(m_bounds[2 * k], point[k]);
+      m_bounds[2 * k + 1] = std::max(m_bounds[2 * k + 1], point[k]);
+    }
+  }
+  for (unsigned int k = 0; k < 3; ++k) {
+    m_bounds[2 * k] -= m_inlierDistance;
+    m_bounds[2 * k + 1] += m_inlierDistance;
+  }
+
+  unsigned int begin = 0;
+  for (size_t slot = 0; slot < tableSize; ++slot) {
+    m_cells[slot].begin = begin;
+    begin += m_cells[slot].count;
+    m_cells[slot].count = 0;
+  }
+  m_cellPoints.resize(n);
+  for (unsigned int p = 0; p < n; ++p) {
+    usCell &cell = m_cells[m_pointSlots[p]];
+    m_cellPoints[cell.begin + cell.count++] = p;
+  }
+}
+
+/*
+ * Polyline sampling the hypothesis fitted on a minimal sample, every inlier distance. A straight line is clipped to
+ * the bounding box of the candidates, a polynomial curve goes from the first to the last sampled candidate.
+ */
+bool usNeedleDetector3D::buildHypothesis(const unsigned int *sample, std::vector<double> &vertices) const
+{
+  unsigned int sampleSize = m_order + 1;
+
+  // The two farthest candidates of the sample give the direction of the hypothesis
+  unsigned int a = 0;
+  unsigned int b = 0;
+  double maxDistance = 0.0;
+  for (unsigned int x = 0; x < sampleSize; ++x) {
+    for (unsigned int y = x + 1; y < sampleSize; ++y) {
+      double d2 = 0.0;
+      for (unsigned int k = 0; k < 3; ++k)
+        d2 += vpMath::sqr(m_points[3 * sample[x] + k] - m_points[3 * sample[y] + k]);
+      if (d2 > maxDistance) {
+        maxDistance = d2;
+        a = x;
+        b = y;
+      }
+    }
+  }
+  double cellSize = 2.0 * m_inlierDistance;
+  if (maxDistance < 4.0 * cellSize * cellSize)
+    return false;
+  const double *pa = &m_points[3 * sample[a]];
+  const double *pb = &m_points[3 * sample[b]];
+
+  if (m_order == 1) {
+    double norm = sqrt(maxDistance);
+    double u[3];
+    double t0 = -std::numeric_limits<double>::max();
+    double t1 = std::numeric_limits<double>::max();
+    for (unsigned int k = 0; k < 3; ++k) {
+      u[k] = (pb[k] - pa[k]) / norm;
+      if (std::fabs(u[k]) > std::numeric_limits<double>::epsilon()) {
+        double ta = (m_bounds[2 * k] - pa[k]) / u[k];
+        double tb = (m_bounds[2 * k + 1] - pa[k]) / u[k];
+        t0 = std::max(t0, std::min(ta, tb));
+        t1 = std::min(t1, std::max(ta, tb));
+      }
+    }
+    if (t0 > t1)
+      return false;
+    unsigned int vertexNumber = static_cast<unsigned int>(std::ceil((t1 - t0) / m_inlierDistance)) + 1;
+    vertices.resize(3 * vertexNumber);
+    for (unsigned int s = 0; s < vertexNumber; ++s) {
+      double t = t0 + (t1 - t0) * s / (vertexNumber - 1);
+      for (unsigned int k = 0; k < 3; ++k)
+        vertices[3 * s + k] = pa[k] + t * u[k];
+    }
+    return true;
+  }
+
+  vpMatrix points(3, sampleSize);
+  for (unsigned int x = 0; x < sampleSize; ++x)
+    for (unsigned int k = 0; k < 3; ++k)
+      points[k][x] = m_points[3 * sample[x] + k];
+  vpColVector direction(3);
+  for (unsigned int k = 0; k < 3; ++k)
+    direction[k] = pb[k] - pa[k];
+  usPolynomialCurve3D curve(m_order);
+  try {
+    curve.defineFromPointsAuto(points, direction, m_order);
+  } catch (const vpException &) {
+    return false;
+  }
+  return sampleCurve(curve, 0.0, vertices);
+}
+
+/*
+ * Turns the per frame counts of candidates and ties into the offsets at which each frame writes its candidates and
+ * the global index of its first tie. Returns the subsampling step of the ties, 0 if they are excluded.
+ */
+unsigned int usNeedleDetector3D::computeFrameOffsets(bool withTies)
+{
+  unsigned int frameNumber = m_frameCounts.size() / 2;
+  unsigned int above = 0;
+  unsigned int ties = 0;
+  for (unsigned int f = 0; f < frameNumber; ++f) {
+    above += m_frameCounts[2 * f];
+    ties += m_frameCounts[2 * f + 1];
+  }
+
+  unsigned int tieStride = 0;
+  if (withTies && (ties > 0) && (above < m_maxCandidateNumber)) {
+    unsigned int remaining = m_maxCandidateNumber - above;
+    tieStride = (ties + remaining - 1) / remaining;
+  }
+
+  unsigned int pointOffset = 0;
+  unsigned int tieOffset = 0;
+  for (unsigned int f = 0; f < frameNumber; ++f) {
+    unsigned int frameAbove = m_frameCounts[2 * f];
+    unsigned int frameTies = m_frameCounts[2 * f + 1];
+    m_frameCounts[2 * f] = pointOffset;
+    m_frameCounts[2 * f + 1] = tieOffset;
+    pointOffset += frameAbove;
+    if (tieStride > 0)
+      pointOffset += (tieOffset + frameTies + tieStride - 1) / tieStride - (tieOffset + tieStride - 1) / tieStride;
+    tieOffset += frameTies;
+  }
+  m_points.resize(3 * pointOffset);
+  return tieStride;
+}
+
+/*
+ * Threshold of unsigned char volumes, from the histogram of the region of interest as in
+ * usNeedleDetectionTools::computeQuantile().
+ */
+double usNeedleDetector3D::computeThreshold(const usImage3D<unsigned char> &V, bool &withTies)
+{
+  int frameNumber = static_cast<int>(m_roi[5] - m_roi[4]);
+  m_histograms.assign(256 * frameNumber, 0);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int f = 0; f < frameNumber; ++f) {
+    unsigned int *histogram = &m_histograms[256 * f];
+    for (unsigned int i = m_roi[0]; i < m_roi[1]; ++i)
+      for (unsigned int j = m_roi[2]; j < m_roi[3]; ++j)
+        ++histogram[V(i, j, m_roi[4] + f)];
+  }
+
+  unsigned int histogram[256];
+  std::fill(histogram, histogram + 256, 0);
+  for (int f = 0; f < frameNumber; ++f)
+    for (unsigned int h = 0; h < 256; ++h)
+      histogram[h] += m_histograms[256 * f + h];
+
+  double quantile = -std::numeric_limits<double>::max();
+  unsigned int nThresholded = 0;
+  for (int q = 255; q >= 0; --q) {
+    nThresholded += histogram[q];
+    if (nThresholded >= m_maxCandidateNumber) {
+      quantile = q;
+      break;
+    }
+  }
+  return selectThreshold(quantile, withTies);
+}
+
+/*
+ * Number of candidates closer than the inlier distance to the polyline of the workspace. A candidate within the
+ * inlier distance of a segment is at most one cell away from both of its vertices, so only the 27 cells around each
+ * vertex are visited.
+ */
+unsigned int usNeedleDetector3D::countInliers(usWorkspace &workspace, std::vector<unsigned int> *inliers) const
+{
+  if (++workspace.stamp == 0) {
+    std::fill(workspace.stamps.begin(), workspace.stamps.end(), 0);
+    workspace.stamp = 1;
+  }
+
+  const std::vector<double> &vertices = workspace.vertices;
+  unsigned int vertexNumber = vertices.size() / 3;
+  double cellSize = 2.0 * m_inlierDistance;
+  double d2 = vpMath::sqr(m_inlierDistance);
+  unsigned int count = 0;
+
+  for (unsigned int s = 0; s < vertexNumber; ++s) {
+    const double *vertex = &vertices[3 * s];
+    const double *previous = (s > 0) ? vertex - 3 : NULL;
+    const double *next = (s + 1 < vertexNumber) ? vertex + 3 : vertex;
+    int ci = static_cast<int>(std::floor(vertex[0] / cellSize));
+    int cj = static_cast<int>(std::floor(vertex[1] / cellSize));
+    int ck = static_cast<int>(std::floor(vertex[2] / cellSize));
+    for (int di = -1; di <= 1; ++di) {
+      for (int dj = -1; dj <= 1; ++dj) {
+        for (int dk = -1; dk <= 1; ++dk) {
+          const usCell *cell = findCell(ci + di, cj + dj, ck + dk);
+          if (cell == NULL)
+            continue;
+          for (unsigned int m = cell->begin; m < cell->begin + cell->count; ++m) {
+            unsigned int p = m_cellPoints[m];
+            if (workspace.stamps[p] == workspace.stamp)
+              continue;
+            const double *point = &m_points[3 * p];
+            double distance = squaredDistanceToSegment(point, vertex, next);
+            if (previous != NULL)
+              distance = std::min(distance, squaredDistanceToSegment(point, previous, vertex));
+            if (distance <= d2) {
+              workspace.stamps[p] = workspace.stamp;
+              ++count;
+              if (inliers != NULL)
+                inliers->push_back(p);
+            }
+          }
+        }
+      }
+    }
+  }
+  return count;
+}
+
+const usNeedleDetector3D::usCell *usNeedleDetector3D::findCell(int ci, int cj, int ck) const
+{
+  if ((ci < 0) || (cj < 0) || (ck < 0) || (ci >= usMaxCellCoordinate) || (cj >= usMaxCellCoordinate) ||
+      (ck >= usMaxCellCoordinate) || m_cells.empty())
+    return NULL;
+  uint64_t key = cellKey(ci, cj, ck);
+  size_t mask = m_cells.size() - 1;
+  size_t slot = cellSlot(key, mask);
+  while (m_cells[slot].key != usEmptyCell) {
+    if (m_cells[slot].key == key)
+      return &m_cells[slot];
+    slot = (slot + 1) & mask;
+  }
+  return NULL;
+}
+
+/*
+ * Hashing, RANSAC and refinement stages on the candidates selected by selectCandidates().
+ */
+bool usNeedleDetector3D::findNeedle()
+{
+  double t0 = vpTime::measureTimeMs();
+  {
+    usLatencyTracer::usScope traceScope("needle 3D hashing");
+    buildHash();
+    removeIsolatedCandidates();
+  }
+  double t1 = vpTime::measureTimeMs();
+  m_stageTimes[HASHING_STAGE] += t1 - t0;
+
+  unsigned int n = m_points.size() / 3;
+  unsigned int sampleSize = m_order + 1;
+  m_inlierNumber = 0;
+  if (n < std::max(sampleSize, m_minInlierNumber) || n < 2) {
+    m_needleFound = false;
+    return false;
+  }
+
+  // RANSAC
+  int bestIteration = -1;
+  {
+    usLatencyTracer::usScope traceScope("needle 3D RANSAC");
+#ifdef VISP_HAVE_OPENMP
+    unsigned int threadNumber = std::max(1, omp_get_max_threads());
+#else
+    unsigned int threadNumber = 1;
+#endif
+    m_workspaces.resize(threadNumber);
+    for (unsigned int w = 0; w < threadNumber; ++w) {
+      if (m_workspaces[w].stamps.size() != n) {
+        m_workspaces[w].stamps.assign(n, 0);
+        m_workspaces[w].stamp = 0;
+      }
+    }
+
+    // The samples are drawn beforehand, so that the result does not depend on the number of threads
+    m_samples.resize(m_iterationNumber * sampleSize);
+    for (unsigned int s = 0; s < m_samples.size(); ++s)
+      m_samples[s] = std::min(n - 1, static_cast<unsigned int>(m_random() * n));
+
+    m_scores.resize(m_iterationNumber);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 8)
+#endif
+    for (int it = 0; it < static_cast<int>(m_iterationNumber); ++it) {
+      usWorkspace &ws = workspace();
+      m_scores[it] = buildHypothesis(&m_samples[it * sampleSize], ws.vertices) ? countInliers(ws, NULL) : 0;
+    }
+
+    unsigned int bestScore = 0;
+    for (unsigned int it = 0; it < m_iterationNumber; ++it) {
+      if (m_scores[it] > bestScore) {
+        bestScore = m_scores[it];
+        bestIteration = it;
+      }
+    }
+  }
+  double t2 = vpTime::measureTimeMs();
+  m_stageTimes[RANSAC_STAGE] += t2 - t1;
+
+  if ((bestIteration < 0) || (m_scores[bestIteration] < m_minInlierNumber)) {
+    m_needleFound = false;
+    return false;
+  }
+
+  // Refinement
+  bool found = false;
+  {
+    usLatencyTracer::usScope traceScope("needle 3D refinement");
+    double cellSize = 2.0 * m_inlierDistance;
+    usWorkspace &ws = m_workspaces[0];
+    buildHypothesis(&m_samples[bestIteration * sampleSize], ws.vertices);
+    m_inliers.clear();
+    countInliers(ws, &m_inliers);
+
+    // Orientation along the previous needle, or along the main axis in the increasing coordinates
+    vpColVector direction(3);
+    for (unsigned int k = 0; k < 3; ++k)
+      direction[k] = ws.vertices[ws.vertices.size() - 3 + k] - ws.vertices[k];
+    double orientation = 0.0;
+    if (m_needleFound) {
+      vpColVector start = m_needle.getStartPoint();
+      vpColVector end = m_needle.getEndPoint();
+      for (unsigned int k = 0; k < 3; ++k)
+        orientation += direction[k] * (end[k] - start[k]);
+    } else {
+      for (unsigned int k = 0; k < 3; ++k)
+        if (std::fabs(direction[k]) > std::fabs(orientation))
+          orientation = direction[k];
+    }
+    if (orientation < 0.0)
+      for (unsigned int k = 0; k < 3; ++k)
+        direction[k] = -direction[k];
+
+    // Fit on the inliers, then look for new inliers beyond the extremities of the curve until it stops growing
+    usPolynomialCurve3D curve(m_order);
+    usPolynomialCurve3D candidate(m_order);
+    unsigned int fitted = 0;
+    for (unsigned int iteration = 0; iteration < usMaxRefinementNumber; ++iteration) {
+      unsigned int used = fitCurve(m_inliers, direction, candidate);
+      if (used <= fitted)
+        break;
+      curve = candidate;
+      fitted = used;
+      double extension = 0.25 * curve.getLength() + cellSize;
+      if (!sampleCurve(curve, extension, ws.vertices))
+        break;
+      m_inliers.clear();
+      countInliers(ws, &m_inliers);
+      vpColVector start = curve.getStartPoint();
+      vpColVector end = curve.getEndPoint();
+      for (unsigned int k = 0; k < 3; ++k)
+        direction[k] = end[k] - start[k];
+    }
+
+    found = (fitted >= m_minInlierNumber) && sampleCurve(curve, 0.0, ws.vertices);
+    if (found) {
+      m_needle = curve;
+      m_inlierNumber = fitted;
+      // Bounding box of the needle, enlarged by the margin to get the next region of interest. A needle reaching a
+      // face of the current region of interest that is not a face of the volume may be clipped by the region.
+      m_needleClipped = false;
+      for (unsigned int k = 0; k < 3; ++k) {
+        double low = std::numeric_limits<double>::max();
+        double high = -std::numeric_limits<double>::max();
+        for (unsigned int s = 0; s < ws.vertices.size(); s += 3) {
+          low = std::min(low, ws.vertices[s + k]);
+          high = std::max(high, ws.vertices[s + k]);
+        }
+        if (((m_roi[2 * k] > 0) && (low - m_roi[2 * k] < cellSize)) ||
+            ((m_roi[2 * k + 1] < m_dims[k]) && (m_roi[2 * k + 1] - 1.0 - high < cellSize)))
+          m_needleClipped = true;
+        if (m_roiTracking) {
+          low = std::floor(low) - m_roiMargin;
+          high = std::ceil(high) + m_roiMargin + 1.0;
+          m_roi[2 * k] = static_cast<unsigned int>(std::max(0.0, std::min(low, static_cast<double>(m_dims[k]))));
+          m_roi[2 * k + 1] = static_cast<unsigned int>(
+              std::max(static_cast<double>(m_roi[2 * k]), std::min(high, static_cast<double>(m_dims[k]))));
+        }
+      }
+    }
+  }
+  m_needleFound = found;
+  if (!found)
+    resetRegionOfInterest();
+  m_stageTimes[REFINEMENT_STAGE] += vpTime::measureTimeMs() - t2;
+
+  return found;
+}
+
+/*
+ * Fits the needle on the inliers: they are binned every inlier distance along the direction, and the curve is fitted
+ * on the centroids of the bins weighted by their number of inliers. The bins with less than a quarter of the median
+ * count are considered empty, and only the longest run of bins without a large gap is kept, the other inliers being
+ * outliers aligned with the needle. Returns the number of inliers used, 0 if the fit failed.
+ */
+unsigned int usNeedleDetector3D::fitCurve(const std::vector<unsigned int> &inliers, const vpColVector &direction,
+                                          usPolynomialCurve3D &curve)
+{
+  double norm = sqrt(vpMath::sqr(direction[0]) + vpMath::sqr(direction[1]) + vpMath::sqr(direction[2]));
+  if ((inliers.size() < 2) || (norm == 0.0))
+    return 0;
+  double u[3] = {direction[0] / norm, direction[1] / norm, direction[2] / norm};
+
+  double tMin = std::numeric_limits<double>::max();
+  double tMax = -std::numeric_limits<double>::max();
+  for (unsigned int m = 0; m < inliers.size(); ++m) {
+    const double *point = &m_points[3 * inliers[m]];
+    double t = point[0] * u[0] + point[1] * u[1] + point[2] * u[2];
+    tMin = std::min(tMin, t);
+    tMax = std::max(tMax, t);
+  }
+  unsigned int binNumber = static_cast<unsigned int>((tMax - tMin) / m_inlierDistance) + 1;
+  m_bins.assign(4 * binNumber, 0.0);
+  for (unsigned int m = 0; m < inliers.size(); ++m) {
+    const double *point = &m_points[3 * inliers[m]];
+    double t = point[0] * u[0] + point[1] * u[1] + point[2] * u[2];
+    unsigned int b = std::min(binNumber - 1, static_cast<unsigned int>((t - tMin) / m_inlierDistance));
+    for (unsigned int k = 0; k < 3; ++k)
+      m_bins[4 * b + k] += point[k];
+    m_bins[4 * b + 3] += 1.0;
+  }
+
+  // Minimal count of a needle bin, from the median count of the non empty bins
+  std::vector<double> counts;
+  for (unsigned int b = 0; b < binNumber; ++b)
+    if (m_bins[4 * b + 3] > 0.0)
+      counts.push_back(m_bins[4 * b + 3]);
+  std::nth_element(counts.begin(), counts.begin() + counts.size() / 2, counts.end());
+  double minCount = std::max(1.0, std::floor(0.25 * counts[counts.size() / 2]));
+
+  unsigned int bestBegin = 0;
+  unsigned int bestEnd = 0;
+  unsigned int bestCount = 0;
+  unsigned int runBegin = 0;
+  unsigned int runEnd = 0;
+  unsigned int runCount = 0;
+  for (unsigned int b = 0; b < binNumber; ++b) {
+    unsigned int count = static_cast<unsigned int>(m_bins[4 * b + 3]);
+    if (count < minCount)
+      continue;
+    if ((runCount > 0) && (b - runEnd >= usMaxBinGap)) {
+      if (runCount > bestCount) {
+        bestBegin = runBegin;
+        bestEnd = runEnd;
+        bestCount = runCount;
+      }
+      runCount = 0;
+    }
+    if (runCount == 0)
+      runBegin = b;
+    runEnd = b + 1;
+    runCount += count;
+  }
+  if (runCount > bestCount) {
+    bestBegin = runBegin;
+    bestEnd = runEnd;
+    bestCount = runCount;
+  }
+
+  unsigned int centroidNumber = 0;
+  for (unsigned int b = bestBegin; b < bestEnd; ++b)
+    if (m_bins[4 * b + 3] >= minCount)
+      ++centroidNumber;
+  if ((centroidNumber < 2) || (centroidNumber < m_order + 1))
+    return 0;
+
+  vpMatrix centroids(3, centroidNumber);
+  vpColVector weights(centroidNumber);
+  unsigned int c = 0;
+  for (unsigned int b = bestBegin; b < bestEnd; ++b) {
+    double count = m_bins[4 * b + 3];
+    if (count < minCount)
+      continue;
+    for (unsigned int k = 0; k < 3; ++k)
+      centroids[k][c] = m_bins[4 * b + k] / count;
+    weights[c] = count;
+    ++c;
+  }
+
+  usPolynomialCurve3D fitted(m_order);
+  try {
+    fitted.defineFromWeightedPointsAuto(centroids, weights, direction, m_order);
+  } catch (const vpException &) {
+    return 0;
+  }
+  curve = fitted;
+  return bestCount;
+}
+
+/*
+ * Discards the candidates having less than two other candidates in the 27 cells around their own cell.
+ */
+void usNeedleDetector3D::removeIsolatedCandidates()
+{
+  unsigned int n = m_points.size() / 3;
+  double cellSize = 2.0 * m_inlierDistance;
+  unsigned int kept = 0;
+  for (unsigned int p = 0; p < n; ++p) {
+    const double *point = &m_points[3 * p];
+    int ci = static_cast<int>(point[0] / cellSize);
+    int cj = static_cast<int>(point[1] / cellSize);
+    int ck = static_cast<int>(point[2] / cellSize);
+    unsigned int neighbours = 0;
+    for (int di = -1; di <= 1 && neighbours < 3; ++di)
+      for (int dj = -1; dj <= 1 && neighbours < 3; ++dj)
+        for (int dk = -1; dk <= 1 && neighbours < 3; ++dk) {
+          const usCell *cell = findCell(ci + di, cj + dj, ck + dk);
+          if (cell != NULL)
+            neighbours += cell->count;
+        }
+    if (neighbours >= 3) {
+      for (unsigned int k = 0; k < 3; ++k)
+        m_points[3 * kept + k] = point[k];
+      ++kept;
+    }
+  }
+  if (kept < n) {
+    m_points.resize(3 * kept);
+    buildHash();
+  }
+}
+
+void usNeedleDetector3D::resetRegionOfInterest()
+{
+  for (unsigned int k = 0; k < 3; ++k) {
+    m_roi[2 * k] = 0;
+    m_roi[2 * k + 1] = m_dims[k];
+  }
+}
+
+/*
+ * Polyline sampling the curve every inlier distance, from extension voxels before its start to extension voxels
+ * after its end. Fails for degenerated curves, and for curves much longer than the candidates extent.
+ */
+bool usNeedleDetector3D::sampleCurve(const usPolynomialCurve3D &curve, double extension,
+                                     std::vector<double> &vertices) const
+{
+  double length = curve.getLength();
+  double diagonal = sqrt(vpMath::sqr(m_bounds[1] - m_bounds[0]) + vpMath::sqr(m_bounds[3] - m_bounds[2]) +
+                         vpMath::sqr(m_bounds[5] - m_bounds[4]));
+  if (!(length > 0.0) || (length > 2.0 * diagonal))
+    return false;
+
+  double start = curve.getStartParameter();
+  double end = curve.getEndParameter();
+  double parameterPerVoxel = (end - start) / length;
+  start -= extension * parameterPerVoxel;
+  end += extension * parameterPerVoxel;
+
+  unsigned int order = curve.getOrder();
+  vpMatrix coefficients = curve.getPolynomialCoefficients();
+  unsigned int vertexNumber = static_cast<unsigned int>(std::ceil((length + 2.0 * extension) / m_inlierDistance)) + 1;
+  vertices.resize(3 * vertexNumber);
+  for (unsigned int s = 0; s < vertexNumber; ++s) {
+    double t = start + (end - start) * s / (vertexNumber - 1);
+    for (unsigned int k = 0; k < 3; ++k) {
+      double value = coefficients[k][order];
+      for (unsigned int m = order; m > 0; --m)
+        value = value * t + coefficients[k][m - 1];
+      vertices[3 * s + k] = value;
+    }
+  }
+  return true;
+}
+
+double usNeedleDetector3D::selectThreshold(double quantile, bool &withTies) const
+{
+  withTies = (quantile > m_threshold);
+  return withTies ? quantile : m_threshold;
+}
+
+void usNeedleDetector3D::startDetection(unsigned int height, unsigned int width, unsigned int frameNumber)
+{
+  if ((height != m_dims[0]) || (width != m_dims[1]) || (frameNumber != m_dims[2])) {
+    m_dims[0] = height;
+    m_dims[1] = width;
+    m_dims[2] = frameNumber;
+    m_needleFound = false;
+    resetRegionOfInterest();
+  }
+  m_inlierNumber = 0;
+  std::fill(m_stageTimes, m_stageTimes + STAGE_NUMBER, 0.0);
+}
+
+usNeedleDetector3D::usWorkspace &usNeedleDetector3D::workspace()
+{
+#ifdef VISP_HAVE_OPENMP
+  return m_workspaces[omp_get_thread_num()];
+#else
+  return m_workspaces[0];
+#endif
+}
@@ -31,13 +31,114 @@
  *
  *****************************************************************************/
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
 #include <visp3/core/vpImageFilter.h>
 #include <visp3/ustk_needle_detection/usNeedleTrackerSIR2D.h>
 
+namespace
+{
+double polynomialValue(const double *coefficients, unsigned int order, double t)
+{
+  double value = coefficients[order];
+  for (unsigned int i = order; i > 0; --i)
+    value = value * t + coefficients[i - 1];
+  return value;
+}
+
+struct usGaussianIntensity {
+  const vpImage<unsigned char> &m_I;
+  usGaussianIntensity(const vpImage<unsigned char> &I) : m_I(I) {}
+  double operator()(unsigned int x, unsigned int y) const { return vpImageFilter::gaussianFilter(m_I, x, y); }
+};
+
+struct usSmoothedIntensity {
+  const vpImage<double> &m_smoothed;
+  const unsigned int *m_region;
+  const vpImage<unsigned char> &m_I;
+  usSmoothedIntensity(const vpImage<double> &smoothed, const unsigned int region[4], const vpImage<unsigned char> &I)
+    : m_smoothed(smoothed), m_region(region), m_I(I)
+  {
+  }
+  double operator()(unsigned int x, unsigned int y) const
+  {
+    if ((m_region[0] <= x) && (x < m_region[2]) && (m_region[1] <= y) && (y < m_region[3]))
+      return m_smoothed[x][y];
+    return vpImageFilter::gaussianFilter(m_I, x, y);
+  }
+};
+
+/*
+ * Samples the curve every pixel along its length and returns the mean intensity plus the contrast at the tip.
+ * Consecutive samples are obtained by forward differencing the polynomial, which costs order + 1 additions per
+ * coordinate instead of a full evaluation.
+ */
+template <class Intensity>
+double curveLikelihood(const usPolynomialCurve2D &model, const unsigned int dims[2], const Intensity &intensity)
+{
+  unsigned int order = model.getOrder();
+  vpMatrix coefficients = model.getPolynomialCoefficients();
+  double length = model.getLength();
+  double step = 1.0 / length;
+
+  // Forward differences of both coordinates at t = 0
+  std::vector<double> delta(2 * (order + 1));
+  for (unsigned int k = 0; k < 2; ++k) {
+    double *d = &delta[k * (order + 1)];
+    for (unsigned int j = 0; j <= order; ++j)
+      d[j] = polynomialValue(coefficients[k], order, j * step);
+    for (unsigned int j = 1; j <= order; ++j)
+      for (unsigned int m = order; m >= j; --m)
+        d[m] -= d[m - 1];
+  }
+  double *dx = &delta[0];
+  double *dy = &delta[order + 1];
+
+  double l = 0.0;
+  unsigned int c = 0;
+  for (double t = 0; t <= 1.0; t += step) {
+    unsigned int x = vpMath::round(dx[0]);
+    unsigned int y = vpMath::round(dy[0]);
+    if ((3 <= x) && (x < dims[0] - 3) && (3 <= y) && (y < dims[1] - 3)) {
+      ++c;
+      l += intensity(x, y);
+    }
+    for (unsigned int j = 0; j < order; ++j) {
+      dx[j] += dx[j + 1];
+      dy[j] += dy[j + 1];
+    }
+  }
+
+  if (c == 0)
+    return 0.0;
+
+  l /= c;
+
+  unsigned int x = vpMath::round(polynomialValue(coefficients[0], order, 1.0));
+  unsigned int y = vpMath::round(polynomialValue(coefficients[1], order, 1.0));
+  if ((3 <= x) && (x < dims[0] - 3) && (3 <= y) && (y < dims[1] - 3))
+    l += intensity(x, y);
+
+  x = vpMath::round(polynomialValue(coefficients[0], order, 1.0 + step));
+  y = vpMath::round(polynomialValue(coefficients[1], order, 1.0 + step));
+  if ((3 <= x) && (x < dims[0] - 3) && (3 <= y) && (y < dims[1] - 3))
+    l -= intensity(x, y);
+
+  return l;
+}
+} // namespace
+
 usNeedleTrackerSIR2D::usNeedleTrackerSIR2D()
 {
   m_needleModel = NULL;
   m_particles = NULL;
+  m_particlesBuffer = NULL;
+  m_controlPoints = NULL;
+  m_controlPointsBuffer = NULL;
+  m_noiseBuffer = NULL;
   m_weights = NULL;
   m_noise.setSigmaMean(1.0, 0.0);
   m_noise.seed(42);
@@ -45,22 +146,34 @@ usNeedleTrackerSIR2D::usNeedleTrackerSIR2D()
   m_sigma.eye(2);
 }
 
-usNeedleTrackerSIR2D::~usNeedleTrackerSIR2D()
+usNeedleTrackerSIR2D::~usNeedleTrackerSIR2D() { release(); }
+
+void usNeedleTrackerSIR2D::release()
 {
   if (m_needleModel) {
     delete m_needleModel;
     m_needleModel = NULL;
   }
   if (m_particles) {
-    for (unsigned int i = 0; i < m_nParticles; ++i) {
-      if (m_particles[i]) {
-        delete m_particles[i];
-        m_particles[i] = NULL;
-      }
-    }
     delete[] m_particles;
     m_particles = NULL;
   }
+  if (m_particlesBuffer) {
+    delete[] m_particlesBuffer;
+    m_particlesBuffer = NULL;
+  }
+  if (m_controlPoints) {
+    delete[] m_controlPoints;
+    m_controlPoints = NULL;
+  }
+  if (m_controlPointsBuffer) {
+    delete[] m_controlPointsBuffer;
+    m_controlPointsBuffer = NULL;
+  }
+  if (m_noiseBuffer) {
+    delete[] m_noiseBuffer;
+    m_noiseBuffer = NULL;
+  }
   if (m_weights) {
     delete[] m_weights;
     m_weights = NULL;
@@ -70,15 +183,33 @@ usNeedleTrackerSIR2D::~usNeedleTrackerSIR2D()
 void usNeedleTrackerSIR2D::init(unsigned int dims[2], unsigned int nPoints, unsigned int nParticles,
                                 const usPolynomialCurve2D &needle)
 {
+  release();
+
   m_dims[0] = dims[0];
   m_dims[1] = dims[1];
-  m_nPoints = nPoints;
   m_nPointsCurrent = needle.getOrder() + 1;
+  m_nPoints = std::max(nPoints, m_nPointsCurrent);
   m_nParticles = nParticles;
   m_needleModel = new usPolynomialCurve2D(needle);
-  m_particles = new usPolynomialCurve2D *[m_nParticles];
-  for (unsigned int i = 0; i < m_nParticles; ++i)
-    m_particles[i] = new usPolynomialCurve2D(needle);
+
+  // All the particle storage is allocated once here, run() and resample() only work in place
+  unsigned int blockSize = 2 * m_nPoints;
+  m_particles = new usPolynomialCurve2D[m_nParticles];
+  m_particlesBuffer = new usPolynomialCurve2D[m_nParticles];
+  m_controlPoints = new double[blockSize * m_nParticles];
+  m_controlPointsBuffer = new double[blockSize * m_nParticles];
+  m_noiseBuffer = new double[blockSize * m_nParticles];
+  m_controlPointsMatrix.resize(2, m_nPointsCurrent);
+  for (unsigned int i = 0; i < m_nParticles; ++i) {
+    m_particles[i] = needle;
+    m_particlesBuffer[i] = needle;
+  }
+  if (m_nParticles > 0) {
+    updateControlPoints(0);
+    for (unsigned int i = 1; i < m_nParticles; ++i)
+      memcpy(m_controlPoints + blockSize * i, m_controlPoints, blockSize * sizeof(double));
+  }
+
   m_weights = new double[m_nParticles];
   for (unsigned int i = 0; i < m_nParticles; ++i)
     m_weights[i] = 1.0 / m_nParticles;
@@ -120,7 +251,7 @@ usPolynomialCurve2D *usNeedleTrackerSIR2D::getParticle(unsigned int i)
               << "Particle index is out of range." << std::endl;
     exit(EXIT_FAILURE);
   }
-  return m_particles[i];
+  return &m_particles[i];
 }
 
 double usNeedleTrackerSIR2D::getWeight(unsigned int i)
@@ -141,73 +272,105 @@ void usNeedleTrackerSIR2D::setSigma2(double s) { m_sigma[1][1] = s; }
 
 void usNeedleTrackerSIR2D::run(vpImage<unsigned char> &I, double v)
 {
-  vpMatrix controlPoints;
-  vpMatrix meanControlPoints;
-  vpColVector direction;
-  vpMatrix S_noise_tip;
-  vpMatrix S_noise_inter;
-  vpColVector noise(2);
-  vpMatrix U(2, 2);
+  unsigned int blockSize = 2 * m_nPoints;
+  unsigned int nNoise = 2 * (m_nPointsCurrent - 1);
+
+  // Draw the update noise of all the particles, in the same order as a particle by particle sampling
+  for (unsigned int n = 0; n < m_nParticles * nNoise; ++n)
+    m_noiseBuffer[n] = m_noise();
+
+  double sigma[2][2];
+  for (unsigned int j = 0; j < 2; ++j)
+    for (unsigned int k = 0; k < 2; ++k)
+      sigma[j][k] = m_sigma[j][k];
 
   // Sample particles
   for (unsigned int i = 0; i < m_nParticles; ++i) {
-    controlPoints = m_particles[i]->getControlPoints();
+    double *controlPoints = m_controlPoints + blockSize * i;
+    const double *noise = m_noiseBuffer + nNoise * i;
 
     // Get needle direction
-    direction = m_particles[i]->getTangent(1.0);
-    direction /= direction.frobeniusNorm();
+    vpColVector tangent = m_particles[i].getTangent(1.0);
+    double norm = sqrt(vpMath::sqr(tangent[0]) + vpMath::sqr(tangent[1]));
+    double direction[2] = {tangent[0] / norm, tangent[1] / norm};
 
     // Compute eigen vectors
-    for (unsigned int j = 0; j < 2; ++j)
-      U[j][0] = direction[j];
-    U[0][1] = -direction[1];
-    U[1][1] = direction[0];
-
-    // Compute noise covariance
-    S_noise_tip = U * m_sigma * U.t();
-    S_noise_inter.eye(2);
-    S_noise_inter *= m_sigma[1][1];
+    double U[2][2] = {{direction[0], -direction[1]}, {direction[1], direction[0]}};
+
+    // Compute noise covariance S_noise_tip = U * m_sigma * U^T
+    double S[2][2];
+    for (unsigned int j = 0; j < 2; ++j) {
+      for (unsigned int k = 0; k < 2; ++k) {
+        S[j][k] = 0.0;
+        for (unsigned int l = 0; l < 2; ++l)
+          S[j][k] += (U[j][0] * sigma[0][l] + U[j][1] * sigma[1][l]) * U[k][l];
+      }
+    }
 
     // Compute tip velocity vector
-    direction *= v;
+    for (unsigned int k = 0; k < 2; ++k)
+      direction[k] *= v;
 
     // Entry point
-    // controlPoints[0][0] += m_noise();
-    // controlPoints[1][0] += m_noise();
+    // controlPoints[0] += m_noise();
+    // controlPoints[m_nPoints] += m_noise();
 
-    // Intermediate control points
+    // Intermediate control points, the noise covariance is sigma2 * Id
     for (unsigned int j = 1; j < m_nPointsCurrent - 1; ++j) {
-
-      // Generate noise
       for (unsigned int k = 0; k < 2; ++k)
-        noise[k] = m_noise();
-      noise = S_noise_inter * noise;
-
-      // Update control points
-      for (unsigned int k = 0; k < 2; ++k)
-        controlPoints[k][j] += direction[k] / (m_nPointsCurrent - 1) + noise[k] / 4.0;
+        controlPoints[k * m_nPoints + j] +=
+            direction[k] / (m_nPointsCurrent - 1) + sigma[1][1] * noise[2 * (j - 1) + k] / 4.0;
     }
 
     // Tip
-
-    // Generate noise
+    noise += nNoise - 2;
     for (unsigned int k = 0; k < 2; ++k)
-      noise[k] = m_noise();
-    noise = S_noise_tip * noise;
+      controlPoints[k * m_nPoints + m_nPointsCurrent - 1] += direction[k] + S[k][0] * noise[0] + S[k][1] * noise[1];
 
-    // Update control points
     for (unsigned int k = 0; k < 2; ++k)
-      controlPoints[k][m_nPointsCurrent - 1] += direction[k] + noise[k];
+      memcpy(m_controlPointsMatrix[k], controlPoints + k * m_nPoints, m_nPointsCurrent * sizeof(double));
+    m_particles[i].setControlPoints(m_controlPointsMatrix);
+    updateControlPoints(i);
+  }
 
-    m_particles[i]->setControlPoints(controlPoints);
+  // Smooth once the bounding box of the particles' control points, the likelihoods then only read the filtered
+  // intensities. Samples falling outside of it (curve overshoot) are filtered on the fly.
+  double bounds[4] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+                      -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+  for (unsigned int i = 0; i < m_nParticles; ++i) {
+    const double *controlPoints = m_controlPoints + blockSize * i;
+    for (unsigned int k = 0; k < 2; ++k) {
+      for (unsigned int j = 0; j < m_nPointsCurrent; ++j) {
+        bounds[k] = std::min(bounds[k], controlPoints[k * m_nPoints + j]);
+        bounds[k + 2] = std::max(bounds[k + 2], controlPoints[k * m_nPoints + j]);
+      }
+    }
+  }
+  m_smoothedImage.resize(m_dims[0], m_dims[1]);
+  for (unsigned int k = 0; k < 2; ++k) {
+    // Two pixels of margin cover the rounding and the sample taken just beyond the tip
+    m_smoothedRegion[k] = static_cast<unsigned int>(std::max(3.0, std::min(bounds[k] - 2.0, m_dims[k] - 3.0)));
+    m_smoothedRegion[k + 2] = static_cast<unsigned int>(
+        std::max(static_cast<double>(m_smoothedRegion[k]), std::min(bounds[k + 2] + 3.0, m_dims[k] - 3.0)));
+  }
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int x = static_cast<int>(m_smoothedRegion[0]); x < static_cast<int>(m_smoothedRegion[2]); ++x) {
+    for (unsigned int y = m_smoothedRegion[1]; y < m_smoothedRegion[3]; ++y)
+      m_smoothedImage[x][y] = vpImageFilter::gaussianFilter(I, x, y);
   }
 
   // Compute weights
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < static_cast<int>(m_nParticles); ++i)
+    m_weights[i] *= computeSmoothedLikelihood(m_particles[i], I);
+
   double sumWeights = 0.0;
-  for (unsigned int i = 0; i < m_nParticles; ++i) {
-    m_weights[i] *= computeLikelihood(*(m_particles[i]), I);
+  for (unsigned int i = 0; i < m_nParticles; ++i)
     sumWeights += m_weights[i];
-  }
 
   // Normalize the weights and estimate the effective number of particles
   double sumSquare = 0.0;
@@ -225,102 +388,65 @@ void usNeedleTrackerSIR2D::run(vpImage<unsigned char> &I, double v)
   }
 
   // Compute mean
-  meanControlPoints.resize(2, m_nPointsCurrent);
-  meanControlPoints = 0.0;
+  m_controlPointsMatrix = 0.0;
   for (unsigned int i = 0; i < m_nParticles; ++i) {
-    meanControlPoints += m_weights[i] * m_particles[i]->getControlPoints();
+    const double *controlPoints = m_controlPoints + blockSize * i;
+    for (unsigned int k = 0; k < 2; ++k)
+      for (unsigned int j = 0; j < m_nPointsCurrent; ++j)
+        m_controlPointsMatrix[k][j] += m_weights[i] * controlPoints[k * m_nPoints + j];
   }
 
-  m_needleModel->setControlPoints(meanControlPoints);
+  m_needleModel->setControlPoints(m_controlPointsMatrix);
 
   if ((m_needleModel->getLength()) > m_lengthThreshold && (m_nPoints != m_nPointsCurrent)) {
     std::cout << "Changing polynomial order from " << m_nPointsCurrent - 1 << " to " << m_nPointsCurrent << std::endl;
-    usPolynomialCurve2D *newModel =
-        new usPolynomialCurve2D(m_needleModel->getNewOrderPolynomialCurve(m_nPointsCurrent));
-    delete m_needleModel;
-    m_needleModel = newModel;
-    for (unsigned int i = 0; i < m_nParticles; ++i) {
-      usPolynomialCurve2D *newModel =
-          new usPolynomialCurve2D(m_particles[i]->getNewOrderPolynomialCurve(m_nPointsCurrent));
-      delete m_particles[i];
-      m_particles[i] = newModel;
-    }
+    *m_needleModel = m_needleModel->getNewOrderPolynomialCurve(m_nPointsCurrent);
+    for (unsigned int i = 0; i < m_nParticles; ++i)
+      m_particles[i] = m_particles[i].getNewOrderPolynomialCurve(m_nPointsCurrent);
+    ++m_nPointsCurrent;
+    m_controlPointsMatrix.resize(2, m_nPointsCurrent);
+    for (unsigned int i = 0; i < m_nParticles; ++i)
+      updateControlPoints(i);
     m_lengthThreshold *= 2.0;
   }
 }
 
-double usNeedleTrackerSIR2D::computeLikelihood(const usPolynomialCurve2D &model, const vpImage<unsigned char> &I)
+void usNeedleTrackerSIR2D::updateControlPoints(unsigned int i)
 {
-  double l = 0.0;
-  vpColVector point;
-  unsigned int c = 0;
-  double length = model.getLength();
-  double intensity;
-
-  for (double t = 0; t <= 1.0; t += 1.0 / length) {
-    point = model.getPoint(t);
-    unsigned int x = vpMath::round(point[0]);
-    unsigned int y = vpMath::round(point[1]);
-    if ((3 <= x) && (x < m_dims[0] - 3) && (3 <= y) && (y < m_dims[1] - 3)) {
-      ++c;
-      intensity = vpImageFilter::gaussianFilter(I, x, y);
-      l += intensity;
-    }
-  }
-
-  if (c == 0)
-    return 0.0;
-
-  l /= c;
-
-  point = model.getPoint(1.0);
-  unsigned int x = vpMath::round(point[0]);
-  unsigned int y = vpMath::round(point[1]);
-  if ((3 <= x) && (x < m_dims[0] - 3) && (3 <= y) && (y < m_dims[1] - 3)) {
-    intensity = vpImageFilter::gaussianFilter(I, x, y);
-    l += intensity;
-  }
+  vpMatrix controlPoints = m_particles[i].getControlPoints();
+  double *dst = m_controlPoints + 2 * m_nPoints * i;
+  for (unsigned int k = 0; k < 2; ++k)
+    memcpy(dst + k * m_nPoints, controlPoints[k], m_nPointsCurrent * sizeof(double));
+}
 
-  point = model.getPoint(1.0 + 1.0 / length);
-  x = vpMath::round(point[0]);
-  y = vpMath::round(point[1]);
-  if ((3 <= x) && (x < m_dims[0] - 3) && (3 <= y) && (y < m_dims[1] - 3)) {
-    intensity = vpImageFilter::gaussianFilter(I, x, y);
-    l -= intensity;
-  }
+double usNeedleTrackerSIR2D::computeLikelihood(const usPolynomialCurve2D &model, const vpImage<unsigned char> &I)
+{
+  return curveLikelihood(model, m_dims, usGaussianIntensity(I));
+}
 
-  return l;
+double usNeedleTrackerSIR2D::computeSmoothedLikelihood(const usPolynomialCurve2D &model,
+                                                       const vpImage<unsigned char> &I) const
+{
+  return curveLikelihood(model, m_dims, usSmoothedIntensity(m_smoothedImage, m_smoothedRegion, I));
 }
 
 void usNeedleTrackerSIR2D::resample()
 {
   // std::cout << "Resampling..." << std::endl;
-  int *idx = new int[m_nParticles];
-  for (unsigned int i = 0; i < m_nParticles; ++i) {
-    double x = m_sample();
-    double sumWeights = 0.0;
-    for (unsigned int j = 0; j < m_nParticles; ++j) {
-      if (x < sumWeights + m_weights[j]) {
-        idx[i] = j;
-        break;
-      }
-      sumWeights += m_weights[j];
-    }
-  }
-  usPolynomialCurve2D **oldParticles = new usPolynomialCurve2D *[m_nParticles];
-  for (unsigned int i = 0; i < m_nParticles; ++i) {
-    oldParticles[i] = new usPolynomialCurve2D(*m_particles[i]);
-  }
-  for (unsigned int i = 0; i < m_nParticles; ++i) {
-    delete m_particles[i];
-    m_particles[i] = new usPolynomialCurve2D(*oldParticles[idx[i]]);
-  }
+  unsigned int blockSize = 2 * m_nPoints;
+  double step = 1.0 / m_nParticles;
+  double u = m_sample() * step;
+  double sumWeights = m_weights[0];
+  unsigned int j = 0;
   for (unsigned int i = 0; i < m_nParticles; ++i) {
-    delete oldParticles[i];
-    oldParticles[i] = NULL;
+    while (u >= sumWeights && j < m_nParticles - 1)
+      sumWeights += m_weights[++j];
+    m_particlesBuffer[i] = m_particles[j];
+    memcpy(m_controlPointsBuffer + blockSize * i, m_controlPoints + blockSize * j, blockSize * sizeof(double));
+    u += step;
   }
-  delete[] oldParticles;
-  delete[] idx;
+  std::swap(m_particles, m_particlesBuffer);
+  std::swap(m_controlPoints, m_controlPointsBuffer);
   for (unsigned int i = 0; i < m_nParticles; ++i) {
     m_weights[i] = 1.0 / m_nParticles;
   }
@@ -0,0 +1,176 @@
+/****************************************************************************
+ *
+ * This file is part of the UsNeedleDetection software.
+ * Copyright (C) 2013 - 2016 by Inria. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License ("GPL") as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * See the file COPYING at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact the
+ * authors at Alexandre.Krupa@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+// visp
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpUniRand.h>
+
+// ustk
+#include <visp3/ustk_needle_detection/usNeedleDetector3D.h>
+
+namespace
+{
+/**
+ * Fills a volume with a uniform background in [0, 100], 300 isolated bright voxels, and a bright needle of radius
+ * 1.2 voxels along the curve p0 + t * (p1 - p0) + t * (1 - t) * bend, t in [0, 1].
+ */
+template <class Type>
+void createVolume(usImage3D<Type> &V, const double p0[3], const double p1[3], const double bend[3], long seed)
+{
+  vpUniRand random(seed);
+  for (unsigned int k = 0; k < V.getNumberOfFrames(); k++)
+    for (unsigned int i = 0; i < V.getHeight(); i++)
+      for (unsigned int j = 0; j < V.getWidth(); j++)
+        V(i, j, k, static_cast<Type>(static_cast<int>(100 * random())));
+
+  for (unsigned int n = 0; n < 300; n++)
+    V(static_cast<unsigned int>(random() * V.getHeight()), static_cast<unsigned int>(random() * V.getWidth()),
+      static_cast<unsigned int>(random() * V.getNumberOfFrames()), static_cast<Type>(255));
+
+  for (unsigned int s = 0; s <= 1000; s++) {
+    double t = s / 1000.0;
+    double c[3];
+    for (unsigned int d = 0; d < 3; d++)
+      c[d] = p0[d] + t * (p1[d] - p0[d]) + t * (1 - t) * bend[d];
+    for (int i = vpMath::round(c[0]) - 2; i <= vpMath::round(c[0]) + 2; i++)
+      for (int j = vpMath::round(c[1]) - 2; j <= vpMath::round(c[1]) + 2; j++)
+        for (int k = vpMath::round(c[2]) - 2; k <= vpMath::round(c[2]) + 2; k++)
+          if (vpMath::sqr(i - c[0]) + vpMath::sqr(j - c[1]) + vpMath::sqr(k - c[2]) <= 1.44)
+            V(i, j, k, static_cast<Type>(200 + (i + j + k) % 40));
+  }
+}
+
+double distance(const vpColVector &p, const double q[3])
+{
+  return sqrt(vpMath::sqr(p[0] - q[0]) + vpMath::sqr(p[1] - q[1]) + vpMath::sqr(p[2] - q[2]));
+}
+
+bool checkNeedle(const usNeedleDetector3D &detector, const double p0[3], const double p1[3], const char *name)
+{
+  const usPolynomialCurve3D &needle = detector.getNeedle();
+  double entryError = distance(needle.getStartPoint(), p0);
+  double tipError = distance(needle.getEndPoint(), p1);
+  std::cout << name << ": " << detector.getCandidateNumber() << " candidates, " << detector.getInlierNumber()
+            << " inliers, entry error " << entryError << ", tip error " << tipError << std::endl;
+  std::cout << "  stage times (ms): " << detector.getStageTime(usNeedleDetector3D::THRESHOLDING_STAGE) << " "
+            << detector.getStageTime(usNeedleDetector3D::HASHING_STAGE) << " "
+            << detector.getStageTime(usNeedleDetector3D::RANSAC_STAGE) << " "
+            << detector.getStageTime(usNeedleDetector3D::REFINEMENT_STAGE) << std::endl;
+  if (entryError > 2.5 || tipError > 2.5) {
+    std::cout << "Error exceeds the test threshold (2.5)" << std::endl;
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+int main()
+{
+  const double noBend[3] = {0, 0, 0};
+  usImage3D<unsigned char> V(96, 96, 64);
+  usNeedleDetector3D detector;
+
+  // Straight needle in the whole volume
+  const double entry[3] = {20, 30, 10};
+  const double tip[3] = {60, 54, 42};
+  createVolume(V, entry, tip, noBend, 1);
+  if (!detector.detect(V)) {
+    std::cout << "No needle found in the first volume" << std::endl;
+    return 1;
+  }
+  if (!checkNeedle(detector, entry, tip, "first volume"))
+    return 1;
+
+  // Needle insertion: the detection is restricted around the previous needle
+  unsigned int roi[6];
+  detector.getRegionOfInterest(roi);
+  if (roi[0] == 0 && roi[1] == V.getHeight() && roi[2] == 0 && roi[3] == V.getWidth()) {
+    std::cout << "The region of interest should be restricted around the needle" << std::endl;
+    return 1;
+  }
+  const double insertedTip[3] = {68, 59, 48};
+  createVolume(V, entry, insertedTip, noBend, 2);
+  if (!detector.detect(V) || !checkNeedle(detector, entry, insertedTip, "insertion"))
+    return 1;
+
+  // Needle moved out of the region of interest: the detection falls back to the whole volume
+  const double movedEntry[3] = {80, 10, 50};
+  const double movedTip[3] = {85, 60, 20};
+  createVolume(V, movedEntry, movedTip, noBend, 3);
+  if (!detector.detect(V) || !checkNeedle(detector, movedEntry, movedTip, "moved needle"))
+    return 1;
+
+  // Dark last frames: no candidate after the needle
+  createVolume(V, entry, tip, noBend, 6);
+  for (unsigned int k = 48; k < V.getNumberOfFrames(); k++)
+    for (unsigned int i = 0; i < V.getHeight(); i++)
+      for (unsigned int j = 0; j < V.getWidth(); j++)
+        V(i, j, k, 0);
+  usNeedleDetector3D darkFramesDetector;
+  if (!darkFramesDetector.detect(V) || !checkNeedle(darkFramesDetector, entry, tip, "dark last frames"))
+    return 1;
+
+  // Curved needle with a second order model
+  const double bend[3] = {0, 30, -20};
+  usNeedleDetector3D curvedDetector;
+  curvedDetector.setOrder(2);
+  createVolume(V, entry, tip, bend, 4);
+  if (!curvedDetector.detect(V) || !checkNeedle(curvedDetector, entry, tip, "curved needle"))
+    return 1;
+  const usPolynomialCurve3D &curve = curvedDetector.getNeedle();
+  double middle[3];
+  for (unsigned int d = 0; d < 3; d++)
+    middle[d] = 0.5 * (entry[d] + tip[d]) + 0.25 * bend[d];
+  double middleError = std::numeric_limits<double>::max();
+  for (unsigned int s = 0; s <= 100; s++)
+    middleError = std::min(middleError, distance(curve.getPoint(curve.getStartParameter() +
+                                                                 s * curve.getParametricLength() / 100),
+                                                 middle));
+  std::cout << "curved needle: middle error " << middleError << std::endl;
+  if (middleError > 2.0) {
+    std::cout << "The curved needle is not followed" << std::endl;
+    return 1;
+  }
+
+  // Needle response volume (double values), such as a vesselness volume
+  usImage3D<double> response(96, 96, 64);
+  createVolume(response, entry, tip, noBend, 5);
+  usNeedleDetector3D responseDetector;
+  if (!responseDetector.detect(response) || !checkNeedle(responseDetector, entry, tip, "response volume"))
+    return 1;
+
+  return 0;
+}
@@ -0,0 +1,258 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Pierre Chatelain
+ * Alexandre Krupa
+ *
+ *****************************************************************************/
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// visp
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpImage.h>
+#include <visp3/core/vpImageFilter.h>
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpMatrix.h>
+#include <visp3/core/vpUniRand.h>
+
+// ustk
+#include <visp3/ustk_core/usPolynomialCurve2D.h>
+#include <visp3/ustk_needle_detection/usNeedleTrackerSIR2D.h>
+
+/*!
+  Synthetic frame : noisy background around 50, crossed along the rows by a straight needle of 3 pixels wide at 255,
+  centered on the given column and going from the entry row to the tip row.
+*/
+void drawFrame(vpImage<unsigned char> &I, unsigned int column, unsigned int entryRow, double tipRow,
+               vpUniRand &random)
+{
+  for (unsigned int i = 0; i < I.getHeight(); i++)
+    for (unsigned int j = 0; j < I.getWidth(); j++) {
+      if (i >= entryRow && i <= tipRow && j + 1 >= column && j <= column + 1)
+        I[i][j] = 255;
+      else
+        I[i][j] = (unsigned char)(40 + 20 * random());
+    }
+}
+
+/*!
+  Exact comparison of two control point matrices, resampling copying the particles.
+*/
+bool equal(const vpMatrix &A, const vpMatrix &B)
+{
+  if (A.getRows() != B.getRows() || A.getCols() != B.getCols())
+    return false;
+  for (unsigned int i = 0; i < A.getRows(); i++)
+    for (unsigned int j = 0; j < A.getCols(); j++)
+      if (A[i][j] != B[i][j])
+        return false;
+  return true;
+}
+
+/*!
+  Reference likelihood, evaluating the curve with getPoint() every pixel along its length : mean of the smoothed
+  intensities, plus the intensity at the tip, minus the intensity just beyond the tip.
+*/
+double referenceLikelihood(const usPolynomialCurve2D &model, const vpImage<unsigned char> &I)
+{
+  const unsigned int dims[2] = {I.getHeight(), I.getWidth()};
+  double length = model.getLength();
+  double l = 0.0;
+  unsigned int c = 0;
+  for (double t = 0; t <= 1.0; t += 1.0 / length) {
+    vpColVector point = model.getPoint(t);
+    unsigned int x = vpMath::round(point[0]);
+    unsigned int y = vpMath::round(point[1]);
+    if ((3 <= x) && (x < dims[0] - 3) && (3 <= y) && (y < dims[1] - 3)) {
+      ++c;
+      l += vpImageFilter::gaussianFilter(I, x, y);
+    }
+  }
+  if (c == 0)
+    return 0.0;
+  l /= c;
+
+  const double tips[2] = {1.0, 1.0 + 1.0 / length};
+  for (unsigned int k = 0; k < 2; k++) {
+    vpColVector point = model.getPoint(tips[k]);
+    unsigned int x = vpMath::round(point[0]);
+    unsigned int y = vpMath::round(point[1]);
+    if ((3 <= x) && (x < dims[0] - 3) && (3 <= y) && (y < dims[1] - 3))
+      l += (k == 0 ? 1.0 : -1.0) * vpImageFilter::gaussianFilter(I, x, y);
+  }
+  return l;
+}
+
+int main()
+{
+  const unsigned int column = 100, entryRow = 20;
+  const unsigned int nPoints = 3, nParticles = 200;
+  const double v = 3.0;
+  vpUniRand random(7);
+  vpImage<unsigned char> I(200, 200);
+
+  // straight needle of length 30, shorter than the length threshold of the order increase (50)
+  double tipRow = entryRow + 30;
+  usPolynomialCurve2D needle(1);
+  vpMatrix controlPoints(2, 2);
+  controlPoints[0][0] = entryRow;
+  controlPoints[1][0] = column;
+  controlPoints[0][1] = tipRow;
+  controlPoints[1][1] = column;
+  needle.setControlPoints(controlPoints);
+
+  drawFrame(I, column, entryRow, tipRow, random);
+  // low noise along the insertion direction, so that the estimated tip follows the insertion velocity
+  usNeedleTrackerSIR2D tracker;
+  tracker.setSigma(1.0);
+  tracker.setSigma1(1.0);
+  tracker.setSigma2(1.0);
+  tracker.init(I, nPoints, nParticles, needle);
+
+  tipRow += v;
+  drawFrame(I, column, entryRow, tipRow, random);
+  tracker.run(I, v);
+
+  // the weights are normalized
+  std::vector<double> weights(nParticles);
+  std::vector<vpMatrix> particles(nParticles);
+  double sumWeights = 0.0;
+  for (unsigned int i = 0; i < nParticles; i++) {
+    weights[i] = tracker.getWeight(i);
+    particles[i] = tracker.getParticle(i)->getControlPoints();
+    sumWeights += weights[i];
+  }
+  if (std::fabs(sumWeights - 1.0) > 1e-9) {
+    std::cout << "ERROR : the weights sum to " << sumWeights << " instead of 1" << std::endl;
+    return 1;
+  }
+
+  // systematic resampling : the particles are copied in order, each run of identical particles being copied n times
+  // with |n - nParticles * weight of the run| < 1, and the weights are reset to 1 / nParticles
+  tracker.resample();
+  unsigned int i = 0;
+  for (unsigned int j = 0; j < nParticles;) {
+    double runWeight = 0.0;
+    unsigned int end = j;
+    for (; end < nParticles && equal(particles[end], particles[j]); end++)
+      runWeight += weights[end];
+    unsigned int copies = 0;
+    for (; i < nParticles && equal(tracker.getParticle(i)->getControlPoints(), particles[j]); i++)
+      copies++;
+    if (std::fabs(copies - nParticles * runWeight) >= 1.0 + 1e-9) {
+      std::cout << "ERROR : particle " << j << " of weight " << runWeight << " copied " << copies << " times"
+                << std::endl;
+      return 1;
+    }
+    j = end;
+  }
+  if (i != nParticles) {
+    std::cout << "ERROR : the resampled particle " << i << " is not a copy of the particles in order" << std::endl;
+    return 1;
+  }
+  for (i = 0; i < nParticles; i++) {
+    if (std::fabs(tracker.getWeight(i) - 1.0 / nParticles) > 1e-12) {
+      std::cout << "ERROR : resampled weight " << tracker.getWeight(i) << " instead of " << 1.0 / nParticles
+                << std::endl;
+      return 1;
+    }
+  }
+
+  // insertion : the order of the needle grows once its length exceeds 50
+  unsigned int frame = 0;
+  for (; frame < 20 && tracker.getNeedle()->getOrder() == 1; frame++) {
+    tipRow += v;
+    drawFrame(I, column, entryRow, tipRow, random);
+    tracker.run(I, v);
+  }
+  std::cout << "order " << tracker.getNeedle()->getOrder() << " at length " << tracker.getNeedle()->getLength()
+            << std::endl;
+  if (tracker.getNeedle()->getOrder() != 2 || tracker.getNeedle()->getLength() < 50.0) {
+    std::cout << "ERROR : the order of the needle did not grow to 2 once its length exceeded 50" << std::endl;
+    return 1;
+  }
+
+  // after the growth, the tip motion is applied to the last of the 3 control points, which follows the tip while the
+  // entry point stays in place
+  for (frame = 0; frame < 10; frame++) {
+    tipRow += v;
+    drawFrame(I, column, entryRow, tipRow, random);
+    tracker.run(I, v);
+    controlPoints = tracker.getNeedle()->getControlPoints();
+    std::cout << "tip row " << tipRow << ", control points rows " << controlPoints[0][0] << " " << controlPoints[0][1]
+              << " " << controlPoints[0][2] << std::endl;
+    if (tracker.getNeedle()->getOrder() != 2 || controlPoints.getCols() != 3) {
+      std::cout << "ERROR : the order of the needle changed again" << std::endl;
+      return 1;
+    }
+    if (std::fabs(controlPoints[0][2] - tipRow) > 3 || std::fabs(controlPoints[1][2] - column) > 3 ||
+        std::fabs(controlPoints[0][0] - entryRow) > 3 || std::fabs(controlPoints[1][0] - column) > 3) {
+      std::cout << "ERROR : the needle does not follow the tip" << std::endl;
+      return 1;
+    }
+  }
+
+  // the likelihood sampled by forward differences equals the likelihood sampled with getPoint(), for the particles of
+  // order 2 and for random curves of order 2 and 3, around the needle or crossing the image borders
+  for (i = 0; i < nParticles; i++) {
+    double likelihood = tracker.computeLikelihood(*tracker.getParticle(i), I);
+    double reference = referenceLikelihood(*tracker.getParticle(i), I);
+    if (likelihood != reference) {
+      std::cout << "ERROR : likelihood " << likelihood << " of particle " << i << " instead of " << reference
+                << std::endl;
+      return 1;
+    }
+  }
+  for (unsigned int n = 0; n < 400; n++) {
+    unsigned int order = 2 + n % 2;
+    usPolynomialCurve2D curve(order);
+    controlPoints.resize(2, order + 1);
+    for (unsigned int j = 0; j <= order; j++) {
+      if (n % 4 < 2) {
+        controlPoints[0][j] = entryRow + (tipRow + 20 - entryRow) * random();
+        controlPoints[1][j] = column - 15 + 30 * random();
+      } else {
+        controlPoints[0][j] = -10 + 220 * random();
+        controlPoints[1][j] = -10 + 220 * random();
+      }
+    }
+    curve.setControlPoints(controlPoints);
+    double likelihood = tracker.computeLikelihood(curve, I);
+    double reference = referenceLikelihood(curve, I);
+    if (likelihood != reference) {
+      std::cout << "ERROR : likelihood " << likelihood << " instead of " << reference << " for curve " << n
+                << " of order " << order << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -44,29 +44,59 @@
 #include <type_traits>
 #endif
 
+#include <algorithm>
+#include <vector>
+
 #include <visp3/core/vpColVector.h>
 #include <visp3/core/vpMath.h>
 #include <visp3/core/vpMatrix.h>
 
 #include <visp3/ustk_core/usImage3D.h>
+#include <visp3/ustk_volume_processing/usVoxelOperations.h>
 
 /**
  * @class usVolumeProcessing
  * @brief Processing tools (derivative, filtering...) for the usImage3D class.
  * @ingroup module_ustk_volume_processing
+ *
+ * Gaussian filtering is available in three forms :
+ * - applyFilter() with a dense 3D kernel (see generateGaussianDerivativeFilterI() and the other generators), which
+ * costs s^3 operations per voxel for a kernel of size s,
+ * - applySeparableFilter() with three 1D kernels (see generateGaussianDerivativeFilter1D()), which gives the same
+ * result as the dense kernel built from their product for 3s operations per voxel, and is used by
+ * gaussianDerivativeI(), gaussianDerivativeJ() and gaussianDerivativeK(),
+ * - recursiveGaussianDerivative(), with the recursive approximations of the gaussian and its derivatives of Deriche
+ * (1993), whose cost does not depend on sigma.
  */
 class VISP_EXPORT usVolumeProcessing
 {
 public:
+  /**
+   * Hessian of a volume, stored as one volume per distinct component of the symmetric 3x3 matrix.
+   */
+  struct usHessian3D {
+    usImage3D<float> ii; ///< Second derivative along i.
+    usImage3D<float> ij; ///< Cross derivative along i and j.
+    usImage3D<float> ik; ///< Cross derivative along i and k.
+    usImage3D<float> jj; ///< Second derivative along j.
+    usImage3D<float> jk; ///< Cross derivative along j and k.
+    usImage3D<float> kk; ///< Second derivative along k.
+  };
+
   template <class Type1, class Type2>
   static void absoluteDifference(const usImage3D<Type1> &src1, const usImage3D<Type1> &src2, usImage3D<Type2> &dst);
 
-  template <class Type1, class Type2>
-  static double applyFilter(const usImage3D<Type1> &src, const usImage3D<Type2> &filter, unsigned int i, unsigned int j,
+  template <class Volume, class Type2>
+  static double applyFilter(const Volume &src, const usImage3D<Type2> &filter, unsigned int i, unsigned int j,
                             unsigned int k);
 
+  template <class Volume, class Type2>
+  static void applyFilter(const Volume &src, usImage3D<Type2> &dst, const usImage3D<double> &filter);
+
   template <class Type1, class Type2>
-  static void applyFilter(const usImage3D<Type1> &src, usImage3D<Type2> &dst, const usImage3D<double> &filter);
+  static void applySeparableFilter(const usImage3D<Type1> &src, usImage3D<Type2> &dst,
+                                   const std::vector<double> &filterI, const std::vector<double> &filterJ,
+                                   const std::vector<double> &filterK);
 
   template <class Type> static void computeBarycenter(const usImage3D<Type> &V, double &ic, double &jc, double &kc);
 
@@ -106,6 +136,13 @@ public:
   template <class Type>
   static void frangi(const usImage3D<Type> &src, usImage3D<double> &dst, double a, double b, double c);
 
+  static void frangi(const usHessian3D &hessian, usImage3D<double> &dst, double a, double b, double c);
+
+  template <class Type>
+  static void frangiMultiScale(const usImage3D<Type> &src, usImage3D<double> &dst, usImage3D<double> &bestScale,
+                               const std::vector<double> &sigmas, double a, double b, double c,
+                               const usImage3D<unsigned char> &mask = usImage3D<unsigned char>());
+
   template <class Type1, class Type2>
   static void gaussianDerivativeI(const usImage3D<Type1> &src, usImage3D<Type2> &dst, double sigma,
                                   unsigned int filter_size);
@@ -118,6 +155,8 @@ public:
   static void gaussianDerivativeK(const usImage3D<Type1> &src, usImage3D<Type2> &dst, double sigma,
                                   unsigned int filter_size);
 
+  static std::vector<double> generateGaussianDerivativeFilter1D(double sigma, int size, unsigned int order);
+
   static usImage3D<double> generateGaussianDerivativeFilterI(double sigma, int size);
 
   static usImage3D<double> generateGaussianDerivativeFilterII(double sigma, int size);
@@ -140,11 +179,154 @@ public:
 
   template <class Type> static void hessian(const usImage3D<Type> &src, usImage3D<vpMatrix> &dst);
 
+  template <class Type> static void hessian(const usImage3D<Type> &src, usHessian3D &dst);
+
   template <class Type> static Type max(const usImage3D<Type> &V);
 
   template <class Type> static Type min(const usImage3D<Type> &V);
 
   static void norm(const usImage3D<vpColVector> &src, usImage3D<double> &dst);
+
+  template <class Type1, class Type2>
+  static void recursiveGaussianDerivative(const usImage3D<Type1> &src, usImage3D<Type2> &dst, double sigma,
+                                          unsigned int orderI, unsigned int orderJ, unsigned int orderK);
+
+  static void symmetricEigenValues(double a00, double a01, double a02, double a11, double a12, double a22,
+                                   double eigenValues[3]);
+
+private:
+  // one row of each hessian component, in the order ii, ij, ik, jj, jk, kk
+  struct usHessianRow {
+    std::vector<double> component[6];
+  };
+
+  static void frangiRow(const usHessianRow &row, unsigned int width, double a, double b, double c,
+                        const unsigned char *mask, double *dst);
+  static void hessianRow(const usImage3D<double> &Gi, const usImage3D<double> &Gj, const usImage3D<double> &Gk,
+                         unsigned int i, unsigned int k, usHessianRow &row);
+
+  // operations on the voxels, applied with usVoxelOperations
+  template <class Type1, class Type2> struct usAbsoluteDifferenceOperation {
+    Type2 operator()(const Type1 &a, const Type1 &b) const { return vpMath::abs(a - b); }
+  };
+
+  struct usBarycenterSums {
+    double i;
+    double j;
+    double k;
+    double sum;
+  };
+
+  template <class Type> struct usBarycenterOperation {
+    void operator()(usBarycenterSums &result, const Type *row, unsigned int width, unsigned int i,
+                    unsigned int k) const
+    {
+      double rowSum = 0.0;
+      double rowJ = 0.0;
+      for (unsigned int j = 0; j < width; j++) {
+        double val = row[j];
+        rowSum += val;
+        rowJ += j * val;
+      }
+      result.i += i * rowSum;
+      result.j += rowJ;
+      result.k += k * rowSum;
+      result.sum += rowSum;
+    }
+    void operator()(usBarycenterSums &result, const usBarycenterSums &partial) const
+    {
+      result.i += partial.i;
+      result.j += partial.j;
+      result.k += partial.k;
+      result.sum += partial.sum;
+    }
+  };
+
+  template <class Type1, class Type2> struct usDerivativeIOperation {
+    Type2 operator()(const usImage3D<Type1> &V, unsigned int i, unsigned int j, unsigned int k) const
+    {
+      return derivativeI(V, i, j, k);
+    }
+  };
+
+  template <class Type1, class Type2> struct usDerivativeJOperation {
+    Type2 operator()(const usImage3D<Type1> &V, unsigned int i, unsigned int j, unsigned int k) const
+    {
+      return derivativeJ(V, i, j, k);
+    }
+  };
+
+  template <class Type1, class Type2> struct usDerivativeKOperation {
+    Type2 operator()(const usImage3D<Type1> &V, unsigned int i, unsigned int j, unsigned int k) const
+    {
+      return derivativeK(V, i, j, k);
+    }
+  };
+
+  template <class Type1, class Type2> struct usDifferenceOperation {
+    Type2 operator()(const Type1 &a, const Type1 &b) const { return a - b; }
+  };
+
+  template <class Volume> struct usFilterOperation {
+    explicit usFilterOperation(const usImage3D<double> &filter) : m_filter(filter) {}
+    double operator()(const Volume &V, unsigned int i, unsigned int j, unsigned int k) const
+    {
+      return applyFilter(V, m_filter, i, j, k);
+    }
+    const usImage3D<double> &m_filter;
+  };
+
+  // the derivative along an axis is zero on the borders of this axis
+  template <class Type> struct usGradientOperation {
+    vpColVector operator()(const usImage3D<Type> &V, unsigned int i, unsigned int j, unsigned int k) const
+    {
+      vpColVector v(3, 0.0);
+      if (i > 0 && i + 1 < V.getHeight())
+        v[0] = ((double)V(i + 1, j, k) - (double)V(i - 1, j, k)) / 2.0;
+      if (j > 0 && j + 1 < V.getWidth())
+        v[1] = ((double)V(i, j + 1, k) - (double)V(i, j - 1, k)) / 2.0;
+      if (k > 0 && k + 1 < V.getNumberOfFrames())
+        v[2] = ((double)V(i, j, k + 1) - (double)V(i, j, k - 1)) / 2.0;
+      return v;
+    }
+  };
+
+  template <class Type> struct usMaximumOperation {
+    void operator()(Type &result, const Type *row, unsigned int width, unsigned int, unsigned int) const
+    {
+      for (unsigned int j = 0; j < width; j++)
+        result = (row[j] > result) ? row[j] : result;
+    }
+    void operator()(Type &result, const Type &partial) const { result = (partial > result) ? partial : result; }
+  };
+
+  template <class Type> struct usMinimumOperation {
+    void operator()(Type &result, const Type *row, unsigned int width, unsigned int, unsigned int) const
+    {
+      for (unsigned int j = 0; j < width; j++)
+        result = (row[j] < result) ? row[j] : result;
+    }
+    void operator()(Type &result, const Type &partial) const { result = (partial < result) ? partial : result; }
+  };
+
+  struct usNormOperation {
+    double operator()(const vpColVector &v) const { return v.frobeniusNorm(); }
+  };
+
+  // 4th order causal and anti-causal recursive filters :
+  // y+(k) = n0 x(k) + n1 x(k-1) + n2 x(k-2) + n3 x(k-3) - d1 y+(k-1) - d2 y+(k-2) - d3 y+(k-3) - d4 y+(k-4)
+  // y-(k) = m1 x(k+1) + m2 x(k+2) + m3 x(k+3) + m4 x(k+4) - d1 y-(k+1) - d2 y-(k+2) - d3 y-(k+3) - d4 y-(k+4)
+  // y(k) = y+(k) + y-(k) - center x(k)
+  struct usRecursiveFilter {
+    double n[4];
+    double m[4];
+    double d[4];
+    double center;
+  };
+
+  static void recursiveGaussianCoefficients(double sigma, unsigned int order, usRecursiveFilter &filter);
+  static void recursiveGaussianLines(double *data, unsigned int count, unsigned int stride, unsigned int lanes,
+                                     const usRecursiveFilter &filter, std::vector<double> &buffer);
 };
 
 /****************************************************************************
@@ -158,15 +340,7 @@ public:
  */
 template <class Type> Type usVolumeProcessing::max(const usImage3D<Type> &V)
 {
-  const Type *p = V.getConstData();
-  Type max = *p;
-  for (unsigned int i = 1; i < V.getSize(); i++) {
-    Type val = *p;
-    if (val > max)
-      max = val;
-    p++;
-  }
-  return max;
+  return usVoxelOperations::reduce(V, V.getConstData()[0], usMaximumOperation<Type>());
 }
 
 /**
@@ -176,29 +350,22 @@ template <class Type> Type usVolumeProcessing::max(const usImage3D<Type> &V)
  */
 template <class Type> Type usVolumeProcessing::min(const usImage3D<Type> &V)
 {
-  const Type *p = V.getConstData();
-  Type min = *p;
-  for (unsigned int i = 1; i < V.getSize(); i++) {
-    Type val = *p;
-    if (val < min)
-      min = val;
-    p++;
-  }
-  return min;
+  return usVoxelOperations::reduce(V, V.getConstData()[0], usMinimumOperation<Type>());
 }
 
 /**
  * Apply a 3D filter to a voxel.
- * @param src The volume to filter.
+ * @param src The volume to filter : usImage3D, or any class with the same voxel accessors, such as the region of
+ * interest usImage3DView.
  * @param filter The filter kernel.
  * @param i Index on i-axis of the voxel to filter.
  * @param j Index on j-axis of the voxel to filter.
  * @param k Index on k-axis of the voxel to filter.
  * @return the value of the volxel filtered.
  */
-template <class Type1, class Type2>
-double usVolumeProcessing::applyFilter(const usImage3D<Type1> &src, const usImage3D<Type2> &filter, unsigned int i,
-                                       unsigned int j, unsigned int k)
+template <class Volume, class Type2>
+double usVolumeProcessing::applyFilter(const Volume &src, const usImage3D<Type2> &filter, unsigned int i, unsigned int j,
+                                       unsigned int k)
 {
   unsigned int s_i = filter.getHeight();
   unsigned int s_j = filter.getWidth();
@@ -211,8 +378,8 @@ double usVolumeProcessing::applyFilter(const usImage3D<Type1> &src, const usImag
   if ((m_i < i) && (i < src.getHeight() - m_i) && (m_j < j) && (j < src.getWidth() - m_j) && (m_k < k) &&
       (k < src.getNumberOfFrames() - m_k)) {
     for (unsigned int k_it = 0; k_it < s_k; k_it++)
-      for (unsigned int j_it = 0; j_it < s_j; j_it++)
-        for (unsigned int i_it = 0; i_it < s_i; i_it++)
+      for (unsigned int i_it = 0; i_it < s_i; i_it++)
+        for (unsigned int j_it = 0; j_it < s_j; j_it++)
           v += filter(i_it, j_it, k_it) * src(i + i_it - m_i, j + j_it - m_j, k + k_it - m_k);
   }
 
@@ -221,27 +388,116 @@ double usVolumeProcessing::applyFilter(const usImage3D<Type1> &src, const usImag
 
 /**
  * Apply a filter to a volume.
- * @param [in] src The volume to filter.
+ * @param [in] src The volume to filter : usImage3D, or any class with the same voxel accessors, such as the region of
+ * interest usImage3DView.
  * @param [out] dst The volume filtered.
  * @param [in] filter The filter kernel.
  */
-template <class Type1, class Type2>
-void usVolumeProcessing::applyFilter(const usImage3D<Type1> &src, usImage3D<Type2> &dst,
-                                     const usImage3D<double> &filter)
+template <class Volume, class Type2>
+void usVolumeProcessing::applyFilter(const Volume &src, usImage3D<Type2> &dst, const usImage3D<double> &filter)
 {
   unsigned int s_i = filter.getHeight();
   unsigned int s_j = filter.getWidth();
   unsigned int s_k = filter.getNumberOfFrames();
 
-  unsigned int height = src.getHeight();
-  unsigned int width = src.getWidth();
-  unsigned int nbFrames = src.getNumberOfFrames();
+  const Type2 zero = 0 * applyFilter(src, filter, s_i / 2, s_j / 2, s_k / 2);
+  usVoxelOperations::stencil(src, dst, usFilterOperation<Volume>(filter), s_i, s_j, s_k, zero);
+}
+
+/**
+ * Apply a separable filter to a volume : the 3D kernel is the product filterI(i) * filterJ(j) * filterK(k), and is
+ * applied with one pass per axis. The result is the one of applyFilter() with the 3D kernel, voxels closer to the
+ * borders than the filter size being set to zero. Each pass runs along contiguous rows or frames of the volume.
+ * @param [in] src The volume to filter (arithmetic type).
+ * @param [out] dst The volume filtered.
+ * @param [in] filterI The filter kernel along the i-axis (height).
+ * @param [in] filterJ The filter kernel along the j-axis (width).
+ * @param [in] filterK The filter kernel along the k-axis (3rd dimension).
+ */
+template <class Type1, class Type2>
+void usVolumeProcessing::applySeparableFilter(const usImage3D<Type1> &src, usImage3D<Type2> &dst,
+                                              const std::vector<double> &filterI, const std::vector<double> &filterJ,
+                                              const std::vector<double> &filterK)
+{
+  const int s_i = (int)filterI.size();
+  const int s_j = (int)filterJ.size();
+  const int s_k = (int)filterK.size();
+  const int m_i = s_i / 2;
+  const int m_j = s_j / 2;
+  const int m_k = s_k / 2;
+
+  const int height = (int)src.getHeight();
+  const int width = (int)src.getWidth();
+  const int nbFrames = (int)src.getNumberOfFrames();
+  const unsigned int frameSize = src.getHeight() * src.getWidth();
   dst.resize(height, width, nbFrames);
-  dst.initData(0 * applyFilter(src, filter, s_i / 2, s_j / 2, s_k / 2));
-  for (unsigned int k = s_k; k < nbFrames - s_k; k++)
-    for (unsigned int j = s_j; j < width - s_j; j++)
-      for (unsigned int i = s_i; i < height - s_i; i++)
-        dst(i, j, k, applyFilter(src, filter, i, j, k));
+  dst.initData(Type2());
+  if (height <= 2 * s_i || width <= 2 * s_j || nbFrames <= 2 * s_k)
+    return;
+
+  // filtered voxels, and rows and frames needed by the i and k passes
+  const int iBegin = s_i, iEnd = height - s_i;
+  const int jBegin = s_j, jEnd = width - s_j;
+  const int kBegin = s_k, kEnd = nbFrames - s_k;
+  const int iFirst = iBegin - m_i, iLast = iEnd - m_i + s_i - 1;
+  const int kFirst = kBegin - m_k, kLast = kEnd - m_k + s_k - 1;
+
+  std::vector<double> filteredJ(src.getSize());
+  std::vector<double> filteredIJ(src.getSize());
+
+  // pass along j : contiguous samples of each row
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int k = kFirst; k < kLast; k++) {
+    for (int i = iFirst; i < iLast; i++) {
+      const Type1 *in = src.getConstData() + k * frameSize + i * width - m_j;
+      double *out = &filteredJ[k * frameSize + i * width];
+      for (int j = jBegin; j < jEnd; j++) {
+        double v = 0.0;
+        for (int t = 0; t < s_j; t++)
+          v += filterJ[t] * in[j + t];
+        out[j] = v;
+      }
+    }
+  }
+
+  // pass along i : weighted sum of whole rows
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int k = kFirst; k < kLast; k++) {
+    for (int i = iBegin; i < iEnd; i++) {
+      double *out = &filteredIJ[k * frameSize + i * width];
+      std::fill(out + jBegin, out + jEnd, 0.0);
+      for (int t = 0; t < s_i; t++) {
+        const double *in = &filteredJ[k * frameSize + (i + t - m_i) * width];
+        const double f = filterI[t];
+        for (int j = jBegin; j < jEnd; j++)
+          out[j] += f * in[j];
+      }
+    }
+  }
+
+  // pass along k : weighted sum of whole frames, row by row
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int k = kBegin; k < kEnd; k++) {
+    std::vector<double> row(width);
+    for (int i = iBegin; i < iEnd; i++) {
+      std::fill(row.begin() + jBegin, row.begin() + jEnd, 0.0);
+      for (int t = 0; t < s_k; t++) {
+        const double *in = &filteredIJ[(k + t - m_k) * frameSize + i * width];
+        const double f = filterK[t];
+        for (int j = jBegin; j < jEnd; j++)
+          row[j] += f * in[j];
+      }
+      Type2 *out = dst.getData() + k * frameSize + i * width;
+      for (int j = jBegin; j < jEnd; j++)
+        out[j] = row[j];
+    }
+  }
 }
 
 #ifdef VISP_HAVE_CPP11_COMPATIBILITY
@@ -342,8 +598,9 @@ template <class Type1, class Type2>
 void usVolumeProcessing::gaussianDerivativeI(const usImage3D<Type1> &src, usImage3D<Type2> &dst, double sigma,
                                              unsigned int filter_size)
 {
-  usImage3D<double> filter = generateGaussianDerivativeFilterI(sigma, filter_size);
-  applyFilter(src, dst, filter);
+  std::vector<double> gaussian = generateGaussianDerivativeFilter1D(sigma, filter_size, 0);
+  std::vector<double> derivative = generateGaussianDerivativeFilter1D(sigma, filter_size, 1);
+  applySeparableFilter(src, dst, derivative, gaussian, gaussian);
 }
 
 /**
@@ -358,8 +615,9 @@ template <class Type1, class Type2>
 void usVolumeProcessing::gaussianDerivativeJ(const usImage3D<Type1> &src, usImage3D<Type2> &dst, double sigma,
                                              unsigned int filter_size)
 {
-  usImage3D<double> filter = generateGaussianDerivativeFilterJ(sigma, filter_size);
-  applyFilter(src, dst, filter);
+  std::vector<double> gaussian = generateGaussianDerivativeFilter1D(sigma, filter_size, 0);
+  std::vector<double> derivative = generateGaussianDerivativeFilter1D(sigma, filter_size, 1);
+  applySeparableFilter(src, dst, gaussian, derivative, gaussian);
 }
 
 /**
@@ -374,8 +632,9 @@ template <class Type1, class Type2>
 void usVolumeProcessing::gaussianDerivativeK(const usImage3D<Type1> &src, usImage3D<Type2> &dst, double sigma,
                                              unsigned int filter_size)
 {
-  usImage3D<double> filter = generateGaussianDerivativeFilterK(sigma, filter_size);
-  applyFilter(src, dst, filter);
+  std::vector<double> gaussian = generateGaussianDerivativeFilter1D(sigma, filter_size, 0);
+  std::vector<double> derivative = generateGaussianDerivativeFilter1D(sigma, filter_size, 1);
+  applySeparableFilter(src, dst, gaussian, gaussian, derivative);
 }
 
 /**
@@ -386,19 +645,8 @@ void usVolumeProcessing::gaussianDerivativeK(const usImage3D<Type1> &src, usImag
 template <class Type1, class Type2>
 void usVolumeProcessing::derivativeI(const usImage3D<Type1> &src, usImage3D<Type2> &dst)
 {
-  unsigned int height = src.getHeight();
-  unsigned int width = src.getWidth();
-  unsigned int nbFrames = src.getNumberOfFrames();
-  dst.resize(height, width, nbFrames);
   Type2 zero = 0 * derivativeI(src, 1, 1, 1);
-  // Access in order k-j-i for performance
-  for (unsigned int k = 0; k < nbFrames; k++)
-    for (unsigned int j = 0; j < width; j++) {
-      dst(0, j, k, zero);
-      for (unsigned int i = 1; i < height - 1; i++)
-        dst(i, j, k, derivativeI(src, i, j, k));
-      dst(height - 1, j, k, zero);
-    }
+  usVoxelOperations::stencil(src, dst, usDerivativeIOperation<Type1, Type2>(), 1, 0, 0, zero);
 }
 
 /**
@@ -409,22 +657,8 @@ void usVolumeProcessing::derivativeI(const usImage3D<Type1> &src, usImage3D<Type
 template <class Type1, class Type2>
 void usVolumeProcessing::derivativeJ(const usImage3D<Type1> &src, usImage3D<Type2> &dst)
 {
-  unsigned int height = src.getHeight();
-  unsigned int width = src.getWidth();
-  unsigned int nbFrames = src.getNumberOfFrames();
-  dst.resize(height, width, nbFrames);
   Type2 zero = 0 * derivativeJ(src, 1, 1, 1);
-  // Access in order k-j-i for performance
-  for (unsigned int k = 0; k < nbFrames; k++) {
-    for (unsigned int j = 1; j < width - 1; j++)
-      for (unsigned int i = 0; i < height; i++)
-        dst(i, j, k, derivativeJ(src, i, j, k));
-
-    for (unsigned int i = 0; i < height; i++) {
-      dst(i, width - 1, k, zero);
-      dst(i, 0, k, zero);
-    }
-  }
+  usVoxelOperations::stencil(src, dst, usDerivativeJOperation<Type1, Type2>(), 0, 1, 0, zero);
 }
 
 /**
@@ -435,22 +669,8 @@ void usVolumeProcessing::derivativeJ(const usImage3D<Type1> &src, usImage3D<Type
 template <class Type1, class Type2>
 void usVolumeProcessing::derivativeK(const usImage3D<Type1> &src, usImage3D<Type2> &dst)
 {
-  unsigned int height = src.getHeight();
-  unsigned int width = src.getWidth();
-  unsigned int nbFrames = src.getNumberOfFrames();
-  dst.resize(height, width, nbFrames);
   Type2 zero = 0 * derivativeK(src, 1, 1, 1);
-  // Access in order k-j-i for performance
-  for (unsigned int k = 1; k < nbFrames - 1; k++)
-    for (unsigned int j = 0; j < width; j++)
-      for (unsigned int i = 0; i < height; i++)
-        dst(i, j, k, derivativeK(src, i, j, k));
-
-  for (unsigned int j = 0; j < width; j++)
-    for (unsigned int i = 0; i < height; i++) {
-      dst(i, j, 0, zero);
-      dst(i, j, nbFrames - 1, zero);
-    }
+  usVoxelOperations::stencil(src, dst, usDerivativeKOperation<Type1, Type2>(), 0, 0, 1, zero);
 }
 
 /**
@@ -459,6 +679,16 @@ void usVolumeProcessing::derivativeK(const usImage3D<Type1> &src, usImage3D<Type
  * @param dst The volume filtered.
  */
 template <class Type> void usVolumeProcessing::gradient(const usImage3D<Type> &src, usImage3D<vpColVector> &dst)
+{
+  usVoxelOperations::stencil(src, dst, usGradientOperation<Type>(), 0, 0, 0, vpColVector(3, 0.0));
+}
+
+/**
+ * Compute the volume hessian.
+ * @param src The volume to filter.
+ * @param dst The volume filtered.
+ */
+template <class Type> void usVolumeProcessing::hessian(const usImage3D<Type> &src, usImage3D<vpMatrix> &dst)
 {
   unsigned int height = src.getHeight();
   unsigned int width = src.getWidth();
@@ -468,48 +698,63 @@ template <class Type> void usVolumeProcessing::gradient(const usImage3D<Type> &s
   derivativeJ(src, Gj);
   derivativeK(src, Gk);
   dst.resize(height, width, nbFrames);
-  for (unsigned int i = 0; i < src.getSize(); i++) {
-    vpColVector v(3);
-    v[0] = Gi.getConstData()[i];
-    v[1] = Gj.getConstData()[i];
-    v[2] = Gk.getConstData()[i];
-    dst.getData()[i] = v;
+  usHessianRow row;
+  for (unsigned int k = 0; k < nbFrames; k++) {
+    for (unsigned int i = 0; i < height; i++) {
+      hessianRow(Gi, Gj, Gk, i, k, row);
+      vpMatrix *out = dst.getData() + k * height * width + i * width;
+      for (unsigned int j = 0; j < width; j++) {
+        vpMatrix M(3, 3);
+        M[0][0] = row.component[0][j];
+        M[0][1] = row.component[1][j];
+        M[0][2] = row.component[2][j];
+        M[1][0] = row.component[1][j];
+        M[1][1] = row.component[3][j];
+        M[1][2] = row.component[4][j];
+        M[2][0] = row.component[2][j];
+        M[2][1] = row.component[4][j];
+        M[2][2] = row.component[5][j];
+        out[j] = M;
+      }
+    }
   }
 }
 
 /**
- * Compute the volume hessian.
+ * Compute the volume hessian, stored as six volumes (one per distinct component), which avoids the allocation of a
+ * matrix per voxel. The components are the same as the ones of hessian(const usImage3D<Type> &, usImage3D<vpMatrix> &).
  * @param src The volume to filter.
- * @param dst The volume filtered.
+ * @param dst The hessian components.
  */
-template <class Type> void usVolumeProcessing::hessian(const usImage3D<Type> &src, usImage3D<vpMatrix> &dst)
+template <class Type> void usVolumeProcessing::hessian(const usImage3D<Type> &src, usHessian3D &dst)
 {
-  unsigned int height = src.getHeight();
-  unsigned int width = src.getWidth();
-  unsigned int nbFrames = src.getNumberOfFrames();
-  usImage3D<double> Gi, Gj, Gk, Gii, Gij, Gik, Gjj, Gjk, Gkk;
+  const unsigned int height = src.getHeight();
+  const unsigned int width = src.getWidth();
+  const unsigned int nbFrames = src.getNumberOfFrames();
+  usImage3D<double> Gi, Gj, Gk;
   derivativeI(src, Gi);
   derivativeJ(src, Gj);
   derivativeK(src, Gk);
-  derivativeI(Gi, Gii);
-  derivativeI(Gj, Gij);
-  derivativeI(Gk, Gik);
-  derivativeJ(Gj, Gjj);
-  derivativeJ(Gk, Gjk);
-  derivativeK(Gk, Gkk);
-  dst.resize(height, width, nbFrames);
-  for (unsigned int i = 0; i < src.getSize(); i++) {
-    vpMatrix M(3, 3);
-    M[0][0] = Gii.getConstData()[i];
-    M[0][1] = Gij.getConstData()[i];
-    M[0][2] = Gik.getConstData()[i];
-    M[1][0] = Gij.getConstData()[i];
-    M[1][1] = Gjj.getConstData()[i];
-    M[1][2] = Gjk.getConstData()[i];
-    M[2][0] = Gik.getConstData()[i];
-    M[2][1] = Gjk.getConstData()[i];
-    M[2][2] = Gkk.getConstData()[i];
-    dst.getData()[i] = M;
+  usImage3D<float> *components[6] = {&dst.ii, &dst.ij, &dst.ik, &dst.jj, &dst.jk, &dst.kk};
+  for (unsigned int c = 0; c < 6; c++)
+    components[c]->resize(height, width, nbFrames);
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    usHessianRow row;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp for
+#endif
+    for (int k = 0; k < (int)nbFrames; k++) {
+      for (unsigned int i = 0; i < height; i++) {
+        hessianRow(Gi, Gj, Gk, i, k, row);
+        for (unsigned int c = 0; c < 6; c++)
+          std::copy(row.component[c].begin(), row.component[c].begin() + width,
+                    components[c]->getData() + k * height * width + i * width);
+      }
+    }
   }
 }
 
@@ -519,7 +764,8 @@ template <class Type> void usVolumeProcessing::hessian(const usImage3D<Type> &sr
  *   \f[
   V_{0}(s) =  (1 - exp(- \frac{- R_{A}^{2}}{2α^{2}}))exp(- \frac{- R_{B}^{2}}{2β^{2}})(1 - exp(- \frac{S^{2}}{2c^{2}}))
   \f]
- * @warning This method needs GSL thirdparty to work. You can prevent errors by testing VISP_HAVE_GSL define.
+ * The hessian is computed row by row and its eigenvalues with symmetricEigenValues(), so that neither the hessian
+ * volume nor a matrix per voxel are allocated.
  * @param src The volume to computed.
  * @param dst The volume filtered.
  * @param a Corresponds to \f$ α \f$ parameter in formula above.
@@ -529,38 +775,205 @@ template <class Type> void usVolumeProcessing::hessian(const usImage3D<Type> &sr
 template <class Type>
 void usVolumeProcessing::frangi(const usImage3D<Type> &src, usImage3D<double> &dst, double a, double b, double c)
 {
-  unsigned int height = src.getHeight();
-  unsigned int width = src.getWidth();
-  unsigned int nbFrames = src.getNumberOfFrames();
-  usImage3D<vpMatrix> H;
-  hessian(src, H);
+  const unsigned int height = src.getHeight();
+  const unsigned int width = src.getWidth();
+  const unsigned int nbFrames = src.getNumberOfFrames();
+  usImage3D<double> Gi, Gj, Gk;
+  derivativeI(src, Gi);
+  derivativeJ(src, Gj);
+  derivativeK(src, Gk);
   dst.resize(height, width, nbFrames);
-  for (unsigned int i = 0; i < src.getSize(); i++) {
-    vpColVector evalues = H.getConstData()[i].eigenValues();
-
-    // Sort eigenvalues
-    if (vpMath::abs(evalues[0]) > vpMath::abs(evalues[1]))
-      std::swap(evalues[0], evalues[1]);
-    if (vpMath::abs(evalues[1]) > vpMath::abs(evalues[2]))
-      std::swap(evalues[1], evalues[2]);
-    if (vpMath::abs(evalues[0]) > vpMath::abs(evalues[1]))
-      std::swap(evalues[0], evalues[1]);
-
-    double v;
-    if ((evalues[1] >= 0.0) || (evalues[2] >= 0.0))
-      v = 0.0;
-    else {
-      double Rb = vpMath::abs(evalues[0]) / sqrt(vpMath::abs(evalues[1] * evalues[2]));
-      double Ra = vpMath::abs(evalues[1] / evalues[2]);
-      double S = evalues.frobeniusNorm();
-
-      v = (1.0 - exp(-vpMath::sqr(Ra) / (2.0 * vpMath::sqr(a)))) * exp(-vpMath::sqr(Rb) / (2.0 * vpMath::sqr(b))) *
-          (1.0 - exp(-vpMath::sqr(S) / (2.0 * vpMath::sqr(c))));
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    usHessianRow row;
+#ifdef VISP_HAVE_OPENMP
+#pragma omp for
+#endif
+    for (int k = 0; k < (int)nbFrames; k++) {
+      for (unsigned int i = 0; i < height; i++) {
+        hessianRow(Gi, Gj, Gk, i, k, row);
+        frangiRow(row, width, a, b, c, NULL, dst.getData() + k * height * width + i * width);
+      }
     }
-    dst.getData()[i] = v;
   }
 }
 
+/**
+ * Compute the multi-scale Frangi's vesselness : the maximum over several scales of the vesselness (see frangi()) of the
+ * volume filtered by a gaussian of standard deviation sigma, the hessian being multiplied by sigma^2 so that the
+ * responses of the different scales can be compared (Frangi et al., 1998).
+ *
+ * The scales are processed by increasing sigma, and each gaussian filtered volume is computed from the previous one
+ * with recursiveGaussianDerivative() and a standard deviation of sqrt(sigma_n^2 - sigma_{n-1}^2). Only the first
+ * derivatives are kept for each scale, the hessian and the vesselness being computed row by row.
+ * @param src The volume to compute.
+ * @param dst The maximum vesselness over the scales.
+ * @param bestScale The sigma giving the maximum vesselness, 0 where the vesselness is 0 at all scales. It can be used
+ * to estimate the radius of the tubular structures (for a gaussian tube profile, the best scale is close to the
+ * standard deviation of the profile).
+ * @param sigmas The gaussian standard deviations of the scales, in voxels (at least 0.5).
+ * @param a Corresponds to \f$ α \f$ parameter in frangi formula.
+ * @param b Corresponds to \f$ β \f$ parameter in frangi formula.
+ * @param c Corresponds to \f$ c \f$ parameter in frangi formula, for the hessian normalized by sigma^2.
+ * @param mask Optional mask of the volume size : the vesselness is only computed for the voxels whose mask value is
+ * not zero, and is zero elsewhere. The vesselness of the whole volume is computed if the mask is empty.
+ */
+template <class Type>
+void usVolumeProcessing::frangiMultiScale(const usImage3D<Type> &src, usImage3D<double> &dst,
+                                          usImage3D<double> &bestScale, const std::vector<double> &sigmas, double a,
+                                          double b, double c, const usImage3D<unsigned char> &mask)
+{
+  const unsigned int height = src.getHeight();
+  const unsigned int width = src.getWidth();
+  const unsigned int nbFrames = src.getNumberOfFrames();
+  const bool masked = mask.getSize() > 0;
+  if (masked && (mask.getHeight() != height || mask.getWidth() != width || mask.getNumberOfFrames() != nbFrames))
+    throw vpException(vpException::dimensionError,
+                      "usVolumeProcessing::frangiMultiScale(): mask and volume should have the same dimensions");
+  if (sigmas.empty())
+    throw vpException(vpException::badValue, "usVolumeProcessing::frangiMultiScale(): no scale");
+  std::vector<double> scales(sigmas);
+  std::sort(scales.begin(), scales.end());
+  if (scales.front() < 0.5)
+    throw vpException(vpException::badValue, "usVolumeProcessing::frangiMultiScale(): sigma should be at least 0.5");
+
+  dst.resize(height, width, nbFrames);
+  dst.initData(0.0);
+  bestScale.resize(height, width, nbFrames);
+  bestScale.initData(0.0);
+
+  usImage3D<double> blurred, Gi, Gj, Gk;
+  double blurredSigma = 0.0;
+  for (unsigned int n = 0; n < scales.size(); n++) {
+    const double sigma = scales[n];
+    if (sigma == blurredSigma)
+      continue;
+
+    // incremental gaussian filtering, unless the increment is too small for the recursive filter
+    const double increment = sqrt(vpMath::sqr(sigma) - vpMath::sqr(blurredSigma));
+    if (blurredSigma > 0.0 && increment >= 0.5)
+      recursiveGaussianDerivative(blurred, blurred, increment, 0, 0, 0);
+    else
+      recursiveGaussianDerivative(src, blurred, sigma, 0, 0, 0);
+    blurredSigma = sigma;
+
+    derivativeI(blurred, Gi);
+    derivativeJ(blurred, Gj);
+    derivativeK(blurred, Gk);
+    const double normalization = vpMath::sqr(sigma);
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel
+#endif
+    {
+      usHessianRow row;
+      std::vector<double> vesselness(width);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp for
+#endif
+      for (int k = 0; k < (int)nbFrames; k++) {
+        for (unsigned int i = 0; i < height; i++) {
+          const unsigned int offset = k * height * width + i * width;
+          const unsigned char *rowMask = masked ? mask.getConstData() + offset : NULL;
+          if (rowMask && std::count(rowMask, rowMask + width, 0) == (int)width)
+            continue;
+
+          hessianRow(Gi, Gj, Gk, i, k, row);
+          for (unsigned int m = 0; m < 6; m++)
+            for (unsigned int j = 0; j < width; j++)
+              row.component[m][j] *= normalization;
+          frangiRow(row, width, a, b, c, rowMask, &vesselness[0]);
+
+          double *maxVesselness = dst.getData() + offset;
+          double *maxScale = bestScale.getData() + offset;
+          for (unsigned int j = 0; j < width; j++) {
+            if (vesselness[j] > maxVesselness[j]) {
+              maxVesselness[j] = vesselness[j];
+              maxScale[j] = sigma;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Compute a gaussian filtered derivative of a volume with the recursive filters of Deriche (1993), which approximate
+ * the gaussian and its first and second derivatives with a cost that does not depend on sigma. Each axis is filtered
+ * by a causal and an anti-causal 4th order recursive filter, the borders being extended with their value.
+ *
+ * Unlike gaussianDerivativeI() and the filters of generateGaussianDerivativeFilter1D(), the derivatives are normalized
+ * as the derivatives of the gaussian filtered volume : for instance the first derivative of a volume equal to i is 1.
+ *
+ * For instance, the second derivative along i is computed with orders (2, 0, 0), and the cross derivative along i and
+ * k with orders (1, 0, 1).
+ * @param [in] src The volume to filter (arithmetic type).
+ * @param [out] dst The volume filtered.
+ * @param [in] sigma Gaussian standard deviation, in voxels (at least 0.5).
+ * @param [in] orderI Derivative order along the i-axis (height) : 0, 1 or 2.
+ * @param [in] orderJ Derivative order along the j-axis (width) : 0, 1 or 2.
+ * @param [in] orderK Derivative order along the k-axis (3rd dimension) : 0, 1 or 2.
+ */
+template <class Type1, class Type2>
+void usVolumeProcessing::recursiveGaussianDerivative(const usImage3D<Type1> &src, usImage3D<Type2> &dst, double sigma,
+                                                     unsigned int orderI, unsigned int orderJ, unsigned int orderK)
+{
+  if (sigma < 0.5)
+    throw vpException(vpException::badValue,
+                      "usVolumeProcessing::recursiveGaussianDerivative(): sigma should be at least 0.5");
+  if (orderI > 2 || orderJ > 2 || orderK > 2)
+    throw vpException(vpException::badValue,
+                      "usVolumeProcessing::recursiveGaussianDerivative(): derivative orders should be 0, 1 or 2");
+
+  const unsigned int height = src.getHeight();
+  const unsigned int width = src.getWidth();
+  const unsigned int nbFrames = src.getNumberOfFrames();
+  const unsigned int frameSize = height * width;
+  usRecursiveFilter filterI, filterJ, filterK;
+  recursiveGaussianCoefficients(sigma, orderI, filterI);
+  recursiveGaussianCoefficients(sigma, orderJ, filterJ);
+  recursiveGaussianCoefficients(sigma, orderK, filterK);
+  std::vector<double> volume(src.getSize());
+  for (unsigned int n = 0; n < src.getSize(); n++)
+    volume[n] = src.getConstData()[n];
+
+  // j-axis : each row is a line
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int k = 0; k < (int)nbFrames; k++) {
+    std::vector<double> buffer;
+    for (unsigned int i = 0; i < height; i++)
+      recursiveGaussianLines(&volume[k * frameSize + i * width], width, 1, 1, filterJ, buffer);
+  }
+
+  // i-axis : the columns of a frame are filtered together, row by row
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int k = 0; k < (int)nbFrames; k++) {
+    std::vector<double> buffer;
+    recursiveGaussianLines(&volume[k * frameSize], height, width, width, filterI, buffer);
+  }
+
+  // k-axis : the lines of a row are filtered together, frame by frame
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < (int)height; i++) {
+    std::vector<double> buffer;
+    recursiveGaussianLines(&volume[i * width], nbFrames, frameSize, width, filterK, buffer);
+  }
+
+  dst.resize(height, width, nbFrames);
+  for (unsigned int n = 0; n < src.getSize(); n++)
+    dst.getData()[n] = volume[n];
+}
+
 /**
  * Compute the volume difference: dst = src1 - src2.
  * @param src1 The first volume.
@@ -570,15 +983,10 @@ void usVolumeProcessing::frangi(const usImage3D<Type> &src, usImage3D<double> &d
 template <class Type1, class Type2>
 void usVolumeProcessing::difference(const usImage3D<Type1> &src1, const usImage3D<Type1> &src2, usImage3D<Type2> &dst)
 {
-  unsigned int height = src1.getHeight();
-  unsigned int width = src1.getWidth();
-  unsigned int nbFrames = src1.getNumberOfFrames();
-  if (height != src2.getHeight() || width != src2.getWidth() || nbFrames != src2.getNumberOfFrames())
+  if (src1.getHeight() != src2.getHeight() || src1.getWidth() != src2.getWidth() ||
+      src1.getNumberOfFrames() != src2.getNumberOfFrames())
     throw vpException(vpException::dimensionError, "usVolumeProcessing::difference: mismatched volumes dimensions");
-  unsigned int n = src1.getSize();
-  dst.resize(height, width, nbFrames);
-  for (unsigned int i = 0; i < n; i++)
-    dst.getData()[i] = src1.getConstData()[i] - src2.getConstData()[i];
+  usVoxelOperations::zip(src1, src2, dst, usDifferenceOperation<Type1, Type2>());
 }
 
 /**
@@ -591,16 +999,11 @@ template <class Type1, class Type2>
 void usVolumeProcessing::absoluteDifference(const usImage3D<Type1> &src1, const usImage3D<Type1> &src2,
                                             usImage3D<Type2> &dst)
 {
-  unsigned int height = src1.getHeight();
-  unsigned int width = src1.getWidth();
-  unsigned int nbFrames = src1.getNumberOfFrames();
-  if (height != src2.getHeight() || width != src2.getWidth() || nbFrames != src2.getNumberOfFrames())
+  if (src1.getHeight() != src2.getHeight() || src1.getWidth() != src2.getWidth() ||
+      src1.getNumberOfFrames() != src2.getNumberOfFrames())
     throw vpException(vpException::dimensionError,
                       "usVolumeProcessing::absoluteDifference: mismatched volumes dimensions");
-  unsigned int n = src1.getSize();
-  dst.resize(height, width, nbFrames);
-  for (unsigned int i = 0; i < n; i++)
-    dst.getData()[i] = vpMath::abs(src1.getConstData()[i] - src2.getConstData()[i]);
+  usVoxelOperations::zip(src1, src2, dst, usAbsoluteDifferenceOperation<Type1, Type2>());
 }
 
 /**
@@ -613,25 +1016,11 @@ void usVolumeProcessing::absoluteDifference(const usImage3D<Type1> &src1, const
 template <class Type>
 void usVolumeProcessing::computeBarycenter(const usImage3D<Type> &V, double &ic, double &jc, double &kc)
 {
-  unsigned int height = V.getHeight();
-  unsigned int width = V.getWidth();
-  unsigned int nbFrames = V.getNumberOfFrames();
-  Type V_sum = 0 * V(0, 0, 0);
-  double i_c = 0.0;
-  double j_c = 0.0;
-  double k_c = 0.0;
-  for (unsigned int k = 0; k < nbFrames; k++)
-    for (unsigned int j = 0; j < width; j++)
-      for (unsigned int i = 0; i < height; i++) {
-        Type val = V(i, j, k);
-        i_c += i * val;
-        j_c += j * val;
-        k_c += k * val;
-        V_sum += val;
-      }
-  ic = i_c / V_sum;
-  jc = j_c / V_sum;
-  kc = k_c / V_sum;
+  usBarycenterSums zero = {0.0, 0.0, 0.0, 0.0};
+  usBarycenterSums sums = usVoxelOperations::reduce(V, zero, usBarycenterOperation<Type>());
+  ic = sums.i / sums.sum;
+  jc = sums.j / sums.sum;
+  kc = sums.k / sums.sum;
 }
 
 #endif // __usVolumeProcessing_h_
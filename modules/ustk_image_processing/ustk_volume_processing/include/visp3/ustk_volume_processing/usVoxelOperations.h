@@ -0,0 +1,238 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/**
+ * @file usVoxelOperations.h
+ * @brief Parallel voxel-wise operations on usImage3D.
+ */
+
+#ifndef __usVoxelOperations_h_
+#define __usVoxelOperations_h_
+
+#include <algorithm>
+#include <vector>
+
+#include <visp3/core/vpConfig.h>
+#include <visp3/core/vpException.h>
+
+#include <visp3/ustk_core/usImage3D.h>
+
+/**
+ * @class usVoxelOperations
+ * @brief Parallel map, zip, reduce and stencil operations on the voxels of usImage3D volumes.
+ * @ingroup module_ustk_volume_processing
+ *
+ * The operations are given as functors, whose calls are inlined in loops that follow the memory layout of the volume
+ * (contiguous rows along j), so that simple element-wise operations are vectorized by the compiler. The volume is cut
+ * into chunks of contiguous voxels or rows processed in parallel with OpenMP when available.
+ *
+ * Several element-wise operations can be fused in a single pass by composing them in one functor, for instance the
+ * absolute difference of two volumes with zip():
+ * \code
+ * struct usAbsoluteDifference {
+ *   double operator()(double a, double b) const { return std::fabs(a - b); }
+ * };
+ * usVoxelOperations::zip(V1, V2, Vdiff, usAbsoluteDifference());
+ * \endcode
+ *
+ * The operations are:
+ * - map(): dst(i, j, k) = op(src(i, j, k)),
+ * - zip(): dst(i, j, k) = op(src1(i, j, k), src2(i, j, k)),
+ * - reduce(): reduction of the rows of the volume, with op(result, row, width, i, k) accumulating a row in a partial
+ *   result and op(result, partial) merging two partial results,
+ * - stencil(): dst(i, j, k) = op(src, i, j, k) for the voxels far enough from the borders, a constant value being set
+ *   on the borders.
+ */
+class usVoxelOperations
+{
+public:
+  template <class Type1, class Type2, class Operation>
+  static void map(const usImage3D<Type1> &src, usImage3D<Type2> &dst, Operation op);
+
+  template <class Type, class Result, class Operation>
+  static Result reduce(const usImage3D<Type> &src, const Result &init, Operation op);
+
+  template <class Volume, class Type2, class Operation>
+  static void stencil(const Volume &src, usImage3D<Type2> &dst, Operation op, unsigned int marginI,
+                      unsigned int marginJ, unsigned int marginK, const Type2 &border);
+
+  template <class Type1, class Type2, class Type3, class Operation>
+  static void zip(const usImage3D<Type1> &src1, const usImage3D<Type2> &src2, usImage3D<Type3> &dst, Operation op);
+
+  /// Number of voxels of the chunks processed by map() and zip().
+  static const unsigned int chunkSize = 16384;
+};
+
+/****************************************************************************
+* Template implementations.
+****************************************************************************/
+
+/**
+ * Apply an element-wise operation to a volume : dst(i, j, k) = op(src(i, j, k)). The destination can be the source.
+ * @param [in] src The input volume.
+ * @param [out] dst The output volume, resized to the dimensions of the input volume.
+ * @param [in] op The operation, a functor such that op(const Type1 &) is convertible to Type2.
+ */
+template <class Type1, class Type2, class Operation>
+void usVoxelOperations::map(const usImage3D<Type1> &src, usImage3D<Type2> &dst, Operation op)
+{
+  dst.resize(src.getHeight(), src.getWidth(), src.getNumberOfFrames());
+  const Type1 *in = src.getConstData();
+  Type2 *out = dst.getData();
+  const int size = (int)src.getSize();
+  const int nbChunks = (size + chunkSize - 1) / chunkSize;
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int c = 0; c < nbChunks; c++) {
+    const int end = std::min(size, (c + 1) * (int)chunkSize);
+    for (int n = c * chunkSize; n < end; n++)
+      out[n] = op(in[n]);
+  }
+}
+
+/**
+ * Reduce a volume row by row. The rows are dispatched in chunks, each chunk being reduced in a partial result
+ * initialized with init; the partial results are then merged in the order of the chunks, starting from init. init
+ * should then be neutral for the merge (zero for a sum, any voxel value for a minimum or a maximum).
+ * @param [in] src The volume to reduce.
+ * @param [in] init Initial value of the partial results and of the result.
+ * @param [in] op The reduction, a functor with the two following calls:
+ * - op(Result &result, const Type *row, unsigned int width, unsigned int i, unsigned int k) accumulates the row (i, k)
+ *   of the volume in result,
+ * - op(Result &result, const Result &partial) merges a partial result in result.
+ * @return The reduction of the volume.
+ */
+template <class Type, class Result, class Operation>
+Result usVoxelOperations::reduce(const usImage3D<Type> &src, const Result &init, Operation op)
+{
+  const unsigned int height = src.getHeight();
+  const unsigned int width = src.getWidth();
+  const int nbRows = (int)(height * src.getNumberOfFrames());
+  if (nbRows == 0 || width == 0)
+    return init;
+  const int rowsPerChunk = (int)std::max(1u, chunkSize / width);
+  const int nbChunks = (nbRows + rowsPerChunk - 1) / rowsPerChunk;
+  std::vector<Result> partials(nbChunks, init);
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int c = 0; c < nbChunks; c++) {
+    const int end = std::min(nbRows, (c + 1) * rowsPerChunk);
+    for (int r = c * rowsPerChunk; r < end; r++)
+      op(partials[c], src.getConstData() + r * width, width, r % height, r / height);
+  }
+
+  Result result = init;
+  for (int c = 0; c < nbChunks; c++)
+    op(result, partials[c]);
+  return result;
+}
+
+/**
+ * Apply a neighbourhood operation to a volume : dst(i, j, k) = op(src, i, j, k) for the voxels whose distance to the
+ * borders is at least the margin along each axis, dst(i, j, k) = border for the other voxels. The frames are processed
+ * in parallel, and each row from the lowest to the highest j.
+ * @param [in] src The input volume : usImage3D, or any class with the same voxel accessors (getHeight(), getWidth(),
+ * getNumberOfFrames(), operator()), such as usImage3DView.
+ * @param [out] dst The output volume, resized to the dimensions of the input volume. It should not be the input volume.
+ * @param [in] op The operation, a functor such that op(const Volume &, unsigned int i, unsigned int j, unsigned int k)
+ * is convertible to Type2.
+ * @param [in] marginI Margin along the i-axis (height).
+ * @param [in] marginJ Margin along the j-axis (width).
+ * @param [in] marginK Margin along the k-axis (3rd dimension).
+ * @param [in] border Value of the voxels of the margins.
+ */
+template <class Volume, class Type2, class Operation>
+void usVoxelOperations::stencil(const Volume &src, usImage3D<Type2> &dst, Operation op, unsigned int marginI,
+                                unsigned int marginJ, unsigned int marginK, const Type2 &border)
+{
+  const unsigned int height = src.getHeight();
+  const unsigned int width = src.getWidth();
+  const unsigned int nbFrames = src.getNumberOfFrames();
+  dst.resize(height, width, nbFrames);
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int k = 0; k < (int)nbFrames; k++) {
+    const bool frameInside = (unsigned int)k >= marginK && (unsigned int)k + marginK < nbFrames;
+    for (unsigned int i = 0; i < height; i++) {
+      Type2 *out = dst.getData() + k * height * width + i * width;
+      if (!frameInside || i < marginI || i + marginI >= height || 2 * marginJ >= width) {
+        std::fill(out, out + width, border);
+        continue;
+      }
+      std::fill(out, out + marginJ, border);
+      for (unsigned int j = marginJ; j < width - marginJ; j++)
+        out[j] = op(src, i, j, (unsigned int)k);
+      std::fill(out + width - marginJ, out + width, border);
+    }
+  }
+}
+
+/**
+ * Apply an element-wise operation to two volumes : dst(i, j, k) = op(src1(i, j, k), src2(i, j, k)). The destination
+ * can be one of the sources.
+ * @param [in] src1 The first input volume.
+ * @param [in] src2 The second input volume, of the same dimensions as the first one.
+ * @param [out] dst The output volume, resized to the dimensions of the input volumes.
+ * @param [in] op The operation, a functor such that op(const Type1 &, const Type2 &) is convertible to Type3.
+ */
+template <class Type1, class Type2, class Type3, class Operation>
+void usVoxelOperations::zip(const usImage3D<Type1> &src1, const usImage3D<Type2> &src2, usImage3D<Type3> &dst,
+                            Operation op)
+{
+  if (src1.getHeight() != src2.getHeight() || src1.getWidth() != src2.getWidth() ||
+      src1.getNumberOfFrames() != src2.getNumberOfFrames())
+    throw vpException(vpException::dimensionError, "usVoxelOperations::zip: mismatched volumes dimensions");
+
+  dst.resize(src1.getHeight(), src1.getWidth(), src1.getNumberOfFrames());
+  const Type1 *in1 = src1.getConstData();
+  const Type2 *in2 = src2.getConstData();
+  Type3 *out = dst.getData();
+  const int size = (int)src1.getSize();
+  const int nbChunks = (size + chunkSize - 1) / chunkSize;
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (int c = 0; c < nbChunks; c++) {
+    const int end = std::min(size, (c + 1) * (int)chunkSize);
+    for (int n = c * chunkSize; n < end; n++)
+      out[n] = op(in1[n], in2[n]);
+  }
+}
+
+#endif // __usVoxelOperations_h_
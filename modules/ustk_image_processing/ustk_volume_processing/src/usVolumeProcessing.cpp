@@ -31,6 +31,8 @@
  *
  *****************************************************************************/
 
+#include <complex>
+
 #include <visp3/core/vpException.h>
 #include <visp3/ustk_volume_processing/usVolumeProcessing.h>
 
@@ -41,10 +43,43 @@
  */
 void usVolumeProcessing::norm(const usImage3D<vpColVector> &src, usImage3D<double> &dst)
 {
-  dst.resize(src.getHeight(), src.getWidth(), src.getNumberOfFrames());
+  usVoxelOperations::map(src, dst, usNormOperation());
+}
 
-  for (unsigned int i = 0; i < src.getSize(); i++)
-    dst.getData()[i] = src.getConstData()[i].frobeniusNorm();
+/**
+ * Generate a 1D Gaussian filter or Gaussian derivative filter, with the same coefficients as the 3D filters (see
+ * generateGaussianDerivativeFilterI() for instance), which are products of these 1D filters.
+ * @param sigma Gaussian filter standard deviation.
+ * @param size Size of the gaussian filter.
+ * @param order Derivative order : 0 (gaussian), 1 or 2.
+ */
+std::vector<double> usVolumeProcessing::generateGaussianDerivativeFilter1D(double sigma, int size, unsigned int order)
+{
+  if (size <= 0 || (size % 2) != 1) {
+    throw vpException(
+        vpException::badValue,
+        "usVolumeProcessing::generateGaussianDerivativeFilter1D(): Bad filter size, should be positive and odd");
+  }
+  if (order > 2) {
+    throw vpException(vpException::badValue,
+                      "usVolumeProcessing::generateGaussianDerivativeFilter1D(): Bad order, should be 0, 1 or 2");
+  }
+
+  double sigma2 = vpMath::sqr(sigma);
+  int m = (size - 1) / 2;
+  std::vector<double> filter(size);
+
+  for (int i = 0; i < size; i++) {
+    if (order == 0)
+      filter[i] = exp(-vpMath::sqr(i - m) / (2.0 * sigma2)) / (sigma * sqrt(2.0 * M_PI));
+    else if (order == 1)
+      filter[i] = -(i - m) * exp(-vpMath::sqr(i - m) / (2.0 * sigma2)) / (2.0 * sigma * sigma2 * sqrt(2.0 * M_PI));
+    else
+      filter[i] = (vpMath::sqr(i - m) / (4.0 * vpMath::sqr(sigma2) * sqrt(2.0 * M_PI)) -
+                   1.0 / (2.0 * sigma * sigma2 * sqrt(2.0 * M_PI))) *
+                  exp(-vpMath::sqr(i - m) / (2.0 * sigma2));
+  }
+  return filter;
 }
 
 /**
@@ -331,3 +366,357 @@ usImage3D<double> usVolumeProcessing::generateGaussianDerivativeFilterJK(double
   }
   return filter;
 }
+
+/**
+ * Coefficients of the 4th order recursive filters of Deriche (1993) approximating the gaussian and its first and second
+ * derivatives. The impulse response, for x >= 0, is the sum of two terms (a cos(w x / sigma) + b sin(w x / sigma))
+ * exp(-l x / sigma); it is even for the orders 0 and 2 and odd for the order 1. It is normalized so that the filter
+ * gives exactly the value, the first or the second derivative of a constant, linear or quadratic signal.
+ * @param [in] sigma Gaussian standard deviation.
+ * @param [in] order Derivative order : 0, 1 or 2.
+ * @param [out] filter Causal and anti-causal recursive filters.
+ */
+void usVolumeProcessing::recursiveGaussianCoefficients(double sigma, unsigned int order, usRecursiveFilter &filter)
+{
+  // a, b, l, w of the two terms, for each order
+  static const double terms[3][2][4] = {{{1.68, 3.735, 1.783, 0.6318}, {-0.6803, -0.2598, 1.723, 1.997}},
+                                        {{-0.6472, -4.531, 1.527, 0.6719}, {0.6494, 0.9557, 1.516, 2.072}},
+                                        {{-1.331, 3.661, 1.24, 0.748}, {0.3225, -1.738, 1.314, 2.166}}};
+
+  // impulse response h(k) = sum of r[p] * pole[p]^k, for k >= 0
+  std::complex<double> pole[4], r[4];
+  for (unsigned int t = 0; t < 2; t++) {
+    const double *c = terms[order][t];
+    pole[2 * t] = std::exp(std::complex<double>(-c[2], c[3]) / sigma);
+    pole[2 * t + 1] = std::conj(pole[2 * t]);
+    r[2 * t] = 0.5 * std::complex<double>(c[0], -c[1]);
+    r[2 * t + 1] = std::conj(r[2 * t]);
+  }
+
+  // causal filter : denominator d(z^-1) = prod(1 - pole z^-1) and numerator n(z^-1) = sum(r prod_{q != p}(1 - q z^-1))
+  // anti-causal filter : sum_{k >= 1} s h(k) z^k = s (n(z) - h0 d(z)) / d(z), s being the parity of the response
+  const double parity = (order == 1) ? -1.0 : 1.0;
+  std::complex<double> d[5] = {1.0, 0.0, 0.0, 0.0, 0.0};
+  std::complex<double> n[4] = {0.0, 0.0, 0.0, 0.0};
+  for (unsigned int p = 0; p < 4; p++) {
+    for (unsigned int k = p + 1; k > 0; k--)
+      d[k] -= pole[p] * d[k - 1];
+    std::complex<double> product[4] = {r[p], 0.0, 0.0, 0.0};
+    unsigned int degree = 0;
+    for (unsigned int q = 0; q < 4; q++) {
+      if (q == p)
+        continue;
+      degree++;
+      for (unsigned int k = degree; k > 0; k--)
+        product[k] -= pole[q] * product[k - 1];
+    }
+    for (unsigned int k = 0; k < 4; k++)
+      n[k] += product[k];
+  }
+
+  // moments of the impulse response for k >= 0 : sum(h), sum(k h), sum(k^2 h)
+  std::complex<double> sum0 = 0.0, sum1 = 0.0, sum2 = 0.0;
+  for (unsigned int p = 0; p < 4; p++) {
+    std::complex<double> one_p = 1.0 - pole[p];
+    sum0 += r[p] / one_p;
+    sum1 += r[p] * pole[p] / (one_p * one_p);
+    sum2 += r[p] * pole[p] * (1.0 + pole[p]) / (one_p * one_p * one_p);
+  }
+  double h0 = (r[0] + r[1] + r[2] + r[3]).real();
+  double scale;
+  if (order == 0)
+    scale = 1.0 / (2.0 * sum0.real() - h0);
+  else if (order == 1)
+    scale = -1.0 / (2.0 * sum1.real());
+  else
+    scale = 1.0 / sum2.real();
+
+  for (unsigned int k = 0; k < 4; k++) {
+    filter.d[k] = d[k + 1].real();
+    filter.n[k] = scale * n[k].real();
+    // anti-causal numerator s (n(z) - h0 d(z)), without its constant term (zero) : coefficient of z^(k + 1)
+    double nNext = (k < 3) ? n[k + 1].real() : 0.0;
+    filter.m[k] = parity * scale * (nNext - h0 * d[k + 1].real());
+  }
+  // central tap correction : zero for the odd order, zero sum for the second order
+  if (order == 1)
+    filter.center = scale * h0;
+  else if (order == 2)
+    filter.center = scale * (2.0 * sum0.real() - h0);
+  else
+    filter.center = 0.0;
+}
+
+/**
+ * Recursive filtering of lines of samples, in place (see recursiveGaussianCoefficients()). The samples outside of the
+ * lines are equal to the first or last sample. Several lines whose samples are contiguous (lanes) are filtered
+ * together.
+ * @param data First sample of the first line.
+ * @param count Number of samples per line.
+ * @param stride Distance between two successive samples of a line.
+ * @param lanes Number of lines, the first samples of which are contiguous.
+ * @param filter Causal and anti-causal recursive filters.
+ * @param buffer Work buffer.
+ */
+void usVolumeProcessing::recursiveGaussianLines(double *data, unsigned int count, unsigned int stride,
+                                                unsigned int lanes, const usRecursiveFilter &filter,
+                                                std::vector<double> &buffer)
+{
+  if (count == 0)
+    return;
+
+  const double *n = filter.n;
+  const double *m = filter.m;
+  const double *d = filter.d;
+  const double dSum = 1.0 + d[0] + d[1] + d[2] + d[3];
+  const double causalGain = (n[0] + n[1] + n[2] + n[3]) / dSum;
+  const double antiCausalGain = (m[0] + m[1] + m[2] + m[3]) / dSum;
+
+  // input samples, and causal output, line by line with the lanes contiguous
+  buffer.resize(2 * count * lanes);
+  double *x = &buffer[0];
+  double *y = &buffer[count * lanes];
+  for (unsigned int k = 0; k < count; k++)
+    std::copy(data + k * stride, data + k * stride + lanes, x + k * lanes);
+
+  // causal pass, the samples before the line being equal to the first one
+  for (unsigned int k = 0; k < count; k++) {
+    const double *xk[4];
+    const double *yk[4];
+    for (unsigned int t = 0; t < 4; t++)
+      xk[t] = x + (k >= t ? k - t : 0) * lanes;
+    for (unsigned int t = 1; t <= 4; t++)
+      yk[t - 1] = (k >= t) ? y + (k - t) * lanes : NULL;
+    double *out = y + k * lanes;
+    for (unsigned int l = 0; l < lanes; l++) {
+      double v = n[0] * xk[0][l] + n[1] * xk[1][l] + n[2] * xk[2][l] + n[3] * xk[3][l];
+      for (unsigned int t = 0; t < 4; t++)
+        v -= d[t] * (yk[t] ? yk[t][l] : causalGain * x[l]);
+      out[l] = v;
+    }
+  }
+
+  // anti-causal pass, the samples after the line being equal to the last one, written in place of the input samples
+  const unsigned int last = count - 1;
+  for (int k = (int)last; k >= 0; k--) {
+    const double *xk[4];
+    const double *yk[4];
+    for (unsigned int t = 1; t <= 4; t++) {
+      xk[t - 1] = x + std::min(k + t, last) * lanes;
+      yk[t - 1] = (k + t <= last) ? data + (k + t) * stride : NULL;
+    }
+    double *out = data + k * stride;
+    for (unsigned int l = 0; l < lanes; l++) {
+      double v = m[0] * xk[0][l] + m[1] * xk[1][l] + m[2] * xk[2][l] + m[3] * xk[3][l];
+      for (unsigned int t = 0; t < 4; t++)
+        v -= d[t] * (yk[t] ? yk[t][l] : antiCausalGain * x[last * lanes + l]);
+      out[l] = v;
+    }
+  }
+
+  // sum of both passes, and central tap correction
+  for (unsigned int k = 0; k < count; k++) {
+    double *out = data + k * stride;
+    const double *xk = x + k * lanes;
+    const double *yk = y + k * lanes;
+    for (unsigned int l = 0; l < lanes; l++)
+      out[l] += yk[l] - filter.center * xk[l];
+  }
+}
+
+/**
+ * Compute the Frangi's vesselness from the hessian of a volume (see frangi(const usImage3D<Type> &,
+ * usImage3D<double> &, double, double, double) for the formula). Computing the hessian once with
+ * hessian(const usImage3D<Type> &, usHessian3D &) allows to try several parameters.
+ * @param hessian The hessian of the volume.
+ * @param dst The vesselness volume.
+ * @param a Corresponds to \f$ α \f$ parameter in frangi formula.
+ * @param b Corresponds to \f$ β \f$ parameter in frangi formula.
+ * @param c Corresponds to \f$ c \f$ parameter in frangi formula.
+ */
+void usVolumeProcessing::frangi(const usHessian3D &hessian, usImage3D<double> &dst, double a, double b, double c)
+{
+  const unsigned int height = hessian.ii.getHeight();
+  const unsigned int width = hessian.ii.getWidth();
+  const unsigned int nbFrames = hessian.ii.getNumberOfFrames();
+  const usImage3D<float> *components[6] = {&hessian.ii, &hessian.ij, &hessian.ik,
+                                           &hessian.jj, &hessian.jk, &hessian.kk};
+  for (unsigned int n = 1; n < 6; n++)
+    if (components[n]->getHeight() != height || components[n]->getWidth() != width ||
+        components[n]->getNumberOfFrames() != nbFrames)
+      throw vpException(vpException::dimensionError,
+                        "usVolumeProcessing::frangi(): hessian components should have the same dimensions");
+
+  dst.resize(height, width, nbFrames);
+
+#ifdef VISP_HAVE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    usHessianRow row;
+    for (unsigned int n = 0; n < 6; n++)
+      row.component[n].resize(width);
+#ifdef VISP_HAVE_OPENMP
+#pragma omp for
+#endif
+    for (int k = 0; k < (int)nbFrames; k++) {
+      for (unsigned int i = 0; i < height; i++) {
+        const unsigned int offset = k * height * width + i * width;
+        for (unsigned int n = 0; n < 6; n++) {
+          const float *in = components[n]->getConstData() + offset;
+          std::copy(in, in + width, row.component[n].begin());
+        }
+        frangiRow(row, width, a, b, c, NULL, dst.getData() + offset);
+      }
+    }
+  }
+}
+
+/**
+ * Compute the Frangi's vesselness of one row of voxels from their hessian.
+ * @param row The hessian components of the row.
+ * @param width Number of voxels in the row.
+ * @param a Corresponds to \f$ α \f$ parameter in frangi formula.
+ * @param b Corresponds to \f$ β \f$ parameter in frangi formula.
+ * @param c Corresponds to \f$ c \f$ parameter in frangi formula.
+ * @param mask Mask of the row (voxels whose vesselness is computed), or NULL to compute the vesselness of all voxels.
+ * @param dst The vesselness of the voxels of the row, 0 outside of the mask.
+ */
+void usVolumeProcessing::frangiRow(const usHessianRow &row, unsigned int width, double a, double b, double c,
+                                   const unsigned char *mask, double *dst)
+{
+  const double *Hii = &row.component[0][0];
+  const double *Hij = &row.component[1][0];
+  const double *Hik = &row.component[2][0];
+  const double *Hjj = &row.component[3][0];
+  const double *Hjk = &row.component[4][0];
+  const double *Hkk = &row.component[5][0];
+  const double ka = -1.0 / (2.0 * vpMath::sqr(a));
+  const double kb = -1.0 / (2.0 * vpMath::sqr(b));
+  const double kc = -1.0 / (2.0 * vpMath::sqr(c));
+
+  for (unsigned int j = 0; j < width; j++) {
+    // the vesselness is zero unless the two eigenvalues of largest magnitude are negative, which implies a negative
+    // trace : the eigenvalues are not computed otherwise
+    if ((mask && !mask[j]) || Hii[j] + Hjj[j] + Hkk[j] >= 0.0) {
+      dst[j] = 0.0;
+      continue;
+    }
+
+    double evalues[3];
+    symmetricEigenValues(Hii[j], Hij[j], Hik[j], Hjj[j], Hjk[j], Hkk[j], evalues);
+
+    // Sort eigenvalues by absolute value
+    if (vpMath::abs(evalues[0]) > vpMath::abs(evalues[1]))
+      std::swap(evalues[0], evalues[1]);
+    if (vpMath::abs(evalues[1]) > vpMath::abs(evalues[2]))
+      std::swap(evalues[1], evalues[2]);
+    if (vpMath::abs(evalues[0]) > vpMath::abs(evalues[1]))
+      std::swap(evalues[0], evalues[1]);
+
+    double v;
+    if ((evalues[1] >= 0.0) || (evalues[2] >= 0.0))
+      v = 0.0;
+    else {
+      double Rb2 = vpMath::sqr(evalues[0]) / vpMath::abs(evalues[1] * evalues[2]);
+      double Ra2 = vpMath::sqr(evalues[1] / evalues[2]);
+      double S2 = vpMath::sqr(evalues[0]) + vpMath::sqr(evalues[1]) + vpMath::sqr(evalues[2]);
+
+      v = (1.0 - exp(ka * Ra2)) * exp(kb * Rb2) * (1.0 - exp(kc * S2));
+    }
+    dst[j] = v;
+  }
+}
+
+/**
+ * Compute the hessian components of one row of voxels, as central differences of the first derivatives (see
+ * derivativeI(), derivativeJ() and derivativeK()), the components being zero on the borders of the volume.
+ * @param Gi Derivative of the volume along i.
+ * @param Gj Derivative of the volume along j.
+ * @param Gk Derivative of the volume along k.
+ * @param i Index on i-axis of the row.
+ * @param k Index on k-axis of the row.
+ * @param row The hessian components of the row.
+ */
+void usVolumeProcessing::hessianRow(const usImage3D<double> &Gi, const usImage3D<double> &Gj,
+                                    const usImage3D<double> &Gk, unsigned int i, unsigned int k, usHessianRow &row)
+{
+  const unsigned int height = Gi.getHeight();
+  const unsigned int width = Gi.getWidth();
+  const unsigned int nbFrames = Gi.getNumberOfFrames();
+  const unsigned int frameSize = height * width;
+  const unsigned int offset = k * frameSize + i * width;
+  for (unsigned int n = 0; n < 6; n++)
+    row.component[n].assign(width, 0.0);
+  double *Hii = &row.component[0][0];
+  double *Hij = &row.component[1][0];
+  double *Hik = &row.component[2][0];
+  double *Hjj = &row.component[3][0];
+  double *Hjk = &row.component[4][0];
+  double *Hkk = &row.component[5][0];
+
+  // derivatives along i of Gi, Gj and Gk
+  if (i > 0 && i + 1 < height) {
+    const double *gi0 = Gi.getConstData() + offset - width, *gi1 = Gi.getConstData() + offset + width;
+    const double *gj0 = Gj.getConstData() + offset - width, *gj1 = Gj.getConstData() + offset + width;
+    const double *gk0 = Gk.getConstData() + offset - width, *gk1 = Gk.getConstData() + offset + width;
+    for (unsigned int j = 0; j < width; j++) {
+      Hii[j] = (gi1[j] - gi0[j]) / 2.0;
+      Hij[j] = (gj1[j] - gj0[j]) / 2.0;
+      Hik[j] = (gk1[j] - gk0[j]) / 2.0;
+    }
+  }
+
+  // derivatives along j of Gj and Gk
+  {
+    const double *gj = Gj.getConstData() + offset;
+    const double *gk = Gk.getConstData() + offset;
+    for (unsigned int j = 1; j + 1 < width; j++) {
+      Hjj[j] = (gj[j + 1] - gj[j - 1]) / 2.0;
+      Hjk[j] = (gk[j + 1] - gk[j - 1]) / 2.0;
+    }
+  }
+
+  // derivative along k of Gk
+  if (k > 0 && k + 1 < nbFrames) {
+    const double *gk0 = Gk.getConstData() + offset - frameSize, *gk1 = Gk.getConstData() + offset + frameSize;
+    for (unsigned int j = 0; j < width; j++)
+      Hkk[j] = (gk1[j] - gk0[j]) / 2.0;
+  }
+}
+
+/**
+ * Compute the eigenvalues of a symmetric 3x3 matrix in closed form, with the trigonometric solution of the
+ * characteristic polynomial (Smith, 1961). It does not allocate memory and is much faster than vpMatrix::eigenValues()
+ * for the small matrices of a hessian volume.
+ * @param a00 Element (0,0) of the matrix.
+ * @param a01 Elements (0,1) and (1,0) of the matrix.
+ * @param a02 Elements (0,2) and (2,0) of the matrix.
+ * @param a11 Element (1,1) of the matrix.
+ * @param a12 Elements (1,2) and (2,1) of the matrix.
+ * @param a22 Element (2,2) of the matrix.
+ * @param eigenValues The eigenvalues, in increasing order.
+ */
+void usVolumeProcessing::symmetricEigenValues(double a00, double a01, double a02, double a11, double a12, double a22,
+                                              double eigenValues[3])
+{
+  // A = q I + p B, with q the mean eigenvalue and B of unit norm (B^2 has trace 6)
+  const double q = (a00 + a11 + a22) / 3.0;
+  const double b00 = a00 - q;
+  const double b11 = a11 - q;
+  const double b22 = a22 - q;
+  const double offDiagonal = a01 * a01 + a02 * a02 + a12 * a12;
+  const double p = sqrt((b00 * b00 + b11 * b11 + b22 * b22 + 2.0 * offDiagonal) / 6.0);
+
+  // the eigenvalues of B are 2 cos(phi + 2 n pi / 3), with cos(3 phi) = det(B) / 2
+  const double detB = b00 * (b11 * b22 - a12 * a12) - a01 * (a01 * b22 - a12 * a02) + a02 * (a01 * a12 - b11 * a02);
+  const double invP3 = (p > 0.0) ? 1.0 / (p * p * p) : 0.0;
+  const double r = std::max(-1.0, std::min(1.0, detB * invP3 / 2.0));
+  const double cosPhi = cos(acos(r) / 3.0);
+  const double sinPhi = sqrt(std::max(0.0, 1.0 - cosPhi * cosPhi));
+
+  // 2 cos(phi + 2 pi / 3) = -cos(phi) - sqrt(3) sin(phi)
+  eigenValues[2] = q + 2.0 * p * cosPhi;
+  eigenValues[0] = q - p * (cosPhi + sqrt(3.0) * sinPhi);
+  eigenValues[1] = 3.0 * q - eigenValues[0] - eigenValues[2];
+}
@@ -0,0 +1,475 @@
+/****************************************************************************
+ *
+ * This file is part of the ustk software.
+ * Copyright (C) 2016 - 2017 by Inria. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ustk with software that can not be combined with the GNU
+ * GPL, please contact Inria about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * This software was developed at:
+ * Inria Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ *
+ * If you have questions regarding the use of this file, please contact
+ * Inria at ustk@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Marc Pouliquen
+ *
+ *****************************************************************************/
+
+/*!
+  \example perfVolumeProcessing.cpp
+
+  USTK volume processing benchmark.
+
+  Compares the element-wise, reduction and neighbourhood operators of usVolumeProcessing, implemented with
+  usVoxelOperations, to reference serial implementations (the loops previously used by usVolumeProcessing). For each
+  operator, one comma separated line gives the computation time of the reference and of usVolumeProcessing, the speedup,
+  and the maximum absolute difference between both results. The program fails if this difference exceeds the tolerance
+  of the operator : 0 for the integer operators, the extrema and the derivatives, which must give the same results as
+  the reference, and 1e-9 for the operators whose floating point sums may be computed in a different order.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <visp3/core/vpColVector.h>
+#include <visp3/core/vpMath.h>
+#include <visp3/core/vpTime.h>
+#include <visp3/core/vpUniRand.h>
+#include <visp3/io/vpParseArgv.h>
+#include <visp3/ustk_core/usImage3D.h>
+#include <visp3/ustk_volume_processing/usVolumeProcessing.h>
+
+/* -------------------------------------------------------------------------- */
+/*                         COMMAND LINE OPTIONS                               */
+/* -------------------------------------------------------------------------- */
+
+// List of allowed command line options
+#define GETOPTARGS "cdhn:o:s:"
+
+void usage(const char *name, const char *badparam, unsigned int size, unsigned int iterations);
+bool getOptions(int argc, const char **argv, unsigned int &size, unsigned int &iterations, std::string &output);
+
+/*!
+
+Print the program options.
+
+\param name : Program name.
+\param badparam : Bad parameter name.
+\param size : Default volume size.
+\param iterations : Default number of iterations.
+
+ */
+void usage(const char *name, const char *badparam, unsigned int size, unsigned int iterations)
+{
+  fprintf(stdout, "\n\
+Benchmark of the usVolumeProcessing operators.\n\
+\n\
+SYNOPSIS\n\
+  %s [-s <size>] [-n <iterations>] [-o <csv file>] [-h]\n",
+          name);
+
+  fprintf(stdout, "\n\
+OPTIONS:                                               Default\n\
+  -s <size>                                            %u\n\
+     Height, width and number of frames of the volume.\n\
+\n\
+  -n <iterations>                                      %u\n\
+     Number of timed iterations per operator.\n\
+\n\
+  -o <csv file>\n\
+     Write the results in this file instead of the\n\
+     standard output.\n\
+\n\
+  -h\n\
+     Print the help.\n\n",
+          size, iterations);
+
+  if (badparam) {
+    fprintf(stderr, "ERROR: \n");
+    fprintf(stderr, "\nBad parameter [%s]\n", badparam);
+  }
+}
+
+/*!
+  Set the program options.
+
+  \param argc : Command line number of parameters.
+  \param argv : Array of command line parameters.
+  \param size : Volume size.
+  \param iterations : Number of iterations.
+  \param output : CSV file.
+  \return false if the program has to be stopped, true otherwise.
+*/
+bool getOptions(int argc, const char **argv, unsigned int &size, unsigned int &iterations, std::string &output)
+{
+  const char *optarg_;
+  int c;
+  while ((c = vpParseArgv::parse(argc, argv, GETOPTARGS, &optarg_)) > 1) {
+
+    switch (c) {
+    case 'n':
+      iterations = (unsigned int)atoi(optarg_);
+      break;
+    case 'o':
+      output = optarg_;
+      break;
+    case 's':
+      size = (unsigned int)atoi(optarg_);
+      break;
+    case 'h':
+      usage(argv[0], NULL, size, iterations);
+      return false;
+      break;
+
+    case 'c':
+    case 'd':
+      break;
+
+    default:
+      usage(argv[0], optarg_, size, iterations);
+      return false;
+      break;
+    }
+  }
+
+  if ((c == 1) || (c == -1)) {
+    // standalone param or error
+    usage(argv[0], NULL, size, iterations);
+    std::cerr << "ERROR: " << std::endl;
+    std::cerr << "  Bad argument " << optarg_ << std::endl << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                         REFERENCE IMPLEMENTATIONS                          */
+/* -------------------------------------------------------------------------- */
+
+void referenceDifference(const usImage3D<unsigned char> &src1, const usImage3D<unsigned char> &src2,
+                         usImage3D<int> &dst)
+{
+  dst.resize(src1.getHeight(), src1.getWidth(), src1.getNumberOfFrames());
+  for (unsigned int i = 0; i < src1.getSize(); i++)
+    dst.getData()[i] = src1.getConstData()[i] - src2.getConstData()[i];
+}
+
+void referenceAbsoluteDifference(const usImage3D<unsigned char> &src1, const usImage3D<unsigned char> &src2,
+                                 usImage3D<int> &dst)
+{
+  dst.resize(src1.getHeight(), src1.getWidth(), src1.getNumberOfFrames());
+  for (unsigned int i = 0; i < src1.getSize(); i++)
+    dst.getData()[i] = vpMath::abs(src1.getConstData()[i] - src2.getConstData()[i]);
+}
+
+double referenceMax(const usImage3D<double> &V)
+{
+  double max = V.getConstData()[0];
+  for (unsigned int i = 1; i < V.getSize(); i++)
+    if (V.getConstData()[i] > max)
+      max = V.getConstData()[i];
+  return max;
+}
+
+double referenceMin(const usImage3D<double> &V)
+{
+  double min = V.getConstData()[0];
+  for (unsigned int i = 1; i < V.getSize(); i++)
+    if (V.getConstData()[i] < min)
+      min = V.getConstData()[i];
+  return min;
+}
+
+void referenceBarycenter(const usImage3D<double> &V, double &ic, double &jc, double &kc)
+{
+  double V_sum = 0.0, i_c = 0.0, j_c = 0.0, k_c = 0.0;
+  for (unsigned int k = 0; k < V.getNumberOfFrames(); k++)
+    for (unsigned int j = 0; j < V.getWidth(); j++)
+      for (unsigned int i = 0; i < V.getHeight(); i++) {
+        double val = V(i, j, k);
+        i_c += i * val;
+        j_c += j * val;
+        k_c += k * val;
+        V_sum += val;
+      }
+  ic = i_c / V_sum;
+  jc = j_c / V_sum;
+  kc = k_c / V_sum;
+}
+
+void referenceNorm(const usImage3D<vpColVector> &src, usImage3D<double> &dst)
+{
+  dst.resize(src.getHeight(), src.getWidth(), src.getNumberOfFrames());
+  for (unsigned int i = 0; i < src.getSize(); i++)
+    dst.getData()[i] = src.getConstData()[i].frobeniusNorm();
+}
+
+void referenceDerivative(const usImage3D<double> &src, usImage3D<double> &dst, unsigned int axis)
+{
+  const unsigned int height = src.getHeight();
+  const unsigned int width = src.getWidth();
+  const unsigned int nbFrames = src.getNumberOfFrames();
+  dst.resize(height, width, nbFrames);
+  dst.initData(0.0);
+  for (unsigned int k = (axis == 2); k < nbFrames - (axis == 2); k++)
+    for (unsigned int j = (axis == 1); j < width - (axis == 1); j++)
+      for (unsigned int i = (axis == 0); i < height - (axis == 0); i++) {
+        if (axis == 0)
+          dst(i, j, k, (src(i + 1, j, k) - src(i - 1, j, k)) / 2.0);
+        else if (axis == 1)
+          dst(i, j, k, (src(i, j + 1, k) - src(i, j - 1, k)) / 2.0);
+        else
+          dst(i, j, k, (src(i, j, k + 1) - src(i, j, k - 1)) / 2.0);
+      }
+}
+
+void referenceGradient(const usImage3D<double> &src, usImage3D<vpColVector> &dst)
+{
+  usImage3D<double> Gi, Gj, Gk;
+  referenceDerivative(src, Gi, 0);
+  referenceDerivative(src, Gj, 1);
+  referenceDerivative(src, Gk, 2);
+  dst.resize(src.getHeight(), src.getWidth(), src.getNumberOfFrames());
+  for (unsigned int i = 0; i < src.getSize(); i++) {
+    vpColVector v(3);
+    v[0] = Gi.getConstData()[i];
+    v[1] = Gj.getConstData()[i];
+    v[2] = Gk.getConstData()[i];
+    dst.getData()[i] = v;
+  }
+}
+
+void referenceFilter(const usImage3D<double> &src, usImage3D<double> &dst, const usImage3D<double> &filter)
+{
+  const unsigned int s = filter.getHeight();
+  const unsigned int m = s / 2;
+  dst.resize(src.getHeight(), src.getWidth(), src.getNumberOfFrames());
+  dst.initData(0.0);
+  for (unsigned int k = s; k < src.getNumberOfFrames() - s; k++)
+    for (unsigned int j = s; j < src.getWidth() - s; j++)
+      for (unsigned int i = s; i < src.getHeight() - s; i++) {
+        double v = 0.0;
+        for (unsigned int k_it = 0; k_it < s; k_it++)
+          for (unsigned int j_it = 0; j_it < s; j_it++)
+            for (unsigned int i_it = 0; i_it < s; i_it++)
+              v += filter(i_it, j_it, k_it) * src(i + i_it - m, j + j_it - m, k + k_it - m);
+        dst(i, j, k, v);
+      }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               COMPARISONS                                  */
+/* -------------------------------------------------------------------------- */
+
+template <class Type> double maxDifference(const usImage3D<Type> &V1, const usImage3D<Type> &V2)
+{
+  double e = 0.0;
+  for (unsigned int i = 0; i < V1.getSize(); i++)
+    e = std::max(e, (double)vpMath::abs(V1.getConstData()[i] - V2.getConstData()[i]));
+  return e;
+}
+
+double maxDifference(const usImage3D<vpColVector> &V1, const usImage3D<vpColVector> &V2)
+{
+  double e = 0.0;
+  for (unsigned int i = 0; i < V1.getSize(); i++)
+    e = std::max(e, (V1.getConstData()[i] - V2.getConstData()[i]).frobeniusNorm());
+  return e;
+}
+
+bool printLine(std::ostream &csv, const std::string &name, unsigned int size, double referenceMs, double ms,
+               double error, double tolerance)
+{
+  csv << name << "," << size << "," << referenceMs << "," << ms << "," << referenceMs / std::max(ms, 1e-6) << ","
+      << error << std::endl;
+  if (error > tolerance) {
+    std::cerr << "ERROR: " << name << " differs from the reference by " << error << " (tolerance " << tolerance << ")"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                               MAIN FUNCTION                                */
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, const char **argv)
+{
+  try {
+    unsigned int size = 96;
+    unsigned int iterations = 3;
+    std::string output;
+
+    // Read the command line options
+    if (getOptions(argc, argv, size, iterations, output) == false) {
+      exit(-1);
+    }
+    if (size < 16 || iterations == 0) {
+      std::cerr << "ERROR: the volume size should be at least 16, with at least 1 iteration" << std::endl;
+      exit(-1);
+    }
+
+    std::ofstream file;
+    if (!output.empty()) {
+      file.open(output.c_str());
+      if (!file.is_open()) {
+        std::cerr << "ERROR: cannot open " << output << std::endl;
+        exit(-1);
+      }
+    }
+    std::ostream &csv = output.empty() ? std::cout : file;
+
+    // random volumes
+    vpUniRand random(42);
+    usImage3D<unsigned char> V1(size, size, size), V2(size, size, size);
+    usImage3D<double> Vd(size, size, size);
+    usImage3D<vpColVector> Vv(size, size, size);
+    for (unsigned int i = 0; i < V1.getSize(); i++) {
+      V1.getData()[i] = (unsigned char)(255.0 * random());
+      V2.getData()[i] = (unsigned char)(255.0 * random());
+      Vd.getData()[i] = 255.0 * random();
+      vpColVector v(3);
+      v[0] = 2.0 * random() - 1.0;
+      v[1] = 2.0 * random() - 1.0;
+      v[2] = 2.0 * random() - 1.0;
+      Vv.getData()[i] = v;
+    }
+    usImage3D<double> filter = usVolumeProcessing::generateGaussianDerivativeFilterI(1, 5);
+
+    csv << "operator,size,reference_ms,ms,speedup,max_error" << std::endl;
+
+    // tolerance of the operators whose floating point sums are reordered
+    const double sumTolerance = 1e-9;
+    bool success = true;
+
+    usImage3D<int> Ri, Oi;
+    usImage3D<double> Rd, Od;
+    usImage3D<vpColVector> Rv, Ov;
+    double t0, t1, t2;
+
+    t0 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      referenceDifference(V1, V2, Ri);
+    t1 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      usVolumeProcessing::difference(V1, V2, Oi);
+    t2 = vpTime::measureTimeMs();
+    success &= printLine(csv, "difference", size, (t1 - t0) / iterations, (t2 - t1) / iterations,
+                         maxDifference(Ri, Oi), 0.0);
+
+    t0 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      referenceAbsoluteDifference(V1, V2, Ri);
+    t1 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      usVolumeProcessing::absoluteDifference(V1, V2, Oi);
+    t2 = vpTime::measureTimeMs();
+    success &= printLine(csv, "absoluteDifference", size, (t1 - t0) / iterations, (t2 - t1) / iterations,
+                         maxDifference(Ri, Oi), 0.0);
+
+    double r = 0.0, o = 0.0;
+    t0 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      r = referenceMax(Vd);
+    t1 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      o = usVolumeProcessing::max(Vd);
+    t2 = vpTime::measureTimeMs();
+    success &= printLine(csv, "max", size, (t1 - t0) / iterations, (t2 - t1) / iterations, vpMath::abs(r - o), 0.0);
+
+    t0 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      r = referenceMin(Vd);
+    t1 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      o = usVolumeProcessing::min(Vd);
+    t2 = vpTime::measureTimeMs();
+    success &= printLine(csv, "min", size, (t1 - t0) / iterations, (t2 - t1) / iterations, vpMath::abs(r - o), 0.0);
+
+    vpColVector rb(3), ob(3);
+    t0 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      referenceBarycenter(Vd, rb[0], rb[1], rb[2]);
+    t1 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      usVolumeProcessing::computeBarycenter(Vd, ob[0], ob[1], ob[2]);
+    t2 = vpTime::measureTimeMs();
+    success &= printLine(csv, "computeBarycenter", size, (t1 - t0) / iterations, (t2 - t1) / iterations,
+                         (rb - ob).frobeniusNorm(), sumTolerance);
+
+    t0 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      referenceNorm(Vv, Rd);
+    t1 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      usVolumeProcessing::norm(Vv, Od);
+    t2 = vpTime::measureTimeMs();
+    success &= printLine(csv, "norm", size, (t1 - t0) / iterations, (t2 - t1) / iterations, maxDifference(Rd, Od), 0.0);
+
+    const char *derivatives[3] = {"derivativeI", "derivativeJ", "derivativeK"};
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      t0 = vpTime::measureTimeMs();
+      for (unsigned int n = 0; n < iterations; n++)
+        referenceDerivative(Vd, Rd, axis);
+      t1 = vpTime::measureTimeMs();
+      for (unsigned int n = 0; n < iterations; n++) {
+        if (axis == 0)
+          usVolumeProcessing::derivativeI(Vd, Od);
+        else if (axis == 1)
+          usVolumeProcessing::derivativeJ(Vd, Od);
+        else
+          usVolumeProcessing::derivativeK(Vd, Od);
+      }
+      t2 = vpTime::measureTimeMs();
+      success &= printLine(csv, derivatives[axis], size, (t1 - t0) / iterations, (t2 - t1) / iterations,
+                           maxDifference(Rd, Od), 0.0);
+    }
+
+    t0 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      referenceGradient(Vd, Rv);
+    t1 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      usVolumeProcessing::gradient(Vd, Ov);
+    t2 = vpTime::measureTimeMs();
+    success &= printLine(csv, "gradient", size, (t1 - t0) / iterations, (t2 - t1) / iterations,
+                         maxDifference(Rv, Ov), 0.0);
+
+    t0 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      referenceFilter(Vd, Rd, filter);
+    t1 = vpTime::measureTimeMs();
+    for (unsigned int n = 0; n < iterations; n++)
+      usVolumeProcessing::applyFilter(Vd, Od, filter);
+    t2 = vpTime::measureTimeMs();
+    success &= printLine(csv, "applyFilter", size, (t1 - t0) / iterations, (t2 - t1) / iterations,
+                         maxDifference(Rd, Od), sumTolerance);
+
+    return success ? 0 : 1;
+  } catch (const vpException &e) {
+    std::cerr << "Catch an exception: " << e.getMessage() << std::endl;
+    return 1;
+  }
+}
@@ -41,6 +41,7 @@
 #include <visp3/core/vpColVector.h>
 #include <visp3/core/vpMatrix.h>
 #include <visp3/ustk_core/usImage3D.h>
+#include <visp3/ustk_core/usImage3DView.h>
 
 int main()
 {
@@ -118,6 +119,37 @@ int main()
   usVolumeProcessing::applyFilter(V1, Vfiltered, filterJK);
   std::cout << "done: usVolumeProcessing::applyFilter filterJK" << std::endl;
 
+  // the filter applied on a region of interest gives the same result as on a copy of the region, and the same result
+  // as on the whole volume for the voxels far enough from the borders of the region
+  usImage3D<unsigned char> Vpattern(size, size, size);
+  for (unsigned int k = 0; k < size; k++)
+    for (unsigned int i = 0; i < size; i++)
+      for (unsigned int j = 0; j < size; j++)
+        Vpattern(i, j, k, (unsigned char)((7 * i + 13 * j * j + 3 * k * i) % 256));
+  usImage3D<double> VpatternFiltered;
+  usVolumeProcessing::applyFilter(Vpattern, VpatternFiltered, filterJK);
+  usImage3DView<unsigned char> Vview(Vpattern, 10, 20, 30, 40, 50, 60);
+  usImage3D<double> VviewFiltered;
+  usVolumeProcessing::applyFilter(Vview, VviewFiltered, filterJK);
+  usImage3D<unsigned char> Vroi;
+  Vview.toImage3D(Vroi);
+  usImage3D<double> VroiFiltered;
+  usVolumeProcessing::applyFilter(Vroi, VroiFiltered, filterJK);
+  if (!(VviewFiltered == VroiFiltered)) {
+    std::cout << "usVolumeProcessing::applyFilter on usImage3DView differs from the filtered copy of the region"
+              << std::endl;
+    return 1;
+  }
+  const unsigned int margin = filterJK.getHeight();
+  for (unsigned int k = margin; k + margin < VviewFiltered.getNumberOfFrames(); k++)
+    for (unsigned int i = margin; i + margin < VviewFiltered.getHeight(); i++)
+      for (unsigned int j = margin; j + margin < VviewFiltered.getWidth(); j++)
+        if (VviewFiltered(i, j, k) != VpatternFiltered(10 + i, 20 + j, 30 + k)) {
+          std::cout << "usVolumeProcessing::applyFilter on usImage3DView differs from the filtered volume" << std::endl;
+          return 1;
+        }
+  std::cout << "done: usVolumeProcessing::applyFilter on usImage3DView" << std::endl;
+
   usVolumeProcessing::derivativeI(V1, V1.getHeight() / 2, V1.getWidth() / 2, V1.getNumberOfFrames() / 2);
   std::cout << "done: usVolumeProcessing::derivativeI to voxel" << std::endl;
   usVolumeProcessing::derivativeJ(V1, V1.getHeight() / 2, V1.getWidth() / 2, V1.getNumberOfFrames() / 2);
@@ -139,6 +171,14 @@ int main()
   usVolumeProcessing::gaussianDerivativeK(V1, Vfiltered, 1, 5);
   std::cout << "done: usVolumeProcessing::gaussianDerivativeK" << std::endl;
 
+  std::vector<double> gaussian = usVolumeProcessing::generateGaussianDerivativeFilter1D(1, 5, 0);
+  std::vector<double> derivative = usVolumeProcessing::generateGaussianDerivativeFilter1D(1, 5, 1);
+  std::cout << "done: usVolumeProcessing::generateGaussianDerivativeFilter1D" << std::endl;
+  usVolumeProcessing::applySeparableFilter(V1, Vfiltered, derivative, gaussian, gaussian);
+  std::cout << "done: usVolumeProcessing::applySeparableFilter" << std::endl;
+  usVolumeProcessing::recursiveGaussianDerivative(V1, Vfiltered, 2, 1, 0, 0);
+  std::cout << "done: usVolumeProcessing::recursiveGaussianDerivative" << std::endl;
+
   usImage3D<vpColVector> Vgrad;
   usVolumeProcessing::gradient(V1, Vgrad);
   std::cout << "done: usVolumeProcessing::gradient" << std::endl;
@@ -146,13 +186,28 @@ int main()
   usImage3D<vpMatrix> Vhes;
   usVolumeProcessing::hessian(V1, Vhes);
   std::cout << "done: usVolumeProcessing::hessian" << std::endl;
-#ifdef VISP_HAVE_GSL
+  usVolumeProcessing::usHessian3D VhesComponents;
+  usVolumeProcessing::hessian(V1, VhesComponents);
+  std::cout << "done: usVolumeProcessing::hessian components" << std::endl;
   usVolumeProcessing::frangi(V1, Vfiltered, 1, 1, 1);
   std::cout << "done: usVolumeProcessing::frangi" << std::endl;
-#else
-  std::cout << "ViSP does not have GSL 3rd party to compute usVolumeProcessing::frangi, skipping frangi test."
-            << std::endl;
-#endif
+  usVolumeProcessing::frangi(VhesComponents, Vfiltered, 1, 1, 1);
+  std::cout << "done: usVolumeProcessing::frangi from hessian components" << std::endl;
+  std::vector<double> sigmas;
+  sigmas.push_back(1);
+  sigmas.push_back(2);
+  usImage3D<double> VbestScale;
+  usVolumeProcessing::frangiMultiScale(V1, Vfiltered, VbestScale, sigmas, 1, 1, 1);
+  std::cout << "done: usVolumeProcessing::frangiMultiScale" << std::endl;
+
+  double eigenValues[3];
+  usVolumeProcessing::symmetricEigenValues(2, 0, 0, -1, 0, 0, eigenValues);
+  if (vpMath::abs(eigenValues[0] + 1) > 1e-9 || vpMath::abs(eigenValues[1]) > 1e-9 ||
+      vpMath::abs(eigenValues[2] - 2) > 1e-9) {
+    std::cout << "usVolumeProcessing::symmetricEigenValues failed" << std::endl;
+    return 1;
+  }
+  std::cout << "done: usVolumeProcessing::symmetricEigenValues" << std::endl;
 
   usImage3D<vpColVector> Vvect(size, size, size, vpColVector(3, 1));
   std::cout << "done: usImage3D<vpColVector> contructor with sizes and initialization" << std::endl;
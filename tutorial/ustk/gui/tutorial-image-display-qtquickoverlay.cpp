@@ -56,9 +56,9 @@ int main(int argc, char **argv)
 
   // send new images via qt signal
   qRegisterMetaType<usImagePreScan2D<unsigned char> >("usImagePreScan2D<unsigned char>");
-  QObject::connect(qtGrabber, SIGNAL(newFrame(usImagePreScan2D<unsigned char>)), widget,
+  QObject::connect(qtGrabber, SIGNAL(newFrame(usImagePreScan2D<unsigned char>, quint64)), widget,
                    SLOT(updateFrame(usImagePreScan2D<unsigned char>)));
-  QObject::connect(qtGrabber, SIGNAL(newFrame(usImagePreScan2D<unsigned char>)), tracker,
+  QObject::connect(qtGrabber, SIGNAL(newFrame(usImagePreScan2D<unsigned char>, quint64)), tracker,
                    SLOT(updateImage(usImagePreScan2D<unsigned char>)));
 
   // updates the GUI based on the tracking output
@@ -99,11 +99,11 @@ int main(int argc, char **argv)
 
   // send new images via qt signal
   qRegisterMetaType<usImagePreScan2D<unsigned char> >("usImagePreScan2D<unsigned char>");
-  QObject::connect(qtGrabber, SIGNAL(newFrame(usImagePreScan2D<unsigned char>)), widget,
+  QObject::connect(qtGrabber, SIGNAL(newFrame(usImagePreScan2D<unsigned char>, quint64)), widget,
                    SLOT(updateFrame(usImagePreScan2D<unsigned char>)));
 
   // confidence controller
-  QObject::connect(qtGrabber, SIGNAL(newFrame(usImagePreScan2D<unsigned char>)), confidenceController,
+  QObject::connect(qtGrabber, SIGNAL(newFrame(usImagePreScan2D<unsigned char>, quint64)), confidenceController,
                    SLOT(updateImage(usImagePreScan2D<unsigned char>)));
   QObject::connect(widget, SIGNAL(confidenceServoing(bool)), confidenceController, SLOT(activateController(bool)));
   QObject::connect(confidenceController, SIGNAL(updateProbeOrientation(int)), &viperControl,
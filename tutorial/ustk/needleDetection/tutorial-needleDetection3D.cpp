@@ -0,0 +1,92 @@
+/****************************************************************************
+ *
+ * This file is part of the UsNeedleDetection software.
+ * Copyright (C) 2013 - 2016 by Inria. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License ("GPL") as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ * See the file COPYING at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact the
+ * authors at Alexandre.Krupa@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Authors:
+ * Pierre Chatelain
+ * Alexandre Krupa
+ *
+ *****************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+
+// ustk
+#include <visp3/ustk_core/us.h>
+#include <visp3/ustk_core/usSequenceReader3D.h>
+#include <visp3/ustk_needle_detection/usNeedleDetector3D.h>
+
+int main(int argc, const char *argv[])
+{
+  std::string vol_filename;
+  unsigned int order = 1;
+
+  for (int i = 0; i < argc; i++) {
+    if (std::string(argv[i]) == "--input" && i + 1 < argc)
+      vol_filename = std::string(argv[i + 1]);
+    else if (std::string(argv[i]) == "--order" && i + 1 < argc)
+      order = static_cast<unsigned int>(atoi(argv[i + 1]));
+    else if (std::string(argv[i]) == "--help") {
+      std::cout << "\nUsage: " << argv[0] << " [--input <file.vol>] [--order <needle model order>] [--help]\n"
+                << std::endl;
+      return 0;
+    }
+  }
+
+  // Get the ustk-dataset package path or USTK_DATASET_PATH environment variable value
+  if (vol_filename.empty()) {
+    std::string env_ipath = us::getDataSetPath();
+    if (!env_ipath.empty())
+      vol_filename = env_ipath + "/vol/01.vol";
+    else {
+      std::cout << "You should set USTK_DATASET_PATH environment var to access to ustk dataset" << std::endl;
+      return 0;
+    }
+  }
+
+  usSequenceReader3D<usImagePreScan3D<unsigned char> > reader;
+  reader.setSequenceFileName(vol_filename);
+  usImagePreScan3D<unsigned char> volume;
+
+  usNeedleDetector3D detector;
+  detector.setOrder(order);
+
+  while (!reader.end()) {
+    reader.acquire(volume);
+
+    if (detector.detect(volume)) {
+      const usPolynomialCurve3D &needle = detector.getNeedle();
+      std::cout << "volume " << reader.getImageNumber() << ": needle from " << needle.getStartPoint().t() << " to "
+                << needle.getEndPoint().t() << " (" << detector.getInlierNumber() << " inliers)" << std::endl;
+    } else
+      std::cout << "volume " << reader.getImageNumber() << ": no needle found" << std::endl;
+
+    std::cout << "  thresholding " << detector.getStageTime(usNeedleDetector3D::THRESHOLDING_STAGE)
+              << " ms, hashing " << detector.getStageTime(usNeedleDetector3D::HASHING_STAGE) << " ms, RANSAC "
+              << detector.getStageTime(usNeedleDetector3D::RANSAC_STAGE) << " ms, refinement "
+              << detector.getStageTime(usNeedleDetector3D::REFINEMENT_STAGE) << " ms" << std::endl;
+  }
+
+  return 0;
+}
@@ -62,8 +62,8 @@ int main(int argc, char **argv)
                    SLOT(updateFrame(vpImage<vpRGBa>)));
 
   qRegisterMetaType<usImageRF2D<short int> >("usImageRF2D<short int>&");
-  QObject::connect(qtGrabber, SIGNAL(newFrame(usImageRF2D<short int> &)), elastoGenerator,
-                   SLOT(updateFrame(usImageRF2D<short int> &)));
+  QObject::connect(qtGrabber, SIGNAL(newFrame(usImageRF2D<short int> &, quint64)), elastoGenerator,
+                   SLOT(updateFrame(usImageRF2D<short int> &, quint64)));
 
   usImageRF2D<short int> rfFrame;
   // our grabbing loop
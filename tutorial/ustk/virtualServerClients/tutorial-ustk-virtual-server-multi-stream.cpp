@@ -0,0 +1,82 @@
+//! \example tutorial-ustk-virtual-server-multi-stream.cpp
+
+#include <iostream>
+#include <visp3/ustk_core/usConfig.h>
+
+#if (defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT))
+
+#include <QApplication>
+#include <QStringList>
+
+#include <visp3/core/vpException.h>
+#include <visp3/ustk_grabber/usNetworkGrabberManager.h>
+
+// Grabs pre-scan frames from several virtual servers running on the local host, on consecutive ports :
+//   ustk-virtualServer --synthetic prescan2d --port 8080
+//   ustk-virtualServer --synthetic prescan2d --port 8081
+//   tutorial-ustk-virtual-server-multi-stream --streams 2 --threads 1
+int main(int argc, char **argv)
+{
+  // QT application
+  QApplication app(argc, argv);
+
+  unsigned int streamNumber = 2;
+  unsigned int threadNumber = 1;
+  if (qApp->arguments().contains(QString("--streams")))
+    streamNumber = qApp->arguments().at(qApp->arguments().indexOf(QString("--streams")) + 1).toUInt();
+  if (qApp->arguments().contains(QString("--threads")))
+    threadNumber = qApp->arguments().at(qApp->arguments().indexOf(QString("--threads")) + 1).toUInt();
+
+  // setting acquisition parameters
+  usNetworkGrabber::usInitHeaderSent header;
+  header.probeId = 0;     // 4DC7 id = 15
+  header.slotId = 0;      // top slot id = 0
+  header.imagingMode = 0; // B-mode = 0
+
+  std::vector<usNetworkGrabberPreScan2D *> grabbers;
+  for (unsigned int i = 0; i < streamNumber; i++) {
+    grabbers.push_back(new usNetworkGrabberPreScan2D());
+    grabbers.back()->setIPAddress("127.0.0.1"); // local loop, servers must be running on same computer
+    grabbers.back()->setPort(8080 + i);
+    grabbers.back()->connectToServer();
+    grabbers.back()->initAcquisition(header);
+  }
+  std::cout << "init success" << std::endl;
+
+  usNetworkGrabberManager *manager = new usNetworkGrabberManager(threadNumber);
+  for (unsigned int i = 0; i < streamNumber; i++)
+    manager->addStream(grabbers.at(i));
+  manager->runAcquisition();
+
+  // our local grabbing loop : time-aligned sets of frames (20 ms tolerance)
+  std::vector<usNetworkGrabberManager::usStreamFrame> frameSet;
+  try {
+    for (unsigned int n = 0; n < 500; n++) {
+      bool aligned = manager->acquireAll(frameSet, 20.0);
+      std::cout << "MAIN THREAD received set" << (aligned ? "" : " (not aligned)") << " :";
+      for (unsigned int i = 0; i < frameSet.size(); i++)
+        std::cout << " stream " << frameSet.at(i).streamId << " frame " << frameSet.at(i).frameCount << " ("
+                  << frameSet.at(i).timeStamp << " ms)";
+      std::cout << std::endl;
+    }
+  } catch (const vpException &e) {
+    // a server stopped sending frames
+    std::cout << e.getStringMessage() << std::endl;
+  }
+
+  // manager is deleted before the grabbers
+  delete manager;
+  for (unsigned int i = 0; i < grabbers.size(); i++)
+    delete grabbers.at(i);
+
+  return 0;
+}
+
+#else
+int main()
+{
+  std::cout << "You should intall Qt5 (with wigdets and network modules) to run this tutorial" << std::endl;
+  return 0;
+}
+
+#endif
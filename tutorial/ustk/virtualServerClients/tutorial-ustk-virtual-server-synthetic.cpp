@@ -0,0 +1,132 @@
+//! \example tutorial-ustk-virtual-server-synthetic.cpp
+
+#include <iostream>
+#include <visp3/ustk_core/usConfig.h>
+
+#if (defined(USTK_HAVE_QT5) || defined(USTK_HAVE_VTK_QT))
+
+#include <QApplication>
+#include <QStringList>
+
+#include <visp3/core/vpTime.h>
+#include <visp3/ustk_core/usFrameStamp.h>
+#include <visp3/ustk_grabber/usNetworkGrabberPostScan2D.h>
+#include <visp3/ustk_grabber/usNetworkGrabberPreScan2D.h>
+
+// Checks the stamp of a frame grabbed, and updates the stream statistics
+void checkFrame(const unsigned char *bitmap, unsigned int size, bool &firstFrame, uint32_t &lastFrameCount,
+                unsigned int &receivedNumber, unsigned int &skippedNumber, unsigned int &outOfOrderNumber,
+                unsigned int &corruptedNumber, double &latencySum, double &latencyMax)
+{
+  uint32_t frameCount;
+  uint64_t sendTime;
+  if (!usFrameStamp::read(bitmap, size, frameCount, sendTime)) {
+    corruptedNumber++;
+    return;
+  }
+  receivedNumber++;
+
+  if (!firstFrame) {
+    if (frameCount <= lastFrameCount)
+      outOfOrderNumber++;
+    else
+      skippedNumber += frameCount - lastFrameCount - 1; // frames overwritten in the grabber buffers
+  }
+  firstFrame = false;
+  lastFrameCount = frameCount;
+
+  double latency = (usFrameStamp::now() - sendTime) / 1000.0; // ms
+  latencySum += latency;
+  if (latency > latencyMax)
+    latencyMax = latency;
+}
+
+int main(int argc, char **argv)
+{
+  // QT application
+  QApplication app(argc, argv);
+
+  // the virtual server must be run with "--synthetic prescan2d" (default), or "--synthetic postscan2d" if the
+  // --postscan option is given to this client
+  bool postScan = qApp->arguments().contains(QString("--postscan"));
+  unsigned int frameNumber = 1000;
+  if (qApp->arguments().contains(QString("--frames")))
+    frameNumber = qApp->arguments().at(qApp->arguments().indexOf(QString("--frames")) + 1).toUInt();
+
+  usNetworkGrabberPreScan2D *preScanGrabber = NULL;
+  usNetworkGrabberPostScan2D *postScanGrabber = NULL;
+  usNetworkGrabber *qtGrabber;
+  if (postScan) {
+    postScanGrabber = new usNetworkGrabberPostScan2D();
+    qtGrabber = postScanGrabber;
+  } else {
+    preScanGrabber = new usNetworkGrabberPreScan2D();
+    qtGrabber = preScanGrabber;
+  }
+  qtGrabber->setIPAddress("127.0.0.1"); // local loop, server must be running on same computer
+  qtGrabber->connectToServer();
+
+  // setting acquisition parameters
+  usNetworkGrabber::usInitHeaderSent header;
+  header.probeId = 0;     // 4DC7 id = 15
+  header.slotId = 0;      // top slot id = 0
+  header.imagingMode = 0; // B-mode = 0
+
+  qtGrabber->initAcquisition(header);
+  std::cout << "init success" << std::endl;
+  qtGrabber->runAcquisition();
+
+  std::cout << "waiting ultrasound initialisation..." << std::endl;
+
+  // stream statistics
+  bool firstFrame = true;
+  uint32_t lastFrameCount = 0;
+  unsigned int receivedNumber = 0;
+  unsigned int skippedNumber = 0;
+  unsigned int outOfOrderNumber = 0;
+  unsigned int corruptedNumber = 0;
+  double latencySum = 0.0;
+  double latencyMax = 0.0;
+
+  // our local grabbing loop
+  while (receivedNumber + corruptedNumber < frameNumber) {
+    if (!qtGrabber->isFirstFrameAvailable()) {
+      vpTime::wait(10);
+      continue;
+    }
+    if (postScan) {
+      usFrameGrabbedInfo<usImagePostScan2D<unsigned char> > *grabbedFrame = postScanGrabber->acquire();
+      checkFrame(grabbedFrame->bitmap, grabbedFrame->getSize(), firstFrame, lastFrameCount, receivedNumber,
+                 skippedNumber, outOfOrderNumber, corruptedNumber, latencySum, latencyMax);
+    } else {
+      usFrameGrabbedInfo<usImagePreScan2D<unsigned char> > *grabbedFrame = preScanGrabber->acquire();
+      checkFrame(grabbedFrame->bitmap, grabbedFrame->getSize(), firstFrame, lastFrameCount, receivedNumber,
+                 skippedNumber, outOfOrderNumber, corruptedNumber, latencySum, latencyMax);
+    }
+  }
+
+  qtGrabber->stopAcquisition();
+
+  std::cout << "frames received : " << receivedNumber << std::endl;
+  std::cout << "frames skipped : " << skippedNumber << std::endl;
+  std::cout << "frames out of order : " << outOfOrderNumber << std::endl;
+  std::cout << "frames corrupted : " << corruptedNumber << std::endl;
+  if (receivedNumber > 0)
+    std::cout << "latency (ms) : mean " << latencySum / receivedNumber << ", max " << latencyMax << std::endl;
+
+  if (postScan)
+    delete postScanGrabber;
+  else
+    delete preScanGrabber;
+
+  return 0;
+}
+
+#else
+int main()
+{
+  std::cout << "You should intall Qt5 (with wigdets and network modules) to run this tutorial" << std::endl;
+  return 0;
+}
+
+#endif